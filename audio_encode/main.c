@@ -1,18 +1,105 @@
 /**
  * @file
- * audio encoding with libavcodec API example.
+ * audio transcoding with libavcodec API example.
+ *
+ * The input file is decoded, resampled with a persistent SwrContext to the
+ * encoder format and encoded to AAC, Opus or MP2. Decoding, resampling and
+ * encoding run as pipelined stages on their own threads, connected by bounded
+ * frame queues, and the output is muxed through a large AVIOContext buffer.
+ * In directory mode every file of the input directory is transcoded, several
+ * files in parallel. The realtime factor of each file is reported.
  *
  * @example encode_audio.c
  */
 
 #include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/common.h>
 #include <libavutil/frame.h>
 #include <libavutil/samplefmt.h>
+#include <libavutil/time.h>
+#include <libswresample/swresample.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* frames buffered between two stages */
+#define QUEUE_SIZE 16
+
+/* the muxer writes the output in chunks of this size */
+#define IO_BUFFER_SIZE (1 << 20)
+
+/* encoder frame size when the encoder accepts any */
+#define DEFAULT_FRAME_SIZE 1024
+
+#define DEFAULT_BIT_RATE 128000
+
+#define MAX_JOBS 64
+
+#define PATH_SIZE 1024
+
+typedef struct Options {
+  const char *codec_name; /* NULL: guessed from the output file name */
+  int64_t bit_rate;
+  int jobs;
+} Options;
+
+/* bounded queue of frames between two stages: put() blocks while it is full,
+ * get() while it is empty and not finished */
+typedef struct FrameQueue {
+  AVFrame *frames[QUEUE_SIZE];
+  int rindex, size;
+  int finished; /* the producer is done */
+  int aborted;  /* a stage failed: everything stops */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} FrameQueue;
+
+/* a file being transcoded: the decode and resample stages run on their own
+ * threads, the encode stage on the calling one */
+typedef struct Transcoder {
+  const Options *opts;
+  const char *input;
+  const char *output;
+
+  AVFormatContext *ifmt;
+  AVCodecContext *dec;
+  int stream_index;
+
+  AVFormatContext *ofmt;
+  AVCodecContext *enc;
+  AVStream *ost;
+  FILE *file;
+
+  SwrContext *swr;
+  AVAudioFifo *fifo;
+  uint8_t **conv_data; /* swr_convert() output, before the fifo */
+  int conv_size;
+  int frame_size;
+  int64_t next_pts;
+
+  FrameQueue decoded;
+  FrameQueue resampled;
+} Transcoder;
+
+/* the files of the directory mode, shared by the jobs */
+typedef struct Batch {
+  const Options *opts;
+  char **inputs;
+  char **outputs;
+  int nb_files;
+  int next_file;
+  int failed;
+  pthread_mutex_t mutex;
+} Batch;
 
 /* check that a given sample format is supported by the encoder */
 static int check_sample_fmt(const AVCodec *codec,
@@ -26,34 +113,39 @@ static int check_sample_fmt(const AVCodec *codec,
   return 0;
 }
 
-/* just pick the highest supported samplerate */
-static int select_sample_rate(const AVCodec *codec) {
+/* pick the supported samplerate closest to the input one */
+static int select_sample_rate(const AVCodec *codec, int sample_rate) {
   const int *p;
   int best_samplerate = 0;
 
-  if (!codec->supported_samplerates) return 44100;
+  if (!codec->supported_samplerates) return sample_rate;
 
   p = codec->supported_samplerates;
   while (*p) {
-    if (!best_samplerate || abs(44100 - *p) < abs(44100 - best_samplerate))
+    if (!best_samplerate ||
+        abs(sample_rate - *p) < abs(sample_rate - best_samplerate))
       best_samplerate = *p;
     p++;
   }
   return best_samplerate;
 }
 
-/* select layout with the highest channel count */
-static int select_channel_layout(const AVCodec *codec) {
+/* keep the input layout if supported, otherwise select the layout with the
+ * highest channel count */
+static uint64_t select_channel_layout(const AVCodec *codec,
+                                      uint64_t channel_layout) {
   const uint64_t *p;
   uint64_t best_ch_layout = 0;
   int best_nb_channels = 0;
 
-  if (!codec->channel_layouts) return AV_CH_LAYOUT_STEREO;
+  if (!codec->channel_layouts) return channel_layout;
 
   p = codec->channel_layouts;
   while (*p) {
     int nb_channels = av_get_channel_layout_nb_channels(*p);
 
+    if (*p == channel_layout) return channel_layout;
+
     if (nb_channels > best_nb_channels) {
       best_ch_layout = *p;
       best_nb_channels = nb_channels;
@@ -63,143 +155,698 @@ static int select_channel_layout(const AVCodec *codec) {
   return best_ch_layout;
 }
 
-static void encode(AVCodecContext *ctx, AVFrame *frame, AVPacket *pkt,
-                   FILE *output) {
+static void queue_init(FrameQueue *q) {
+  memset(q, 0, sizeof(*q));
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->cond, NULL);
+}
+
+static void queue_destroy(FrameQueue *q) {
+  while (q->size > 0) {
+    av_frame_free(&q->frames[q->rindex]);
+    q->rindex = (q->rindex + 1) % QUEUE_SIZE;
+    q->size--;
+  }
+  pthread_cond_destroy(&q->cond);
+  pthread_mutex_destroy(&q->mutex);
+}
+
+/* takes ownership of frame, freed if the queue is aborted */
+static int queue_put(FrameQueue *q, AVFrame *frame) {
+  pthread_mutex_lock(&q->mutex);
+  while (q->size == QUEUE_SIZE && !q->aborted)
+    pthread_cond_wait(&q->cond, &q->mutex);
+
+  if (q->aborted) {
+    pthread_mutex_unlock(&q->mutex);
+    av_frame_free(&frame);
+    return AVERROR_EXIT;
+  }
+
+  q->frames[(q->rindex + q->size) % QUEUE_SIZE] = frame;
+  q->size++;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+  return 0;
+}
+
+/* returns 1 with a frame, 0 once the queue is finished and empty */
+static int queue_get(FrameQueue *q, AVFrame **frame) {
+  int ret = 1;
+
+  pthread_mutex_lock(&q->mutex);
+  while (q->size == 0 && !q->finished && !q->aborted)
+    pthread_cond_wait(&q->cond, &q->mutex);
+
+  if (q->aborted) {
+    ret = AVERROR_EXIT;
+  } else if (q->size == 0) {
+    ret = 0;
+  } else {
+    *frame = q->frames[q->rindex];
+    q->rindex = (q->rindex + 1) % QUEUE_SIZE;
+    q->size--;
+    pthread_cond_signal(&q->cond);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return ret;
+}
+
+static void queue_finish(FrameQueue *q) {
+  pthread_mutex_lock(&q->mutex);
+  q->finished = 1;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+static void queue_abort(FrameQueue *q) {
+  pthread_mutex_lock(&q->mutex);
+  q->aborted = 1;
+  pthread_cond_broadcast(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+/* a failed stage stops the two others */
+static void transcoder_abort(Transcoder *t) {
+  queue_abort(&t->decoded);
+  queue_abort(&t->resampled);
+}
+
+/* AVIOContext callbacks: the muxer flushes its whole buffer at once, the stdio
+ * buffer is disabled */
+static int write_packet(void *opaque, uint8_t *buf, int buf_size) {
+  FILE *f = opaque;
+
+  if (fwrite(buf, 1, buf_size, f) != (size_t)buf_size) return AVERROR(EIO);
+  return buf_size;
+}
+
+static int64_t seek_packet(void *opaque, int64_t offset, int whence) {
+  FILE *f = opaque;
+
+  if (whence == AVSEEK_SIZE) return AVERROR(ENOSYS);
+  if (fseeko(f, offset, whence & ~AVSEEK_FORCE) < 0) return AVERROR(errno);
+  return ftello(f);
+}
+
+static int open_input(Transcoder *t) {
+  AVCodec *codec = NULL;
+  int ret;
+
+  if ((ret = avformat_open_input(&t->ifmt, t->input, NULL, NULL)) < 0) {
+    fprintf(stderr, "Could not open %s\n", t->input);
+    return ret;
+  }
+
+  if ((ret = avformat_find_stream_info(t->ifmt, NULL)) < 0) {
+    fprintf(stderr, "Could not find stream information of %s\n", t->input);
+    return ret;
+  }
+
+  ret = av_find_best_stream(t->ifmt, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+  if (ret < 0 || !codec) {
+    fprintf(stderr, "Could not find an audio stream in %s\n", t->input);
+    return ret < 0 ? ret : AVERROR_DECODER_NOT_FOUND;
+  }
+  t->stream_index = ret;
+
+  t->dec = avcodec_alloc_context3(codec);
+  if (!t->dec) {
+    fprintf(stderr, "Could not allocate audio codec context\n");
+    return AVERROR(ENOMEM);
+  }
+
+  ret = avcodec_parameters_to_context(t->dec,
+                                      t->ifmt->streams[t->stream_index]->codecpar);
+  if (ret < 0) return ret;
+
+  if ((ret = avcodec_open2(t->dec, codec, NULL)) < 0) {
+    fprintf(stderr, "Could not open the decoder of %s\n", t->input);
+    return ret;
+  }
+
+  if (!t->dec->channel_layout)
+    t->dec->channel_layout = av_get_default_channel_layout(t->dec->channels);
+
+  return 0;
+}
+
+static const AVCodec *find_encoder(const char *name) {
+  const AVCodec *codec = NULL;
+
+  /* prefer libopus over the experimental native encoder */
+  if (!strcmp(name, "opus")) codec = avcodec_find_encoder_by_name("libopus");
+  if (!codec) codec = avcodec_find_encoder_by_name(name);
+  if (!codec || codec->type != AVMEDIA_TYPE_AUDIO) return NULL;
+  return codec;
+}
+
+static int open_output(Transcoder *t) {
+  const AVCodec *codec;
+  uint8_t *io_buffer;
+  int ret;
+
+  ret = avformat_alloc_output_context2(&t->ofmt, NULL, NULL, t->output);
+  if (ret < 0) {
+    fprintf(stderr, "Could not guess the output format of %s\n", t->output);
+    return ret;
+  }
+
+  if (t->opts->codec_name) {
+    codec = find_encoder(t->opts->codec_name);
+  } else {
+    codec = avcodec_find_encoder(av_guess_codec(t->ofmt->oformat, NULL,
+                                                t->output, NULL,
+                                                AVMEDIA_TYPE_AUDIO));
+  }
+  if (!codec) {
+    fprintf(stderr, "Codec not found\n");
+    return AVERROR_ENCODER_NOT_FOUND;
+  }
+
+  t->enc = avcodec_alloc_context3(codec);
+  if (!t->enc) {
+    fprintf(stderr, "Could not allocate audio codec context\n");
+    return AVERROR(ENOMEM);
+  }
+
+  /* put sample parameters: the input ones, when supported */
+  t->enc->bit_rate = t->opts->bit_rate;
+  t->enc->sample_fmt = check_sample_fmt(codec, t->dec->sample_fmt)
+                           ? t->dec->sample_fmt
+                           : codec->sample_fmts[0];
+  t->enc->sample_rate = select_sample_rate(codec, t->dec->sample_rate);
+  t->enc->channel_layout =
+      select_channel_layout(codec, t->dec->channel_layout);
+  t->enc->channels = av_get_channel_layout_nb_channels(t->enc->channel_layout);
+  t->enc->time_base = (AVRational){1, t->enc->sample_rate};
+  t->enc->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+  if (t->ofmt->oformat->flags & AVFMT_GLOBALHEADER)
+    t->enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+  /* open it */
+  if ((ret = avcodec_open2(t->enc, codec, NULL)) < 0) {
+    fprintf(stderr, "Could not open codec\n");
+    return ret;
+  }
+
+  t->frame_size =
+      (codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) ||
+              t->enc->frame_size <= 0
+          ? DEFAULT_FRAME_SIZE
+          : t->enc->frame_size;
+
+  t->ost = avformat_new_stream(t->ofmt, NULL);
+  if (!t->ost) return AVERROR(ENOMEM);
+  t->ost->time_base = t->enc->time_base;
+
+  ret = avcodec_parameters_from_context(t->ost->codecpar, t->enc);
+  if (ret < 0) return ret;
+
+  t->file = fopen(t->output, "wb");
+  if (!t->file) {
+    fprintf(stderr, "Could not open %s\n", t->output);
+    return AVERROR(errno);
+  }
+  setvbuf(t->file, NULL, _IONBF, 0);
+
+  io_buffer = av_malloc(IO_BUFFER_SIZE);
+  if (!io_buffer) return AVERROR(ENOMEM);
+
+  t->ofmt->pb = avio_alloc_context(io_buffer, IO_BUFFER_SIZE, 1, t->file,
+                                   NULL, write_packet, seek_packet);
+  if (!t->ofmt->pb) {
+    av_free(io_buffer);
+    return AVERROR(ENOMEM);
+  }
+
+  if ((ret = avformat_write_header(t->ofmt, NULL)) < 0) {
+    fprintf(stderr, "Could not write the header of %s\n", t->output);
+    return ret;
+  }
+
+  return 0;
+}
+
+static int open_resampler(Transcoder *t) {
+  int ret;
+
+  t->swr = swr_alloc_set_opts(NULL, t->enc->channel_layout,
+                              t->enc->sample_fmt, t->enc->sample_rate,
+                              t->dec->channel_layout, t->dec->sample_fmt,
+                              t->dec->sample_rate, 0, NULL);
+  if (!t->swr || (ret = swr_init(t->swr)) < 0) {
+    fprintf(stderr, "Could not initialize the resampler\n");
+    return t->swr ? ret : AVERROR(ENOMEM);
+  }
+
+  t->fifo = av_audio_fifo_alloc(t->enc->sample_fmt, t->enc->channels,
+                                2 * t->frame_size);
+  if (!t->fifo) return AVERROR(ENOMEM);
+
+  return 0;
+}
+
+/* decode stage: demuxes and decodes the audio stream into t->decoded */
+static void *decode_thread(void *arg) {
+  Transcoder *t = arg;
+  AVPacket *pkt = av_packet_alloc();
+  AVFrame *frame = NULL;
+  int ret = pkt ? 0 : AVERROR(ENOMEM);
+
+  while (ret >= 0) {
+    ret = av_read_frame(t->ifmt, pkt);
+    if (ret == AVERROR_EOF) {
+      /* flush the decoder */
+      ret = avcodec_send_packet(t->dec, NULL);
+    } else if (ret >= 0) {
+      if (pkt->stream_index != t->stream_index) {
+        av_packet_unref(pkt);
+        continue;
+      }
+      ret = avcodec_send_packet(t->dec, pkt);
+      av_packet_unref(pkt);
+      /* skip corrupted packets */
+      if (ret == AVERROR_INVALIDDATA) ret = 0;
+    }
+    if (ret < 0) break;
+
+    while (ret >= 0) {
+      if (!frame && !(frame = av_frame_alloc())) {
+        ret = AVERROR(ENOMEM);
+        break;
+      }
+      ret = avcodec_receive_frame(t->dec, frame);
+      if (ret < 0) break;
+
+      ret = queue_put(&t->decoded, frame);
+      frame = NULL;
+    }
+    if (ret == AVERROR(EAGAIN)) ret = 0;
+  }
+
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+
+  if (ret == AVERROR_EOF) {
+    queue_finish(&t->decoded);
+  } else if (ret != AVERROR_EXIT) {
+    fprintf(stderr, "Error while decoding %s\n", t->input);
+    transcoder_abort(t);
+  }
+  return NULL;
+}
+
+/* sends the fifo samples to t->resampled in frames of the encoder frame size;
+ * the last one, when flushing, is shorter or padded with silence */
+static int send_fifo_frames(Transcoder *t, int flush) {
+  int ret;
+
+  while (av_audio_fifo_size(t->fifo) >= t->frame_size ||
+         (flush && av_audio_fifo_size(t->fifo) > 0)) {
+    int nb_samples = FFMIN(av_audio_fifo_size(t->fifo), t->frame_size);
+    int small_last = t->enc->codec->capabilities &
+                     (AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_VARIABLE_FRAME_SIZE);
+    AVFrame *frame = av_frame_alloc();
+
+    if (!frame) return AVERROR(ENOMEM);
+
+    frame->nb_samples = small_last ? nb_samples : t->frame_size;
+    frame->format = t->enc->sample_fmt;
+    frame->channel_layout = t->enc->channel_layout;
+    frame->sample_rate = t->enc->sample_rate;
+
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0) {
+      av_frame_free(&frame);
+      return ret;
+    }
+
+    av_audio_fifo_read(t->fifo, (void **)frame->data, nb_samples);
+    if (nb_samples < frame->nb_samples)
+      av_samples_set_silence(frame->extended_data, nb_samples,
+                             frame->nb_samples - nb_samples, t->enc->channels,
+                             t->enc->sample_fmt);
+
+    frame->pts = t->next_pts;
+    t->next_pts += frame->nb_samples;
+
+    if ((ret = queue_put(&t->resampled, frame)) < 0) return ret;
+  }
+  return 0;
+}
+
+/* converts the given samples, NULL to flush the resampler, into the fifo */
+static int resample(Transcoder *t, const uint8_t **data, int nb_samples) {
+  int out_samples = swr_get_out_samples(t->swr, nb_samples);
+  int ret;
+
+  if (out_samples <= 0) return 0;
+
+  /* the conversion buffer only grows */
+  if (out_samples > t->conv_size) {
+    if (t->conv_data) av_freep(&t->conv_data[0]);
+    av_freep(&t->conv_data);
+
+    ret = av_samples_alloc_array_and_samples(&t->conv_data, NULL,
+                                             t->enc->channels, out_samples,
+                                             t->enc->sample_fmt, 0);
+    if (ret < 0) return ret;
+    t->conv_size = out_samples;
+  }
+
+  ret = swr_convert(t->swr, t->conv_data, out_samples, data, nb_samples);
+  if (ret <= 0) return ret;
+
+  if (av_audio_fifo_write(t->fifo, (void **)t->conv_data, ret) < ret)
+    return AVERROR(ENOMEM);
+
+  return 0;
+}
+
+/* resample stage: converts t->decoded into encoder frames in t->resampled */
+static void *resample_thread(void *arg) {
+  Transcoder *t = arg;
+  AVFrame *frame = NULL;
+  int ret;
+
+  while ((ret = queue_get(&t->decoded, &frame)) > 0) {
+    ret = resample(t, (const uint8_t **)frame->extended_data,
+                   frame->nb_samples);
+    av_frame_free(&frame);
+
+    if (ret >= 0) ret = send_fifo_frames(t, 0);
+    if (ret < 0) break;
+  }
+
+  /* the delayed samples of the resampler, then what is left in the fifo */
+  if (ret == 0) {
+    ret = resample(t, NULL, 0);
+    if (ret >= 0) ret = send_fifo_frames(t, 1);
+  }
+
+  if (ret == 0) {
+    queue_finish(&t->resampled);
+  } else if (ret != AVERROR_EXIT) {
+    fprintf(stderr, "Error while resampling %s\n", t->input);
+    transcoder_abort(t);
+  }
+  return NULL;
+}
+
+static int encode(Transcoder *t, AVFrame *frame, AVPacket *pkt) {
   int ret;
 
   /* send the frame for encoding */
-  ret = avcodec_send_frame(ctx, frame);
+  ret = avcodec_send_frame(t->enc, frame);
   if (ret < 0) {
     fprintf(stderr, "Error sending the frame to the encoder\n");
-    exit(1);
+    return ret;
   }
 
   /* read all the available output packets (in general there may be any
    * number of them */
   while (ret >= 0) {
-    ret = avcodec_receive_packet(ctx, pkt);
+    ret = avcodec_receive_packet(t->enc, pkt);
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-      return;
+      return 0;
     else if (ret < 0) {
       fprintf(stderr, "Error encoding audio frame\n");
-      exit(1);
+      return ret;
     }
 
-    fwrite(pkt->data, 1, pkt->size, output);
-    av_packet_unref(pkt);
+    av_packet_rescale_ts(pkt, t->enc->time_base, t->ost->time_base);
+    pkt->stream_index = t->ost->index;
+
+    /* buffered in the AVIOContext */
+    ret = av_interleaved_write_frame(t->ofmt, pkt);
+    if (ret < 0) {
+      fprintf(stderr, "Error writing audio packet\n");
+      return ret;
+    }
   }
+  return 0;
 }
 
-int main(int argc, char **argv) {
-  const char *filename;
-  const AVCodec *codec;
-  AVCodecContext *c = NULL;
-  AVFrame *frame;
-  AVPacket *pkt;
-  int i, j, k, ret;
-  FILE *f;
-  uint16_t *samples;
-  float t, tincr;
-
-  if (argc <= 1) {
-    fprintf(stderr, "Usage: %s <output file>\n", argv[0]);
-    return 0;
+static void transcoder_close(Transcoder *t) {
+  queue_destroy(&t->decoded);
+  queue_destroy(&t->resampled);
+
+  if (t->ofmt && t->ofmt->pb) {
+    /* the buffer may have been reallocated by libavformat */
+    av_freep(&t->ofmt->pb->buffer);
+    avio_context_free(&t->ofmt->pb);
   }
-  filename = argv[1];
+  if (t->file) fclose(t->file);
+  avformat_free_context(t->ofmt);
+  avcodec_free_context(&t->enc);
 
-  /* find the MP2 encoder */
-  codec = avcodec_find_encoder(AV_CODEC_ID_MP2);
-  if (!codec) {
-    fprintf(stderr, "Codec not found\n");
-    exit(1);
+  avcodec_free_context(&t->dec);
+  avformat_close_input(&t->ifmt);
+
+  swr_free(&t->swr);
+  if (t->fifo) av_audio_fifo_free(t->fifo);
+  if (t->conv_data) av_freep(&t->conv_data[0]);
+  av_freep(&t->conv_data);
+}
+
+/* transcodes input into output and reports the realtime factor */
+static int transcode(const Options *opts, const char *input,
+                     const char *output) {
+  Transcoder t = {0};
+  AVPacket *pkt = NULL;
+  AVFrame *frame = NULL;
+  int decoding = 0, resampling = 0;
+  pthread_t decode_tid, resample_tid;
+  int64_t start = av_gettime_relative();
+  int ret;
+
+  t.opts = opts;
+  t.input = input;
+  t.output = output;
+  queue_init(&t.decoded);
+  queue_init(&t.resampled);
+
+  if ((ret = open_input(&t)) < 0 || (ret = open_output(&t)) < 0 ||
+      (ret = open_resampler(&t)) < 0)
+    goto end;
+
+  pkt = av_packet_alloc();
+  if (!pkt) {
+    fprintf(stderr, "could not allocate the packet\n");
+    ret = AVERROR(ENOMEM);
+    goto end;
   }
 
-  c = avcodec_alloc_context3(codec);
-  if (!c) {
-    fprintf(stderr, "Could not allocate audio codec context\n");
-    exit(1);
+  /* start the pipeline */
+  decoding = !pthread_create(&decode_tid, NULL, decode_thread, &t);
+  resampling =
+      decoding && !pthread_create(&resample_tid, NULL, resample_thread, &t);
+  if (!resampling) {
+    fprintf(stderr, "Could not start the pipeline threads\n");
+    transcoder_abort(&t);
+    ret = AVERROR(EAGAIN);
+    goto end;
   }
 
-  /* put sample parameters */
-  c->bit_rate = 64000;
+  /* encode stage */
+  while ((ret = queue_get(&t.resampled, &frame)) > 0) {
+    ret = encode(&t, frame, pkt);
+    av_frame_free(&frame);
+    if (ret < 0) break;
+  }
 
-  /* check that the encoder supports s16 pcm input */
-  c->sample_fmt = AV_SAMPLE_FMT_S16;
-  if (!check_sample_fmt(codec, c->sample_fmt)) {
-    fprintf(stderr, "Encoder does not support sample format %s",
-            av_get_sample_fmt_name(c->sample_fmt));
-    exit(1);
+  if (ret == 0) {
+    /* flush the encoder */
+    ret = encode(&t, NULL, pkt);
+    if (ret >= 0) ret = av_write_trailer(t.ofmt);
+    if (ret >= 0) avio_flush(t.ofmt->pb);
+    if (ret >= 0 && t.ofmt->pb->error < 0) ret = t.ofmt->pb->error;
   }
+  if (ret < 0) transcoder_abort(&t);
 
-  /* select other audio parameters supported by the encoder */
-  c->sample_rate = select_sample_rate(codec);
-  c->channel_layout = select_channel_layout(codec);
-  c->channels = av_get_channel_layout_nb_channels(c->channel_layout);
+end:
+  if (resampling) pthread_join(resample_tid, NULL);
+  if (decoding) pthread_join(decode_tid, NULL);
 
-  /* open it */
-  if (avcodec_open2(c, codec, NULL) < 0) {
-    fprintf(stderr, "Could not open codec\n");
-    exit(1);
+  /* an aborted queue means a stage failed */
+  if (ret >= 0 && (t.decoded.aborted || t.resampled.aborted)) ret = AVERROR_EXIT;
+
+  if (ret >= 0) {
+    double seconds = (av_gettime_relative() - start) / 1000000.0;
+    double duration = (double)t.next_pts / t.enc->sample_rate;
+
+    printf("%s: %.2f s of audio in %.3f s, %.1fx realtime\n", output,
+           duration, seconds, seconds > 0 ? duration / seconds : 0.0);
+  } else {
+    fprintf(stderr, "Could not transcode %s\n", input);
   }
 
-  f = fopen(filename, "wb");
-  if (!f) {
-    fprintf(stderr, "Could not open %s\n", filename);
-    exit(1);
+  av_packet_free(&pkt);
+  transcoder_close(&t);
+
+  return ret < 0 ? ret : 0;
+}
+
+/* directory mode job: transcodes the batch files until none is left */
+static void *batch_thread(void *arg) {
+  Batch *b = arg;
+
+  for (;;) {
+    int i;
+
+    pthread_mutex_lock(&b->mutex);
+    i = b->next_file < b->nb_files ? b->next_file++ : -1;
+    pthread_mutex_unlock(&b->mutex);
+
+    if (i < 0) break;
+
+    if (transcode(b->opts, b->inputs[i], b->outputs[i]) < 0) {
+      pthread_mutex_lock(&b->mutex);
+      b->failed++;
+      pthread_mutex_unlock(&b->mutex);
+    }
   }
+  return NULL;
+}
 
-  /* packet for holding encoded output */
-  pkt = av_packet_alloc();
-  if (!pkt) {
-    fprintf(stderr, "could not allocate the packet\n");
-    exit(1);
+/* file name extension of the directory mode outputs */
+static const char *output_extension(const char *codec_name) {
+  if (!strcmp(codec_name, "aac")) return "m4a";
+  if (!strcmp(codec_name, "opus") || !strcmp(codec_name, "libopus"))
+    return "opus";
+  return codec_name;
+}
+
+/* transcodes every regular file of input_dir into output_dir, opts->jobs
+ * files in parallel */
+static int transcode_directory(const Options *opts, const char *input_dir,
+                               const char *output_dir) {
+  Batch b = {0};
+  pthread_t tids[MAX_JOBS];
+  int nb_jobs = 0, capacity = 0, i;
+  int64_t start = av_gettime_relative();
+  const char *ext = output_extension(opts->codec_name);
+  struct dirent *entry;
+  DIR *dir;
+
+  dir = opendir(input_dir);
+  if (!dir) {
+    fprintf(stderr, "Could not open directory %s\n", input_dir);
+    return AVERROR(errno);
   }
 
-  /* frame containing input raw audio */
-  frame = av_frame_alloc();
-  if (!frame) {
-    fprintf(stderr, "Could not allocate audio frame\n");
-    exit(1);
+  while ((entry = readdir(dir))) {
+    char input[PATH_SIZE], output[PATH_SIZE];
+    const char *dot;
+    struct stat st;
+
+    if (entry->d_name[0] == '.') continue;
+
+    snprintf(input, sizeof(input), "%s/%s", input_dir, entry->d_name);
+    if (stat(input, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+
+    dot = strrchr(entry->d_name, '.');
+    snprintf(output, sizeof(output), "%s/%.*s.%s", output_dir,
+             dot ? (int)(dot - entry->d_name) : (int)strlen(entry->d_name),
+             entry->d_name, ext);
+
+    if (b.nb_files == capacity) {
+      capacity = capacity ? 2 * capacity : 16;
+      if (av_reallocp_array(&b.inputs, capacity, sizeof(char *)) < 0 ||
+          av_reallocp_array(&b.outputs, capacity, sizeof(char *)) < 0) {
+        fprintf(stderr, "Could not allocate the files list\n");
+        exit(1);
+      }
+    }
+    b.inputs[b.nb_files] = av_strdup(input);
+    b.outputs[b.nb_files] = av_strdup(output);
+    b.nb_files++;
   }
+  closedir(dir);
 
-  frame->nb_samples = c->frame_size;
-  frame->format = c->sample_fmt;
-  frame->channel_layout = c->channel_layout;
+  b.opts = opts;
+  pthread_mutex_init(&b.mutex, NULL);
 
-  /* allocate the data buffers */
-  ret = av_frame_get_buffer(frame, 0);
-  if (ret < 0) {
-    fprintf(stderr, "Could not allocate audio data buffers\n");
-    exit(1);
+  for (; nb_jobs < FFMIN(opts->jobs, b.nb_files); nb_jobs++)
+    if (pthread_create(&tids[nb_jobs], NULL, batch_thread, &b)) break;
+
+  /* no job could be started: transcode on this thread */
+  if (nb_jobs == 0) batch_thread(&b);
+
+  for (i = 0; i < nb_jobs; i++) pthread_join(tids[i], NULL);
+
+  printf("%d files transcoded (%d failed) in %.3f s with %d jobs\n",
+         b.nb_files - b.failed, b.failed,
+         (av_gettime_relative() - start) / 1000000.0, FFMAX(nb_jobs, 1));
+
+  for (i = 0; i < b.nb_files; i++) {
+    av_free(b.inputs[i]);
+    av_free(b.outputs[i]);
   }
+  av_free(b.inputs);
+  av_free(b.outputs);
+  pthread_mutex_destroy(&b.mutex);
 
-  /* encode a single tone sound */
-  t = 0;
-  tincr = 2 * M_PI * 440.0 / c->sample_rate;
-  for (i = 0; i < 200; i++) {
-    /* make sure the frame is writable -- makes a copy if the encoder
-     * kept a reference internally */
-    ret = av_frame_make_writable(frame);
-    if (ret < 0) exit(1);
-    samples = (uint16_t *)frame->data[0];
+  return b.failed ? -1 : 0;
+}
 
-    for (j = 0; j < c->frame_size; j++) {
-      samples[2 * j] = (int)(sin(t) * 10000);
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [-c aac|opus|mp2] [-b bit_rate] [-j jobs] <input> <output>\n"
+          "Transcodes the audio stream of the input file, with the codec guessed "
+          "from the output file name by default.\n"
+          "If input is a directory, each of its files is transcoded into the "
+          "output directory (default codec aac), jobs files in parallel (default "
+          "one per core).\n",
+          name);
+}
 
-      for (k = 1; k < c->channels; k++) samples[2 * j + k] = samples[2 * j];
-      t += tincr;
+int main(int argc, char **argv) {
+  Options opts = {NULL, DEFAULT_BIT_RATE, 0};
+  struct stat st;
+  char *end;
+  int i;
+
+  opts.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (!strcmp(argv[i], "-c")) {
+      opts.codec_name = argv[i + 1];
+    } else if (!strcmp(argv[i], "-b")) {
+      opts.bit_rate = strtoll(argv[i + 1], &end, 10);
+      if (*end != '\0' || opts.bit_rate <= 0) {
+        fprintf(stderr, "Invalid bit rate %s\n", argv[i + 1]);
+        exit(1);
+      }
+    } else if (!strcmp(argv[i], "-j")) {
+      opts.jobs = (int)strtol(argv[i + 1], &end, 10);
+      if (*end != '\0' || opts.jobs < 1 || opts.jobs > MAX_JOBS) {
+        fprintf(stderr, "Invalid number of jobs %s\n", argv[i + 1]);
+        exit(1);
+      }
+    } else {
+      usage(argv[0]);
+      return 0;
     }
-    encode(c, frame, pkt, f);
   }
 
-  /* flush the encoder */
-  encode(c, NULL, pkt, f);
+  if (argc - i != 2) {
+    usage(argv[0]);
+    return 0;
+  }
+  opts.jobs = av_clip(opts.jobs, 1, MAX_JOBS);
 
-  fclose(f);
+  if (opts.codec_name && !find_encoder(opts.codec_name)) {
+    fprintf(stderr, "Codec %s not found\n", opts.codec_name);
+    exit(1);
+  }
 
-  av_frame_free(&frame);
-  av_packet_free(&pkt);
-  avcodec_free_context(&c);
+  if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+    if (!opts.codec_name) opts.codec_name = "aac";
+    return transcode_directory(&opts, argv[i], argv[i + 1]) < 0 ? 1 : 0;
+  }
 
-  return 0;
-}
\ No newline at end of file
+  return transcode(&opts, argv[i], argv[i + 1]) < 0 ? 1 : 0;
+}
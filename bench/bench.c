@@ -0,0 +1,502 @@
+/**
+*
+*   File:   bench.c
+*           Headless decode benchmark built on libplayer: each file is run by
+*           player_bench() through the demux, decode, sliced sws_scale() and
+*           audio resampling of the playback, as fast as possible, without any
+*           window or audio device, and the throughput, the per-stage latency
+*           percentiles measured by the player and the peak resident set size
+*           are reported.
+*
+*           Every decoded frame is converted to YUV420P, the format the players
+*           upload when a frame cannot be uploaded directly, so the conversion
+*           is always timed. Each run is made twice, in separate passes: with a
+*           single sws_scale() call per frame, then with the frames split in
+*           bands converted in parallel on the scheduler workers, and the
+*           speedup of the latter is reported. The order of the two passes
+*           alternates between the runs, so neither always gets the warm
+*           caches.
+*
+*           Compiled using
+*               gcc -o bench bench.c -I../libplayer -L../libplayer -lplayer
+*                   -lavutil -lavformat -lavcodec -lswscale -lswresample -lSDL2 -lz -lm
+*           on Arch Linux.
+*
+*           Usage: ./bench [-threads N] [-loop N] [-slices N|auto] [--option ...] [file ...]
+*           With no file, the media files shipped with the repository are used.
+*
+**/
+
+/**
+ * The players initialize the SDL subsystems they use: main() is not replaced.
+ */
+#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <SDL2/SDL.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include "player.h"
+#include "scale.h"
+
+/**
+ * Directory of the default corpus, set by CMake to the repository root.
+ */
+#ifndef BENCH_CORPUS_DIR
+#define BENCH_CORPUS_DIR "."
+#endif
+
+/**
+ * Maximum number of video decoder threads, as accepted by --threads.
+ */
+#define BENCH_MAX_THREADS 64
+
+/**
+ * Latency summary of a pipeline stage over all the runs, in milliseconds: the
+ * percentiles of the runs are not merged, the worst run is kept.
+ */
+typedef struct BenchStage
+{
+    int     count;
+    double  total;
+    double  p50;
+    double  p99;
+    double  max;
+} BenchStage;
+
+/**
+ * Benchmark passes: the single sws_scale() call, and the sliced conversion.
+ */
+enum
+{
+    BENCH_PASS_SINGLE,
+    BENCH_PASS_SLICED,
+    BENCH_PASS_NB
+};
+
+/**
+ * A benchmark pass: its --scale-slices setting and the counters accumulated
+ * over all of its runs, the bands and workers of its last run.
+ */
+typedef struct BenchPass
+{
+    const char *    name;
+    int             scale_slices;
+    int64_t         video_frames;
+    int64_t         run_time;
+    BenchStage      stages[PLAYER_STAGE_NB];
+    int             slices;
+    int             workers;
+} BenchPass;
+
+/**
+ * Benchmark state: options and the passes.
+ */
+typedef struct BenchState
+{
+    /**
+     * Options, the -- ones are given to the players as they are.
+     */
+    PlayerOptions   options;
+    int             loops;
+
+    /**
+     * Passes, and the number of runs so far, which orders them.
+     */
+    BenchPass       passes[BENCH_PASS_NB];
+    int             runs;
+} BenchState;
+
+/**
+ * Names of the PLAYER_STAGE_* pipeline stages.
+ */
+static const char * stage_names[PLAYER_STAGE_NB] = {
+        "demux",
+        "video decode",
+        "scale",
+        "upload",
+        "present",
+        "av sync",
+        "audio decode",
+        "resample"
+};
+
+/**
+ * Methods declaration.
+ */
+void printHelpMenu();
+
+static void count_frame(void * opaque, const PlayerTraceFrame * frame);
+
+static int bench_file(BenchState * bench, const char * filename);
+
+static int bench_run(BenchState * bench, BenchPass * pass, const char * filename);
+
+static void bench_add_stats(BenchPass * pass, const PlayerStats * stats);
+
+static void print_pass(BenchPass * pass);
+
+static void print_report(BenchState * bench);
+
+/**
+ * Entry point.
+ *
+ * @param   argc    command line arguments counter.
+ * @param   argv    command line arguments.
+ *
+ * @return          execution exit code.
+ */
+int main(int argc, char * argv[])
+{
+    // the audio only file runs the audio decoding and resampling on their own
+    static const char * default_corpus[] = {
+            BENCH_CORPUS_DIR "/Iron_Man-Trailer_HD.mp4",
+            BENCH_CORPUS_DIR "/music_orig.wav"
+    };
+
+    BenchState * bench = av_mallocz(sizeof(BenchState));
+    if (!bench)
+    {
+        printf("Could not allocate the benchmark state.\n");
+        return -1;
+    }
+
+    player_options_default(&bench->options);
+    bench->loops = 1;
+
+    // parse the options, the remaining arguments are the input files
+    const char ** files = NULL;
+    int nb_files = 0;
+    char * pEnd;
+
+    files = av_mallocz_array(argc, sizeof(char *));
+    if (!files)
+    {
+        printf("Could not allocate the input files list.\n");
+        av_free(bench);
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+        {
+            bench->options.video_decoder_threads = (int)strtol(argv[++i], &pEnd, 10);
+
+            if (*pEnd != '\0' || bench->options.video_decoder_threads < 0 ||
+                bench->options.video_decoder_threads > BENCH_MAX_THREADS)
+            {
+                printf("Invalid number of decoder threads: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-loop") == 0 && i + 1 < argc)
+        {
+            bench->loops = (int)strtol(argv[++i], &pEnd, 10);
+
+            if (*pEnd != '\0' || bench->loops < 1)
+            {
+                printf("Invalid number of loops: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-slices") == 0 && i + 1 < argc)
+        {
+            if (strcmp(argv[++i], "auto") == 0)
+            {
+                bench->options.scale_slices = 0;
+            }
+            else
+            {
+                bench->options.scale_slices = (int)strtol(argv[i], &pEnd, 10);
+
+                if (*pEnd != '\0' || bench->options.scale_slices < 1 || bench->options.scale_slices > SCALE_MAX_SLICES)
+                {
+                    printf("Invalid number of scale slices: %s.\n", argv[i]);
+                    goto fail;
+                }
+            }
+        }
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (player_parse_option(&bench->options, argv[i]) < 0)
+            {
+                printHelpMenu();
+                goto fail;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            printHelpMenu();
+            goto fail;
+        }
+        else
+        {
+            files[nb_files++] = argv[i];
+        }
+    }
+
+    // no input files: run the default corpus
+    if (nb_files == 0)
+    {
+        for (int i = 0; i < FF_ARRAY_ELEMS(default_corpus); i++)
+        {
+            files[nb_files++] = default_corpus[i];
+        }
+    }
+
+    // headless: the players open no window nor audio device, but they still
+    // initialize the SDL video and audio subsystems
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+    // the same options but the number of bands
+    bench->passes[BENCH_PASS_SINGLE].name = "single sws_scale()";
+    bench->passes[BENCH_PASS_SINGLE].scale_slices = 1;
+    bench->passes[BENCH_PASS_SLICED].name = "sliced sws_scale()";
+    bench->passes[BENCH_PASS_SLICED].scale_slices = bench->options.scale_slices;
+
+    // run each file the requested number of times
+    for (int i = 0; i < nb_files; i++)
+    {
+        if (bench_file(bench, files[i]) < 0)
+        {
+            goto fail;
+        }
+    }
+
+    print_report(bench);
+
+    av_free(files);
+    av_free(bench);
+
+    return 0;
+
+    fail:
+    {
+        av_free(files);
+        av_free(bench);
+
+        return -1;
+    };
+}
+
+/**
+ * Print help menu containing usage information.
+ */
+void printHelpMenu()
+{
+    printf("Invalid arguments.\n\n");
+    printf("Usage: ./bench [options] [file ...]\n\n");
+    printf("Options:\n");
+    printf("    -threads N      video decoder threads (0-%d, 0 for a share of the budget, default 0).\n", BENCH_MAX_THREADS);
+    printf("    -loop N         number of runs of each file (default 1).\n");
+    printf("    -slices N       bands of the sliced scale (1-%d or auto, default auto).\n\n", SCALE_MAX_SLICES);
+    printf("Player options:\n");
+    player_print_options();
+    printf("\nWith no file, the repository corpus is used:\n");
+    printf("    %s/Iron_Man-Trailer_HD.mp4 and %s/music_orig.wav\n\n", BENCH_CORPUS_DIR, BENCH_CORPUS_DIR);
+    printf("e.g: ./bench -threads 4 -loop 3 /home/rambodrahmani/Videos/video.mp4\n");
+}
+
+/**
+ * player_bench() trace callback: counts the video frames.
+ *
+ * @param   opaque  the BenchPass.
+ * @param   frame   the frame shown, dropped or skipped.
+ */
+static void count_frame(void * opaque, const PlayerTraceFrame * frame)
+{
+    BenchPass * pass = (BenchPass *)opaque;
+
+    pass->video_frames++;
+}
+
+/**
+ * Runs the given file bench->loops times in each pass, the order of the passes
+ * alternating from one run to the next.
+ *
+ * @param   bench       the BenchState.
+ * @param   filename    the media file to be run.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int bench_file(BenchState * bench, const char * filename)
+{
+    for (int loop = 0; loop < bench->loops; loop++)
+    {
+        for (int i = 0; i < BENCH_PASS_NB; i++)
+        {
+            BenchPass * pass = &bench->passes[(bench->runs + i) % BENCH_PASS_NB];
+
+            if (bench_run(bench, pass, filename) < 0)
+            {
+                return -1;
+            }
+        }
+
+        bench->runs++;
+    }
+
+    return 0;
+}
+
+/**
+ * Runs the given file once through a new Player, with the scale slices of the
+ * given pass: a Player is only run once, each run opens the input again.
+ *
+ * @param   bench       the BenchState.
+ * @param   pass        the BenchPass.
+ * @param   filename    the media file to be run.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int bench_run(BenchState * bench, BenchPass * pass, const char * filename)
+{
+    PlayerOptions options = bench->options;
+    options.scale_slices = pass->scale_slices;
+
+    Player * player = player_open(filename, &options);
+    if (!player)
+    {
+        printf("Could not open %s.\n", filename);
+        return -1;
+    }
+
+    int64_t run_start = av_gettime_relative();
+    int ret = player_bench(player, 1, count_frame, pass);
+    pass->run_time += av_gettime_relative() - run_start;
+
+    if (ret < 0)
+    {
+        printf("Could not run %s.\n", filename);
+        player_close(player);
+        return -1;
+    }
+
+    PlayerStats stats;
+    player_get_stats(player, &stats);
+    bench_add_stats(pass, &stats);
+
+    player_close(player);
+
+    return 0;
+}
+
+/**
+ * Adds the stage latencies of a run, summarized by the player over the whole
+ * run, to the counters of the given pass.
+ *
+ * @param   pass    the BenchPass.
+ * @param   stats   the PlayerStats of the run.
+ */
+static void bench_add_stats(BenchPass * pass, const PlayerStats * stats)
+{
+    for (int i = 0; i < PLAYER_STAGE_NB; i++)
+    {
+        const PlayerStageStats * run = &stats->interval.stages[i];
+        BenchStage * stage = &pass->stages[i];
+
+        if (run->count == 0)
+        {
+            continue;
+        }
+
+        stage->count += run->count;
+        stage->total += run->mean * run->count;
+        stage->p50 = FFMAX(stage->p50, run->p50);
+        stage->p99 = FFMAX(stage->p99, run->p99);
+        stage->max = FFMAX(stage->max, run->max);
+    }
+
+    pass->slices = stats->scale_slices;
+    pass->workers = stats->scale_workers;
+}
+
+/**
+ * Prints the throughput and the per-stage latency percentiles of the given
+ * pass.
+ *
+ * @param   pass    the BenchPass.
+ */
+static void print_pass(BenchPass * pass)
+{
+    double seconds = pass->run_time / 1000000.0;
+    int audio_frames = pass->stages[PLAYER_STAGE_RESAMPLE].count;
+
+    printf("Pass %s: %lld video frames and %d audio frames in %.3f s.\n",
+           pass->name, (long long)pass->video_frames, audio_frames, seconds);
+    printf("Throughput: %.1f video frames/s, %.1f audio frames/s.\n",
+           seconds > 0 ? pass->video_frames / seconds : 0.0,
+           seconds > 0 ? audio_frames / seconds : 0.0);
+
+    // the percentiles are the upper bounds of the player histogram buckets
+    printf("%-14s %10s %10s %10s %10s %10s\n", "stage (ms)", "count", "mean", "p50", "p99", "max");
+
+    for (int i = 0; i < PLAYER_STAGE_NB; i++)
+    {
+        BenchStage * stage = &pass->stages[i];
+
+        if (stage->count == 0)
+        {
+            continue;
+        }
+
+        printf("%-14s %10d %10.3f %10.3f %10.3f %10.3f\n",
+               stage_names[i],
+               stage->count,
+               stage->total / stage->count,
+               stage->p50,
+               stage->p99,
+               stage->max);
+    }
+
+    printf("\n");
+}
+
+/**
+ * Prints the report of each pass, the speedup of the sliced conversion and the
+ * peak resident set size.
+ *
+ * @param   bench   the BenchState.
+ */
+static void print_report(BenchState * bench)
+{
+    for (int i = 0; i < BENCH_PASS_NB; i++)
+    {
+        print_pass(&bench->passes[i]);
+    }
+
+    // the scale stage of both passes converts the same frames, each pass has
+    // its own run time
+    BenchPass * single = &bench->passes[BENCH_PASS_SINGLE];
+    BenchPass * sliced = &bench->passes[BENCH_PASS_SLICED];
+    BenchStage * single_scale = &single->stages[PLAYER_STAGE_SCALE];
+    BenchStage * sliced_scale = &sliced->stages[PLAYER_STAGE_SCALE];
+
+    if (single_scale->count > 0 && sliced_scale->count > 0 && sliced_scale->total > 0 && sliced->run_time > 0)
+    {
+        printf("Sliced scale: %d bands on %d workers, %.2fx the single sws_scale() call, %.2fx the throughput.\n",
+               sliced->slices,
+               sliced->workers,
+               (single_scale->total / single_scale->count) / (sliced_scale->total / sliced_scale->count),
+               ((double)sliced->video_frames / sliced->run_time) / ((double)single->video_frames / single->run_time));
+    }
+
+    // ru_maxrss is in bytes on macOS, in kilobytes elsewhere
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        long peak_rss_kb = usage.ru_maxrss / 1024;
+#else
+        long peak_rss_kb = usage.ru_maxrss;
+#endif
+        printf("Peak RSS: %.1f MB.\n", peak_rss_kb / 1024.0);
+    }
+}
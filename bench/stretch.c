@@ -0,0 +1,222 @@
+/**
+*
+*   File:   stretch.c
+*           Micro benchmark of the audio stretch kernel used by synchronize_audio()
+*           in tutorial06.c: for each buffer shape, the SSE2 or NEON loop is
+*           checked to be bit-exact against the scalar loop, and both are timed.
+*
+*           Compiled using
+*               gcc -O2 -o stretch stretch.c -I../tutorial06 -lavutil -lm
+*           on Arch Linux.
+*
+*           Usage: ./stretch [-iterations N]
+*           The exit code is 1 if any SIMD output differs from the scalar one.
+*
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/time.h>
+#include "audio_stretch.h"
+
+/**
+ * Default number of timed runs of each kernel per buffer shape.
+ */
+#define STRETCH_ITERATIONS 2000
+
+/**
+ * A buffer shape: the input and output sample frames and the channels.
+ */
+typedef struct StretchCase
+{
+    const char *    name;
+    int             src_frames;
+    int             dst_frames;
+    int             channels;
+} StretchCase;
+
+/**
+ * The shapes synchronize_audio() produces: an SDL audio buffer of 1024 frames
+ * corrected by up to SAMPLE_CORRECTION_PERCENT_MAX, for each output channel
+ * count of audio_resampling(), and a buffer longer than 65536 frames, whose
+ * 16.16 fixed point positions do not fit 32 bits.
+ */
+static const StretchCase stretch_cases[] = {
+        {"stereo squeeze",      1024,   922,    2},
+        {"stereo stretch",      1024,   1126,   2},
+        {"stereo tiny",         5,      7,      2},
+        {"mono stretch",        1024,   1126,   1},
+        {"surround squeeze",    1024,   922,    3},
+        {"stereo long",         200000, 220000, 2},
+};
+
+/**
+ * Methods declaration.
+ */
+static int stretch_check_ramp(const StretchCase * c, const int16_t * dst);
+
+static double stretch_time(const StretchCase * c, const int16_t * src, int16_t * dst, int simd, int iterations);
+
+/**
+ * Entry point.
+ *
+ * @param   argc    command line arguments counter.
+ * @param   argv    command line arguments.
+ *
+ * @return          0 if every SIMD output is bit-exact, 1 otherwise.
+ */
+int main(int argc, char * argv[])
+{
+    int iterations = STRETCH_ITERATIONS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+        {
+            iterations = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("Usage: ./stretch [-iterations N]\n");
+            return -1;
+        }
+    }
+
+    if (iterations <= 0)
+    {
+        printf("Invalid number of iterations.\n");
+        return -1;
+    }
+
+    printf("SIMD kernel: %s.\n", AUDIO_STRETCH_SIMD ? AUDIO_STRETCH_SIMD : "none");
+    printf("%-18s %8s %8s %3s  %-9s %12s %12s %8s\n",
+           "case", "src", "dst", "ch", "check", "scalar ns/f", "simd ns/f", "speedup");
+
+    int failed = 0;
+
+    for (int i = 0; i < sizeof(stretch_cases) / sizeof(stretch_cases[0]); i++)
+    {
+        const StretchCase * c = &stretch_cases[i];
+
+        int16_t * src = malloc(c->src_frames * c->channels * sizeof(int16_t));
+        int16_t * ref = malloc(c->dst_frames * c->channels * sizeof(int16_t));
+        int16_t * dst = malloc(c->dst_frames * c->channels * sizeof(int16_t));
+        if (!src || !ref || !dst)
+        {
+            printf("Could not allocate the %s buffers.\n", c->name);
+            free(src);
+            free(ref);
+            free(dst);
+            return -1;
+        }
+
+        // full scale noise: exercises the rounding and the saturation
+        srand(i + 1);
+        for (int k = 0; k < c->src_frames * c->channels; k++)
+        {
+            src[k] = (int16_t)(rand() & 0xffff);
+        }
+
+        audio_stretch_s16_ex(src, c->src_frames, ref, c->dst_frames, c->channels, 0);
+        audio_stretch_s16_ex(src, c->src_frames, dst, c->dst_frames, c->channels, 1);
+
+        int exact = memcmp(ref, dst, c->dst_frames * c->channels * sizeof(int16_t)) == 0;
+
+        // a ramp must come out as a ramp: catches the positions wrapping around
+        for (int k = 0; k < c->src_frames; k++)
+        {
+            for (int ch = 0; ch < c->channels; ch++)
+            {
+                src[k * c->channels + ch] = (int16_t)(k / 8);
+            }
+        }
+
+        audio_stretch_s16_ex(src, c->src_frames, dst, c->dst_frames, c->channels, 1);
+
+        int ramp = stretch_check_ramp(c, dst);
+
+        double scalar_time = stretch_time(c, src, dst, 0, iterations);
+        double simd_time = stretch_time(c, src, dst, 1, iterations);
+
+        printf("%-18s %8d %8d %3d  %-9s %12.3f %12.3f %7.2fx\n",
+               c->name,
+               c->src_frames,
+               c->dst_frames,
+               c->channels,
+               !exact ? "MISMATCH" : !ramp ? "DRIFT" : "ok",
+               scalar_time,
+               simd_time,
+               simd_time > 0 ? scalar_time / simd_time : 0);
+
+        failed |= !exact || !ramp;
+
+        free(src);
+        free(ref);
+        free(dst);
+    }
+
+    return failed;
+}
+
+/**
+ * Checks the stretched ramp: src[k] = k / 8 on every channel, so that output
+ * frame j must be within 2 of j * (src_frames - 1) / (dst_frames - 1) / 8 once
+ * the fixed point truncation of the step and of the weights is accounted for.
+ *
+ * @param   c       the buffer shape.
+ * @param   dst     the stretched ramp.
+ *
+ * @return          1 if the ramp is preserved, 0 otherwise.
+ */
+static int stretch_check_ramp(const StretchCase * c, const int16_t * dst)
+{
+    for (int j = 0; j < c->dst_frames; j++)
+    {
+        double expected = (double)j * (c->src_frames - 1) / (c->dst_frames - 1) / 8;
+
+        for (int ch = 0; ch < c->channels; ch++)
+        {
+            double diff = dst[j * c->channels + ch] - expected;
+            if (diff > 2 || diff < -2)
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Times the given kernel on the given buffer shape.
+ *
+ * @param   c           the buffer shape.
+ * @param   src         the input samples.
+ * @param   dst         the output samples.
+ * @param   simd        0 for the scalar loop, 1 for the SIMD one.
+ * @param   iterations  the number of timed runs.
+ *
+ * @return              the time per output frame, in nanoseconds.
+ */
+static double stretch_time(const StretchCase * c, const int16_t * src, int16_t * dst, int simd, int iterations)
+{
+    // the long buffers are run proportionally less
+    int runs = (int)((int64_t)iterations * 1024 / c->dst_frames);
+    if (runs < 1)
+    {
+        runs = 1;
+    }
+
+    // warm up the caches
+    audio_stretch_s16_ex(src, c->src_frames, dst, c->dst_frames, c->channels, simd);
+
+    int64_t start = av_gettime_relative();
+    for (int i = 0; i < runs; i++)
+    {
+        audio_stretch_s16_ex(src, c->src_frames, dst, c->dst_frames, c->channels, simd);
+    }
+    int64_t elapsed = av_gettime_relative() - start;
+
+    return elapsed * 1000.0 / ((double)runs * c->dst_frames);
+}
@@ -0,0 +1,982 @@
+/**
+*
+*   File:   glrender.c
+*           libplayer OpenGL renderer: one texture per frame plane and a
+*           fragment shader converting the samples to display RGB. See
+*           glrender.h.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <libavutil/avutil.h>
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/mastering_display_metadata.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include "glrender.h"
+
+/**
+ * Transfer functions handled by the shader.
+ */
+#define GL_RENDER_TRANSFER_SDR 0
+#define GL_RENDER_TRANSFER_PQ 1
+#define GL_RENDER_TRANSFER_HLG 2
+
+/**
+ * Vertex attributes locations, shared by the two programs.
+ */
+#define GL_RENDER_ATTRIB_POSITION 0
+#define GL_RENDER_ATTRIB_TEXCOORD 1
+
+/**
+ * OpenGL functions used by the renderer, loaded with SDL_GL_GetProcAddress():
+ * each X(return type, name without the gl prefix, arguments) entry becomes a
+ * GLRenderer function pointer.
+ */
+#define GL_RENDER_FUNCTIONS(X) \
+    X(void,     Viewport,               (GLint x, GLint y, GLsizei width, GLsizei height)) \
+    X(void,     ClearColor,             (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)) \
+    X(void,     Clear,                  (GLbitfield mask)) \
+    X(void,     Enable,                 (GLenum cap)) \
+    X(void,     Disable,                (GLenum cap)) \
+    X(void,     BlendFunc,              (GLenum sfactor, GLenum dfactor)) \
+    X(void,     PixelStorei,            (GLenum pname, GLint param)) \
+    X(void,     GenTextures,            (GLsizei n, GLuint * textures)) \
+    X(void,     DeleteTextures,         (GLsizei n, const GLuint * textures)) \
+    X(void,     BindTexture,            (GLenum target, GLuint texture)) \
+    X(void,     ActiveTexture,          (GLenum texture)) \
+    X(void,     TexParameteri,          (GLenum target, GLenum pname, GLint param)) \
+    X(void,     TexImage2D,             (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels)) \
+    X(void,     TexSubImage2D,          (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void * pixels)) \
+    X(GLuint,   CreateShader,           (GLenum type)) \
+    X(void,     ShaderSource,           (GLuint shader, GLsizei count, const GLchar * const * string, const GLint * length)) \
+    X(void,     CompileShader,          (GLuint shader)) \
+    X(void,     GetShaderiv,            (GLuint shader, GLenum pname, GLint * params)) \
+    X(void,     GetShaderInfoLog,       (GLuint shader, GLsizei bufSize, GLsizei * length, GLchar * infoLog)) \
+    X(void,     DeleteShader,           (GLuint shader)) \
+    X(GLuint,   CreateProgram,          (void)) \
+    X(void,     AttachShader,           (GLuint program, GLuint shader)) \
+    X(void,     BindAttribLocation,     (GLuint program, GLuint index, const GLchar * name)) \
+    X(void,     LinkProgram,            (GLuint program)) \
+    X(void,     GetProgramiv,           (GLuint program, GLenum pname, GLint * params)) \
+    X(void,     GetProgramInfoLog,      (GLuint program, GLsizei bufSize, GLsizei * length, GLchar * infoLog)) \
+    X(void,     DeleteProgram,          (GLuint program)) \
+    X(void,     UseProgram,             (GLuint program)) \
+    X(GLint,    GetUniformLocation,     (GLuint program, const GLchar * name)) \
+    X(void,     Uniform1i,              (GLint location, GLint v0)) \
+    X(void,     Uniform1f,              (GLint location, GLfloat v0)) \
+    X(void,     Uniform2f,              (GLint location, GLfloat v0, GLfloat v1)) \
+    X(void,     Uniform3fv,             (GLint location, GLsizei count, const GLfloat * value)) \
+    X(void,     Uniform4f,              (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)) \
+    X(void,     UniformMatrix3fv,       (GLint location, GLsizei count, GLboolean transpose, const GLfloat * value)) \
+    X(void,     GenVertexArrays,        (GLsizei n, GLuint * arrays)) \
+    X(void,     BindVertexArray,        (GLuint array)) \
+    X(void,     DeleteVertexArrays,     (GLsizei n, const GLuint * arrays)) \
+    X(void,     GenBuffers,             (GLsizei n, GLuint * buffers)) \
+    X(void,     BindBuffer,             (GLenum target, GLuint buffer)) \
+    X(void,     BufferData,             (GLenum target, GLsizeiptr size, const void * data, GLenum usage)) \
+    X(void,     DeleteBuffers,          (GLsizei n, const GLuint * buffers)) \
+    X(void,     VertexAttribPointer,    (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer)) \
+    X(void,     EnableVertexAttribArray,(GLuint index)) \
+    X(void,     DisableVertexAttribArray,(GLuint index)) \
+    X(void,     DrawArrays,             (GLenum mode, GLint first, GLsizei count))
+
+/**
+ * A set of plane textures and the conversion of the frame uploaded to it.
+ */
+typedef struct GLRenderTextures
+{
+    GLuint      planes[3];
+    int         nb_planes;
+    int         width;
+    int         height;
+    int         format;
+    int         uploaded;
+
+    /**
+     * Sample normalization, then YUV to RGB offset and matrix (row-major), the
+     * transfer function, the BT.2020 to BT.709 gamut conversion flag and the
+     * tonemapping peak, relative to the reference white.
+     */
+    int         interleaved;
+    GLfloat     depth_scale;
+    GLfloat     yuv_offset[3];
+    GLfloat     yuv_matrix[9];
+    int         transfer;
+    int         convert_gamut;
+    GLfloat     peak;
+} GLRenderTextures;
+
+/**
+ * The OpenGL renderer.
+ */
+struct GLRenderer
+{
+    SDL_Window *        window;
+    SDL_GLContext       context;
+
+    /**
+     * OpenGL functions.
+     */
+#define GL_RENDER_FUNCTION_FIELD(ret, name, args) ret (APIENTRY * name) args;
+    GL_RENDER_FUNCTIONS(GL_RENDER_FUNCTION_FIELD)
+#undef GL_RENDER_FUNCTION_FIELD
+
+    /**
+     * Frame program, drawing a textured quad, and its uniforms.
+     */
+    GLuint              video_program;
+    GLint               video_planes[3];
+    GLint               video_interleaved;
+    GLint               video_depth_scale;
+    GLint               video_yuv_offset;
+    GLint               video_yuv_matrix;
+    GLint               video_transfer;
+    GLint               video_convert_gamut;
+    GLint               video_gamut;
+    GLint               video_peak;
+
+    /**
+     * Rectangles program, drawing in window coordinates, and its uniforms.
+     */
+    GLuint              rect_program;
+    GLint               rect_viewport;
+    GLint               rect_color;
+
+    /**
+     * Vertex array, the frame quad and the rectangles vertices, reused
+     * across calls.
+     */
+    GLuint              vao;
+    GLuint              video_vbo;
+    GLuint              rect_vbo;
+    GLfloat *           rect_vertices;
+    int                 rect_capacity;
+
+    /**
+     * Front and back textures sets.
+     */
+    GLRenderTextures    textures[2];
+};
+
+/**
+ * Shaders, GLSL 1.50. The frame is sampled with bilinear filtering, scaled to
+ * the viewport by the rasterization.
+ */
+static const char * GL_RENDER_VIDEO_VERTEX_SHADER =
+        "#version 150\n"
+        "in vec2 position;\n"
+        "in vec2 texcoord;\n"
+        "out vec2 uv;\n"
+        "void main()\n"
+        "{\n"
+        "    uv = texcoord;\n"
+        "    gl_Position = vec4(position, 0.0, 1.0);\n"
+        "}\n";
+
+static const char * GL_RENDER_VIDEO_FRAGMENT_SHADER =
+        "#version 150\n"
+        "in vec2 uv;\n"
+        "out vec4 frag_color;\n"
+        "uniform sampler2D plane0;\n"
+        "uniform sampler2D plane1;\n"
+        "uniform sampler2D plane2;\n"
+        "uniform int interleaved;\n"
+        "uniform float depth_scale;\n"
+        "uniform vec3 yuv_offset;\n"
+        "uniform mat3 yuv_matrix;\n"
+        "uniform int transfer;\n"
+        "uniform int convert_gamut;\n"
+        "uniform mat3 gamut;\n"
+        "uniform float peak;\n"
+        "\n"
+        "// SMPTE ST 2084 EOTF, relative to the reference white\n"
+        "vec3 pq_eotf(vec3 e)\n"
+        "{\n"
+        "    vec3 p = pow(e, vec3(1.0 / 78.84375));\n"
+        "    vec3 l = pow(max(p - 0.8359375, 0.0) / (18.8515625 - 18.6875 * p), vec3(1.0 / 0.1593017578125));\n"
+        "    return l * (10000.0 / " AV_STRINGIFY(GL_RENDER_REFERENCE_WHITE) ");\n"
+        "}\n"
+        "\n"
+        "// ARIB STD-B67 inverse OETF then OOTF for a 1000 nits display, relative to\n"
+        "// the reference white\n"
+        "vec3 hlg_eotf(vec3 e)\n"
+        "{\n"
+        "    vec3 low = e * e / 3.0;\n"
+        "    vec3 high = (exp((e - 0.55991073) / 0.17883277) + 0.28466892) / 12.0;\n"
+        "    vec3 l = mix(low, high, step(0.5, e));\n"
+        "    float y = dot(l, vec3(0.2627, 0.6780, 0.0593));\n"
+        "    return l * pow(max(y, 1e-6), 0.2) * (1000.0 / " AV_STRINGIFY(GL_RENDER_REFERENCE_WHITE) ");\n"
+        "}\n"
+        "\n"
+        "// extended Reinhard on the largest component: peak is mapped to 1.0\n"
+        "vec3 tonemap(vec3 l)\n"
+        "{\n"
+        "    float m = max(max(l.r, l.g), l.b);\n"
+        "    if (m <= 0.0)\n"
+        "        return l;\n"
+        "    return l * ((1.0 + m / (peak * peak)) / (1.0 + m));\n"
+        "}\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    vec3 yuv;\n"
+        "    yuv.x = texture(plane0, uv).r;\n"
+        "    if (interleaved != 0)\n"
+        "        yuv.yz = texture(plane1, uv).rg;\n"
+        "    else\n"
+        "        yuv.yz = vec2(texture(plane1, uv).r, texture(plane2, uv).r);\n"
+        "\n"
+        "    vec3 rgb = yuv_matrix * (yuv * depth_scale - yuv_offset);\n"
+        "    if (transfer == 0 && convert_gamut == 0)\n"
+        "    {\n"
+        "        frag_color = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    // linear light, converted to the BT.709 primaries and tonemapped\n"
+        "    vec3 e = clamp(rgb, 0.0, 1.0);\n"
+        "    vec3 l;\n"
+        "    if (transfer == 1)\n"
+        "        l = pq_eotf(e);\n"
+        "    else if (transfer == 2)\n"
+        "        l = hlg_eotf(e);\n"
+        "    else\n"
+        "        l = pow(e, vec3(2.4));\n"
+        "    if (convert_gamut != 0)\n"
+        "        l = max(gamut * l, 0.0);\n"
+        "    if (transfer != 0)\n"
+        "        l = tonemap(l);\n"
+        "    frag_color = vec4(pow(clamp(l, 0.0, 1.0), vec3(1.0 / 2.4)), 1.0);\n"
+        "}\n";
+
+static const char * GL_RENDER_RECT_VERTEX_SHADER =
+        "#version 150\n"
+        "in vec2 position;\n"
+        "uniform vec2 viewport;\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = vec4(position.x / viewport.x * 2.0 - 1.0, 1.0 - position.y / viewport.y * 2.0, 0.0, 1.0);\n"
+        "}\n";
+
+static const char * GL_RENDER_RECT_FRAGMENT_SHADER =
+        "#version 150\n"
+        "out vec4 frag_color;\n"
+        "uniform vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "    frag_color = color;\n"
+        "}\n";
+
+/**
+ * BT.2020 to BT.709 primaries conversion of linear RGB, row-major.
+ */
+static const GLfloat GL_RENDER_BT2020_TO_BT709[9] = {
+         1.6605f, -0.5876f, -0.0728f,
+        -0.1246f,  1.1329f, -0.0083f,
+        -0.0182f, -0.1006f,  1.1187f
+};
+
+/**
+ * Methods declaration.
+ */
+static GLuint gl_renderer_program(GLRenderer * gl, const char * vertex_source, const char * fragment_source);
+
+static GLuint gl_renderer_shader(GLRenderer * gl, GLenum type, const char * source);
+
+static int gl_renderer_textures(GLRenderer * gl, GLRenderTextures * textures, const AVFrame * frame, const AVPixFmtDescriptor * desc);
+
+static void gl_renderer_colorimetry(GLRenderTextures * textures, const AVFrame * frame, const AVPixFmtDescriptor * desc);
+
+/**
+ * Returns whether the frames of the given pixel format can be uploaded as they
+ * are: YUV, 8 to 16 bits in the host byte order, each component in its own
+ * plane or the chroma interleaved U first in the second plane.
+ *
+ * @param   pix_fmt the AVFrame pixel format.
+ *
+ * @return          != 0 if supported, 0 otherwise.
+ */
+int gl_renderer_supported(enum AVPixelFormat pix_fmt)
+{
+    const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(pix_fmt);
+
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || desc->nb_components < 3 ||
+        (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BITSTREAM)))
+    {
+        return 0;
+    }
+
+    int depth = desc->comp[0].depth;
+    int bytes = depth > 8 ? 2 : 1;
+
+    if (depth > 16 || (bytes > 1 && !!(desc->flags & AV_PIX_FMT_FLAG_BE) != AV_HAVE_BIGENDIAN))
+    {
+        return 0;
+    }
+
+    // the three components share the same depth and alignment
+    for (int i = 1; i < 3; i++)
+    {
+        if (desc->comp[i].depth != depth || desc->comp[i].shift != desc->comp[0].shift)
+        {
+            return 0;
+        }
+    }
+
+    if (desc->comp[0].plane != 0 || desc->comp[0].step != bytes)
+    {
+        return 0;
+    }
+
+    // planar, e.g. yuv420p, yuv422p10le or yuv444p
+    if (desc->comp[1].plane == 1 && desc->comp[2].plane == 2)
+    {
+        return desc->comp[1].step == bytes && desc->comp[2].step == bytes;
+    }
+
+    // semi-planar, e.g. nv12 or p010le
+    return desc->comp[1].plane == 1 && desc->comp[2].plane == 1 &&
+           desc->comp[1].step == 2 * bytes && desc->comp[1].offset == 0 && desc->comp[2].offset == bytes;
+}
+
+/**
+ * Creates an OpenGL context for the given window and the shaders drawing to
+ * it.
+ *
+ * @param   window  the SDL_Window.
+ *
+ * @return          the new GLRenderer, NULL in case of error.
+ */
+GLRenderer * gl_renderer_create(SDL_Window * window)
+{
+    GLRenderer * gl = av_mallocz(sizeof(GLRenderer));
+    if (!gl)
+    {
+        printf("Could not allocate the OpenGL renderer.\n");
+        return NULL;
+    }
+
+    gl->window = window;
+
+    // request a 3.2 core context, then restore the attributes the other
+    // players SDL_Renderers may rely on
+    int major, minor, profile, flags;
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &major);
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &minor);
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, &profile);
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_FLAGS, &flags);
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+
+    gl->context = SDL_GL_CreateContext(window);
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, major);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, minor);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, profile);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, flags);
+
+    if (!gl->context)
+    {
+        printf("SDL: could not create the OpenGL context: %s.\n", SDL_GetError());
+        gl_renderer_free(&gl);
+        return NULL;
+    }
+
+    // load the OpenGL functions of the new context
+#define GL_RENDER_FUNCTION_LOAD(ret, name, args)                                  \
+    gl->name = (ret (APIENTRY *) args)SDL_GL_GetProcAddress("gl" #name);          \
+    if (!gl->name)                                                                \
+    {                                                                             \
+        printf("SDL: could not load the OpenGL function gl%s.\n", #name);         \
+        gl_renderer_free(&gl);                                                    \
+        return NULL;                                                              \
+    }
+    GL_RENDER_FUNCTIONS(GL_RENDER_FUNCTION_LOAD)
+#undef GL_RENDER_FUNCTION_LOAD
+
+    // present on the vsync, as the SDL_Renderer path does
+    SDL_GL_SetSwapInterval(1);
+
+    gl->video_program = gl_renderer_program(gl, GL_RENDER_VIDEO_VERTEX_SHADER, GL_RENDER_VIDEO_FRAGMENT_SHADER);
+    gl->rect_program = gl_renderer_program(gl, GL_RENDER_RECT_VERTEX_SHADER, GL_RENDER_RECT_FRAGMENT_SHADER);
+    if (!gl->video_program || !gl->rect_program)
+    {
+        gl_renderer_free(&gl);
+        return NULL;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "plane%d", i);
+        gl->video_planes[i] = gl->GetUniformLocation(gl->video_program, name);
+    }
+
+    gl->video_interleaved = gl->GetUniformLocation(gl->video_program, "interleaved");
+    gl->video_depth_scale = gl->GetUniformLocation(gl->video_program, "depth_scale");
+    gl->video_yuv_offset = gl->GetUniformLocation(gl->video_program, "yuv_offset");
+    gl->video_yuv_matrix = gl->GetUniformLocation(gl->video_program, "yuv_matrix");
+    gl->video_transfer = gl->GetUniformLocation(gl->video_program, "transfer");
+    gl->video_convert_gamut = gl->GetUniformLocation(gl->video_program, "convert_gamut");
+    gl->video_gamut = gl->GetUniformLocation(gl->video_program, "gamut");
+    gl->video_peak = gl->GetUniformLocation(gl->video_program, "peak");
+    gl->rect_viewport = gl->GetUniformLocation(gl->rect_program, "viewport");
+    gl->rect_color = gl->GetUniformLocation(gl->rect_program, "color");
+
+    // the frame quad covers the whole viewport: x, y, u, v
+    static const GLfloat quad[16] = {
+            -1.0f,  1.0f, 0.0f, 0.0f,
+            -1.0f, -1.0f, 0.0f, 1.0f,
+             1.0f,  1.0f, 1.0f, 0.0f,
+             1.0f, -1.0f, 1.0f, 1.0f
+    };
+
+    gl->GenVertexArrays(1, &gl->vao);
+    gl->BindVertexArray(gl->vao);
+
+    gl->GenBuffers(1, &gl->video_vbo);
+    gl->BindBuffer(GL_ARRAY_BUFFER, gl->video_vbo);
+    gl->BufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    gl->GenBuffers(1, &gl->rect_vbo);
+
+    gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    return gl;
+}
+
+/**
+ * Uploads the planes of the given frame to the given set of textures.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ * @param   frame   the AVFrame.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+int gl_renderer_upload(GLRenderer * gl, int index, const AVFrame * frame)
+{
+    GLRenderTextures * textures = &gl->textures[index];
+    const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(frame->format);
+
+    if (!desc || !gl_renderer_supported(frame->format))
+    {
+        printf("OpenGL: unsupported pixel format %d.\n", frame->format);
+        return -1;
+    }
+
+    // the textures are only recreated if the frames size or format changes
+    if (!textures->planes[0] || textures->width != frame->width || textures->height != frame->height ||
+        textures->format != frame->format)
+    {
+        if (gl_renderer_textures(gl, textures, frame, desc) < 0)
+        {
+            return -1;
+        }
+    }
+
+    int bytes = desc->comp[0].depth > 8 ? 2 : 1;
+
+    for (int i = 0; i < textures->nb_planes; i++)
+    {
+        int texel = bytes * (i == 1 && textures->interleaved ? 2 : 1);
+
+        if (frame->linesize[i] <= 0 || frame->linesize[i] % texel)
+        {
+            printf("OpenGL: unsupported line size %d.\n", frame->linesize[i]);
+            return -1;
+        }
+
+        int width = i == 0 ? frame->width : AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w);
+        int height = i == 0 ? frame->height : AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+
+        // the lines are uploaded straight from the frame, padding skipped
+        gl->PixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i] / texel);
+        gl->BindTexture(GL_TEXTURE_2D, textures->planes[i]);
+        gl->TexSubImage2D(
+                GL_TEXTURE_2D,
+                0,
+                0,
+                0,
+                width,
+                height,
+                i == 1 && textures->interleaved ? GL_RG : GL_RED,
+                bytes > 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE,
+                frame->data[i]
+        );
+    }
+
+    gl->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    gl_renderer_colorimetry(textures, frame, desc);
+    textures->uploaded = 1;
+
+    return 0;
+}
+
+/**
+ * Returns whether a frame was uploaded to the given set of textures.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ *
+ * @return          != 0 if a frame was uploaded, 0 otherwise.
+ */
+int gl_renderer_has_frame(GLRenderer * gl, int index)
+{
+    return gl->textures[index].uploaded;
+}
+
+/**
+ * Clears the window and draws the frame of the given set of textures in the
+ * given area.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ * @param   rect    the area, in window coordinates.
+ */
+void gl_renderer_draw(GLRenderer * gl, int index, const SDL_Rect * rect)
+{
+    GLRenderTextures * textures = &gl->textures[index];
+
+    // the drawable is in pixels, larger than the window on high-DPI displays
+    int window_width, window_height, drawable_width, drawable_height;
+    SDL_GetWindowSize(gl->window, &window_width, &window_height);
+    SDL_GL_GetDrawableSize(gl->window, &drawable_width, &drawable_height);
+
+    gl->Viewport(0, 0, drawable_width, drawable_height);
+    gl->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    gl->Clear(GL_COLOR_BUFFER_BIT);
+
+    if (!textures->uploaded || window_width <= 0 || window_height <= 0)
+    {
+        return;
+    }
+
+    double scale_x = (double)drawable_width / window_width;
+    double scale_y = (double)drawable_height / window_height;
+
+    // the OpenGL viewport origin is the bottom left corner
+    gl->Viewport(
+            (GLint)(rect->x * scale_x),
+            (GLint)(drawable_height - (rect->y + rect->h) * scale_y),
+            (GLsizei)(rect->w * scale_x),
+            (GLsizei)(rect->h * scale_y)
+    );
+
+    gl->UseProgram(gl->video_program);
+
+    for (int i = 0; i < 3; i++)
+    {
+        gl->ActiveTexture(GL_TEXTURE0 + i);
+        gl->BindTexture(GL_TEXTURE_2D, textures->planes[i < textures->nb_planes ? i : 0]);
+        gl->Uniform1i(gl->video_planes[i], i);
+    }
+
+    gl->Uniform1i(gl->video_interleaved, textures->interleaved);
+    gl->Uniform1f(gl->video_depth_scale, textures->depth_scale);
+    gl->Uniform3fv(gl->video_yuv_offset, 1, textures->yuv_offset);
+    gl->UniformMatrix3fv(gl->video_yuv_matrix, 1, GL_TRUE, textures->yuv_matrix);
+    gl->Uniform1i(gl->video_transfer, textures->transfer);
+    gl->Uniform1i(gl->video_convert_gamut, textures->convert_gamut);
+    gl->UniformMatrix3fv(gl->video_gamut, 1, GL_TRUE, GL_RENDER_BT2020_TO_BT709);
+    gl->Uniform1f(gl->video_peak, textures->peak);
+
+    gl->BindVertexArray(gl->vao);
+    gl->BindBuffer(GL_ARRAY_BUFFER, gl->video_vbo);
+    gl->EnableVertexAttribArray(GL_RENDER_ATTRIB_POSITION);
+    gl->EnableVertexAttribArray(GL_RENDER_ATTRIB_TEXCOORD);
+    gl->VertexAttribPointer(GL_RENDER_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (const void *)0);
+    gl->VertexAttribPointer(GL_RENDER_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (const void *)(2 * sizeof(GLfloat)));
+    gl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl->DisableVertexAttribArray(GL_RENDER_ATTRIB_TEXCOORD);
+
+    gl->ActiveTexture(GL_TEXTURE0);
+
+    // the overlay is drawn over the whole window
+    gl->Viewport(0, 0, drawable_width, drawable_height);
+}
+
+/**
+ * Fills the given rectangles with the given color, blended over what was drawn
+ * already.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   rects   the rectangles, in window coordinates.
+ * @param   count   the number of rectangles.
+ * @param   r       the color red component.
+ * @param   g       the color green component.
+ * @param   b       the color blue component.
+ * @param   a       the color alpha component.
+ */
+void gl_renderer_fill_rects(GLRenderer * gl, const SDL_Rect * rects, int count, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    // two triangles per rectangle, the vertices buffer only grows
+    if (count > gl->rect_capacity)
+    {
+        GLfloat * vertices = av_realloc_array(gl->rect_vertices, count, 12 * sizeof(GLfloat));
+        if (!vertices)
+        {
+            return;
+        }
+
+        gl->rect_vertices = vertices;
+        gl->rect_capacity = count;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        GLfloat x0 = rects[i].x;
+        GLfloat y0 = rects[i].y;
+        GLfloat x1 = rects[i].x + rects[i].w;
+        GLfloat y1 = rects[i].y + rects[i].h;
+        GLfloat * v = &gl->rect_vertices[12 * i];
+
+        v[0] = x0; v[1] = y0; v[2] = x1; v[3] = y0; v[4] = x0; v[5] = y1;
+        v[6] = x1; v[7] = y0; v[8] = x1; v[9] = y1; v[10] = x0; v[11] = y1;
+    }
+
+    int window_width, window_height;
+    SDL_GetWindowSize(gl->window, &window_width, &window_height);
+
+    gl->UseProgram(gl->rect_program);
+    gl->Uniform2f(gl->rect_viewport, (GLfloat)window_width, (GLfloat)window_height);
+    gl->Uniform4f(gl->rect_color, r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f);
+
+    gl->BindVertexArray(gl->vao);
+    gl->BindBuffer(GL_ARRAY_BUFFER, gl->rect_vbo);
+    gl->BufferData(GL_ARRAY_BUFFER, count * 12 * sizeof(GLfloat), gl->rect_vertices, GL_STREAM_DRAW);
+    gl->EnableVertexAttribArray(GL_RENDER_ATTRIB_POSITION);
+    gl->VertexAttribPointer(GL_RENDER_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (const void *)0);
+
+    gl->Enable(GL_BLEND);
+    gl->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl->DrawArrays(GL_TRIANGLES, 0, count * 6);
+    gl->Disable(GL_BLEND);
+}
+
+/**
+ * Shows what was drawn since the previous call.
+ *
+ * @param   gl  the GLRenderer.
+ */
+void gl_renderer_present(GLRenderer * gl)
+{
+    SDL_GL_SwapWindow(gl->window);
+}
+
+/**
+ * Frees the given GLRenderer.
+ *
+ * @param   gl  pointer to the GLRenderer, set to NULL. May point to NULL.
+ */
+void gl_renderer_free(GLRenderer ** gl)
+{
+    GLRenderer * renderer = *gl;
+
+    if (!renderer)
+    {
+        return;
+    }
+
+    // the OpenGL objects only exist if all of the functions were loaded
+    if (renderer->context && renderer->DrawArrays)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            renderer->DeleteTextures(3, renderer->textures[i].planes);
+        }
+
+        renderer->DeleteBuffers(1, &renderer->video_vbo);
+        renderer->DeleteBuffers(1, &renderer->rect_vbo);
+        renderer->DeleteVertexArrays(1, &renderer->vao);
+        renderer->DeleteProgram(renderer->video_program);
+        renderer->DeleteProgram(renderer->rect_program);
+    }
+
+    if (renderer->context)
+    {
+        SDL_GL_DeleteContext(renderer->context);
+    }
+
+    av_freep(&renderer->rect_vertices);
+    av_freep(gl);
+}
+
+/**
+ * Compiles and links a program from the given shaders sources.
+ *
+ * @param   gl              the GLRenderer.
+ * @param   vertex_source   the vertex shader source.
+ * @param   fragment_source the fragment shader source.
+ *
+ * @return                  the program, 0 in case of error.
+ */
+static GLuint gl_renderer_program(GLRenderer * gl, const char * vertex_source, const char * fragment_source)
+{
+    GLuint vertex = gl_renderer_shader(gl, GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment = gl_renderer_shader(gl, GL_FRAGMENT_SHADER, fragment_source);
+    GLuint program = 0;
+
+    if (vertex && fragment)
+    {
+        program = gl->CreateProgram();
+        gl->AttachShader(program, vertex);
+        gl->AttachShader(program, fragment);
+        gl->BindAttribLocation(program, GL_RENDER_ATTRIB_POSITION, "position");
+        gl->BindAttribLocation(program, GL_RENDER_ATTRIB_TEXCOORD, "texcoord");
+        gl->LinkProgram(program);
+
+        GLint status;
+        gl->GetProgramiv(program, GL_LINK_STATUS, &status);
+        if (!status)
+        {
+            char log[1024];
+            gl->GetProgramInfoLog(program, sizeof(log), NULL, log);
+            printf("OpenGL: could not link the program: %s\n", log);
+            gl->DeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // the program keeps the shaders it is linked with
+    if (vertex)
+    {
+        gl->DeleteShader(vertex);
+    }
+
+    if (fragment)
+    {
+        gl->DeleteShader(fragment);
+    }
+
+    return program;
+}
+
+/**
+ * Compiles the given shader source.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   type    the shader type, GL_VERTEX_SHADER or GL_FRAGMENT_SHADER.
+ * @param   source  the shader source.
+ *
+ * @return          the shader, 0 in case of error.
+ */
+static GLuint gl_renderer_shader(GLRenderer * gl, GLenum type, const char * source)
+{
+    GLuint shader = gl->CreateShader(type);
+    gl->ShaderSource(shader, 1, &source, NULL);
+    gl->CompileShader(shader);
+
+    GLint status;
+    gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status)
+    {
+        char log[1024];
+        gl->GetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("OpenGL: could not compile the shader: %s\n", log);
+        gl->DeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/**
+ * (Re)creates the plane textures of the given set for the given frame size and
+ * format: R8 or R16 textures, RG8 or RG16 for the interleaved chroma.
+ *
+ * @param   gl          the GLRenderer.
+ * @param   textures    the textures set.
+ * @param   frame       the AVFrame.
+ * @param   desc        the AVFrame pixel format descriptor.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int gl_renderer_textures(GLRenderer * gl, GLRenderTextures * textures, const AVFrame * frame, const AVPixFmtDescriptor * desc)
+{
+    if (textures->planes[0])
+    {
+        gl->DeleteTextures(3, textures->planes);
+        memset(textures->planes, 0, sizeof(textures->planes));
+    }
+
+    int bytes = desc->comp[0].depth > 8 ? 2 : 1;
+
+    textures->interleaved = desc->comp[1].plane == desc->comp[2].plane;
+    textures->nb_planes = textures->interleaved ? 2 : 3;
+    textures->width = frame->width;
+    textures->height = frame->height;
+    textures->format = frame->format;
+    textures->uploaded = 0;
+
+    gl->GenTextures(textures->nb_planes, textures->planes);
+
+    for (int i = 0; i < textures->nb_planes; i++)
+    {
+        int rg = i == 1 && textures->interleaved;
+        int width = i == 0 ? frame->width : AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w);
+        int height = i == 0 ? frame->height : AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+
+        gl->BindTexture(GL_TEXTURE_2D, textures->planes[i]);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        gl->TexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                bytes > 1 ? (rg ? GL_RG16 : GL_R16) : (rg ? GL_RG8 : GL_R8),
+                width,
+                height,
+                0,
+                rg ? GL_RG : GL_RED,
+                bytes > 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE,
+                NULL
+        );
+    }
+
+    return 0;
+}
+
+/**
+ * Sets the conversion of the given frame to display RGB: the samples depth
+ * and range, the YUV to RGB matrix of its colorspace, and for HDR frames the
+ * transfer function and tonemapping peak. Unspecified colorspaces are guessed
+ * from the frame height.
+ *
+ * @param   textures    the textures set the frame was uploaded to.
+ * @param   frame       the AVFrame.
+ * @param   desc        the AVFrame pixel format descriptor.
+ */
+static void gl_renderer_colorimetry(GLRenderTextures * textures, const AVFrame * frame, const AVPixFmtDescriptor * desc)
+{
+    int depth = desc->comp[0].depth;
+    double max = (1 << depth) - 1;
+
+    // the 16 bits textures samples are normalized to 65535, whatever the depth
+    // and alignment of the actual samples
+    textures->depth_scale = depth > 8 ? (GLfloat)(65535.0 / (max * (1 << desc->comp[0].shift))) : 1.0f;
+
+    int full_range = frame->color_range == AVCOL_RANGE_JPEG ||
+                     (frame->color_range == AVCOL_RANGE_UNSPECIFIED && strncmp(desc->name, "yuvj", 4) == 0);
+
+    double y_offset = full_range ? 0.0 : (16 << (depth - 8)) / max;
+    double y_scale = full_range ? 1.0 : max / (219 << (depth - 8));
+    double c_offset = (1 << (depth - 1)) / max;
+    double c_scale = full_range ? 1.0 : max / (224 << (depth - 8));
+
+    // luma coefficients of the colorspace
+    double kr, kb;
+    switch (frame->colorspace)
+    {
+        case AVCOL_SPC_BT709:
+        {
+            kr = 0.2126;
+            kb = 0.0722;
+        }
+        break;
+
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+        {
+            kr = 0.2627;
+            kb = 0.0593;
+        }
+        break;
+
+        case AVCOL_SPC_SMPTE240M:
+        {
+            kr = 0.212;
+            kb = 0.087;
+        }
+        break;
+
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+        {
+            kr = 0.299;
+            kb = 0.114;
+        }
+        break;
+
+        default:
+        {
+            if (frame->color_primaries == AVCOL_PRI_BT2020)
+            {
+                kr = 0.2627;
+                kb = 0.0593;
+            }
+            else if (frame->height >= 720)
+            {
+                kr = 0.2126;
+                kb = 0.0722;
+            }
+            else
+            {
+                kr = 0.299;
+                kb = 0.114;
+            }
+        }
+        break;
+    }
+
+    double kg = 1.0 - kr - kb;
+
+    GLfloat matrix[9] = {
+            (GLfloat)y_scale, 0.0f,                                          (GLfloat)(2.0 * (1.0 - kr) * c_scale),
+            (GLfloat)y_scale, (GLfloat)(-2.0 * kb * (1.0 - kb) / kg * c_scale), (GLfloat)(-2.0 * kr * (1.0 - kr) / kg * c_scale),
+            (GLfloat)y_scale, (GLfloat)(2.0 * (1.0 - kb) * c_scale),          0.0f
+    };
+
+    memcpy(textures->yuv_matrix, matrix, sizeof(matrix));
+    textures->yuv_offset[0] = (GLfloat)y_offset;
+    textures->yuv_offset[1] = (GLfloat)c_offset;
+    textures->yuv_offset[2] = (GLfloat)c_offset;
+
+    // HDR transfer functions and the content peak luminance, from its metadata
+    double peak = GL_RENDER_DEFAULT_PEAK;
+
+    if (frame->color_trc == AVCOL_TRC_SMPTE2084)
+    {
+        textures->transfer = GL_RENDER_TRANSFER_PQ;
+
+        AVFrameSideData * sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+        AVFrameSideData * md = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+
+        if (sd && ((AVContentLightMetadata *)sd->data)->MaxCLL > 0)
+        {
+            peak = ((AVContentLightMetadata *)sd->data)->MaxCLL;
+        }
+        else if (md && ((AVMasteringDisplayMetadata *)md->data)->has_luminance)
+        {
+            peak = av_q2d(((AVMasteringDisplayMetadata *)md->data)->max_luminance);
+        }
+    }
+    else if (frame->color_trc == AVCOL_TRC_ARIB_STD_B67)
+    {
+        textures->transfer = GL_RENDER_TRANSFER_HLG;
+    }
+    else
+    {
+        textures->transfer = GL_RENDER_TRANSFER_SDR;
+    }
+
+    textures->peak = (GLfloat)FFMAX(peak / GL_RENDER_REFERENCE_WHITE, 1.0);
+    textures->convert_gamut = frame->color_primaries == AVCOL_PRI_BT2020;
+}
@@ -0,0 +1,125 @@
+/**
+*
+*   File:   glrender.h
+*           libplayer OpenGL renderer: the decoded frames planes are uploaded as
+*           they are, 8 to 16 bits, 3 planes or NV12/P010 style 2 planes, and a
+*           fragment shader does the YUV to RGB conversion, the HDR tonemapping
+*           and the scaling to the window. The CPU cost of a frame only depends
+*           on its size, not on the window size or the pixel format.
+*
+*           The OpenGL 3.2 core functions are loaded through SDL, nothing else
+*           has to be linked. All of the functions below must be called from
+*           the thread which created the GLRenderer.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#ifndef GLRENDER_H
+#define GLRENDER_H
+
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <SDL2/SDL.h>
+
+/**
+ * Reference white, in nits: the HDR frames are tonemapped so that this
+ * luminance is displayed as the SDR white.
+ */
+#define GL_RENDER_REFERENCE_WHITE 203.0
+
+/**
+ * Peak luminance, in nits, of the HDR frames without content light level or
+ * mastering display metadata.
+ */
+#define GL_RENDER_DEFAULT_PEAK 1000.0
+
+/**
+ * An OpenGL renderer, opaque. It owns the OpenGL context of its window and two
+ * sets of plane textures, as the SDL_Renderer path has two SDL_Textures.
+ */
+typedef struct GLRenderer GLRenderer;
+
+/**
+ * Returns whether the frames of the given pixel format can be uploaded to a
+ * GLRenderer as they are.
+ *
+ * @param   pix_fmt the AVFrame pixel format.
+ *
+ * @return          != 0 if supported, 0 if the frames have to be converted with
+ *                  sws_scale() first.
+ */
+int gl_renderer_supported(enum AVPixelFormat pix_fmt);
+
+/**
+ * Creates an OpenGL context for the given window, made current on the calling
+ * thread, and the shaders drawing to it.
+ *
+ * @param   window  the SDL_Window, created with SDL_WINDOW_OPENGL.
+ *
+ * @return          the new GLRenderer, NULL in case of error.
+ */
+GLRenderer * gl_renderer_create(SDL_Window * window);
+
+/**
+ * Uploads the planes of the given frame to the given set of textures, which
+ * are recreated if the frame size or format changes.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ * @param   frame   the AVFrame, in a gl_renderer_supported() format.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+int gl_renderer_upload(GLRenderer * gl, int index, const AVFrame * frame);
+
+/**
+ * Returns whether a frame was uploaded to the given set of textures.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ *
+ * @return          != 0 if a frame was uploaded, 0 otherwise.
+ */
+int gl_renderer_has_frame(GLRenderer * gl, int index);
+
+/**
+ * Clears the window and draws the frame of the given set of textures in the
+ * given area, scaled by the GPU.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   index   the textures set, 0 or 1.
+ * @param   rect    the area, in window coordinates.
+ */
+void gl_renderer_draw(GLRenderer * gl, int index, const SDL_Rect * rect);
+
+/**
+ * Fills the given rectangles with the given color, blended over what was drawn
+ * already.
+ *
+ * @param   gl      the GLRenderer.
+ * @param   rects   the rectangles, in window coordinates.
+ * @param   count   the number of rectangles.
+ * @param   r       the color red component.
+ * @param   g       the color green component.
+ * @param   b       the color blue component.
+ * @param   a       the color alpha component.
+ */
+void gl_renderer_fill_rects(GLRenderer * gl, const SDL_Rect * rects, int count, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+
+/**
+ * Shows what was drawn since the previous call, waiting for the vsync.
+ *
+ * @param   gl  the GLRenderer.
+ */
+void gl_renderer_present(GLRenderer * gl);
+
+/**
+ * Frees the given GLRenderer, its textures, shaders and OpenGL context.
+ *
+ * @param   gl  pointer to the GLRenderer, set to NULL. May point to NULL.
+ */
+void gl_renderer_free(GLRenderer ** gl);
+
+#endif // GLRENDER_H
@@ -0,0 +1,7758 @@
+/**
+*
+*   File:   player.c
+*           libplayer: the playback engine of tutorial07.c as a library. The
+*           whole state of a playback lives in its Player (VideoState): there is
+*           no global state, so several independent players can run in the same
+*           process. Their demuxing, decoding and scaling run as tasks of the
+*           shared scheduler (scheduler.c). See player.h for the API.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/avstring.h>
+#include <libavutil/time.h>
+#include <libavutil/opt.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_thread.h>
+#include "player.h"
+#include "scheduler.h"
+#include "scale.h"
+#include "glrender.h"
+
+/**
+ * Debug flag: one-off diagnostics (stream layout, decoder setup, ...).
+ */
+#ifndef _DEBUG_
+#define _DEBUG_ 1
+#endif
+
+/**
+ * Per-frame debug logging (timestamps, sync decisions, uploaded frames). Compiled
+ * out unless built with -D_DEBUG_FRAMES_=1: at high frame rates printing on every
+ * frame costs more than the rest of the video pipeline.
+ */
+#ifndef _DEBUG_FRAMES_
+#define _DEBUG_FRAMES_ 0
+#endif
+
+/**
+ * SDL audio buffer size in samples, default of --audio-buffer=N.
+ */
+#define SDL_AUDIO_BUFFER_SIZE 1024
+
+/**
+ * SDL audio buffer sizes in samples used by --audio-buffer=low and
+ * --audio-buffer=high: low latency for interactive use, low wake-up rate for
+ * batch and kiosk use.
+ */
+#define AUDIO_BUFFER_LOW_LATENCY 256
+#define AUDIO_BUFFER_HIGH_LATENCY 8192
+
+/**
+ * Pseudo buffer size requesting a buffer size derived from the sample rate, so
+ * that the audio callback runs about AUDIO_MAX_CALLBACKS_PER_SEC times a second.
+ */
+#define AUDIO_BUFFER_AUTO 0
+#define AUDIO_MAX_CALLBACKS_PER_SEC 30
+
+/**
+ * Duration, in seconds, of decoded audio the AudioRing between the audio
+ * decoding task and the audio callback can hold, at least.
+ */
+#define AUDIO_RING_DURATION 0.5
+
+/**
+ * Audio packets queue minimum size, in bytes: the floor of the maximum size
+ * derived from the stream bitrate by packet_queue_max_size().
+ */
+#define MAX_AUDIOQ_SIZE (5 * 16 * 1024)
+
+/**
+ * Video packets queue minimum size, in bytes: the floor of the maximum size
+ * derived from the stream bitrate by packet_queue_max_size().
+ */
+#define MAX_VIDEOQ_SIZE (5 * 256 * 1024)
+
+/**
+ * Packet queues high watermark, in seconds of buffered media: the demux thread
+ * stops reading when a packet queue holds more than this (or more than its
+ * maximum size in bytes) and none of the packet queues is below its low
+ * watermark.
+ */
+#define PACKET_QUEUE_HIGH_DURATION 2.0
+
+/**
+ * Packet queues low watermark, in seconds of buffered media and in percent of
+ * the queue maximum size in bytes: a parked demux thread resumes reading as
+ * soon as one of the packet queues is below both.
+ */
+#define PACKET_QUEUE_LOW_DURATION 0.5
+#define PACKET_QUEUE_LOW_SIZE_PERCENT 50
+
+/**
+ * Packet queues maximum size: PACKET_QUEUE_HIGH_DURATION seconds at
+ * PACKET_QUEUE_BITRATE_MARGIN times the stream bitrate, covering the variable
+ * bitrate peaks. The bitrate of a video stream which does not declare it is
+ * estimated at VIDEO_BITS_PER_PIXEL bits per pixel of each frame.
+ */
+#define PACKET_QUEUE_BITRATE_MARGIN 2
+#define VIDEO_BITS_PER_PIXEL 0.15
+
+/**
+ * AV sync correction threshold.
+ */
+#define AV_SYNC_THRESHOLD 0.01
+
+/**
+ * No AV sync correction threshold.
+ */
+#define AV_NOSYNC_THRESHOLD 1.0
+
+/**
+ * Video lag behind the master clock, in seconds, above which the decoder starts
+ * skipping work (loop filter first, then non-reference frames) if it lasts for
+ * FRAME_DROP_ESCALATE_TIME seconds. The decoder goes back to the previous level
+ * once the lag stays below AV_SYNC_THRESHOLD for as long.
+ */
+#define FRAME_DROP_ESCALATE_LAG 0.1
+#define FRAME_DROP_ESCALATE_TIME 1.0
+
+/**
+ * Decoder skip levels used under CPU overload.
+ */
+#define DECODER_SKIP_NONE 0
+#define DECODER_SKIP_LOOP_FILTER 1
+#define DECODER_SKIP_NONREF 2
+
+/**
+ *
+ */
+#define SAMPLE_CORRECTION_PERCENT_MAX 10
+
+/**
+ *
+ */
+#define AUDIO_DIFF_AVG_NB 20
+
+/**
+ * Time, in seconds, the presentation thread busy-waits before a deadline
+ * instead of sleeping, to make up for the sleep granularity of the system.
+ */
+#define PRESENTATION_SPIN_TIME 0.0005
+
+/**
+ * Time, in seconds, the presentation thread waits before checking again for
+ * the video stream or a decoded frame.
+ */
+#define PRESENTATION_IDLE_TIME 0.1
+
+/**
+ * Default Video Frame queue size, can be changed using --pictq=N.
+ */
+#define VIDEO_PICTURE_QUEUE_SIZE 3
+
+/**
+ * Maximum Video Frame queue size.
+ */
+#define VIDEO_PICTURE_QUEUE_MAX_SIZE 16
+
+/**
+ * Default video decoder threading, can be changed using --threads=N and
+ * --thread-type=frame|slice|auto. A thread count of 0 takes the share of the
+ * player in the decoder threads budget (--thread-budget=N) shared by all of
+ * the players of the process, see scheduler_decoder_threads_acquire().
+ */
+#define VIDEO_DECODER_THREADS 0
+#define VIDEO_DECODER_THREAD_TYPE (FF_THREAD_FRAME | FF_THREAD_SLICE)
+
+/**
+ * Maximum number of video decoder threads.
+ */
+#define VIDEO_DECODER_MAX_THREADS 64
+
+/**
+ * Default number of bands the sws_scale() conversion is split in, converted in
+ * parallel on the shared workers, can be changed using --scale-slices=N|auto.
+ * 0 picks it from the frame height and the number of workers.
+ */
+#define SCALE_SLICES 0
+
+/**
+ * Default hardware accelerated decoding device, can be changed using
+ * --hwaccel=auto|none|<device>. When set to auto, the platform devices listed
+ * by HW_DEVICE_TYPES_AUTO are tried in order.
+ */
+#define DEFAULT_HW_DEVICE_TYPE AV_HWDEVICE_TYPE_NONE
+
+/**
+ * Memory alignment, in bytes, of the VideoPicture frames planes and lines.
+ */
+#define VIDEO_PICTURE_ALIGN 64
+
+/**
+ * Initial number of entries of the video KeyframeIndex, doubled when full.
+ */
+#define KEYFRAME_INDEX_INITIAL_CAPACITY 256
+
+/**
+ * Sidecar seek index file, enabled with --seek-index: stored next to the media
+ * file as <filename>SEEK_INDEX_SUFFIX.
+ */
+#define SEEK_INDEX_SUFFIX ".seekidx"
+#define SEEK_INDEX_MAGIC "SEEKIDX"
+#define SEEK_INDEX_VERSION 1
+
+/**
+ * Demuxer probing limits used by --fast-start, in bytes and in AV_TIME_BASE
+ * units: the stream information not found within them is completed by the
+ * decoders from the first packets.
+ */
+#define FAST_START_PROBESIZE 32768
+#define FAST_START_ANALYZE_DURATION 100000
+
+/**
+ * Default AVIOContext buffer size in KB, can be changed using --io-buffer=KB.
+ */
+#define INPUT_IO_BUFFER_SIZE 32
+#define INPUT_IO_BUFFER_MAX_SIZE 16384
+
+/**
+ * Default read-ahead of the prefetch backend in MB, can be changed using
+ * --prefetch=MB, and the size of each read issued by the prefetch thread.
+ */
+#define INPUT_PREFETCH_SIZE 8
+#define INPUT_PREFETCH_MAX_SIZE 1024
+#define INPUT_PREFETCH_CHUNK (256 * 1024)
+
+/**
+ * Default memory budget of a player in MB, can be changed using --memory=MB.
+ * It is split between the memory arenas (PLAYER_MEMORY_*) by
+ * MEMORY_ARENA_SHARES.
+ */
+#define MEMORY_BUDGET 256
+#define MEMORY_BUDGET_MIN 16
+#define MEMORY_BUDGET_MAX 2047
+
+/**
+ * Network inputs: default jitter buffer depth in seconds, can be changed using
+ * --buffer=MS, and the I/O timeout in microseconds after which a stalled
+ * connection fails instead of blocking the demuxer. The jitter buffer must stay
+ * below PACKET_QUEUE_HIGH_DURATION, or the demuxer backpressure would keep it
+ * from ever being filled.
+ */
+#define NETWORK_JITTER_BUFFER 0.5
+#define JITTER_BUFFER_MAX 1.5
+#define NETWORK_TIMEOUT 5000000
+
+/**
+ * Live mode (--live): the buffered media duration is averaged with this
+ * coefficient at each audio frame, and the audio is played at most
+ * LIVE_SPEED_CORRECTION_PERCENT_MAX percent faster or slower to bring it back
+ * to the jitter buffer depth, unless it is within LIVE_LATENCY_TOLERANCE
+ * seconds already.
+ */
+#define LIVE_LATENCY_AVG_COEF 0.98
+#define LIVE_LATENCY_TOLERANCE 0.05
+#define LIVE_SPEED_CORRECTION_PERCENT_MAX 2
+
+/**
+ * Pipeline instrumentation: interval, in milliseconds, of the stats summaries
+ * shown by the overlay and written by --stats=FILE, and number of log2 buckets
+ * of the latency histograms: bucket i counts the samples in [2^i, 2^(i+1))
+ * microseconds, the last one also everything above.
+ */
+#define STATS_INTERVAL 1000
+#define STATS_HISTOGRAM_BUCKETS 24
+
+/**
+ * On-screen stats overlay: size in screen pixels of a font pixel, and margin
+ * in screen pixels from the window corner.
+ */
+#define STATS_OVERLAY_SCALE 2
+#define STATS_OVERLAY_MARGIN 8
+
+/**
+ * Work done by one step of the scheduler tasks before they yield to the other
+ * queued tasks: AVPackets read by a demux step, AVPackets sent to the decoder
+ * by the video decoding task and audio frames decoded by the audio decoding
+ * task.
+ */
+#define DEMUX_TASK_QUANTUM 32
+#define VIDEO_TASK_QUANTUM 4
+#define AUDIO_TASK_QUANTUM 8
+
+/**
+ * Consecutive audio decoding failures after which the audio stream is given
+ * up: its AVPackets are then discarded and the video is synced to its own
+ * clock.
+ */
+#define AUDIO_DECODE_MAX_ERRORS 16
+
+/**
+ * Default audio video sync type.
+ */
+#define DEFAULT_AV_SYNC_TYPE AV_SYNC_AUDIO_MASTER
+
+/**
+ * Accounted memory arena of a player: current and peak are the bytes drawn
+ * from it, updated lock-free by any thread, limit is its share of the memory
+ * budget, in bytes. The limit sizes the buffers drawing from the arena when
+ * they are created (the packet queues maximum size, the VideoPicture pool
+ * capacity, the prefetch ring), so it is never checked while playing.
+ */
+typedef struct MemoryArena
+{
+    SDL_atomic_t    current;
+    SDL_atomic_t    peak;
+    int             limit;
+} MemoryArena;
+
+/**
+ * Number of AVPacket slots in a PacketQueue ring. Must be a power of 2.
+ */
+#define PACKET_QUEUE_CAPACITY 1024
+
+/**
+ * Single-producer/single-consumer ring used to store AVPackets.
+ *
+ * The demux thread is the only producer and the decoding task of the stream the
+ * only consumer: windex is only written by the producer and rindex only by the
+ * consumer, so no lock is taken while the ring is neither empty nor full. The
+ * indices are free running and are masked with (PACKET_QUEUE_CAPACITY - 1) to
+ * address a slot. The AVPacket slots are allocated once in packet_queue_init()
+ * and reused for the whole playback.
+ *
+ * size is the total size of the queued AVPackets in bytes and duration their
+ * total duration in milliseconds (using time_base); both are compared against
+ * max_size and the PACKET_QUEUE_* watermarks to apply backpressure on
+ * the demux thread.
+ *
+ * serial is increased by each packet_queue_flush(): packet_queue_get() returns
+ * the serial the extracted AVPacket belongs to, so the consumer knows when to
+ * flush its decoder state without any special AVPacket in the ring.
+ *
+ * videoState is the player the queue belongs to, for its quit flag and its
+ * demuxer backpressure, consumer the task woken up by each new AVPacket.
+ */
+typedef struct PacketQueue
+{
+    struct VideoState * videoState;
+    SchedulerTask * consumer;
+    MemoryArena *   arena;
+    AVPacket *      pkts[PACKET_QUEUE_CAPACITY];
+    SDL_atomic_t    windex;
+    SDL_atomic_t    rindex;
+    SDL_atomic_t    flush_index;
+    SDL_atomic_t    serial;
+    SDL_atomic_t    nb_packets;
+    SDL_atomic_t    size;
+    SDL_atomic_t    duration;
+    SDL_atomic_t    waiting;
+    int             max_size;
+    AVRational      time_base;
+    SDL_mutex *     mutex;
+    SDL_cond *      cond;
+} PacketQueue;
+
+/**
+ * Keyframes of the video stream, sorted by pts (in the stream time base), with
+ * their byte position in the file. It is built lazily by the demux thread from
+ * the demuxed AVPackets and lets a seek ask the demuxer for the exact keyframe
+ * the target GOP starts with.
+ */
+typedef struct KeyframeIndex
+{
+    int64_t *   pts;
+    int64_t *   pos;
+    int         nb_entries;
+    int         capacity;
+} KeyframeIndex;
+
+/**
+ * Sidecar seek index file layout. All the fields are in the native byte order
+ * (a file written with a different one fails the version check):
+ *
+ *  - SeekIndexHeader;
+ *  - one SeekIndexStream per AVStream, with the parameters probed by
+ *    avformat_find_stream_info();
+ *  - the streams extradata, each one padded to 8 bytes;
+ *  - nb_entries SeekIndexEntry, sorted by pts within each stream.
+ *
+ * The file is only valid for the media file with the same size and mtime.
+ */
+typedef struct SeekIndexHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    nb_streams;
+    int64_t     file_size;
+    int64_t     file_mtime;
+    int64_t     start_time;
+    int64_t     duration;
+    int64_t     bit_rate;
+    int64_t     entries_offset;
+    int64_t     nb_entries;
+} SeekIndexHeader;
+
+typedef struct SeekIndexStream
+{
+    int64_t     bit_rate;
+    int64_t     start_time;
+    int64_t     duration;
+    uint64_t    channel_layout;
+    int64_t     extradata_offset;
+    int32_t     extradata_size;
+    int32_t     codec_type;
+    int32_t     codec_id;
+    uint32_t    codec_tag;
+    int32_t     format;
+    int32_t     profile;
+    int32_t     level;
+    int32_t     width;
+    int32_t     height;
+    int32_t     sample_aspect_ratio[2];
+    int32_t     field_order;
+    int32_t     color_range;
+    int32_t     color_primaries;
+    int32_t     color_trc;
+    int32_t     color_space;
+    int32_t     chroma_location;
+    int32_t     video_delay;
+    int32_t     channels;
+    int32_t     sample_rate;
+    int32_t     frame_size;
+    int32_t     block_align;
+    int32_t     initial_padding;
+    int32_t     bits_per_coded_sample;
+    int32_t     bits_per_raw_sample;
+    int32_t     time_base[2];
+    int32_t     avg_frame_rate[2];
+    int32_t     r_frame_rate[2];
+    int32_t     reserved;
+} SeekIndexStream;
+
+typedef struct SeekIndexEntry
+{
+    int64_t     pts;
+    int64_t     pos;
+    int32_t     stream_index;
+    int32_t     flags;
+} SeekIndexEntry;
+
+/**
+ * Sidecar seek index state. The sidecar is mapped by seek_index_open() and
+ * unmapped once its keyframes are loaded. path is empty if the media file
+ * could not be stat()ed, in which case no sidecar is written either.
+ */
+typedef struct SeekIndex
+{
+    char        path[1040];
+    int64_t     file_size;
+    int64_t     file_mtime;
+    uint8_t *   map;
+    size_t      map_size;
+    int         loaded;
+    int         nb_loaded_entries;
+} SeekIndex;
+
+/**
+ * Custom AVIOContext backend of the media file (--io=prefetch|mmap).
+ *
+ * prefetch: the prefetch thread keeps the ring filled with the bytes following
+ * the read position, with pread() calls issued outside of the lock. The ring
+ * holds ring_fill bytes of the file starting at pos, from ring_rindex. A seek
+ * inside the buffered data only skips bytes; otherwise the ring is reset and
+ * generation increased, so that a read in flight is discarded.
+ *
+ * mmap: the whole file is mapped and copied straight into the buffers of the
+ * AVIOContext, no read() system call is issued.
+ *
+ * bytes_fetched and fetch_time measure the backing reads (pread() or mapped
+ * memory copies), stall_time is the time the demuxer waited for data.
+ *
+ * The prefetch ring and the AVIOContext buffer, arena_size bytes, are drawn
+ * from the PLAYER_MEMORY_INPUT arena; the mapped file is page cache and is not
+ * accounted.
+ */
+typedef struct InputReader
+{
+    int             type;
+    int             fd;
+    int64_t         file_size;
+    int64_t         pos;
+    uint8_t *       map;
+    AVIOContext *   avio;
+
+    MemoryArena *   arena;
+    int             arena_size;
+
+    uint8_t *       ring;
+    int             ring_capacity;
+    int             ring_rindex;
+    int             ring_fill;
+    int             generation;
+    int             eof;
+    int             error;
+    int             abort;
+    SDL_mutex *     mutex;
+    SDL_cond *      cond;
+    SDL_Thread *    prefetch_tid;
+
+    int64_t         bytes_fetched;
+    int64_t         fetch_time;
+    int64_t         stall_time;
+} InputReader;
+
+/**
+ * Queue structure used to store processed video frames. The frame data points
+ * into buffer, which is kept for the whole playback and only reallocated when
+ * the video resolution changes. A direct picture references the decoded frame
+ * in src_frame instead, src_frame_size is the size of its buffers charged to
+ * the pictures arena.
+ */
+typedef struct VideoPicture
+{
+    AVFrame *   frame;
+    AVFrame *   src_frame;
+    int         src_frame_size;
+    int         direct;
+    uint8_t *   buffer;
+    int         buffer_size;
+    int         width;
+    int         height;
+    int         allocated;
+    double      pts;
+    double      display_time;
+    int         dropped;
+} VideoPicture;
+
+/**
+ * Struct used to hold data fields used for audio resampling.
+ */
+typedef struct AudioResamplingState
+{
+    SwrContext * swr_ctx;
+    int64_t in_channel_layout;
+    enum AVSampleFormat in_sample_fmt;
+    int in_sample_rate;
+    uint64_t out_channel_layout;
+    enum AVSampleFormat out_sample_fmt;
+    int out_sample_rate;
+    int out_nb_channels;
+    int out_linesize;
+    int in_nb_samples;
+    int64_t out_nb_samples;
+    int64_t max_out_nb_samples;
+    uint8_t ** resampled_data;
+    int resampled_data_size;
+    MemoryArena * arena;
+    int buffer_size;
+
+} AudioResamplingState;
+
+/**
+ * Lock-free single producer single consumer ring of decoded audio samples: the
+ * audio decoding task writes, the SDL audio callback reads. Both indices are
+ * free running byte counters, the capacity is a power of 2.
+ */
+typedef struct AudioRing
+{
+    uint8_t *       data;
+    int             capacity;
+    SDL_atomic_t    windex;
+    SDL_atomic_t    rindex;
+} AudioRing;
+
+/**
+ * Lock-free latency histogram, in microseconds. Any thread adds samples with
+ * stats_record(); stats_update() takes them out with SDL_AtomicSet(), which
+ * returns the previous value, so each summary covers exactly one interval and
+ * the counters do not overflow.
+ */
+typedef struct StatsHistogram
+{
+    SDL_atomic_t    count;
+    SDL_atomic_t    total;
+    SDL_atomic_t    max;
+    SDL_atomic_t    buckets[STATS_HISTOGRAM_BUCKETS];
+} StatsHistogram;
+
+/**
+ * Struct used to hold the format context, the indices of the audio and video stream,
+ * the corresponding AVStream objects, the audio and video codec information,
+ * the audio and video queues and buffers, the quit flag and the filename of
+ * the movie.
+ */
+typedef struct VideoState
+{
+    /**
+     * File I/O Context.
+     */
+    AVFormatContext * pFormatCtx;
+
+    /**
+     * Audio Stream.
+     */
+    int                 audioStream;
+    AVStream *          audio_st;
+    AVCodecContext *    audio_ctx;
+    PacketQueue         audioq;
+    AudioRing           audio_ring;
+    SDL_AudioDeviceID   audio_dev;
+    int                 audio_buffer_samples;
+    int                 audio_hw_buf_size;
+    SDL_atomic_t        audio_callback_time;
+    SDL_SpinLock        audio_clock_lock;
+    double              audio_ring_clock;
+    int                 audio_ring_clock_windex;
+    AVPacket *          audio_pkt;
+    AVFrame *           audio_frame;
+    int64_t             audio_decode_time;
+    double              audio_clock;
+    AudioResamplingState * audio_resampler;
+    uint8_t *           audio_pending_buf;
+    int                 audio_pending_size;
+    int                 audio_decode_errors;
+    SDL_atomic_t        audio_disabled;
+
+    /**
+     * Video Stream.
+     */
+    int                 videoStream;
+    AVStream *          video_st;
+    AVCodecContext *    video_ctx;
+    AVPacket *          video_pkt;
+    AVFrame *           video_frame;
+    int                 video_receiving;
+    int                 video_draining;
+    int                 video_frame_pending;
+    double              video_frame_pts;
+    int64_t             video_decode_time;
+    SDL_Window *        screen;
+    SDL_Renderer *      renderer;
+    PacketQueue         videoq;
+    SliceScaler         scaler;
+    double              frame_timer;
+    double              frame_last_pts;
+    double              frame_last_delay;
+    double              video_clock;
+    double              video_current_pts;
+    int64_t             video_current_pts_time;
+    SDL_SpinLock        video_clock_lock;
+    int                 video_decoder_threads;
+    int                 video_decoder_threads_taken;
+    int                 video_decoder_thread_type;
+    int                 hw_device_type;
+    enum AVPixelFormat  hw_pix_fmt;
+    AVBufferRef *       hw_device_ctx;
+    AVBufferPool *      hw_download_pool;
+    int                 hw_download_size;
+    double              audio_diff_cum;
+    double              audio_diff_avg_coef;
+    double              audio_diff_threshold;
+    int                 audio_diff_avg_count;
+
+    /**
+     * VideoPicture Queue.
+     */
+    VideoPicture *      pictq;
+    int                 pictq_capacity;
+    int                 pictq_size;
+    int                 pictq_rindex;
+    int                 pictq_windex;
+    SDL_mutex *         pictq_mutex;
+
+    /**
+     * Render stage: double-buffered textures, the front one is on screen while
+     * the next VideoPicture is uploaded to the back one. The VideoPicture queue
+     * mutex also protects the render requests. With --renderer=gl the
+     * GLRenderer replaces the SDL_Renderer and holds the textures.
+     */
+    int                 renderer_type;
+    int                 convert_all;
+    GLRenderer *        gl;
+    SDL_Texture *       textures[2];
+    Uint32              texture_formats[2];
+    int                 texture_front;
+    int                 texture_back_ready;
+    int                 pictq_render_index;
+    int                 pictq_render_requests;
+    SDL_cond *          render_cond;
+
+    /**
+     * Presentation scheduling, on the clock of the player: clock returns the
+     * current time in microseconds, the av_gettime_relative() monotonic clock
+     * while playing, the virtual replay_time under player_replay(). The
+     * presentation deadlines, the audio device callback time and the video and
+     * external clocks all use it.
+     */
+    int64_t             (* clock)(struct VideoState * videoState);
+    double              vsync_period;
+    double              frame_lateness;
+    double              frame_lateness_max;
+
+    /**
+     * Deterministic replay, player_replay(): the tasks run on the calling
+     * thread and replay_time only moves forward when the presentation waits.
+     * The simulated audio sink pulls a device buffer every audio_buffer_samples
+     * samples of virtual time since replay_audio_start, replay_video_ready is
+     * the virtual time the simulated video decoder is busy until. Each frame
+     * shown, dropped or skipped is reported to replay_callback.
+     */
+    int                 replay;
+    int64_t             replay_time;
+    int64_t             replay_audio_start;
+    int64_t             replay_audio_callbacks;
+    uint8_t *           replay_audio_buf;
+    int64_t             replay_video_ready;
+    int64_t             replay_video_decode_time;
+    int                 replay_demux_done;
+    int                 replay_video_done;
+    int                 replay_audio_done;
+    int                 replay_frames;
+    PlayerTraceCallback replay_callback;
+    void *              replay_opaque;
+
+    /**
+     * Late frames drop policy counters: frames dropped from the VideoPicture
+     * queue, frames dropped right after decoding (never converted nor
+     * uploaded) and the current decoder skip level. lag_state_start is the
+     * time the current lag period started, negated for a recovery period.
+     */
+    SDL_atomic_t        frames_dropped;
+    SDL_atomic_t        frames_skipped;
+    SDL_atomic_t        decoder_skip_level;
+    double              lag_state_start;
+
+    /**
+     * Pipeline instrumentation: the stage histograms and av_diff, the last
+     * A/V difference in microseconds, are updated lock-free by the pipeline
+     * threads. Every STATS_INTERVAL ms the presentation thread summarizes them
+     * with stats_update() into stats_summary, protected by stats_lock, for the
+     * overlay (player_toggle_stats_overlay()) and the --stats=FILE dump.
+     * stats_next_time is the time of the next summary.
+     */
+    StatsHistogram      stats[PLAYER_STAGE_NB];
+    SDL_atomic_t        av_diff;
+    SDL_atomic_t        stats_overlay;
+    int64_t             stats_next_time;
+    SDL_SpinLock        stats_lock;
+    PlayerIntervalStats        stats_summary;
+    FILE *              stats_file;
+    int                 stats_json;
+
+    /**
+     * Memory budget in bytes (--memory=MB) and its accounted arenas, indexed
+     * by PLAYER_MEMORY_*: the packet queues, the VideoPicture pool buffers,
+     * the audio ring and resampler buffers and the input backend buffers draw
+     * from them.
+     */
+    int                 memory_budget;
+    MemoryArena         memory[PLAYER_MEMORY_NB];
+
+    /**
+     * AV Sync. The external clock runs at the computer clock rate from
+     * external_clock, its value at external_clock_time. Both are read and set
+     * again by the presentation thread and the decoding tasks, under
+     * external_clock_lock.
+     */
+    int             av_sync_type;
+    double          external_clock;
+    int64_t         external_clock_time;
+    SDL_SpinLock    external_clock_lock;
+
+    /**
+     * Network input and live mode. jitter_buffer is the media duration, in
+     * seconds, the audio queue must hold before the playback starts or resumes
+     * after an underrun, 0 if disabled (--buffer=MS). In live mode (--live) the
+     * audio speed is adjusted to keep live_latency, the averaged buffered media
+     * duration, at the jitter buffer depth. rebuffer_start is the time the
+     * current rebuffering started, 0 if none.
+     */
+    int     network_input;
+    int     live;
+    double  jitter_buffer;
+    double  live_latency;
+    int     rebuffer_count;
+    int64_t rebuffer_time;
+    int64_t rebuffer_start;
+
+    /**
+     * Seeking. seek_pos and seek_rel are in AV_TIME_BASE units. In accurate
+     * seek mode the frames before seek_target_time are decoded but neither
+     * converted nor played: each decoder sets its seek_pending flag when it
+     * sees a new PacketQueue serial and clears it when it reaches the target.
+     */
+    int             seek_req;
+    int64_t         seek_pos;
+    int64_t         seek_rel;
+    int             accurate_seek;
+    double          seek_target_time;
+    int             video_pkt_serial;
+    int             audio_pkt_serial;
+    int             video_seek_pending;
+    int             audio_seek_pending;
+    KeyframeIndex   keyframes;
+
+    /**
+     * Sidecar seek index, used if use_seek_index is set (--seek-index).
+     */
+    int             use_seek_index;
+    SeekIndex       seek_index;
+
+    /**
+     * Startup. fast_start (--fast-start) limits the demuxer probing, input_io
+     * selects the input backend (--io, --io-buffer in bytes, --prefetch in
+     * bytes). The startup timing is in av_gettime_relative() microseconds: the program
+     * start, then the time each startup step completed, 0 if not reached.
+     */
+    int             fast_start;
+    int             input_io;
+    int             input_io_buffer_size;
+    int             input_prefetch_size;
+    InputReader     input;
+    int64_t         startup_time;
+    int64_t         open_done_time;
+    int64_t         probe_done_time;
+    int64_t         codec_open_done_time;
+    int64_t         first_packet_time;
+    int64_t         first_display_time;
+
+    /**
+     * Demuxer backpressure: the demux thread parks while the packet queues are
+     * full, or while demux_pending_queue, the queue of the AVPacket it last
+     * read (demux_pkt), has no free slot; read_waiting is set while it does
+     * so. It sleeps on continue_read_cond until demux_wake() sets
+     * demux_wakeup, or for a while after a transient read error.
+     * demux_opened is set once the input and the streams are opened.
+     */
+    SDL_mutex *     continue_read_mutex;
+    SDL_cond *      continue_read_cond;
+    int             demux_wakeup;
+    SDL_atomic_t    read_waiting;
+    AVPacket *      demux_pkt;
+    PacketQueue *   demux_pending_queue;
+    int             demux_opened;
+
+    /**
+     * Tasks run by the shared scheduler, at the player priority (--priority):
+     * video decoding and scaling, audio decoding. The demuxing blocks on the
+     * input, it runs on the demux thread of the player instead of holding a
+     * worker. The render thread owns the SDL_Renderer, the presentation thread
+     * schedules the display. scheduler holds the scheduler reference taken in
+     * player_open().
+     */
+    SDL_Thread *    demux_tid;
+    SchedulerTask   video_task;
+    SchedulerTask   audio_task;
+    SDL_Thread *    render_tid;
+
+    /**
+     * RENDER_ON_MAIN_THREAD: set once the video stream is opened, the main
+     * thread renders from then on, and set while a PLAYER_EVENT_RENDER of this
+     * player is pending. render_opened is only accessed by the main thread.
+     */
+    SDL_atomic_t    render_started;
+    SDL_atomic_t    render_event_pending;
+    int             render_opened;
+    SDL_Thread *    presentation_tid;
+    int             priority;
+    int             scheduler;
+
+    /**
+     * Input file name.
+     */
+    char filename[1024];
+
+    /**
+     * Global quit flag.
+     */
+    int quit;
+
+    /**
+     * Maximum number of frames to be decoded.
+     */
+    long    maxFramesToDecode;
+    int     currentFrameIndex;
+} VideoState;
+
+/**
+ * Audio Video Sync Types.
+ */
+enum
+{
+    /**
+     * Sync to audio clock.
+     */
+            AV_SYNC_AUDIO_MASTER = PLAYER_SYNC_AUDIO,
+
+    /**
+     * Sync to video clock.
+     */
+            AV_SYNC_VIDEO_MASTER = PLAYER_SYNC_VIDEO,
+
+    /**
+     * Sync to external clock: the computer clock
+     */
+            AV_SYNC_EXTERNAL_MASTER = PLAYER_SYNC_EXTERNAL,
+};
+
+/**
+ * Methods declaration.
+ */
+static int demux_thread(void * arg);
+
+static int demux_step(void * arg);
+
+static int demux_open(VideoState * videoState);
+
+static void demux_close(VideoState * videoState);
+
+static int demux_done(VideoState * videoState);
+
+static int decode_interrupt_cb(void * opaque);
+
+static int player_event_filter(void * userdata, SDL_Event * event);
+
+static int stream_component_open(
+        VideoState * videoState,
+        int stream_index
+);
+
+static int hw_decoder_init(
+        VideoState * videoState,
+        AVCodec * codec,
+        AVCodecContext * codecCtx
+);
+
+static enum AVPixelFormat get_hw_format(
+        AVCodecContext * codecCtx,
+        const enum AVPixelFormat * pix_fmts
+);
+
+static int hw_download_get_buffer(
+        VideoState * videoState,
+        AVFrame * frame,
+        const AVFrame * hwFrame
+);
+
+static Uint32 get_texture_format(
+        enum AVPixelFormat pix_fmt
+);
+
+static int is_direct_format(
+        VideoState * videoState,
+        enum AVPixelFormat pix_fmt
+);
+
+static int alloc_picture(
+        VideoState * videoState,
+        VideoPicture * videoPicture
+);
+
+static int queue_picture(
+        VideoState * videoState,
+        AVFrame * pFrame,
+        double pts
+);
+
+static int video_decode_step(void * arg);
+
+static int64_t guess_correct_pts(
+        AVCodecContext * ctx,
+        int64_t reordered_pts,
+        int64_t dts
+);
+
+static double synchronize_video(
+        VideoState * videoState,
+        AVFrame * src_frame,
+        double pts
+);
+
+static int video_frame_is_late(
+        VideoState * videoState,
+        double pts
+);
+
+static void update_decoder_skip_level(
+        VideoState * videoState,
+        double lag
+);
+
+static int synchronize_audio(
+        VideoState * videoState,
+        int nb_samples
+);
+
+static int presentation_thread(void * arg);
+
+static double get_monotonic_time(VideoState * videoState);
+
+static int64_t wall_clock(VideoState * videoState);
+
+static int64_t replay_clock(VideoState * videoState);
+
+static VideoPicture * presentation_schedule(VideoState * videoState);
+
+static int replay_run(VideoState * videoState);
+
+static void replay_run_tasks(VideoState * videoState);
+
+static int replay_audio_over(VideoState * videoState);
+
+static void replay_advance(VideoState * videoState, double deadline);
+
+static void replay_trace(VideoState * videoState, double pts, int status);
+
+static void sleep_until(
+        VideoState * videoState,
+        double deadline
+);
+
+static double video_refresh_timer(VideoState * videoState);
+
+static double get_audio_clock(VideoState * videoState);
+
+static double get_video_clock(VideoState * videoState);
+
+static double get_external_clock(VideoState * videoState);
+
+static double get_master_clock(VideoState * videoState);
+
+static int render_thread(void * arg);
+
+static int window_open(VideoState * videoState);
+
+static int render_open(VideoState * videoState);
+
+static int render_pending(VideoState * videoState);
+
+static void render_step(VideoState * videoState);
+
+static void render_close(VideoState * videoState);
+
+static void render_wake(VideoState * videoState);
+
+static int video_upload(
+        VideoState * videoState,
+        VideoPicture * videoPicture,
+        int texture_index
+);
+
+static void video_display(VideoState * videoState);
+
+static void packet_queue_init(PacketQueue * q, struct VideoState * videoState, SchedulerTask * consumer, MemoryArena * arena);
+
+static int packet_queue_max_size(VideoState * videoState, AVStream * stream, int min_size, MemoryArena * arena);
+
+static void packet_queue_destroy(PacketQueue * q);
+
+static int packet_queue_put(
+        PacketQueue * queue,
+        AVPacket * packet
+);
+
+static int packet_queue_get(
+        PacketQueue * queue,
+        AVPacket * packet,
+        int blocking,
+        int * serial
+);
+
+static void packet_queue_flush(PacketQueue * queue);
+
+static inline int packet_queue_distance(int windex, int rindex);
+
+static int packet_queue_is_full(PacketQueue * queue);
+
+static int packet_queue_is_low(PacketQueue * queue);
+
+static int packet_queue_has_room(PacketQueue * queue);
+
+static int packet_queues_full(VideoState * videoState);
+
+static int packet_queues_low(VideoState * videoState);
+
+static void demux_wake(VideoState * videoState);
+
+static int demux_seek(VideoState * videoState);
+
+static int keyframe_index_add(KeyframeIndex * index, int64_t pts, int64_t pos);
+
+static int keyframe_index_search(KeyframeIndex * index, int64_t pts);
+
+static void keyframe_index_free(KeyframeIndex * index);
+
+static int seek_index_open(VideoState * videoState, AVFormatContext * pFormatCtx);
+
+static void seek_index_load_keyframes(VideoState * videoState);
+
+static int seek_index_write(VideoState * videoState);
+
+static void seek_index_save(VideoState * videoState);
+
+static void seek_index_close(SeekIndex * seekIndex);
+
+static int input_reader_open(VideoState * videoState, AVFormatContext * pFormatCtx);
+
+static void input_reader_close(InputReader * reader);
+
+static int input_read_packet(void * opaque, uint8_t * buf, int buf_size);
+
+static int64_t input_seek(void * opaque, int64_t offset, int whence);
+
+static int prefetch_thread(void * arg);
+
+static int is_network_input(const char * filename);
+
+static int jitter_buffer_ready(VideoState * videoState);
+
+static int live_speed_correction(VideoState * videoState, int nb_samples);
+
+static void stats_record(StatsHistogram * histogram, int64_t start);
+
+static void stats_record_value(StatsHistogram * histogram, int64_t value);
+
+static void stats_histogram_summarize(StatsHistogram * histogram, PlayerStageStats * stage);
+
+static void memory_arenas_init(VideoState * videoState);
+
+static void memory_arena_charge(MemoryArena * arena, int size);
+
+static void memory_arena_release(MemoryArena * arena, int size);
+
+static void stats_update(VideoState * videoState);
+
+static void stats_write_header(VideoState * videoState);
+
+static void stats_write(VideoState * videoState, PlayerIntervalStats * summary);
+
+static void stats_overlay_draw(VideoState * videoState);
+
+static void stats_overlay_text(VideoState * videoState, int x, int y, const char * text);
+
+static void stats_overlay_fill(VideoState * videoState, const SDL_Rect * rects, int count, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+
+static int stats_font_glyph(char c);
+
+static void audio_callback(
+        void * userdata,
+        Uint8 * stream,
+        int len
+);
+
+static int audio_decode_step(void * arg);
+
+static int audio_decode_frame(
+        VideoState * videoState,
+        uint8_t ** audio_buf,
+        double * pts_ptr
+);
+
+static int audio_resampling(
+        VideoState * videoState,
+        AVFrame * decoded_audio_frame,
+        enum AVSampleFormat out_sample_fmt,
+        uint8_t * out_buf
+);
+
+static int audio_resampling_init(
+        AudioResamplingState * arState,
+        int64_t in_channel_layout,
+        enum AVSampleFormat in_sample_fmt,
+        int in_sample_rate
+);
+
+static AudioResamplingState * getAudioResampling(
+        AVCodecContext * audio_ctx,
+        enum AVSampleFormat out_sample_fmt
+);
+
+static uint64_t audio_output_layout(int channels);
+
+static int audio_output_channels(VideoState * videoState);
+
+static void freeAudioResampling(AudioResamplingState ** arState);
+
+static void stream_seek(VideoState * videoState, int64_t pos, int64_t rel);
+
+/**
+ * Sets the given PlayerOptions to their default values.
+ *
+ * @param   options the PlayerOptions to be initialized.
+ */
+void player_options_default(PlayerOptions * options)
+{
+    memset(options, 0, sizeof(PlayerOptions));
+
+    options->max_frames = 0;
+    options->pictq_size = VIDEO_PICTURE_QUEUE_SIZE;
+    options->video_decoder_threads = VIDEO_DECODER_THREADS;
+    options->video_decoder_thread_type = VIDEO_DECODER_THREAD_TYPE;
+    options->hw_device_type = DEFAULT_HW_DEVICE_TYPE;
+    options->audio_buffer_samples = SDL_AUDIO_BUFFER_SIZE;
+    options->input_io = INPUT_IO_DEFAULT;
+    options->input_io_buffer_size = INPUT_IO_BUFFER_SIZE * 1024;
+    options->input_prefetch_size = INPUT_PREFETCH_SIZE * 1024 * 1024;
+    options->jitter_buffer = -1;
+    options->stats_file = NULL;
+    options->priority = PLAYER_PRIORITY_NORMAL;
+    options->workers = 0;
+    options->decoder_thread_budget = 0;
+    options->scale_slices = SCALE_SLICES;
+    options->renderer = PLAYER_RENDERER_SDL;
+    options->memory_budget = MEMORY_BUDGET * 1024 * 1024;
+    options->av_sync_type = DEFAULT_AV_SYNC_TYPE;
+}
+
+/**
+ * Parses the given command line option (e.g. --threads=4) into the given
+ * PlayerOptions. An error message is printed if the option is unknown or its
+ * value invalid.
+ *
+ * @param   options the PlayerOptions to be updated.
+ * @param   arg     the command line option.
+ *
+ * @return          < 0 if the option is unknown or invalid, 0 otherwise.
+ */
+int player_parse_option(PlayerOptions * options, const char * arg)
+{
+    const char * value = NULL;
+    char * pEnd;
+
+    if (av_strstart(arg, "--max-frames=", &value))
+    {
+        options->max_frames = strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || options->max_frames < 0)
+        {
+            printf("Invalid number of frames: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--pictq=", &value))
+    {
+        options->pictq_size = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || options->pictq_size < 1 || options->pictq_size > VIDEO_PICTURE_QUEUE_MAX_SIZE)
+        {
+            printf("Invalid picture queue size: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--threads=", &value))
+    {
+        // 0 (auto) means a share of the decoder threads budget
+        if (strcmp(value, "auto") == 0)
+        {
+            options->video_decoder_threads = 0;
+        }
+        else
+        {
+            options->video_decoder_threads = (int)strtol(value, &pEnd, 10);
+
+            if (*pEnd != '\0' || options->video_decoder_threads < 1 || options->video_decoder_threads > VIDEO_DECODER_MAX_THREADS)
+            {
+                printf("Invalid number of decoder threads: %s.\n", value);
+                return -1;
+            }
+        }
+    }
+    else if (av_strstart(arg, "--thread-type=", &value))
+    {
+        if (strcmp(value, "frame") == 0)
+        {
+            options->video_decoder_thread_type = FF_THREAD_FRAME;
+        }
+        else if (strcmp(value, "slice") == 0)
+        {
+            options->video_decoder_thread_type = FF_THREAD_SLICE;
+        }
+        else if (strcmp(value, "auto") == 0)
+        {
+            options->video_decoder_thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        }
+        else
+        {
+            printf("Invalid decoder thread type: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--hwaccel=", &value))
+    {
+        if (strcmp(value, "auto") == 0)
+        {
+            options->hw_device_type = HW_DEVICE_TYPE_AUTO;
+        }
+        else if (strcmp(value, "none") == 0)
+        {
+            options->hw_device_type = AV_HWDEVICE_TYPE_NONE;
+        }
+        else
+        {
+            options->hw_device_type = av_hwdevice_find_type_by_name(value);
+
+            if (options->hw_device_type == AV_HWDEVICE_TYPE_NONE)
+            {
+                printf("Unknown hardware device type: %s.\n", value);
+                return -1;
+            }
+        }
+    }
+    else if (av_strstart(arg, "--audio-buffer=", &value))
+    {
+        if (strcmp(value, "low") == 0)
+        {
+            options->audio_buffer_samples = AUDIO_BUFFER_LOW_LATENCY;
+        }
+        else if (strcmp(value, "high") == 0)
+        {
+            options->audio_buffer_samples = AUDIO_BUFFER_HIGH_LATENCY;
+        }
+        else if (strcmp(value, "auto") == 0)
+        {
+            options->audio_buffer_samples = AUDIO_BUFFER_AUTO;
+        }
+        else
+        {
+            options->audio_buffer_samples = (int)strtol(value, &pEnd, 10);
+
+            // SDL requires a power of 2 number of samples
+            if (*pEnd != '\0' || options->audio_buffer_samples < 16 || options->audio_buffer_samples > 65536 ||
+                (options->audio_buffer_samples & (options->audio_buffer_samples - 1)))
+            {
+                printf("Invalid audio buffer size: %s.\n", value);
+                return -1;
+            }
+        }
+    }
+    else if (strcmp(arg, "--accurate-seek") == 0)
+    {
+        options->accurate_seek = 1;
+    }
+    else if (strcmp(arg, "--seek-index") == 0)
+    {
+        options->seek_index = 1;
+    }
+    else if (strcmp(arg, "--fast-start") == 0)
+    {
+        options->fast_start = 1;
+    }
+    else if (strcmp(arg, "--live") == 0)
+    {
+        options->live = 1;
+    }
+    else if (av_strstart(arg, "--buffer=", &value))
+    {
+        options->jitter_buffer = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || options->jitter_buffer < 0 || options->jitter_buffer > (int)(JITTER_BUFFER_MAX * 1000))
+        {
+            printf("Invalid jitter buffer depth: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--stats=", &value))
+    {
+        options->stats_file = value;
+    }
+    else if (av_strstart(arg, "--priority=", &value))
+    {
+        if (strcmp(value, "low") == 0)
+        {
+            options->priority = PLAYER_PRIORITY_LOW;
+        }
+        else if (strcmp(value, "normal") == 0)
+        {
+            options->priority = PLAYER_PRIORITY_NORMAL;
+        }
+        else if (strcmp(value, "high") == 0)
+        {
+            options->priority = PLAYER_PRIORITY_HIGH;
+        }
+        else
+        {
+            printf("Invalid priority: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--workers=", &value))
+    {
+        options->workers = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || options->workers < 1 || options->workers > SCHEDULER_MAX_WORKERS)
+        {
+            printf("Invalid number of workers: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--thread-budget=", &value))
+    {
+        options->decoder_thread_budget = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || options->decoder_thread_budget < 1 || options->decoder_thread_budget > VIDEO_DECODER_MAX_THREADS * SCHEDULER_MAX_WORKERS)
+        {
+            printf("Invalid decoder threads budget: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--scale-slices=", &value))
+    {
+        if (strcmp(value, "auto") == 0)
+        {
+            options->scale_slices = 0;
+        }
+        else
+        {
+            options->scale_slices = (int)strtol(value, &pEnd, 10);
+
+            if (*pEnd != '\0' || options->scale_slices < 1 || options->scale_slices > SCALE_MAX_SLICES)
+            {
+                printf("Invalid number of scale slices: %s.\n", value);
+                return -1;
+            }
+        }
+    }
+    else if (av_strstart(arg, "--renderer=", &value))
+    {
+        if (strcmp(value, "sdl") == 0)
+        {
+            options->renderer = PLAYER_RENDERER_SDL;
+        }
+        else if (strcmp(value, "gl") == 0)
+        {
+            options->renderer = PLAYER_RENDERER_GL;
+        }
+        else
+        {
+            printf("Invalid renderer: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--io=", &value))
+    {
+        if (strcmp(value, "default") == 0)
+        {
+            options->input_io = INPUT_IO_DEFAULT;
+        }
+        else if (strcmp(value, "prefetch") == 0)
+        {
+            options->input_io = INPUT_IO_PREFETCH;
+        }
+        else if (strcmp(value, "mmap") == 0)
+        {
+            options->input_io = INPUT_IO_MMAP;
+        }
+        else
+        {
+            printf("Invalid input backend: %s.\n", value);
+            return -1;
+        }
+    }
+    else if (av_strstart(arg, "--io-buffer=", &value))
+    {
+        int size = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || size < 1 || size > INPUT_IO_BUFFER_MAX_SIZE)
+        {
+            printf("Invalid input buffer size: %s.\n", value);
+            return -1;
+        }
+
+        options->input_io_buffer_size = size * 1024;
+    }
+    else if (av_strstart(arg, "--prefetch=", &value))
+    {
+        int size = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || size < 1 || size > INPUT_PREFETCH_MAX_SIZE)
+        {
+            printf("Invalid prefetch size: %s.\n", value);
+            return -1;
+        }
+
+        options->input_prefetch_size = size * 1024 * 1024;
+    }
+    else if (av_strstart(arg, "--memory=", &value))
+    {
+        int size = (int)strtol(value, &pEnd, 10);
+
+        if (*pEnd != '\0' || size < MEMORY_BUDGET_MIN || size > MEMORY_BUDGET_MAX)
+        {
+            printf("Invalid memory budget: %s.\n", value);
+            return -1;
+        }
+
+        options->memory_budget = size * 1024 * 1024;
+    }
+    else if (av_strstart(arg, "--sync=", &value))
+    {
+        if (strcmp(value, "audio") == 0)
+        {
+            options->av_sync_type = AV_SYNC_AUDIO_MASTER;
+        }
+        else if (strcmp(value, "video") == 0)
+        {
+            options->av_sync_type = AV_SYNC_VIDEO_MASTER;
+        }
+        else if (strcmp(value, "external") == 0)
+        {
+            options->av_sync_type = AV_SYNC_EXTERNAL_MASTER;
+        }
+        else
+        {
+            printf("Invalid sync type: %s.\n", value);
+            return -1;
+        }
+    }
+    else
+    {
+        printf("Unknown option: %s.\n", arg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Prints the usage of the options parsed by player_parse_option().
+ */
+void player_print_options()
+{
+    printf("Options:\n");
+    printf("    --max-frames=N  number of frames to be displayed (default 0, the whole input).\n");
+    printf("    --pictq=N       decoded pictures queue size (1-%d, default %d).\n", VIDEO_PICTURE_QUEUE_MAX_SIZE, VIDEO_PICTURE_QUEUE_SIZE);
+    printf("    --threads=N     video decoder threads (1-%d or auto, default auto: a share of the budget).\n", VIDEO_DECODER_MAX_THREADS);
+    printf("    --thread-type=T video decoder threading: frame, slice or auto (default auto).\n");
+    printf("    --hwaccel=D     hardware decoding device: auto, none, vaapi, cuda, videotoolbox, ...\n");
+    printf("                    (default none). Falls back to software decoding if unsupported.\n");
+    printf("    --audio-buffer=B audio device buffer: low (%d samples), high (%d samples),\n", AUDIO_BUFFER_LOW_LATENCY, AUDIO_BUFFER_HIGH_LATENCY);
+    printf("                    auto (from the sample rate) or N samples, a power of 2 (default %d).\n", SDL_AUDIO_BUFFER_SIZE);
+    printf("    --accurate-seek decode up to the exact seek target instead of the previous keyframe.\n");
+    printf("    --seek-index    read (or write on first playback) the <filename>%s sidecar index:\n", SEEK_INDEX_SUFFIX);
+    printf("                    probed codec parameters and keyframes, skips the stream probe.\n");
+    printf("    --fast-start    minimal stream probe for known-good inputs (%d bytes, %d ms).\n", FAST_START_PROBESIZE, FAST_START_ANALYZE_DURATION / 1000);
+    printf("    --io=I          input backend: default, prefetch (read-ahead thread) or mmap (local files).\n");
+    printf("    --io-buffer=KB  input buffer size of the prefetch and mmap backends (default %d).\n", INPUT_IO_BUFFER_SIZE);
+    printf("    --prefetch=MB   read-ahead of the prefetch backend (1-%d, default %d).\n", INPUT_PREFETCH_MAX_SIZE, INPUT_PREFETCH_SIZE);
+    printf("    --sync=S        master clock: audio, video or external (default audio).\n");
+    printf("    --memory=MB     memory budget of the player (%d-%d, default %d), split between the packet queues,\n", MEMORY_BUDGET_MIN, MEMORY_BUDGET_MAX, MEMORY_BUDGET);
+    printf("                    the pictures queue, the audio buffers and the input buffers: it caps the\n");
+    printf("                    packet queues sized from the bitrate, the --pictq size and the --prefetch size.\n");
+    printf("    --buffer=MS     jitter buffer depth (0-%d, default %d for network inputs, 0 otherwise).\n", (int)(JITTER_BUFFER_MAX * 1000), (int)(NETWORK_JITTER_BUFFER * 1000));
+    printf("    --live          low latency live mode: track the live edge adjusting the audio speed.\n");
+    printf("    --stats=FILE    write the pipeline stats every %d ms: JSON lines for a .json FILE, CSV otherwise.\n", STATS_INTERVAL);
+    printf("    --priority=P    scheduling priority of the player tasks: low, normal or high (default normal),\n");
+    printf("                    also weighting its share of the decoder threads budget.\n");
+    printf("    --workers=N     worker threads shared by all of the players (1-%d, default one per core).\n", SCHEDULER_MAX_WORKERS);
+    printf("    --thread-budget=N video decoder threads shared by the --threads=auto players (default one per core).\n");
+    printf("                    The --workers and --thread-budget of the first player opened apply.\n");
+    printf("    --renderer=R    video renderer: sdl (SDL_Renderer, YUV420P and NV12 frames uploaded as they are)\n");
+    printf("                    or gl (OpenGL shader: 8-16 bits planar, NV12 and P010 uploaded as they are,\n");
+    printf("                    YUV to RGB, HDR tonemapping and scaling on the GPU) (default sdl).\n");
+    printf("    --scale-slices=N bands of the sws_scale() conversion, converted in parallel on the workers\n");
+    printf("                    (1-%d or auto, default auto: one per %d rows, at most one per worker).\n", SCALE_MAX_SLICES, SCALE_SLICE_MIN_HEIGHT);
+}
+
+/**
+ * Creates a Player for the given media file or url. Nothing is read until
+ * player_play() is called.
+ *
+ * @param   url     media file name or url.
+ * @param   options the playback options, copied.
+ *
+ * @return          the new Player, NULL in case of error.
+ */
+Player * player_open(const char * url, const PlayerOptions * options)
+{
+    // startup timing reference
+    int64_t startup_time = av_gettime_relative();
+
+    // the subsystems are reference counted, each player holds a reference
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0)
+    {
+        printf("Could not initialize SDL - %s\n.", SDL_GetError());
+        return NULL;
+    }
+
+    // needed by the http, hls, rtsp and srt inputs
+    avformat_network_init();
+
+    // allocate memory for the VideoState and zero it out
+    VideoState * videoState = av_mallocz(sizeof(VideoState));
+    if (!videoState)
+    {
+        printf("Could not allocate the player.\n");
+        avformat_network_deinit();
+        SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER);
+        return NULL;
+    }
+
+    // copy the file name input by the user to the VideoState structure
+    av_strlcpy(videoState->filename, url, sizeof(videoState->filename));
+
+    videoState->startup_time = startup_time;
+
+    // copy the options
+    videoState->maxFramesToDecode = options->max_frames;
+    videoState->pictq_capacity = options->pictq_size;
+    videoState->audio_buffer_samples = options->audio_buffer_samples;
+    videoState->video_decoder_threads = options->video_decoder_threads;
+    videoState->video_decoder_thread_type = options->video_decoder_thread_type;
+    videoState->hw_device_type = options->hw_device_type;
+    videoState->hw_pix_fmt = AV_PIX_FMT_NONE;
+    videoState->accurate_seek = options->accurate_seek;
+    videoState->use_seek_index = options->seek_index;
+    videoState->fast_start = options->fast_start;
+    videoState->input_io = options->input_io;
+    videoState->input_io_buffer_size = options->input_io_buffer_size;
+    videoState->input_prefetch_size = options->input_prefetch_size;
+    videoState->network_input = is_network_input(videoState->filename);
+    videoState->live = options->live;
+    videoState->av_sync_type = options->av_sync_type;
+    videoState->clock = wall_clock;
+    videoState->priority = av_clip(options->priority, PLAYER_PRIORITY_LOW, PLAYER_PRIORITY_HIGH);
+    videoState->renderer_type = options->renderer;
+    videoState->memory_budget = options->memory_budget;
+
+    // split the memory budget between the arenas
+    memory_arenas_init(videoState);
+
+    if (options->jitter_buffer >= 0)
+    {
+        videoState->jitter_buffer = options->jitter_buffer / 1000.0;
+    }
+    else
+    {
+        videoState->jitter_buffer = videoState->network_input ? NETWORK_JITTER_BUFFER : 0;
+    }
+
+    // the live mode tracks the jitter buffer depth
+    if (videoState->live && videoState->jitter_buffer <= 0)
+    {
+        videoState->jitter_buffer = NETWORK_JITTER_BUFFER;
+    }
+
+    if (videoState->pictq_capacity < 1 || videoState->pictq_capacity > VIDEO_PICTURE_QUEUE_MAX_SIZE)
+    {
+        printf("Invalid picture queue size: %d.\n", videoState->pictq_capacity);
+        goto fail;
+    }
+
+    // the custom input backends only read local files
+    if (videoState->network_input && videoState->input_io != INPUT_IO_DEFAULT)
+    {
+        printf("The --io backends only support local files.\n");
+        goto fail;
+    }
+
+    // allocate the VideoPicture queue, its frames are allocated once the video
+    // resolution is known in stream_component_open()
+    videoState->pictq = av_mallocz_array(videoState->pictq_capacity, sizeof(VideoPicture));
+    if (!videoState->pictq)
+    {
+        printf("Could not allocate the picture queue.\n");
+        goto fail;
+    }
+
+    // the demuxing and decoding run on the workers shared by all of the players
+    if (scheduler_acquire(options->workers, options->decoder_thread_budget, videoState->priority) < 0)
+    {
+        printf("Could not start the scheduler.\n");
+        goto fail;
+    }
+    videoState->scheduler = 1;
+
+    // the sws_scale() conversion bands run on the same workers
+    if (slice_scaler_init(&videoState->scaler, options->scale_slices, SWS_BILINEAR, videoState->priority) < 0)
+    {
+        goto fail;
+    }
+
+    // initialize the lock and condition used by the demux thread to wait for
+    // room in the packet queues or after a transient read error
+    videoState->continue_read_mutex = SDL_CreateMutex();
+    videoState->continue_read_cond = SDL_CreateCond();
+
+    // initialize locks for the display buffer (pictq)
+    videoState->pictq_mutex = SDL_CreateMutex();
+    videoState->render_cond = SDL_CreateCond();
+
+    if (!videoState->continue_read_mutex || !videoState->continue_read_cond ||
+        !videoState->pictq_mutex || !videoState->render_cond)
+    {
+        printf("Could not create the player locks: %s.\n", SDL_GetError());
+        goto fail;
+    }
+
+    if (options->stats_file)
+    {
+        videoState->stats_file = fopen(options->stats_file, "w");
+        if (!videoState->stats_file)
+        {
+            printf("Could not open the stats file %s.\n", options->stats_file);
+            goto fail;
+        }
+
+        // JSON lines for a .json file, CSV otherwise
+        const char * ext = strrchr(options->stats_file, '.');
+        videoState->stats_json = ext && strcmp(ext, ".json") == 0;
+
+        stats_write_header(videoState);
+    }
+
+    return videoState;
+
+    fail:
+    {
+        player_close(videoState);
+        return NULL;
+    };
+}
+
+/**
+ * Starts the playback: the input is opened and demuxed, and its window and
+ * audio device are opened, by the player tasks.
+ *
+ * @param   videoState  the Player.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+int player_play(Player * videoState)
+{
+    // already playing
+    if (videoState->demux_tid)
+    {
+        return 0;
+    }
+
+    // the first pipeline stats summary, then one every STATS_INTERVAL ms
+    videoState->stats_next_time = av_gettime_relative() + STATS_INTERVAL * 1000;
+
+    // start the demux thread to read data from the AVFormatContext, it starts
+    // the decoding tasks once the streams are opened
+    videoState->demux_tid = SDL_CreateThread(demux_thread, "Demux Thread", videoState);
+    if (!videoState->demux_tid)
+    {
+        printf("Could not start demux SDL_Thread: %s.\n", SDL_GetError());
+        return -1;
+    }
+
+    // start the presentation thread, it schedules the display of the decoded frames
+    videoState->presentation_tid = SDL_CreateThread(presentation_thread, "Presentation Thread", videoState);
+    if (!videoState->presentation_tid)
+    {
+        printf("Could not start presentation SDL_Thread: %s.\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Replays the input on the calling thread instead of starting the playback,
+ * as fast as it can be decoded: the player clock is a virtual one, only moved
+ * forward when the presentation waits for a frame display time, and the audio
+ * device is simulated, its buffers pulled at their virtual times. Video is
+ * decoded in software by a single thread, so the same input gives the same
+ * trace on any machine. Returns at the end of the input.
+ *
+ * @param   videoState          the Player, not playing.
+ * @param   video_decode_time   virtual time taken to decode each video frame,
+ *                              in seconds, 0 for instant decoding.
+ * @param   callback            called for each frame shown, dropped or skipped,
+ *                              may be NULL.
+ * @param   opaque              the callback argument.
+ *
+ * @return                      < 0 in case of error, 0 otherwise.
+ */
+int player_replay(Player * videoState, double video_decode_time, PlayerTraceCallback callback, void * opaque)
+{
+    // already playing or replayed
+    if (videoState->demux_tid || videoState->replay)
+    {
+        return -1;
+    }
+
+    videoState->replay_video_decode_time = llrint(FFMAX(video_decode_time, 0) * 1000000.0);
+    videoState->replay_callback = callback;
+    videoState->replay_opaque = opaque;
+    videoState->video_decoder_threads = 1;
+    videoState->hw_device_type = AV_HWDEVICE_TYPE_NONE;
+
+    return replay_run(videoState);
+}
+
+/**
+ * Runs the input through the playback pipeline on the calling thread, as fast
+ * as it can be decoded: player_replay() with instant virtual decoding, but with
+ * the video decoder threads and hardware device of the options. The pipeline
+ * stats of the last interval then cover the whole run.
+ *
+ * @param   videoState  the Player, not playing.
+ * @param   convert     != 0 to convert every decoded frame with the sliced
+ *                      sws_scale(), as done when it cannot be uploaded directly.
+ * @param   callback    called for each frame shown, dropped or skipped, may be
+ *                      NULL.
+ * @param   opaque      the callback argument.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+int player_bench(Player * videoState, int convert, PlayerTraceCallback callback, void * opaque)
+{
+    // already playing or replayed
+    if (videoState->demux_tid || videoState->replay)
+    {
+        return -1;
+    }
+
+    videoState->replay_video_decode_time = 0;
+    videoState->replay_callback = callback;
+    videoState->replay_opaque = opaque;
+    videoState->convert_all = convert;
+
+    return replay_run(videoState);
+}
+
+/**
+ * Runs the replay of the given VideoState, set up by player_replay() or
+ * player_bench(), until the end of the input. The pipeline stats gathered
+ * meanwhile are summarized once at the end, as a single interval: no
+ * presentation thread summarizes them periodically during a replay.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int replay_run(VideoState * videoState)
+{
+    videoState->replay = 1;
+    videoState->clock = replay_clock;
+    videoState->replay_time = 0;
+
+    // open the input and the streams, and fill the queues
+    replay_run_tasks(videoState);
+
+    if (!videoState->demux_opened)
+    {
+        return -1;
+    }
+
+    // the simulated audio device starts with the playback, if any
+    if (videoState->audio_st)
+    {
+        videoState->replay_audio_buf = av_malloc(videoState->audio_hw_buf_size);
+        if (!videoState->replay_audio_buf)
+        {
+            printf("Could not allocate the replay audio buffer.\n");
+            return -1;
+        }
+    }
+
+    videoState->replay_audio_start = videoState->replay_time;
+
+    while (!videoState->quit)
+    {
+        replay_run_tasks(videoState);
+
+        if (videoState->pictq_size > 0)
+        {
+            // the presentation thread scheduling, without the render thread
+            VideoPicture * videoPicture = presentation_schedule(videoState);
+            int dropped = videoPicture->dropped;
+
+            replay_trace(videoState, videoPicture->pts, dropped ? PLAYER_TRACE_DROPPED : PLAYER_TRACE_SHOWN);
+
+            // release the VideoPicture as if presented
+            SDL_LockMutex(videoState->pictq_mutex);
+            videoState->pictq_size--;
+            SDL_UnlockMutex(videoState->pictq_mutex);
+
+            if (++videoState->pictq_render_index == videoState->pictq_capacity)
+            {
+                videoState->pictq_render_index = 0;
+            }
+
+            // check the number of frames to display was not exceeded
+            if (!dropped && videoState->maxFramesToDecode > 0 && ++videoState->currentFrameIndex >= videoState->maxFramesToDecode)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        // the simulated video decoder is still busy with the next frames
+        if (!videoState->replay_video_done && videoState->replay_time < videoState->replay_video_ready)
+        {
+            replay_advance(videoState, videoState->replay_video_ready / 1000000.0);
+            continue;
+        }
+
+        // no video: the simulated audio device pulls the next buffer, until the
+        // audio packets are decoded and the AudioRing is played out
+        if (!videoState->video_st && !replay_audio_over(videoState))
+        {
+            replay_advance(videoState, (videoState->replay_time + av_rescale(
+                    videoState->audio_buffer_samples,
+                    1000000,
+                    videoState->audio_ctx->sample_rate
+            )) / 1000000.0);
+            continue;
+        }
+
+        // none of the tasks has work left: the input is over
+        break;
+    }
+
+    stats_update(videoState);
+
+    return 0;
+}
+
+/**
+ * Seeks by the given offset from the current playback position. Ignored until
+ * the streams are opened.
+ *
+ * @param   videoState  the Player.
+ * @param   offset      the seek offset, in seconds, negative to seek backward.
+ */
+void player_seek(Player * videoState, double offset)
+{
+    if (!videoState->audio_st && !videoState->video_st)
+    {
+        return;
+    }
+
+    double pos = get_master_clock(videoState) + offset;
+
+    stream_seek(videoState, (int64_t)(pos * AV_TIME_BASE), (int64_t)(offset * AV_TIME_BASE));
+}
+
+/**
+ * Fills the given PlayerStats with the current stats of the given Player.
+ *
+ * @param   videoState  the Player.
+ * @param   stats       the PlayerStats to be filled.
+ */
+void player_get_stats(Player * videoState, PlayerStats * stats)
+{
+    memset(stats, 0, sizeof(PlayerStats));
+
+    if (videoState->audio_st || videoState->video_st)
+    {
+        stats->position = get_master_clock(videoState);
+    }
+
+    SDL_AtomicLock(&videoState->stats_lock);
+    stats->interval = videoState->stats_summary;
+    SDL_AtomicUnlock(&videoState->stats_lock);
+
+    stats->frames_dropped = SDL_AtomicGet(&videoState->frames_dropped);
+    stats->frames_skipped = SDL_AtomicGet(&videoState->frames_skipped);
+    stats->decoder_skip_level = SDL_AtomicGet(&videoState->decoder_skip_level);
+
+    stats->rebuffer_count = videoState->rebuffer_count;
+    stats->rebuffer_time = videoState->rebuffer_time / 1000.0;
+
+    // each startup step since player_open()
+    int64_t startup_times[] = {
+            videoState->open_done_time,
+            videoState->probe_done_time,
+            videoState->codec_open_done_time,
+            videoState->first_packet_time,
+            videoState->first_display_time
+    };
+    double * startup_stats[] = {
+            &stats->open_time,
+            &stats->probe_time,
+            &stats->codec_open_time,
+            &stats->first_packet_time,
+            &stats->first_display_time
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(startup_times); i++)
+    {
+        *startup_stats[i] = startup_times[i] ? (startup_times[i] - videoState->startup_time) / 1000.0 : -1;
+    }
+
+    if (videoState->input_io != INPUT_IO_DEFAULT)
+    {
+        stats->input_bytes = videoState->input.bytes_fetched;
+        stats->input_time = videoState->input.fetch_time / 1000.0;
+        stats->input_stall_time = videoState->input.stall_time / 1000.0;
+    }
+
+    stats->scale_slices = videoState->scaler.job_slices;
+    stats->scale_workers = scheduler_workers();
+
+    stats->memory_budget = videoState->memory_budget;
+
+    for (int i = 0; i < PLAYER_MEMORY_NB; i++)
+    {
+        stats->memory[i].current = SDL_AtomicGet(&videoState->memory[i].current);
+        stats->memory[i].peak = SDL_AtomicGet(&videoState->memory[i].peak);
+        stats->memory[i].limit = videoState->memory[i].limit;
+    }
+}
+
+/**
+ * Shows or hides the pipeline stats overlay drawn over the video.
+ *
+ * @param   videoState  the Player.
+ */
+void player_toggle_stats_overlay(Player * videoState)
+{
+    SDL_AtomicSet(&videoState->stats_overlay, !SDL_AtomicGet(&videoState->stats_overlay));
+}
+
+/**
+ * Returns the SDL window id of the given Player, used to route the window and
+ * keyboard events to it.
+ *
+ * @param   videoState  the Player.
+ *
+ * @return              the SDL window id, 0 if the window is not opened yet.
+ */
+Uint32 player_get_window_id(Player * videoState)
+{
+    return videoState->screen ? SDL_GetWindowID(videoState->screen) : 0;
+}
+
+/**
+ * Uploads and presents the pending frames of the given Player, on the calling
+ * thread: the host calls it from the main thread on each PLAYER_EVENT_RENDER.
+ * Creates the window and the renderer on the first call. Does nothing unless
+ * RENDER_ON_MAIN_THREAD, the render thread of the player renders otherwise.
+ *
+ * @param   videoState  the Player.
+ */
+void player_render(Player * videoState)
+{
+    if (!RENDER_ON_MAIN_THREAD || videoState->quit || !SDL_AtomicGet(&videoState->render_started))
+    {
+        return;
+    }
+
+    // the next wake up pushes a new event
+    SDL_AtomicSet(&videoState->render_event_pending, 0);
+
+    if (!videoState->render_opened)
+    {
+        videoState->render_opened = 1;
+
+        if (render_open(videoState) < 0)
+        {
+            // nothing can be shown: end the playback
+            videoState->quit = 1;
+            demux_done(videoState);
+            return;
+        }
+    }
+
+    for (;;)
+    {
+        SDL_LockMutex(videoState->pictq_mutex);
+        int pending = render_pending(videoState);
+        SDL_UnlockMutex(videoState->pictq_mutex);
+
+        if (!pending)
+        {
+            break;
+        }
+
+        render_step(videoState);
+    }
+}
+
+/**
+ * Returns whether the playback of the given Player has ended.
+ *
+ * @param   videoState  the Player.
+ *
+ * @return              != 0 if the playback has ended, 0 otherwise.
+ */
+int player_is_done(Player * videoState)
+{
+    return videoState->quit;
+}
+
+/**
+ * Stops the playback, waits for the player threads and releases all of the
+ * resources of the given Player, including its pending PLAYER_EVENT_DONE
+ * events.
+ *
+ * @param   videoState  the Player, may be NULL.
+ */
+void player_close(Player * videoState)
+{
+    if (!videoState)
+    {
+        return;
+    }
+
+    videoState->quit = 1;
+
+    /**
+     * Wake up every thread waiting for data or room: they check the quit flag
+     * under the same locks, so none of the wake-ups can be missed. The parked
+     * tasks are woken up by scheduler_task_join() below.
+     */
+    PacketQueue * queues[] = {&videoState->audioq, &videoState->videoq};
+    for (int i = 0; i < FF_ARRAY_ELEMS(queues); i++)
+    {
+        if (queues[i]->mutex)
+        {
+            SDL_LockMutex(queues[i]->mutex);
+            SDL_CondBroadcast(queues[i]->cond);
+            SDL_UnlockMutex(queues[i]->mutex);
+        }
+    }
+
+    if (videoState->continue_read_mutex)
+    {
+        demux_wake(videoState);
+    }
+
+    if (videoState->pictq_mutex)
+    {
+        SDL_LockMutex(videoState->pictq_mutex);
+        SDL_CondBroadcast(videoState->render_cond);
+        SDL_UnlockMutex(videoState->pictq_mutex);
+    }
+
+    // wait for the threads, the render thread releases the renderer; the
+    // demux thread first, it starts the decoding tasks
+    SDL_Thread ** threads[] = {
+            &videoState->demux_tid,
+            &videoState->presentation_tid,
+            &videoState->render_tid
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(threads); i++)
+    {
+        if (*threads[i])
+        {
+            SDL_WaitThread(*threads[i], NULL);
+            *threads[i] = NULL;
+        }
+    }
+
+    // wait for the tasks, then close the streams they use
+    scheduler_task_join(&videoState->video_task);
+    scheduler_task_join(&videoState->audio_task);
+
+    demux_close(videoState);
+
+    // drop the PLAYER_EVENT_DONE and PLAYER_EVENT_RENDER events of this player
+    // not handled yet
+    SDL_FilterEvents(player_event_filter, videoState);
+
+    // the renderer of the main thread, the render thread released its own
+    if (videoState->render_opened)
+    {
+        render_close(videoState);
+    }
+
+    if (videoState->audio_dev)
+    {
+        SDL_CloseAudioDevice(videoState->audio_dev);
+    }
+
+    if (videoState->screen)
+    {
+        SDL_DestroyWindow(videoState->screen);
+    }
+
+    if (videoState->stats_file)
+    {
+        fclose(videoState->stats_file);
+    }
+
+    // clean up memory
+    freeAudioResampling(&videoState->audio_resampler);
+    av_freep(&videoState->audio_ring.data);
+    av_freep(&videoState->replay_audio_buf);
+    av_packet_free(&videoState->audio_pkt);
+    av_frame_free(&videoState->audio_frame);
+    av_packet_free(&videoState->video_pkt);
+    av_frame_free(&videoState->video_frame);
+    av_packet_free(&videoState->demux_pkt);
+    avcodec_free_context(&videoState->audio_ctx);
+    avcodec_free_context(&videoState->video_ctx);
+    av_buffer_unref(&videoState->hw_device_ctx);
+    av_buffer_pool_uninit(&videoState->hw_download_pool);
+    slice_scaler_free(&videoState->scaler);
+
+    for (int i = 0; videoState->pictq && i < videoState->pictq_capacity; i++)
+    {
+        av_frame_free(&videoState->pictq[i].src_frame);
+        av_frame_free(&videoState->pictq[i].frame);
+        av_freep(&videoState->pictq[i].buffer);
+    }
+    av_freep(&videoState->pictq);
+
+    packet_queue_destroy(&videoState->audioq);
+    packet_queue_destroy(&videoState->videoq);
+
+    SDL_DestroyMutex(videoState->continue_read_mutex);
+    SDL_DestroyCond(videoState->continue_read_cond);
+    SDL_DestroyMutex(videoState->pictq_mutex);
+    SDL_DestroyCond(videoState->render_cond);
+
+    // the decoder is closed, its share of the decoder threads budget is free
+    if (videoState->video_decoder_threads_taken > 0)
+    {
+        scheduler_decoder_threads_release(videoState->video_decoder_threads_taken);
+    }
+
+    // the tasks are done, the workers may be stopped
+    if (videoState->scheduler)
+    {
+        scheduler_release(videoState->priority);
+    }
+
+    av_free(videoState);
+
+    avformat_network_deinit();
+    SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER);
+}
+
+/**
+ * AVIOInterruptCB callback of the player AVFormatContext: aborts the blocking
+ * demuxer reads once the player is closed.
+ *
+ * @param   opaque  the VideoState.
+ *
+ * @return          != 0 to abort the blocking operation, 0 otherwise.
+ */
+static int decode_interrupt_cb(void * opaque)
+{
+    VideoState * videoState = (VideoState *)opaque;
+
+    return videoState->quit;
+}
+
+/**
+ * SDL_FilterEvents() callback used by player_close(): drops the
+ * PLAYER_EVENT_DONE events of the given player.
+ *
+ * @param   userdata    the VideoState being closed.
+ * @param   event       the queued SDL_Event.
+ *
+ * @return              0 to drop the event, 1 to keep it.
+ */
+static int player_event_filter(void * userdata, SDL_Event * event)
+{
+    return !((event->type == PLAYER_EVENT_DONE || event->type == PLAYER_EVENT_RENDER) && event->user.data1 == userdata);
+}
+
+/**
+ * This function is used as callback for the SDL_Thread.
+ *
+ * The demux thread runs demux_step() until it is done. The input is opened,
+ * probed and read with blocking calls (avformat_open_input(),
+ * avformat_find_stream_info(), av_read_frame() waiting for a network input),
+ * which would hold one of the workers shared by all of the players: the demux
+ * steps run here instead, with the same results as a SchedulerTask step, so
+ * player_replay() runs them on its own thread like the decoding tasks. The
+ * thread sleeps while a step parks, until demux_wake().
+ *
+ * @param   arg the VideoState.
+ *
+ * @return      0.
+ */
+static int demux_thread(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+
+    for (;;)
+    {
+        int ret = demux_step(videoState);
+        if (ret == SCHEDULER_TASK_DONE)
+        {
+            break;
+        }
+
+        // the wake-ups sent while the step ran are not lost
+        if (ret == SCHEDULER_TASK_PARK)
+        {
+            SDL_LockMutex(videoState->continue_read_mutex);
+            while (!videoState->demux_wakeup && !videoState->quit)
+            {
+                SDL_CondWait(videoState->continue_read_cond, videoState->continue_read_mutex);
+            }
+            videoState->demux_wakeup = 0;
+            SDL_UnlockMutex(videoState->continue_read_mutex);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Step function of the demux thread.
+ *
+ * Its first step opens Audio and Video Streams. If all codecs are retrieved
+ * correctly, each step then reads up to DEMUX_TASK_QUANTUM AVPackets from the
+ * VideoState AVFormatContext. Based on their stream index, each packet is
+ * placed in the appropriate queue. The step parks while the packet queues are
+ * full, and is done once the quit flag is set, at the end of the input or in
+ * case of error.
+ *
+ * @param   arg the VideoState.
+ *
+ * @return      a SCHEDULER_TASK_* value.
+ */
+int demux_step(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+
+    // check quit flag
+    if (videoState->quit)
+    {
+        return demux_done(videoState);
+    }
+
+    // open the input and the streams, and start the decoding tasks
+    if (!videoState->demux_opened && demux_open(videoState) < 0)
+    {
+        return demux_done(videoState);
+    }
+
+    AVPacket * packet = videoState->demux_pkt;
+
+    // resumed: the consumers need not signal us any longer
+    SDL_AtomicSet(&videoState->read_waiting, 0);
+
+    // read in packets and put them on the right queue
+    for (int i = 0; i < DEMUX_TASK_QUANTUM; i++)
+    {
+        // check quit flag
+        if (videoState->quit)
+        {
+            return demux_done(videoState);
+        }
+
+        // seek stuff goes here
+        if (videoState->seek_req)
+        {
+            // the AVPacket waiting for a free slot predates the seek
+            if (videoState->demux_pending_queue)
+            {
+                av_packet_unref(packet);
+                videoState->demux_pending_queue = NULL;
+            }
+
+            demux_seek(videoState);
+
+            videoState->seek_req = 0;
+        }
+
+        // put the last AVPacket read once its queue has a free slot
+        if (videoState->demux_pending_queue)
+        {
+            // tell the consumer to wake us up, then check again before parking
+            SDL_AtomicSet(&videoState->read_waiting, 1);
+
+            if (!packet_queue_has_room(videoState->demux_pending_queue))
+            {
+                return SCHEDULER_TASK_PARK;
+            }
+
+            SDL_AtomicSet(&videoState->read_waiting, 0);
+
+            packet_queue_put(videoState->demux_pending_queue, packet);
+            videoState->demux_pending_queue = NULL;
+        }
+
+        // check the packet queues high watermarks
+        if (packet_queues_full(videoState))
+        {
+            // tell the consumers to wake us up, then check again before parking:
+            // one of the packet queues may have gone below its low watermark
+            SDL_AtomicSet(&videoState->read_waiting, 1);
+
+            if (!videoState->quit && !videoState->seek_req && !packet_queues_low(videoState))
+            {
+                return SCHEDULER_TASK_PARK;
+            }
+
+            SDL_AtomicSet(&videoState->read_waiting, 0);
+
+            continue;
+        }
+
+        // read data from the AVFormatContext by repeatedly calling av_read_frame()
+        int64_t read_start = av_gettime_relative();
+        int ret = av_read_frame(videoState->pFormatCtx, packet);
+        if (ret < 0)
+        {
+            if (ret == AVERROR_EOF)
+            {
+                // all of the keyframes are known: save them right away, the
+                // demux thread still owns the AVFormatContext
+                seek_index_save(videoState);
+
+                // the replay plays the queued packets out
+                if (videoState->replay)
+                {
+                    return SCHEDULER_TASK_DONE;
+                }
+
+                // media EOF reached, quit
+                videoState->quit = 1;
+                return demux_done(videoState);
+            }
+            else if (videoState->pFormatCtx->pb->error == 0)
+            {
+                // no read error; wait for user input, woken up early by seek or
+                // quit. Bounded to 10 ms, on the demux thread, never on a worker
+                SDL_LockMutex(videoState->continue_read_mutex);
+                SDL_CondWaitTimeout(videoState->continue_read_cond, videoState->continue_read_mutex, 10);
+                SDL_UnlockMutex(videoState->continue_read_mutex);
+
+                return SCHEDULER_TASK_YIELD;
+            }
+            else
+            {
+                // stop reading in case of error
+                return demux_done(videoState);
+            }
+        }
+
+        if (!videoState->first_packet_time)
+        {
+            videoState->first_packet_time = av_gettime_relative();
+        }
+
+        stats_record(&videoState->stats[PLAYER_STAGE_DEMUX], read_start);
+
+        // put the packet in the appropriate queue
+        PacketQueue * queue;
+        if (packet->stream_index == videoState->videoStream)
+        {
+            // record the keyframes met so far for the next seeks
+            if (packet->flags & AV_PKT_FLAG_KEY)
+            {
+                keyframe_index_add(&videoState->keyframes, packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts, packet->pos);
+            }
+
+            queue = &videoState->videoq;
+        }
+        else if (packet->stream_index == videoState->audioStream && !SDL_AtomicGet(&videoState->audio_disabled))
+        {
+            queue = &videoState->audioq;
+        }
+        else
+        {
+            // otherwise free the memory
+            av_packet_unref(packet);
+            continue;
+        }
+
+        // packet_queue_put() would block on a full ring: keep the AVPacket
+        // until a slot is released
+        if (!packet_queue_has_room(queue))
+        {
+            videoState->demux_pending_queue = queue;
+            continue;
+        }
+
+        packet_queue_put(queue, packet);
+    }
+
+    // the demux thread steps again at once, the replay runs the decoding tasks
+    return SCHEDULER_TASK_YIELD;
+}
+
+/**
+ * Opens the input AVFormatContext, reads the stream information and opens the
+ * audio and video stream components, which start their decoding tasks. Called
+ * by the first step of the demux thread.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int demux_open(VideoState * videoState)
+{
+    // file I/O context: demuxers read a media file and split it into chunks of data (packets)
+    AVFormatContext * pFormatCtx = avformat_alloc_context();
+    if (!pFormatCtx)
+    {
+        printf("Could not allocate AVFormatContext.\n");
+        return -1;
+    }
+
+    // let player_close() interrupt the blocking reads
+    pFormatCtx->interrupt_callback.callback = decode_interrupt_cb;
+    pFormatCtx->interrupt_callback.opaque = videoState;
+
+    // fast start: probe just enough to open the decoders and do not buffer
+    // packets in the demuxer
+    if (videoState->fast_start)
+    {
+        pFormatCtx->probesize = FAST_START_PROBESIZE;
+        pFormatCtx->max_analyze_duration = FAST_START_ANALYZE_DURATION;
+        pFormatCtx->flags |= AVFMT_FLAG_NOBUFFER;
+    }
+
+    // replace the libavformat file protocol with our own backend
+    if (videoState->input_io != INPUT_IO_DEFAULT && input_reader_open(videoState, pFormatCtx) < 0)
+    {
+        avformat_free_context(pFormatCtx);
+        return -1;
+    }
+
+    // network inputs: fail on stalled connections and reconnect dropped http ones;
+    // the options not known by the protocol are left in the dictionary
+    AVDictionary * options = NULL;
+    if (videoState->network_input)
+    {
+        av_dict_set_int(&options, "rw_timeout", NETWORK_TIMEOUT, 0);
+        av_dict_set(&options, "reconnect", "1", 0);
+        av_dict_set(&options, "reconnect_streamed", "1", 0);
+    }
+
+    // on failure the AVFormatContext is freed by avformat_open_input()
+    int ret = avformat_open_input(&pFormatCtx, videoState->filename, NULL, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+    {
+        printf("Could not open file %s.\n", videoState->filename);
+        input_reader_close(&videoState->input);
+        return -1;
+    }
+
+    videoState->open_done_time = av_gettime_relative();
+
+    // reset stream indexes
+    videoState->videoStream = -1;
+    videoState->audioStream = -1;
+
+    // set the AVFormatContext for the VideoState
+    videoState->pFormatCtx = pFormatCtx;
+
+    // a valid sidecar index already holds the stream information: skip the probe
+    if (videoState->use_seek_index && seek_index_open(videoState, pFormatCtx) == 0)
+    {
+        if (_DEBUG_)
+            printf("Stream information restored from %s.\n", videoState->seek_index.path);
+    }
+    else
+    {
+        // read packets of the media file to get stream information
+        ret = avformat_find_stream_info(pFormatCtx, NULL);
+        if (ret < 0)
+        {
+            printf("Could not find stream information: %s.\n", videoState->filename);
+            return -1;
+        }
+    }
+
+    videoState->probe_done_time = av_gettime_relative();
+
+    // dump information about file onto standard error
+    if (_DEBUG_)
+        av_dump_format(pFormatCtx, 0, videoState->filename, 0);
+
+    // video and audio stream indexes
+    int videoStream = -1;
+    int audioStream = -1;
+
+    // loop through the streams that have been found
+    for (int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        // look for the video stream
+        if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && videoStream < 0)
+        {
+            videoStream = i;
+        }
+
+        // look for the audio stream
+        if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && audioStream < 0)
+        {
+            audioStream = i;
+        }
+    }
+
+    // return with error in case neither a video nor an audio stream was found:
+    // an input with only one of them plays without the tasks of the other
+    if (videoStream == -1 && audioStream == -1)
+    {
+        printf("Could not find video or audio stream.\n");
+        return -1;
+    }
+
+    if (videoStream != -1)
+    {
+        // open video stream component codec
+        ret = stream_component_open(videoState, videoStream);
+
+        // check video codec was opened correctly
+        if (ret < 0)
+        {
+            printf("Could not open video codec.\n");
+            return -1;
+        }
+    }
+
+    if (audioStream != -1)
+    {
+        // open audio stream component codec
+        ret = stream_component_open(videoState, audioStream);
+
+        // check audio codec was opened correctly
+        if (ret < 0)
+        {
+            printf("Could not open audio codec.\n");
+            return -1;
+        }
+    }
+
+    // the missing stream cannot be the master clock: the video runs on its own
+    // clock without audio, the audio is the master without video
+    if (!videoState->audio_st && videoState->av_sync_type == AV_SYNC_AUDIO_MASTER)
+    {
+        videoState->av_sync_type = AV_SYNC_VIDEO_MASTER;
+    }
+    else if (!videoState->video_st && videoState->av_sync_type == AV_SYNC_VIDEO_MASTER)
+    {
+        videoState->av_sync_type = AV_SYNC_AUDIO_MASTER;
+    }
+
+    videoState->codec_open_done_time = av_gettime_relative();
+
+    // the keyframes of the sidecar index make the first seeks exact
+    seek_index_load_keyframes(videoState);
+
+    // alloc the AVPacket used to read the media file
+    videoState->demux_pkt = av_packet_alloc();
+    if (videoState->demux_pkt == NULL)
+    {
+        printf("Could not allocate AVPacket.\n");
+        return -1;
+    }
+
+    videoState->demux_opened = 1;
+
+    return 0;
+}
+
+/**
+ * Closes what the demux thread opened, once all of the tasks are done: the
+ * keyframes met during the playback are saved to the sidecar index, and the
+ * input AVFormatContext and backend are closed.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void demux_close(VideoState * videoState)
+{
+    // save the keyframes met during the playback for the next one, unless
+    // saved already at the end of the input
+    if (videoState->demux_opened)
+    {
+        seek_index_save(videoState);
+    }
+
+    // the keyframe index is only used by the demux thread
+    keyframe_index_free(&videoState->keyframes);
+
+    // close the opened input AVFormatContext, a custom AVIOContext is left open
+    avformat_close_input(&videoState->pFormatCtx);
+    input_reader_close(&videoState->input);
+}
+
+/**
+ * Ends the demux thread: pushes the PLAYER_EVENT_DONE of the player, the playback
+ * is over.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              SCHEDULER_TASK_DONE.
+ */
+static int demux_done(VideoState * videoState)
+{
+    // create an SDL_Event of type PLAYER_EVENT_DONE
+    SDL_Event event;
+    event.type = PLAYER_EVENT_DONE;
+    event.user.data1 = videoState;
+
+    // push the event to the events queue
+    SDL_PushEvent(&event);
+
+    return SCHEDULER_TASK_DONE;
+}
+
+/**
+ * Serves the seek request set by stream_seek(): the whole file is repositioned
+ * with avformat_seek_file() and both the packet queues are flushed.
+ *
+ * The seek is expressed in the video stream time base, or in the audio stream
+ * one for an input without video. The demuxer is allowed
+ * to land anywhere between the current position and the target; if the
+ * KeyframeIndex already knows the keyframe the GOP holding the target starts
+ * with, that keyframe is asked for instead, so the decoder never has to go
+ * through more than one GOP to reach the target.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              0 on success, < 0 if the seek failed.
+ */
+static int demux_seek(VideoState * videoState)
+{
+    int stream_index = videoState->videoStream >= 0 ? videoState->videoStream : videoState->audioStream;
+    AVStream * seek_st = videoState->pFormatCtx->streams[stream_index];
+    KeyframeIndex * index = &videoState->keyframes;
+
+    int64_t seek_target = videoState->seek_pos;
+    int64_t seek_rel = videoState->seek_rel;
+
+    // do not let the demuxer land on the other side of the current position
+    int64_t ts = av_rescale_q(seek_target, AV_TIME_BASE_Q, seek_st->time_base);
+    int64_t min_ts = seek_rel > 0 ? av_rescale_q(seek_target - seek_rel, AV_TIME_BASE_Q, seek_st->time_base) + 2 : INT64_MIN;
+    int64_t max_ts = seek_rel < 0 ? av_rescale_q(seek_target - seek_rel, AV_TIME_BASE_Q, seek_st->time_base) - 2 : INT64_MAX;
+
+    // the target GOP is known if a keyframe was seen after it as well
+    int i = keyframe_index_search(index, ts);
+    if (i >= 0 && i + 1 < index->nb_entries && index->pts[i] >= min_ts)
+    {
+        min_ts = index->pts[i];
+        max_ts = ts;
+        ts = index->pts[i];
+    }
+
+    int ret = avformat_seek_file(videoState->pFormatCtx, stream_index, min_ts, ts, max_ts, 0);
+    if (ret < 0)
+    {
+        fprintf(stderr, "%s: error while seeking\n", videoState->filename);
+        return ret;
+    }
+
+    // set the target before the flush, the decoders read it once they see the
+    // new serial
+    videoState->seek_target_time = seek_target / (double)AV_TIME_BASE;
+
+    packet_queue_flush(&videoState->videoq);
+    packet_queue_flush(&videoState->audioq);
+
+    return 0;
+}
+
+/**
+ * Records a keyframe in the given KeyframeIndex, keeping it sorted by pts.
+ * Keyframes are mostly met in order; the ones met again after a backward seek
+ * are not duplicated.
+ *
+ * @param   index   the KeyframeIndex to be updated.
+ * @param   pts     the keyframe pts, in the stream time base.
+ * @param   pos     the keyframe byte position in the file, -1 if unknown.
+ *
+ * @return          0 on success, < 0 if the index could not be grown.
+ */
+static int keyframe_index_add(KeyframeIndex * index, int64_t pts, int64_t pos)
+{
+    if (pts == AV_NOPTS_VALUE)
+    {
+        return 0;
+    }
+
+    // insertion point: after the last entry unless the keyframe is already known
+    int i = index->nb_entries;
+    if (i > 0 && index->pts[i - 1] >= pts)
+    {
+        i = keyframe_index_search(index, pts);
+        if (i >= 0 && index->pts[i] == pts)
+        {
+            return 0;
+        }
+
+        i++;
+    }
+
+    // grow the index
+    if (index->nb_entries == index->capacity)
+    {
+        int capacity = index->capacity ? 2 * index->capacity : KEYFRAME_INDEX_INITIAL_CAPACITY;
+
+        int64_t * entries = av_realloc_array(index->pts, capacity, sizeof(int64_t));
+        if (!entries)
+        {
+            return AVERROR(ENOMEM);
+        }
+        index->pts = entries;
+
+        entries = av_realloc_array(index->pos, capacity, sizeof(int64_t));
+        if (!entries)
+        {
+            return AVERROR(ENOMEM);
+        }
+        index->pos = entries;
+
+        index->capacity = capacity;
+    }
+
+    memmove(&index->pts[i + 1], &index->pts[i], (index->nb_entries - i) * sizeof(int64_t));
+    memmove(&index->pos[i + 1], &index->pos[i], (index->nb_entries - i) * sizeof(int64_t));
+
+    index->pts[i] = pts;
+    index->pos[i] = pos;
+    index->nb_entries++;
+
+    return 0;
+}
+
+/**
+ * Looks for the last keyframe at or before the given pts.
+ *
+ * @param   index   the KeyframeIndex to search.
+ * @param   pts     the pts to look for, in the stream time base.
+ *
+ * @return          the index of the keyframe entry, -1 if pts is before the
+ *                  first known keyframe.
+ */
+static int keyframe_index_search(KeyframeIndex * index, int64_t pts)
+{
+    int lo = 0;
+    int hi = index->nb_entries - 1;
+    int found = -1;
+
+    // binary search, entries are sorted by pts
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (index->pts[mid] <= pts)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Frees the entries of the given KeyframeIndex and resets it.
+ *
+ * @param   index   the KeyframeIndex to be freed.
+ */
+static void keyframe_index_free(KeyframeIndex * index)
+{
+    av_freep(&index->pts);
+    av_freep(&index->pos);
+    index->nb_entries = 0;
+    index->capacity = 0;
+}
+
+/**
+ * Maps the sidecar seek index of the media file and, if it is valid, restores
+ * the stream information it holds into the given AVFormatContext, so that
+ * avformat_find_stream_info() does not need to be called. The keyframes are
+ * loaded later, by seek_index_load_keyframes(), once the video stream is known.
+ *
+ * @param   videoState  the VideoState.
+ * @param   pFormatCtx  the AVFormatContext just opened by avformat_open_input().
+ *
+ * @return              0 if the stream information was restored, < 0 if the
+ *                      sidecar is missing, stale or corrupted.
+ */
+static int seek_index_open(VideoState * videoState, AVFormatContext * pFormatCtx)
+{
+    SeekIndex * seekIndex = &videoState->seek_index;
+    struct stat st;
+
+    // the sidecar is only valid for the very same media file
+    if (stat(videoState->filename, &st) != 0)
+    {
+        return -1;
+    }
+
+    snprintf(seekIndex->path, sizeof(seekIndex->path), "%s%s", videoState->filename, SEEK_INDEX_SUFFIX);
+    seekIndex->file_size = st.st_size;
+    seekIndex->file_mtime = st.st_mtime;
+
+    int fd = open(seekIndex->path, O_RDONLY);
+    if (fd < 0)
+    {
+        // first playback of the file
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SeekIndexHeader))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    seekIndex->map = map;
+    seekIndex->map_size = st.st_size;
+
+    const SeekIndexHeader * header = map;
+    const SeekIndexStream * streams = (const SeekIndexStream *)(seekIndex->map + sizeof(SeekIndexHeader));
+    uint64_t streams_end = sizeof(SeekIndexHeader) + (uint64_t)pFormatCtx->nb_streams * sizeof(SeekIndexStream);
+
+    // check the whole sidecar before touching the AVFormatContext
+    int valid = memcmp(header->magic, SEEK_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == SEEK_INDEX_VERSION &&
+                header->file_size == seekIndex->file_size &&
+                header->file_mtime == seekIndex->file_mtime &&
+                header->nb_streams == pFormatCtx->nb_streams &&
+                streams_end <= seekIndex->map_size &&
+                header->entries_offset >= (int64_t)streams_end &&
+                header->nb_entries >= 0 && header->nb_entries <= INT_MAX &&
+                header->entries_offset <= (int64_t)seekIndex->map_size &&
+                header->nb_entries <= (int64_t)((seekIndex->map_size - header->entries_offset) / sizeof(SeekIndexEntry));
+
+    for (unsigned int i = 0; valid && i < pFormatCtx->nb_streams; i++)
+    {
+        const SeekIndexStream * stream = &streams[i];
+
+        valid = stream->codec_type == pFormatCtx->streams[i]->codecpar->codec_type &&
+                stream->extradata_size >= 0 &&
+                stream->extradata_offset >= (int64_t)streams_end &&
+                stream->extradata_offset + stream->extradata_size <= header->entries_offset;
+    }
+
+    if (!valid)
+    {
+        printf("Ignoring stale seek index %s.\n", seekIndex->path);
+        seek_index_close(seekIndex);
+        return -1;
+    }
+
+    // restore the stream information
+    pFormatCtx->start_time = header->start_time;
+    pFormatCtx->duration = header->duration;
+    pFormatCtx->bit_rate = header->bit_rate;
+
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        const SeekIndexStream * stream = &streams[i];
+        AVStream * avStream = pFormatCtx->streams[i];
+        AVCodecParameters * codecpar = avStream->codecpar;
+
+        codecpar->codec_id = stream->codec_id;
+        codecpar->codec_tag = stream->codec_tag;
+        codecpar->format = stream->format;
+        codecpar->bit_rate = stream->bit_rate;
+        codecpar->profile = stream->profile;
+        codecpar->level = stream->level;
+        codecpar->width = stream->width;
+        codecpar->height = stream->height;
+        codecpar->sample_aspect_ratio = (AVRational){stream->sample_aspect_ratio[0], stream->sample_aspect_ratio[1]};
+        codecpar->field_order = stream->field_order;
+        codecpar->color_range = stream->color_range;
+        codecpar->color_primaries = stream->color_primaries;
+        codecpar->color_trc = stream->color_trc;
+        codecpar->color_space = stream->color_space;
+        codecpar->chroma_location = stream->chroma_location;
+        codecpar->video_delay = stream->video_delay;
+        codecpar->channel_layout = stream->channel_layout;
+        codecpar->channels = stream->channels;
+        codecpar->sample_rate = stream->sample_rate;
+        codecpar->frame_size = stream->frame_size;
+        codecpar->block_align = stream->block_align;
+        codecpar->initial_padding = stream->initial_padding;
+        codecpar->bits_per_coded_sample = stream->bits_per_coded_sample;
+        codecpar->bits_per_raw_sample = stream->bits_per_raw_sample;
+
+        // keep the extradata set by the demuxer, if any
+        if (!codecpar->extradata && stream->extradata_size > 0)
+        {
+            codecpar->extradata = av_mallocz(stream->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (codecpar->extradata)
+            {
+                memcpy(codecpar->extradata, seekIndex->map + stream->extradata_offset, stream->extradata_size);
+                codecpar->extradata_size = stream->extradata_size;
+            }
+        }
+
+        avStream->time_base = (AVRational){stream->time_base[0], stream->time_base[1]};
+        avStream->avg_frame_rate = (AVRational){stream->avg_frame_rate[0], stream->avg_frame_rate[1]};
+        avStream->r_frame_rate = (AVRational){stream->r_frame_rate[0], stream->r_frame_rate[1]};
+        avStream->start_time = stream->start_time;
+        avStream->duration = stream->duration;
+    }
+
+    seekIndex->loaded = 1;
+
+    return 0;
+}
+
+/**
+ * Loads the keyframes of the mapped sidecar seek index: the ones of the video
+ * stream go to the KeyframeIndex used by demux_seek(), and all of them
+ * are added to the demuxer index of their AVStream, so that seeking does not
+ * need to scan the file. The sidecar is unmapped afterwards.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void seek_index_load_keyframes(VideoState * videoState)
+{
+    SeekIndex * seekIndex = &videoState->seek_index;
+    AVFormatContext * pFormatCtx = videoState->pFormatCtx;
+
+    if (!seekIndex->map)
+    {
+        return;
+    }
+
+    const SeekIndexHeader * header = (const SeekIndexHeader *)seekIndex->map;
+    const SeekIndexEntry * entries = (const SeekIndexEntry *)(seekIndex->map + header->entries_offset);
+
+    for (int64_t i = 0; i < header->nb_entries; i++)
+    {
+        const SeekIndexEntry * entry = &entries[i];
+
+        if (entry->stream_index < 0 || entry->stream_index >= (int)pFormatCtx->nb_streams)
+        {
+            continue;
+        }
+
+        av_add_index_entry(pFormatCtx->streams[entry->stream_index], entry->pos, entry->pts, 0, 0, entry->flags);
+
+        if (entry->stream_index == videoState->videoStream && (entry->flags & AVINDEX_KEYFRAME))
+        {
+            keyframe_index_add(&videoState->keyframes, entry->pts, entry->pos);
+        }
+    }
+
+    seekIndex->nb_loaded_entries = videoState->keyframes.nb_entries;
+
+    seek_index_close(seekIndex);
+}
+
+/**
+ * Writes the sidecar seek index of the media file: the stream information of
+ * the AVFormatContext and the keyframes of the KeyframeIndex. Nothing is
+ * written if the loaded sidecar already holds all the known keyframes. The file
+ * is written under a temporary name and renamed, so a concurrent player never
+ * maps a partial file.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              0 on success, < 0 otherwise.
+ */
+static int seek_index_write(VideoState * videoState)
+{
+    SeekIndex * seekIndex = &videoState->seek_index;
+    AVFormatContext * pFormatCtx = videoState->pFormatCtx;
+    KeyframeIndex * keyframes = &videoState->keyframes;
+    static const uint8_t padding[8] = {0};
+
+    // not a local file, or nothing new since the sidecar was loaded
+    if (seekIndex->path[0] == '\0' || (seekIndex->loaded && keyframes->nb_entries <= seekIndex->nb_loaded_entries))
+    {
+        return 0;
+    }
+
+    char tmp_path[sizeof(seekIndex->path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", seekIndex->path);
+
+    FILE * file = fopen(tmp_path, "wb");
+    if (!file)
+    {
+        printf("Could not create seek index %s.\n", tmp_path);
+        return -1;
+    }
+
+    // the extradata follow the streams, the entries follow the extradata
+    int64_t offset = sizeof(SeekIndexHeader) + (int64_t)pFormatCtx->nb_streams * sizeof(SeekIndexStream);
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        offset += FFALIGN(pFormatCtx->streams[i]->codecpar->extradata_size, 8);
+    }
+
+    SeekIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SEEK_INDEX_VERSION;
+    header.nb_streams = pFormatCtx->nb_streams;
+    header.file_size = seekIndex->file_size;
+    header.file_mtime = seekIndex->file_mtime;
+    header.start_time = pFormatCtx->start_time;
+    header.duration = pFormatCtx->duration;
+    header.bit_rate = pFormatCtx->bit_rate;
+    header.entries_offset = offset;
+    header.nb_entries = keyframes->nb_entries;
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    offset = sizeof(SeekIndexHeader) + (int64_t)pFormatCtx->nb_streams * sizeof(SeekIndexStream);
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        AVStream * avStream = pFormatCtx->streams[i];
+        AVCodecParameters * codecpar = avStream->codecpar;
+        SeekIndexStream stream;
+
+        memset(&stream, 0, sizeof(stream));
+        stream.bit_rate = codecpar->bit_rate;
+        stream.start_time = avStream->start_time;
+        stream.duration = avStream->duration;
+        stream.channel_layout = codecpar->channel_layout;
+        stream.extradata_offset = offset;
+        stream.extradata_size = codecpar->extradata_size;
+        stream.codec_type = codecpar->codec_type;
+        stream.codec_id = codecpar->codec_id;
+        stream.codec_tag = codecpar->codec_tag;
+        stream.format = codecpar->format;
+        stream.profile = codecpar->profile;
+        stream.level = codecpar->level;
+        stream.width = codecpar->width;
+        stream.height = codecpar->height;
+        stream.sample_aspect_ratio[0] = codecpar->sample_aspect_ratio.num;
+        stream.sample_aspect_ratio[1] = codecpar->sample_aspect_ratio.den;
+        stream.field_order = codecpar->field_order;
+        stream.color_range = codecpar->color_range;
+        stream.color_primaries = codecpar->color_primaries;
+        stream.color_trc = codecpar->color_trc;
+        stream.color_space = codecpar->color_space;
+        stream.chroma_location = codecpar->chroma_location;
+        stream.video_delay = codecpar->video_delay;
+        stream.channels = codecpar->channels;
+        stream.sample_rate = codecpar->sample_rate;
+        stream.frame_size = codecpar->frame_size;
+        stream.block_align = codecpar->block_align;
+        stream.initial_padding = codecpar->initial_padding;
+        stream.bits_per_coded_sample = codecpar->bits_per_coded_sample;
+        stream.bits_per_raw_sample = codecpar->bits_per_raw_sample;
+        stream.time_base[0] = avStream->time_base.num;
+        stream.time_base[1] = avStream->time_base.den;
+        stream.avg_frame_rate[0] = avStream->avg_frame_rate.num;
+        stream.avg_frame_rate[1] = avStream->avg_frame_rate.den;
+        stream.r_frame_rate[0] = avStream->r_frame_rate.num;
+        stream.r_frame_rate[1] = avStream->r_frame_rate.den;
+
+        fwrite(&stream, sizeof(stream), 1, file);
+
+        offset += FFALIGN(codecpar->extradata_size, 8);
+    }
+
+    for (unsigned int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        AVCodecParameters * codecpar = pFormatCtx->streams[i]->codecpar;
+
+        if (codecpar->extradata_size > 0)
+        {
+            fwrite(codecpar->extradata, codecpar->extradata_size, 1, file);
+            fwrite(padding, FFALIGN(codecpar->extradata_size, 8) - codecpar->extradata_size, 1, file);
+        }
+    }
+
+    for (int i = 0; i < keyframes->nb_entries; i++)
+    {
+        SeekIndexEntry entry;
+
+        memset(&entry, 0, sizeof(entry));
+        entry.pts = keyframes->pts[i];
+        entry.pos = keyframes->pos[i];
+        entry.stream_index = videoState->videoStream;
+        entry.flags = AVINDEX_KEYFRAME;
+
+        fwrite(&entry, sizeof(entry), 1, file);
+    }
+
+    int failed = ferror(file);
+    failed |= fclose(file);
+
+    if (failed || rename(tmp_path, seekIndex->path) != 0)
+    {
+        printf("Could not write seek index %s.\n", seekIndex->path);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Writes the sidecar seek index if --seek-index is used, and records its
+ * keyframes as saved: it is only written again for the keyframes met later.
+ * Only called by the demux thread, or once it is joined.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void seek_index_save(VideoState * videoState)
+{
+    if (!videoState->use_seek_index)
+    {
+        return;
+    }
+
+    if (seek_index_write(videoState) == 0)
+    {
+        videoState->seek_index.loaded = 1;
+        videoState->seek_index.nb_loaded_entries = videoState->keyframes.nb_entries;
+    }
+}
+
+/**
+ * Unmaps the given sidecar seek index, if mapped.
+ *
+ * @param   seekIndex   the SeekIndex to be closed.
+ */
+static void seek_index_close(SeekIndex * seekIndex)
+{
+    if (seekIndex->map)
+    {
+        munmap(seekIndex->map, seekIndex->map_size);
+        seekIndex->map = NULL;
+        seekIndex->map_size = 0;
+    }
+}
+
+/**
+ * Opens the custom input backend selected by --io and sets it as the AVIOContext
+ * of the given AVFormatContext, which must not be opened yet.
+ *
+ * @param   videoState  the VideoState.
+ * @param   pFormatCtx  the AVFormatContext to be opened by avformat_open_input().
+ *
+ * @return              0 on success, < 0 otherwise.
+ */
+static int input_reader_open(VideoState * videoState, AVFormatContext * pFormatCtx)
+{
+    InputReader * reader = &videoState->input;
+    struct stat st;
+
+    memset(reader, 0, sizeof(InputReader));
+    reader->type = videoState->input_io;
+    reader->fd = -1;
+    reader->arena = &videoState->memory[PLAYER_MEMORY_INPUT];
+
+    reader->fd = open(videoState->filename, O_RDONLY);
+    if (reader->fd < 0 || fstat(reader->fd, &st) != 0)
+    {
+        printf("Could not open file %s.\n", videoState->filename);
+        goto fail;
+    }
+
+    reader->file_size = st.st_size;
+
+    if (reader->type == INPUT_IO_MMAP)
+    {
+        if (reader->file_size <= 0)
+        {
+            printf("Could not map file %s: not a regular file.\n", videoState->filename);
+            goto fail;
+        }
+
+        void * map = mmap(NULL, reader->file_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+        if (map == MAP_FAILED)
+        {
+            printf("Could not map file %s.\n", videoState->filename);
+            goto fail;
+        }
+
+        reader->map = map;
+
+        // the file is read in order, let the kernel read ahead
+        madvise(reader->map, reader->file_size, MADV_SEQUENTIAL);
+    }
+    else
+    {
+        // the read-ahead is capped by the input arena, less the AVIOContext buffer
+        int max_capacity = reader->arena->limit - videoState->input_io_buffer_size;
+        reader->ring_capacity = FFMAX(FFMIN(videoState->input_prefetch_size, max_capacity), INPUT_PREFETCH_CHUNK);
+        if (reader->ring_capacity < videoState->input_prefetch_size)
+        {
+            printf("Prefetch size reduced to %d KB to fit the memory budget.\n", reader->ring_capacity / 1024);
+        }
+
+        reader->ring = av_malloc(reader->ring_capacity);
+        reader->mutex = SDL_CreateMutex();
+        reader->cond = SDL_CreateCond();
+
+        if (!reader->ring || !reader->mutex || !reader->cond)
+        {
+            printf("Could not allocate the prefetch buffer.\n");
+            goto fail;
+        }
+
+        reader->prefetch_tid = SDL_CreateThread(prefetch_thread, "Prefetch Thread", reader);
+        if (!reader->prefetch_tid)
+        {
+            printf("Could not start prefetch SDL_Thread: %s.\n", SDL_GetError());
+            goto fail;
+        }
+    }
+
+    // the AVIOContext buffer is owned by the AVIOContext once allocated
+    uint8_t * buffer = av_malloc(videoState->input_io_buffer_size);
+    if (buffer)
+    {
+        reader->avio = avio_alloc_context(buffer, videoState->input_io_buffer_size, 0, reader, input_read_packet, NULL, input_seek);
+    }
+
+    if (!reader->avio)
+    {
+        printf("Could not allocate AVIOContext.\n");
+        av_free(buffer);
+        goto fail;
+    }
+
+    // account the ring and the AVIOContext buffer, released by input_reader_close()
+    reader->arena_size = reader->ring_capacity + videoState->input_io_buffer_size;
+    memory_arena_charge(reader->arena, reader->arena_size);
+
+    pFormatCtx->pb = reader->avio;
+    pFormatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    return 0;
+
+    fail:
+    {
+        input_reader_close(reader);
+        return -1;
+    };
+}
+
+/**
+ * Stops the prefetch thread, if any, and releases the given InputReader. The
+ * statistics are kept for the final report.
+ *
+ * @param   reader  the InputReader to be closed.
+ */
+static void input_reader_close(InputReader * reader)
+{
+    // nothing to release for the libavformat file protocol
+    if (reader->type == INPUT_IO_DEFAULT)
+    {
+        return;
+    }
+
+    if (reader->prefetch_tid)
+    {
+        SDL_LockMutex(reader->mutex);
+        reader->abort = 1;
+        SDL_CondBroadcast(reader->cond);
+        SDL_UnlockMutex(reader->mutex);
+
+        SDL_WaitThread(reader->prefetch_tid, NULL);
+        reader->prefetch_tid = NULL;
+    }
+
+    if (reader->avio)
+    {
+        av_freep(&reader->avio->buffer);
+        avio_context_free(&reader->avio);
+    }
+
+    if (reader->map)
+    {
+        munmap(reader->map, reader->file_size);
+        reader->map = NULL;
+    }
+
+    if (reader->fd >= 0)
+    {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+
+    av_freep(&reader->ring);
+
+    if (reader->arena)
+    {
+        memory_arena_release(reader->arena, reader->arena_size);
+        reader->arena_size = 0;
+    }
+
+    if (reader->cond)
+    {
+        SDL_DestroyCond(reader->cond);
+        reader->cond = NULL;
+    }
+
+    if (reader->mutex)
+    {
+        SDL_DestroyMutex(reader->mutex);
+        reader->mutex = NULL;
+    }
+}
+
+/**
+ * AVIOContext read callback: copies the data at the read position from the
+ * prefetch ring, waiting for the prefetch thread if it is empty, or from the
+ * mapped file.
+ *
+ * @param   opaque      the InputReader.
+ * @param   buf         the buffer to be filled.
+ * @param   buf_size    the size of buf.
+ *
+ * @return              the number of bytes read, AVERROR_EOF at the end of the
+ *                      file, another AVERROR code on read errors.
+ */
+static int input_read_packet(void * opaque, uint8_t * buf, int buf_size)
+{
+    InputReader * reader = opaque;
+
+    if (reader->type == INPUT_IO_MMAP)
+    {
+        int64_t start = av_gettime_relative();
+
+        int size = (int)FFMIN(buf_size, reader->file_size - reader->pos);
+        if (size <= 0)
+        {
+            return AVERROR_EOF;
+        }
+
+        // the page faults of the copy are the only reads of the mmap backend
+        memcpy(buf, reader->map + reader->pos, size);
+        reader->pos += size;
+
+        int64_t elapsed = av_gettime_relative() - start;
+        reader->bytes_fetched += size;
+        reader->fetch_time += elapsed;
+        reader->stall_time += elapsed;
+
+        return size;
+    }
+
+    SDL_LockMutex(reader->mutex);
+
+    // wait for the prefetch thread, this is the time the demuxer is stalled
+    if (reader->ring_fill == 0 && !reader->eof && !reader->error && !reader->abort)
+    {
+        int64_t start = av_gettime_relative();
+
+        while (reader->ring_fill == 0 && !reader->eof && !reader->error && !reader->abort)
+        {
+            SDL_CondWait(reader->cond, reader->mutex);
+        }
+
+        reader->stall_time += av_gettime_relative() - start;
+    }
+
+    int size = 0;
+    if (reader->ring_fill > 0)
+    {
+        // copy the contiguous data at the ring read index
+        size = FFMIN(buf_size, FFMIN(reader->ring_fill, reader->ring_capacity - reader->ring_rindex));
+        memcpy(buf, reader->ring + reader->ring_rindex, size);
+
+        reader->ring_rindex = (reader->ring_rindex + size) % reader->ring_capacity;
+        reader->ring_fill -= size;
+        reader->pos += size;
+
+        // there is room for the prefetch thread again
+        SDL_CondSignal(reader->cond);
+    }
+    else
+    {
+        size = reader->error ? reader->error : AVERROR_EOF;
+    }
+
+    SDL_UnlockMutex(reader->mutex);
+
+    return size;
+}
+
+/**
+ * AVIOContext seek callback. The prefetch ring is kept if the new position is
+ * inside the buffered data.
+ *
+ * @param   opaque  the InputReader.
+ * @param   offset  the seek offset.
+ * @param   whence  SEEK_SET, SEEK_CUR, SEEK_END or AVSEEK_SIZE.
+ *
+ * @return          the new position, the file size for AVSEEK_SIZE, < 0 on error.
+ */
+static int64_t input_seek(void * opaque, int64_t offset, int whence)
+{
+    InputReader * reader = opaque;
+    int64_t pos;
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE:
+            return reader->file_size;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = reader->pos + offset;
+            break;
+        case SEEK_END:
+            pos = reader->file_size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+
+    if (pos < 0)
+    {
+        return AVERROR(EINVAL);
+    }
+
+    if (reader->type == INPUT_IO_MMAP)
+    {
+        reader->pos = pos;
+        return pos;
+    }
+
+    SDL_LockMutex(reader->mutex);
+
+    if (pos >= reader->pos && pos <= reader->pos + reader->ring_fill)
+    {
+        // skip the buffered bytes before the new position
+        int skip = (int)(pos - reader->pos);
+
+        reader->ring_rindex = (reader->ring_rindex + skip) % reader->ring_capacity;
+        reader->ring_fill -= skip;
+    }
+    else
+    {
+        // restart the read-ahead from the new position
+        reader->ring_rindex = 0;
+        reader->ring_fill = 0;
+        reader->eof = 0;
+        reader->error = 0;
+        reader->generation++;
+    }
+
+    reader->pos = pos;
+
+    SDL_CondBroadcast(reader->cond);
+    SDL_UnlockMutex(reader->mutex);
+
+    return pos;
+}
+
+/**
+ * Prefetch thread of the InputReader: keeps the ring filled with the data that
+ * follows the read position, INPUT_PREFETCH_CHUNK bytes at a time.
+ *
+ * @param   arg the InputReader.
+ *
+ * @return      0.
+ */
+static int prefetch_thread(void * arg)
+{
+    InputReader * reader = arg;
+
+    SDL_LockMutex(reader->mutex);
+
+    while (!reader->abort)
+    {
+        // wait for room in the ring or a seek past the end of the file
+        if (reader->ring_fill == reader->ring_capacity || reader->eof || reader->error)
+        {
+            SDL_CondWait(reader->cond, reader->mutex);
+            continue;
+        }
+
+        // contiguous free room after the buffered data
+        int windex = (reader->ring_rindex + reader->ring_fill) % reader->ring_capacity;
+        int size = FFMIN(reader->ring_capacity - reader->ring_fill, reader->ring_capacity - windex);
+        size = FFMIN(size, INPUT_PREFETCH_CHUNK);
+
+        int64_t file_pos = reader->pos + reader->ring_fill;
+        int generation = reader->generation;
+
+        // the free room is only written by this thread: read without the lock
+        SDL_UnlockMutex(reader->mutex);
+
+        int64_t start = av_gettime_relative();
+        ssize_t ret = pread(reader->fd, reader->ring + windex, size, file_pos);
+        int64_t elapsed = av_gettime_relative() - start;
+
+        SDL_LockMutex(reader->mutex);
+
+        reader->fetch_time += elapsed;
+
+        // the data read before a seek is of no use
+        if (generation != reader->generation)
+        {
+            continue;
+        }
+
+        if (ret > 0)
+        {
+            reader->ring_fill += (int)ret;
+            reader->bytes_fetched += ret;
+        }
+        else if (ret == 0)
+        {
+            reader->eof = 1;
+        }
+        else
+        {
+            reader->error = AVERROR(errno);
+        }
+
+        SDL_CondBroadcast(reader->cond);
+    }
+
+    SDL_UnlockMutex(reader->mutex);
+
+    return 0;
+}
+
+/**
+ * Checks the given input is a network stream (http, hls, rtsp, srt, ...)
+ * rather than a local file.
+ *
+ * @param   filename    the input file name or URL.
+ *
+ * @return              != 0 for network inputs, 0 otherwise.
+ */
+static int is_network_input(const char * filename)
+{
+    return strstr(filename, "://") != NULL && !av_strstart(filename, "file:", NULL);
+}
+
+/**
+ * Jitter buffer: once the audio PacketQueue ran dry, holds the audio decoding
+ * back until it holds jitter_buffer seconds of media again, so that a network
+ * hiccup costs a single pause instead of a long series of audio underruns.
+ * Once AVPackets arrive the pause lasts one buffer depth at most, which also
+ * covers the streams whose AVPackets carry no duration. The audio decoding task
+ * parks meanwhile: each new AVPacket and each audio callback wake it up to
+ * check again.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              != 0 if the audio decoding may go on, 0 otherwise.
+ */
+static int jitter_buffer_ready(VideoState * videoState)
+{
+    PacketQueue * queue = &videoState->audioq;
+    int64_t now = videoState->clock(videoState);
+
+    if (videoState->rebuffer_start == 0)
+    {
+        if (SDL_AtomicGet(&queue->nb_packets) > 0)
+        {
+            return 1;
+        }
+
+        // the queue ran dry: start rebuffering
+        videoState->rebuffer_start = now;
+    }
+
+    int64_t depth = (int64_t)(videoState->jitter_buffer * 1000000);
+
+    if (!videoState->quit &&
+        SDL_AtomicGet(&queue->duration) < depth / 1000 &&
+        (SDL_AtomicGet(&queue->nb_packets) == 0 || now - videoState->rebuffer_start < depth))
+    {
+        return 0;
+    }
+
+    videoState->rebuffer_count++;
+    videoState->rebuffer_time += now - videoState->rebuffer_start;
+    videoState->rebuffer_start = 0;
+
+    return 1;
+}
+
+/**
+ * Names of the instrumented pipeline stages, as used by the overlay and the
+ * stats dump.
+ */
+static const char * STATS_NAMES[PLAYER_STAGE_NB] = {
+        "demux",
+        "decode",
+        "scale",
+        "upload",
+        "present",
+        "av_sync",
+        "adecode",
+        "resample"
+};
+
+/**
+ * Adds the time elapsed since the given start to the given latency histogram.
+ * Lock-free, can be called from any thread.
+ *
+ * @param   histogram   the StatsHistogram to be updated.
+ * @param   start       the measure start time, from av_gettime_relative().
+ */
+static void stats_record(StatsHistogram * histogram, int64_t start)
+{
+    stats_record_value(histogram, av_gettime_relative() - start);
+}
+
+/**
+ * Adds the given sample to the given latency histogram. Lock-free, can be
+ * called from any thread. The sample is clamped to the range of the last
+ * bucket, which keeps the interval total from overflowing.
+ *
+ * @param   histogram   the StatsHistogram to be updated.
+ * @param   value       the sample, in microseconds.
+ */
+static void stats_record_value(StatsHistogram * histogram, int64_t value)
+{
+    int us = (int)av_clip64(value, 0, (1 << STATS_HISTOGRAM_BUCKETS) - 1);
+    int max;
+
+    SDL_AtomicAdd(&histogram->buckets[FFMIN(av_log2(us), STATS_HISTOGRAM_BUCKETS - 1)], 1);
+    SDL_AtomicAdd(&histogram->count, 1);
+    SDL_AtomicAdd(&histogram->total, us);
+
+    // raise the maximum, unless another thread raised it higher meanwhile
+    do
+    {
+        max = SDL_AtomicGet(&histogram->max);
+    } while (us > max && !SDL_AtomicCAS(&histogram->max, max, us));
+}
+
+/**
+ * Takes the samples out of the given histogram and summarizes them. The
+ * histogram is left empty for the next interval.
+ *
+ * @param   histogram   the StatsHistogram to be summarized.
+ * @param   stage       the PlayerStageStats filled with the summary.
+ */
+static void stats_histogram_summarize(StatsHistogram * histogram, PlayerStageStats * stage)
+{
+    int buckets[STATS_HISTOGRAM_BUCKETS];
+    int count = 0;
+
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+    {
+        buckets[i] = SDL_AtomicSet(&histogram->buckets[i], 0);
+        count += buckets[i];
+    }
+
+    // the samples added while the buckets were taken out are in the next interval
+    SDL_AtomicSet(&histogram->count, 0);
+    int total = SDL_AtomicSet(&histogram->total, 0);
+    int max = SDL_AtomicSet(&histogram->max, 0);
+
+    stage->count = count;
+    stage->mean = count ? total / 1000.0 / count : 0;
+    stage->max = max / 1000.0;
+    stage->p50 = 0;
+    stage->p99 = 0;
+
+    // the percentiles are the upper bound of the bucket they fall in, or the
+    // maximum if lower
+    int cumulated = 0;
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS && count > 0; i++)
+    {
+        cumulated += buckets[i];
+
+        double upper = FFMIN((double)(2 << i), (double)max) / 1000.0;
+
+        if (stage->p50 == 0 && cumulated * 100 >= count * 50)
+        {
+            stage->p50 = upper;
+        }
+
+        if (cumulated * 100 >= count * 99)
+        {
+            stage->p99 = upper;
+            break;
+        }
+    }
+}
+
+/**
+ * Memory arenas names, used by the stats overlay, and their share of the
+ * memory budget in percent, indexed by PLAYER_MEMORY_*.
+ */
+static const char * MEMORY_ARENA_NAMES[PLAYER_MEMORY_NB] = {
+        "videoq",
+        "audioq",
+        "pictures",
+        "audio",
+        "input"
+};
+
+static const int MEMORY_ARENA_SHARES[PLAYER_MEMORY_NB] = {
+        40,
+        5,
+        35,
+        5,
+        15
+};
+
+/**
+ * Splits the memory budget of the given VideoState between its arenas, all of
+ * them empty.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void memory_arenas_init(VideoState * videoState)
+{
+    for (int i = 0; i < PLAYER_MEMORY_NB; i++)
+    {
+        SDL_AtomicSet(&videoState->memory[i].current, 0);
+        SDL_AtomicSet(&videoState->memory[i].peak, 0);
+        videoState->memory[i].limit = (int)((int64_t)videoState->memory_budget * MEMORY_ARENA_SHARES[i] / 100);
+    }
+}
+
+/**
+ * Draws the given number of bytes from the given memory arena. Lock-free, can
+ * be called from any thread.
+ *
+ * @param   arena   the MemoryArena.
+ * @param   size    the number of bytes allocated.
+ */
+static void memory_arena_charge(MemoryArena * arena, int size)
+{
+    int current = SDL_AtomicAdd(&arena->current, size) + size;
+    int peak;
+
+    // raise the peak, unless another thread raised it higher meanwhile
+    do
+    {
+        peak = SDL_AtomicGet(&arena->peak);
+    } while (current > peak && !SDL_AtomicCAS(&arena->peak, peak, current));
+}
+
+/**
+ * Gives the given number of bytes back to the given memory arena. Lock-free,
+ * can be called from any thread.
+ *
+ * @param   arena   the MemoryArena.
+ * @param   size    the number of bytes released.
+ */
+static void memory_arena_release(MemoryArena * arena, int size)
+{
+    SDL_AtomicAdd(&arena->current, -size);
+}
+
+/**
+ * Summarizes the pipeline stats of the last interval for the overlay and
+ * player_get_stats(), and writes them to the stats file, if any. Called every
+ * STATS_INTERVAL ms by the presentation thread.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void stats_update(VideoState * videoState)
+{
+    PlayerIntervalStats summary;
+
+    summary.time = (av_gettime_relative() - videoState->startup_time) / 1000000.0;
+
+    for (int i = 0; i < PLAYER_STAGE_NB; i++)
+    {
+        stats_histogram_summarize(&videoState->stats[i], &summary.stages[i]);
+    }
+
+    summary.audioq_packets = SDL_AtomicGet(&videoState->audioq.nb_packets);
+    summary.audioq_size = SDL_AtomicGet(&videoState->audioq.size);
+    summary.videoq_packets = SDL_AtomicGet(&videoState->videoq.nb_packets);
+    summary.videoq_size = SDL_AtomicGet(&videoState->videoq.size);
+
+    SDL_LockMutex(videoState->pictq_mutex);
+    summary.pictq_size = videoState->pictq_size;
+    SDL_UnlockMutex(videoState->pictq_mutex);
+
+    summary.av_diff = SDL_AtomicGet(&videoState->av_diff) / 1000.0;
+    summary.frames_dropped = SDL_AtomicGet(&videoState->frames_dropped);
+    summary.frames_skipped = SDL_AtomicGet(&videoState->frames_skipped);
+
+    SDL_AtomicLock(&videoState->stats_lock);
+    videoState->stats_summary = summary;
+    SDL_AtomicUnlock(&videoState->stats_lock);
+
+    if (videoState->stats_file)
+    {
+        stats_write(videoState, &summary);
+    }
+}
+
+/**
+ * Writes the CSV header line to the stats file. Nothing is written for JSON
+ * lines, each is self-describing.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void stats_write_header(VideoState * videoState)
+{
+    if (videoState->stats_json)
+    {
+        return;
+    }
+
+    fprintf(videoState->stats_file, "time");
+
+    for (int i = 0; i < PLAYER_STAGE_NB; i++)
+    {
+        fprintf(videoState->stats_file, ",%s_count,%s_mean,%s_p50,%s_p99,%s_max",
+                STATS_NAMES[i], STATS_NAMES[i], STATS_NAMES[i], STATS_NAMES[i], STATS_NAMES[i]);
+    }
+
+    fprintf(videoState->stats_file, ",audioq_packets,audioq_bytes,videoq_packets,videoq_bytes,pictq_size,av_diff,frames_dropped,frames_skipped\n");
+}
+
+/**
+ * Writes the given stats summary to the stats file, as a CSV or JSON line. The
+ * times are in milliseconds. The file is flushed so it can be followed live.
+ *
+ * @param   videoState  the VideoState.
+ * @param   summary     the PlayerIntervalStats to be written.
+ */
+static void stats_write(VideoState * videoState, PlayerIntervalStats * summary)
+{
+    FILE * file = videoState->stats_file;
+
+    if (videoState->stats_json)
+    {
+        fprintf(file, "{\"time\":%.3f,\"stages\":{", summary->time);
+
+        for (int i = 0; i < PLAYER_STAGE_NB; i++)
+        {
+            PlayerStageStats * stage = &summary->stages[i];
+
+            fprintf(file, "%s\"%s\":{\"count\":%d,\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                    i ? "," : "", STATS_NAMES[i], stage->count, stage->mean, stage->p50, stage->p99, stage->max);
+        }
+
+        fprintf(file, "},\"audioq\":{\"packets\":%d,\"bytes\":%d},\"videoq\":{\"packets\":%d,\"bytes\":%d},"
+                      "\"pictq_size\":%d,\"av_diff\":%.3f,\"frames_dropped\":%d,\"frames_skipped\":%d}\n",
+                summary->audioq_packets, summary->audioq_size, summary->videoq_packets, summary->videoq_size,
+                summary->pictq_size, summary->av_diff, summary->frames_dropped, summary->frames_skipped);
+    }
+    else
+    {
+        fprintf(file, "%.3f", summary->time);
+
+        for (int i = 0; i < PLAYER_STAGE_NB; i++)
+        {
+            PlayerStageStats * stage = &summary->stages[i];
+
+            fprintf(file, ",%d,%.3f,%.3f,%.3f,%.3f", stage->count, stage->mean, stage->p50, stage->p99, stage->max);
+        }
+
+        fprintf(file, ",%d,%d,%d,%d,%d,%.3f,%d,%d\n",
+                summary->audioq_packets, summary->audioq_size, summary->videoq_packets, summary->videoq_size,
+                summary->pictq_size, summary->av_diff, summary->frames_dropped, summary->frames_skipped);
+    }
+
+    fflush(file);
+}
+
+/**
+ * Draws the last stats summary over the video, in the top left corner of the
+ * window. Only ever called from the render thread, between the copy of the
+ * frame and the present.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void stats_overlay_draw(VideoState * videoState)
+{
+    PlayerIntervalStats summary;
+    char lines[PLAYER_STAGE_NB + PLAYER_MEMORY_NB + 7][64];
+    int nb_lines = 0;
+    int columns = 0;
+
+    SDL_AtomicLock(&videoState->stats_lock);
+    summary = videoState->stats_summary;
+    SDL_AtomicUnlock(&videoState->stats_lock);
+
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5s %7s %7s %7s", "MS", "N", "MEAN", "P99", "MAX");
+
+    for (int i = 0; i < PLAYER_STAGE_NB; i++)
+    {
+        PlayerStageStats * stage = &summary.stages[i];
+
+        snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5d %7.2f %7.2f %7.2f",
+                 STATS_NAMES[i], stage->count, stage->mean, stage->p99, stage->max);
+    }
+
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5d PKT %7d KB", "audioq", summary.audioq_packets, summary.audioq_size / 1024);
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5d PKT %7d KB", "videoq", summary.videoq_packets, summary.videoq_size / 1024);
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5d/%d", "pictq", summary.pictq_size, videoState->pictq_capacity);
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %+.1f MS", "av diff", summary.av_diff);
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %5d SKIPPED %d", "dropped", summary.frames_dropped, summary.frames_skipped);
+    snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %7s %7s %7s", "KB", "CUR", "PEAK", "MAX");
+
+    for (int i = 0; i < PLAYER_MEMORY_NB; i++)
+    {
+        MemoryArena * arena = &videoState->memory[i];
+
+        snprintf(lines[nb_lines++], sizeof(lines[0]), "%-8s %7d %7d %7d", MEMORY_ARENA_NAMES[i],
+                 SDL_AtomicGet(&arena->current) / 1024, SDL_AtomicGet(&arena->peak) / 1024, arena->limit / 1024);
+    }
+
+    for (int i = 0; i < nb_lines; i++)
+    {
+        columns = FFMAX(columns, (int)strlen(lines[i]));
+    }
+
+    // glyphs are 3x5 font pixels in a 4x6 cell
+    int cell_w = 4 * STATS_OVERLAY_SCALE;
+    int cell_h = 6 * STATS_OVERLAY_SCALE;
+
+    SDL_Rect background;
+    background.x = STATS_OVERLAY_MARGIN;
+    background.y = STATS_OVERLAY_MARGIN;
+    background.w = columns * cell_w + 2 * cell_w;
+    background.h = nb_lines * cell_h + cell_h;
+
+    // translucent background, white text
+    stats_overlay_fill(videoState, &background, 1, 0, 0, 0, 160);
+
+    for (int i = 0; i < nb_lines; i++)
+    {
+        stats_overlay_text(videoState, background.x + cell_w, background.y + cell_h / 2 + i * cell_h, lines[i]);
+    }
+}
+
+/**
+ * Draws the given text in white with the built-in 3x5 font, batching the lit
+ * font pixels in a single stats_overlay_fill() call.
+ *
+ * @param   videoState  the VideoState.
+ * @param   x           the text left edge, in screen pixels.
+ * @param   y           the text top edge, in screen pixels.
+ * @param   text        the text to be drawn, at most 64 characters are.
+ */
+static void stats_overlay_text(VideoState * videoState, int x, int y, const char * text)
+{
+    SDL_Rect rects[64 * 15];
+    int nb_rects = 0;
+
+    for (int i = 0; text[i] && i < 64; i++)
+    {
+        int glyph = stats_font_glyph(text[i]);
+
+        for (int row = 0; row < 5; row++)
+        {
+            int bits = (glyph >> (3 * (4 - row))) & 7;
+
+            for (int col = 0; col < 3; col++)
+            {
+                if (bits & (4 >> col))
+                {
+                    rects[nb_rects].x = x + (4 * i + col) * STATS_OVERLAY_SCALE;
+                    rects[nb_rects].y = y + row * STATS_OVERLAY_SCALE;
+                    rects[nb_rects].w = STATS_OVERLAY_SCALE;
+                    rects[nb_rects].h = STATS_OVERLAY_SCALE;
+                    nb_rects++;
+                }
+            }
+        }
+    }
+
+    stats_overlay_fill(videoState, rects, nb_rects, 255, 255, 255, 255);
+}
+
+/**
+ * Fills the given rectangles with the given color, blended over the frame, with
+ * the SDL_Renderer or the GLRenderer.
+ *
+ * @param   videoState  the VideoState.
+ * @param   rects       the rectangles, in screen pixels.
+ * @param   count       the number of rectangles.
+ * @param   r           the color red component.
+ * @param   g           the color green component.
+ * @param   b           the color blue component.
+ * @param   a           the color alpha component.
+ */
+static void stats_overlay_fill(VideoState * videoState, const SDL_Rect * rects, int count, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (videoState->gl)
+    {
+        gl_renderer_fill_rects(videoState->gl, rects, count, r, g, b, a);
+        return;
+    }
+
+    SDL_SetRenderDrawBlendMode(videoState->renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(videoState->renderer, r, g, b, a);
+    SDL_RenderFillRects(videoState->renderer, rects, count);
+
+    // restore the draw mode and color SDL_RenderClear() uses
+    SDL_SetRenderDrawBlendMode(videoState->renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(videoState->renderer, 0, 0, 0, 255);
+}
+
+/**
+ * Returns the 3x5 font glyph of the given character: 5 rows of 3 pixels, one
+ * octal digit per row from the top, the most significant bit on the left.
+ * Letters are drawn uppercase, unsupported characters blank.
+ *
+ * @param   c   the character.
+ *
+ * @return      the glyph bits.
+ */
+static int stats_font_glyph(char c)
+{
+    static const int digits[10] = {
+            075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717
+    };
+
+    static const int letters[26] = {
+            025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152,
+            055655, 044447, 057755, 065555, 025552, 065644, 025563, 065655, 034216, 072222,
+            055557, 055552, 055775, 055255, 055222, 071247
+    };
+
+    c = (char)toupper((unsigned char)c);
+
+    if (c >= '0' && c <= '9')
+    {
+        return digits[c - '0'];
+    }
+
+    if (c >= 'A' && c <= 'Z')
+    {
+        return letters[c - 'A'];
+    }
+
+    switch (c)
+    {
+        case '.': return 000002;
+        case ':': return 002020;
+        case '-': return 000700;
+        case '+': return 002720;
+        case '/': return 011244;
+        case '%': return 051245;
+        case '_': return 000007;
+        default:  return 0;
+    }
+}
+
+/**
+ * Retrieves the AVCodec and initializes the AVCodecContext for the given AVStream
+ * index. In case of AVMEDIA_TYPE_AUDIO codec type, it sets the desired audio specs,
+ * opens the audio device and starts playing.
+ *
+ * @param   videoState      the VideoState used to save info
+ *                          related to the media being played.
+ * @param   stream_index    the stream index obtained from the AVFormatContext.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+int stream_component_open(VideoState * videoState, int stream_index)
+{
+    // retrieve file I/O context
+    AVFormatContext * pFormatCtx = videoState->pFormatCtx;
+
+    // check the given stream index is valid
+    if (stream_index < 0 || stream_index >= pFormatCtx->nb_streams)
+    {
+        printf("Invalid stream index.");
+        return -1;
+    }
+
+    // retrieve codec for the given stream index
+    AVCodec * codec = NULL;
+    codec = avcodec_find_decoder(pFormatCtx->streams[stream_index]->codecpar->codec_id);
+    if (codec == NULL)
+    {
+        printf("Unsupported codec.\n");
+        return -1;
+    }
+
+    // retrieve codec context
+    AVCodecContext * codecCtx = NULL;
+    codecCtx = avcodec_alloc_context3(codec);
+    int ret = avcodec_parameters_to_context(codecCtx, pFormatCtx->streams[stream_index]->codecpar);
+    if (ret != 0)
+    {
+        printf("Could not copy codec context.\n");
+        return -1;
+    }
+
+    // in case of Audio codec, set up and open the audio device
+    if (codecCtx->codec_type == AVMEDIA_TYPE_AUDIO)
+    {
+        // desired and obtained audio specs references
+        SDL_AudioSpec wanted_specs;
+        SDL_AudioSpec specs;
+
+        // Set audio settings from codec info
+        wanted_specs.freq = codecCtx->sample_rate;
+        wanted_specs.format = AUDIO_S16SYS;
+        wanted_specs.channels = av_get_channel_layout_nb_channels(audio_output_layout(codecCtx->channels));
+        wanted_specs.silence = 0;
+        wanted_specs.samples = videoState->audio_buffer_samples;
+        wanted_specs.callback = audio_callback;
+        wanted_specs.userdata = videoState;
+
+        // derive the buffer size from the sample rate if requested
+        if (wanted_specs.samples == AUDIO_BUFFER_AUTO)
+        {
+            wanted_specs.samples = 2 << av_log2(codecCtx->sample_rate / AUDIO_MAX_CALLBACKS_PER_SEC);
+            if (wanted_specs.samples < AUDIO_BUFFER_LOW_LATENCY)
+            {
+                wanted_specs.samples = AUDIO_BUFFER_LOW_LATENCY;
+            }
+        }
+
+        if (videoState->replay)
+        {
+            // the simulated audio sink of player_replay() gets what it asks for
+            specs = wanted_specs;
+            specs.size = wanted_specs.samples * 2 * wanted_specs.channels;
+        }
+        else
+        {
+            // open the default audio device, the obtained buffer size may differ
+            videoState->audio_dev = SDL_OpenAudioDevice(NULL, 0, &wanted_specs, &specs, 0);
+
+            // check audio device was correctly opened
+            if (videoState->audio_dev == 0)
+            {
+                printf("SDL_OpenAudioDevice: %s.\n", SDL_GetError());
+                return -1;
+            }
+        }
+
+        // keep the actual device buffer size, used to estimate its latency
+        videoState->audio_buffer_samples = specs.samples;
+        videoState->audio_hw_buf_size = specs.size;
+
+        if (_DEBUG_)
+            printf("Audio device buffer: %d samples (%d bytes).\n", specs.samples, specs.size);
+    }
+
+    // in case of Video codec, set up the decoder threading: libavcodec only
+    // honors these before the codec is opened, and falls back to a single
+    // thread if the decoder supports neither frame nor slice threading
+    if (codecCtx->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        // --threads=auto: the share of the decoder threads budget of this player
+        // among all of the players currently opened, instead of one thread per
+        // core for each of them, given back once the player is closed
+        if (videoState->video_decoder_threads > 0)
+        {
+            codecCtx->thread_count = videoState->video_decoder_threads;
+        }
+        else
+        {
+            videoState->video_decoder_threads_taken = scheduler_decoder_threads_acquire(videoState->priority);
+            codecCtx->thread_count = videoState->video_decoder_threads_taken;
+        }
+        codecCtx->thread_type = videoState->video_decoder_thread_type;
+
+        // try to set up a hardware decoding device, software decoding is used
+        // if none of the requested devices supports this codec
+        if (videoState->hw_device_type != AV_HWDEVICE_TYPE_NONE)
+        {
+            if (hw_decoder_init(videoState, codec, codecCtx) < 0)
+            {
+                printf("Hardware decoding not available, using software decoding.\n");
+            }
+        }
+    }
+
+    // initialize the AVCodecContext to use the given AVCodec
+    if (avcodec_open2(codecCtx, codec, NULL) < 0)
+    {
+        printf("Unsupported codec.\n");
+        return -1;
+    }
+
+    // set up the VideoState based on the type of the codec obtained for
+    // the given stream index
+    switch (codecCtx->codec_type)
+    {
+        case AVMEDIA_TYPE_AUDIO:
+        {
+            // set VideoState audio related fields
+            videoState->audioStream = stream_index;
+            videoState->audio_st = pFormatCtx->streams[stream_index];
+            videoState->audio_ctx = codecCtx;
+
+            // allocate the AVPacket and AVFrame used by audio_decode_frame() for
+            // the whole playback
+            videoState->audio_pkt = av_packet_alloc();
+            videoState->audio_frame = av_frame_alloc();
+            if (!videoState->audio_pkt || !videoState->audio_frame)
+            {
+                printf("Could not allocate audio AVPacket and AVFrame.\n");
+                return -1;
+            }
+
+            // init audio packet queue
+            MemoryArena * audioq_arena = &videoState->memory[PLAYER_MEMORY_AUDIOQ];
+            packet_queue_init(&videoState->audioq, videoState, &videoState->audio_task, audioq_arena);
+            videoState->audioq.max_size = packet_queue_max_size(videoState, videoState->audio_st, MAX_AUDIOQ_SIZE, audioq_arena);
+            videoState->audioq.time_base = videoState->audio_st->time_base;
+
+            // init the averaging filter used by synchronize_audio()
+            videoState->audio_diff_avg_coef = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
+            videoState->audio_diff_avg_count = 0;
+            videoState->audio_diff_threshold = 2.0 * videoState->audio_buffer_samples / codecCtx->sample_rate;
+
+            // create the audio resampler once for the whole playback, the
+            // SwrContext is rebuilt only if the input audio format changes
+            videoState->audio_resampler = getAudioResampling(codecCtx, AV_SAMPLE_FMT_S16);
+            if (!videoState->audio_resampler)
+            {
+                printf("Could not allocate audio resampler.\n");
+                return -1;
+            }
+            videoState->audio_resampler->arena = &videoState->memory[PLAYER_MEMORY_AUDIO];
+
+            // allocate the decoded audio ring: a power of 2 bytes holding at
+            // least AUDIO_RING_DURATION seconds and a few device buffers
+            int bytes_per_sec = codecCtx->sample_rate * 2 * videoState->audio_resampler->out_nb_channels;
+            int ring_size = FFMAX((int)(AUDIO_RING_DURATION * bytes_per_sec), 4 * videoState->audio_hw_buf_size);
+            videoState->audio_ring.capacity = 1 << (av_log2(ring_size - 1) + 1);
+            videoState->audio_ring.data = av_mallocz(videoState->audio_ring.capacity);
+            if (!videoState->audio_ring.data)
+            {
+                printf("Could not allocate audio ring.\n");
+                return -1;
+            }
+            memory_arena_charge(&videoState->memory[PLAYER_MEMORY_AUDIO], videoState->audio_ring.capacity);
+
+            // the replay runs the audio decoding and the audio sink itself
+            if (videoState->replay)
+            {
+                break;
+            }
+
+            // start the audio decoding task, it fills the audio ring
+            scheduler_task_init(&videoState->audio_task, audio_decode_step, videoState, videoState->priority);
+            scheduler_task_wake(&videoState->audio_task);
+
+            // start playing audio on the opened audio device
+            SDL_PauseAudioDevice(videoState->audio_dev, 0);
+        }
+            break;
+
+        case AVMEDIA_TYPE_VIDEO:
+        {
+            // set VideoState video related fields
+            videoState->videoStream = stream_index;
+            videoState->video_st = pFormatCtx->streams[stream_index];
+            videoState->video_ctx = codecCtx;
+
+            // allocate the AVPacket and AVFrame used by video_decode_step() for
+            // the whole playback
+            videoState->video_pkt = av_packet_alloc();
+            videoState->video_frame = av_frame_alloc();
+            if (!videoState->video_pkt || !videoState->video_frame)
+            {
+                printf("Could not allocate video AVPacket and AVFrame.\n");
+                return -1;
+            }
+
+            // frame threading keeps up to thread_count - 1 frames in flight
+            // inside the decoder: each frame still carries the pts and pkt_dts
+            // of its own packet, the frames are only handed back later. That
+            // latency is absorbed by the VideoPicture queue, the timestamps
+            // need no correction.
+            if (_DEBUG_)
+            {
+                printf("Video decoder threads: %d (%s).\n",
+                       codecCtx->thread_count,
+                       (codecCtx->active_thread_type & FF_THREAD_FRAME) ? "frame" :
+                       (codecCtx->active_thread_type & FF_THREAD_SLICE) ? "slice" : "none");
+            }
+
+            // Don't forget to initialize the frame timer and the initial
+            // previous frame delay: 1ms = 1e-6s
+            videoState->frame_timer = get_monotonic_time(videoState);
+            videoState->frame_last_delay = 40e-3;
+            videoState->video_current_pts_time = videoState->clock(videoState);
+
+            // init video packet queue
+            MemoryArena * videoq_arena = &videoState->memory[PLAYER_MEMORY_VIDEOQ];
+            packet_queue_init(&videoState->videoq, videoState, &videoState->video_task, videoq_arena);
+            videoState->videoq.max_size = packet_queue_max_size(videoState, videoState->video_st, MAX_VIDEOQ_SIZE, videoq_arena);
+            videoState->videoq.time_base = videoState->video_st->time_base;
+
+            // create the window, unless it must be created on the main thread
+            // by player_render(). The replay shows no frames
+            if (!videoState->replay && !RENDER_ON_MAIN_THREAD && window_open(videoState) < 0)
+            {
+                return -1;
+            }
+
+            // the textures are created by the render thread, in the decoder
+            // output format if it can be uploaded as is: video_upload()
+            // recreates them if the frames turn out to come in another format
+            Uint32 texture_format = get_texture_format(codecCtx->pix_fmt);
+            if (texture_format == SDL_PIXELFORMAT_UNKNOWN || videoState->hw_pix_fmt != AV_PIX_FMT_NONE)
+            {
+                texture_format = SDL_PIXELFORMAT_YV12;
+            }
+
+            videoState->texture_formats[0] = texture_format;
+            videoState->texture_formats[1] = texture_format;
+
+            // the VideoPicture pool keeps as many pictures as its arena holds,
+            // at least one: each picture is charged its YUV420P buffer, or the
+            // buffers of the decoded frame it references if direct (see
+            // queue_picture()), of about the same size
+            int picture_size = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, codecCtx->width, codecCtx->height, VIDEO_PICTURE_ALIGN);
+            int max_pictures = FFMAX(videoState->memory[PLAYER_MEMORY_PICTURES].limit / FFMAX(picture_size + VIDEO_PICTURE_ALIGN - 1, 1), 1);
+            if (videoState->pictq_capacity > max_pictures)
+            {
+                printf("Picture queue size reduced to %d to fit the memory budget.\n", max_pictures);
+
+                SDL_LockMutex(videoState->pictq_mutex);
+                videoState->pictq_capacity = max_pictures;
+                SDL_UnlockMutex(videoState->pictq_mutex);
+            }
+
+            // pre-allocate the VideoPicture frames pool, reused for the whole
+            // playback. The converted frames buffers are only needed if the
+            // decoded frames can not be uploaded directly to the texture.
+            for (int i = 0; i < videoState->pictq_capacity; i++)
+            {
+                videoState->pictq[i].src_frame = av_frame_alloc();
+                if (!videoState->pictq[i].src_frame)
+                {
+                    printf("Could not allocate frame.\n");
+                    return -1;
+                }
+
+                if (!is_direct_format(videoState, codecCtx->pix_fmt) && videoState->hw_pix_fmt == AV_PIX_FMT_NONE)
+                {
+                    if (alloc_picture(videoState, &videoState->pictq[i]) < 0)
+                    {
+                        return -1;
+                    }
+                }
+            }
+
+            // the replay runs the video decoding and the presentation itself
+            if (videoState->replay)
+            {
+                break;
+            }
+
+            // start the render thread, it owns the SDL_Renderer, or let the
+            // main thread render from now on
+            if (RENDER_ON_MAIN_THREAD)
+            {
+                SDL_LockMutex(videoState->pictq_mutex);
+                SDL_AtomicSet(&videoState->render_started, 1);
+                render_wake(videoState);
+                SDL_UnlockMutex(videoState->pictq_mutex);
+            }
+            else
+            {
+                videoState->render_tid = SDL_CreateThread(render_thread, "Render Thread", videoState);
+            }
+
+            // start the video decoding task, once everything it uses is set up
+            scheduler_task_init(&videoState->video_task, video_decode_step, videoState, videoState->priority);
+            scheduler_task_wake(&videoState->video_task);
+        }
+            break;
+
+        default:
+        {
+            // nothing to do
+        }
+            break;
+    }
+
+    return 0;
+}
+
+/**
+ * Hardware device types tried, in order, when --hwaccel=auto is used.
+ */
+static const enum AVHWDeviceType HW_DEVICE_TYPES_AUTO[] = {
+#if defined(__APPLE__)
+        AV_HWDEVICE_TYPE_VIDEOTOOLBOX,
+#else
+        AV_HWDEVICE_TYPE_VAAPI,
+        AV_HWDEVICE_TYPE_CUDA,
+#endif
+        AV_HWDEVICE_TYPE_NONE
+};
+
+/**
+ * Looks for a hardware configuration of the given AVCodec using the given
+ * hardware device type through an AVHWDeviceContext.
+ *
+ * @param   codec   the video AVCodec.
+ * @param   type    the hardware device type.
+ *
+ * @return          the pixel format of the hardware surfaces, AV_PIX_FMT_NONE
+ *                  if the decoder does not support the device type.
+ */
+static enum AVPixelFormat find_hw_pix_fmt(AVCodec * codec, enum AVHWDeviceType type)
+{
+    for (int i = 0;; i++)
+    {
+        const AVCodecHWConfig * config = avcodec_get_hw_config(codec, i);
+        if (!config)
+        {
+            return AV_PIX_FMT_NONE;
+        }
+
+        if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type)
+        {
+            return config->pix_fmt;
+        }
+    }
+}
+
+/**
+ * Sets up hardware accelerated decoding for the given video AVCodecContext. It
+ * must be called before avcodec_open2(). Either the device type requested in
+ * VideoState->hw_device_type or, in case of HW_DEVICE_TYPE_AUTO, the first of
+ * HW_DEVICE_TYPES_AUTO that supports the codec and can be opened is used.
+ *
+ * Decoded frames are then hardware surfaces of format VideoState->hw_pix_fmt,
+ * they are only downloaded to system memory in queue_picture(). The codec
+ * still falls back to software decoding, through get_hw_format(), if the
+ * stream profile turns out not to be supported by the device.
+ *
+ * @param   videoState  the VideoState.
+ * @param   codec       the video AVCodec.
+ * @param   codecCtx    the video AVCodecContext, not yet opened.
+ *
+ * @return              < 0 if no hardware device could be used, 0 otherwise.
+ */
+static int hw_decoder_init(VideoState * videoState, AVCodec * codec, AVCodecContext * codecCtx)
+{
+    enum AVHWDeviceType requested[2] = { videoState->hw_device_type, AV_HWDEVICE_TYPE_NONE };
+    const enum AVHWDeviceType * types = requested;
+
+    if (videoState->hw_device_type == HW_DEVICE_TYPE_AUTO)
+    {
+        types = HW_DEVICE_TYPES_AUTO;
+    }
+
+    for (; *types != AV_HWDEVICE_TYPE_NONE; types++)
+    {
+        // check the decoder can output surfaces of this device type
+        enum AVPixelFormat hw_pix_fmt = find_hw_pix_fmt(codec, *types);
+        if (hw_pix_fmt == AV_PIX_FMT_NONE)
+        {
+            if (_DEBUG_)
+                printf("%s does not support %s decoding.\n", codec->name, av_hwdevice_get_type_name(*types));
+            continue;
+        }
+
+        // open the default device of this type
+        int ret = av_hwdevice_ctx_create(&videoState->hw_device_ctx, *types, NULL, NULL, 0);
+        if (ret < 0)
+        {
+            if (_DEBUG_)
+                printf("Could not open %s device.\n", av_hwdevice_get_type_name(*types));
+            continue;
+        }
+
+        // the decoder keeps its own reference to the device
+        codecCtx->hw_device_ctx = av_buffer_ref(videoState->hw_device_ctx);
+        codecCtx->opaque = videoState;
+        codecCtx->get_format = get_hw_format;
+        videoState->hw_pix_fmt = hw_pix_fmt;
+
+        if (_DEBUG_)
+            printf("Using %s hardware decoding.\n", av_hwdevice_get_type_name(*types));
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * AVCodecContext.get_format callback: picks the hardware surfaces format set up
+ * by hw_decoder_init() when the decoder offers it. libavcodec removes it from
+ * the given list and calls this function again if the hardware decoder could
+ * not be initialized for the stream (e.g. unsupported profile), in which case
+ * the first software format is returned and decoding goes on in software.
+ *
+ * @param   codecCtx    the video AVCodecContext.
+ * @param   pix_fmts    the formats the decoder can output, AV_PIX_FMT_NONE
+ *                      terminated.
+ *
+ * @return              the selected pixel format.
+ */
+static enum AVPixelFormat get_hw_format(AVCodecContext * codecCtx, const enum AVPixelFormat * pix_fmts)
+{
+    VideoState * videoState = codecCtx->opaque;
+    const enum AVPixelFormat * p;
+
+    for (p = pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+    {
+        if (*p == videoState->hw_pix_fmt)
+        {
+            return *p;
+        }
+    }
+
+    printf("Hardware surfaces not available for this stream, falling back to software decoding.\n");
+    videoState->hw_pix_fmt = AV_PIX_FMT_NONE;
+
+    // return the first format which is not a hardware one
+    for (p = pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+    {
+        const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(*p);
+        if (!(desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+        {
+            return *p;
+        }
+    }
+
+    return AV_PIX_FMT_NONE;
+}
+
+/**
+ * Maps the given decoded frames pixel format to an SDL texture format the frame
+ * planes can be uploaded to without any conversion.
+ *
+ * @param   pix_fmt the decoded AVFrame pixel format.
+ *
+ * @return          the matching SDL pixel format, SDL_PIXELFORMAT_UNKNOWN if the
+ *                  frame has to be converted with sws_scale() first.
+ */
+static Uint32 get_texture_format(enum AVPixelFormat pix_fmt)
+{
+    switch (pix_fmt)
+    {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        {
+            return SDL_PIXELFORMAT_IYUV;
+        }
+
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+        case AV_PIX_FMT_NV12:
+        {
+            return SDL_PIXELFORMAT_NV12;
+        }
+#endif
+
+        default:
+        {
+            return SDL_PIXELFORMAT_UNKNOWN;
+        }
+    }
+}
+
+/**
+ * Sets up the given AVFrame to receive the download of the given hardware
+ * surface: its planes are laid out in a buffer of the VideoState download
+ * pool, in the software format of the surfaces. The pool is recreated if the
+ * size of the downloaded frames changes.
+ *
+ * @param   videoState  the VideoState.
+ * @param   frame       the blank AVFrame the surface is downloaded to.
+ * @param   hwFrame     the decoded hardware surface.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int hw_download_get_buffer(VideoState * videoState, AVFrame * frame, const AVFrame * hwFrame)
+{
+    if (!hwFrame->hw_frames_ctx)
+    {
+        return -1;
+    }
+
+    AVHWFramesContext * framesCtx = (AVHWFramesContext *)hwFrame->hw_frames_ctx->data;
+    int size = av_image_get_buffer_size(framesCtx->sw_format, hwFrame->width, hwFrame->height, VIDEO_PICTURE_ALIGN);
+    if (size < 0)
+    {
+        return -1;
+    }
+
+    // the buffers still referenced by the queued pictures keep the previous
+    // pool alive until they are released
+    if (!videoState->hw_download_pool || videoState->hw_download_size != size)
+    {
+        av_buffer_pool_uninit(&videoState->hw_download_pool);
+
+        videoState->hw_download_pool = av_buffer_pool_init(size, NULL);
+        if (!videoState->hw_download_pool)
+        {
+            return -1;
+        }
+        videoState->hw_download_size = size;
+    }
+
+    frame->buf[0] = av_buffer_pool_get(videoState->hw_download_pool);
+    if (!frame->buf[0])
+    {
+        return -1;
+    }
+
+    frame->format = framesCtx->sw_format;
+    frame->width = hwFrame->width;
+    frame->height = hwFrame->height;
+
+    if (av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data,
+                             frame->format, frame->width, frame->height, VIDEO_PICTURE_ALIGN) < 0)
+    {
+        av_frame_unref(frame);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns whether the decoded frames of the given pixel format can be uploaded
+ * by the renderer of the given VideoState without any conversion: see
+ * get_texture_format() and gl_renderer_supported().
+ *
+ * @param   videoState  the VideoState.
+ * @param   pix_fmt     the decoded AVFrame pixel format.
+ *
+ * @return              != 0 if the frames are uploaded as they are, 0 if they
+ *                      have to be converted with sws_scale() first.
+ */
+static int is_direct_format(VideoState * videoState, enum AVPixelFormat pix_fmt)
+{
+    // player_bench() times the conversion of every frame
+    if (videoState->convert_all)
+    {
+        return 0;
+    }
+
+    if (videoState->renderer_type == PLAYER_RENDERER_GL)
+    {
+        return gl_renderer_supported(pix_fmt);
+    }
+
+    return get_texture_format(pix_fmt) != SDL_PIXELFORMAT_UNKNOWN;
+}
+
+/**
+ * Allocates the AVFrame and the image data buffer of the given VideoPicture for
+ * the current video resolution. The buffer and every plane line are aligned to
+ * VIDEO_PICTURE_ALIGN bytes.
+ * Nothing is done if the VideoPicture is already allocated with the same
+ * resolution, so the frames of the pool are only reallocated when the video
+ * resolution actually changes. It is only called from the decoding side
+ * (stream_component_open() and the video decoding task), never while rendering.
+ *
+ * @param   videoState      the VideoState.
+ * @param   videoPicture    the VideoPicture to be (re)allocated.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+int alloc_picture(VideoState * videoState, VideoPicture * videoPicture)
+{
+    int width = videoState->video_ctx->width;
+    int height = videoState->video_ctx->height;
+
+    // check if the VideoPicture is already allocated for the current resolution
+    if (videoPicture->frame && videoPicture->allocated &&
+        videoPicture->width == width && videoPicture->height == height)
+    {
+        return 0;
+    }
+
+    // release the image data buffer allocated for the previous resolution
+    av_freep(&videoPicture->buffer);
+    memory_arena_release(&videoState->memory[PLAYER_MEMORY_PICTURES], videoPicture->buffer_size);
+    videoPicture->buffer_size = 0;
+    videoPicture->allocated = 0;
+
+    // alloc the AVFrame later used to contain the scaled frame, once
+    if (!videoPicture->frame)
+    {
+        videoPicture->frame = av_frame_alloc();
+        if (videoPicture->frame == NULL)
+        {
+            printf("Could not allocate frame.\n");
+            return -1;
+        }
+    }
+
+    // get the size in bytes required to store an image with the given parameters
+    int numBytes;
+    numBytes = av_image_get_buffer_size(
+            AV_PIX_FMT_YUV420P,
+            width,
+            height,
+            VIDEO_PICTURE_ALIGN
+    );
+
+    // allocate image data buffer, with room to align its start
+    videoPicture->buffer = (uint8_t *) av_malloc((numBytes + VIDEO_PICTURE_ALIGN - 1) * sizeof(uint8_t));
+    if (videoPicture->buffer == NULL)
+    {
+        printf("Could not allocate picture buffer.\n");
+        return -1;
+    }
+
+    // drawn from the pictures arena
+    videoPicture->buffer_size = numBytes + VIDEO_PICTURE_ALIGN - 1;
+    memory_arena_charge(&videoState->memory[PLAYER_MEMORY_PICTURES], videoPicture->buffer_size);
+
+    uint8_t * buffer = (uint8_t *)(((uintptr_t)videoPicture->buffer + VIDEO_PICTURE_ALIGN - 1) & ~(uintptr_t)(VIDEO_PICTURE_ALIGN - 1));
+
+    // The fields of the given image are filled in by using the buffer which points to the image data buffer.
+    av_image_fill_arrays(
+            videoPicture->frame->data,
+            videoPicture->frame->linesize,
+            buffer,
+            AV_PIX_FMT_YUV420P,
+            width,
+            height,
+            VIDEO_PICTURE_ALIGN
+    );
+
+    // update VideoPicture struct fields
+    videoPicture->width = width;
+    videoPicture->height = height;
+    videoPicture->allocated = 1;
+
+    return 0;
+}
+
+/**
+ * Writes the given decoded AVFrame in the VideoPicture queue, the caller made
+ * sure it has room for it. Frames the renderer can upload as they are (see
+ * is_direct_format()) are only referenced, their buffers are moved out of the
+ * given AVFrame. Any other frame is converted with sws_scale() to YUV420P into
+ * the pooled frame, which is reallocated in case it has a different width/height.
+ *
+ * @param   videoState  the VideoState.
+ * @param   pFrame      AVFrame to be inserted in the VideoState->pictq, it is
+ *                      left blank on return.
+ *
+ * @return              < 0 in case the quit flag is set, 0 otherwise.
+ */
+int queue_picture(VideoState * videoState, AVFrame * pFrame, double pts)
+{
+    // check quit flag
+    if (videoState->quit)
+    {
+        return -1;
+    }
+
+    // retrieve video picture using the queue write index
+    VideoPicture * videoPicture;
+    videoPicture = &videoState->pictq[videoState->pictq_windex];
+
+    // release the decoded frame this VideoPicture was still referencing
+    av_frame_unref(videoPicture->src_frame);
+    memory_arena_release(&videoState->memory[PLAYER_MEMORY_PICTURES], videoPicture->src_frame_size);
+    videoPicture->src_frame_size = 0;
+
+    if (pFrame->format == videoState->hw_pix_fmt && videoState->hw_pix_fmt != AV_PIX_FMT_NONE)
+    {
+        // hardware surfaces stay on the GPU for the whole decoding, they are
+        // downloaded to system memory only here, for the upload to the texture,
+        // into a buffer of the download pool: the buffers the previous
+        // downloads released are reused instead of allocating one per frame
+        if (hw_download_get_buffer(videoState, videoPicture->src_frame, pFrame) < 0)
+        {
+            printf("Could not allocate the hardware frame download buffer.\n");
+            return -1;
+        }
+
+        if (av_hwframe_transfer_data(videoPicture->src_frame, pFrame, 0) < 0)
+        {
+            printf("Error transferring the frame from the hardware surface.\n");
+            return -1;
+        }
+
+        av_frame_copy_props(videoPicture->src_frame, pFrame);
+    }
+    else
+    {
+        // take over the decoded frame buffers, no copy involved
+        av_frame_move_ref(videoPicture->src_frame, pFrame);
+    }
+
+    // set pts value for the last decode frame in the VideoPicture queu (pctq)
+    videoPicture->pts = pts;
+    videoPicture->dropped = 0;
+
+    // the decoded frame planes can be uploaded as they are, sws_scale() is only
+    // needed when an actual pixel format conversion is required
+    videoPicture->direct = is_direct_format(videoState, videoPicture->src_frame->format) &&
+                           videoPicture->src_frame->width == videoState->video_ctx->width &&
+                           videoPicture->src_frame->height == videoState->video_ctx->height;
+
+    // a direct picture holds the decoded frame buffers until it is reused:
+    // they are drawn from the pictures arena in place of the YUV420P buffer
+    if (videoPicture->direct)
+    {
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && videoPicture->src_frame->buf[i]; i++)
+        {
+            videoPicture->src_frame_size += (int)videoPicture->src_frame->buf[i]->size;
+        }
+
+        memory_arena_charge(&videoState->memory[PLAYER_MEMORY_PICTURES], videoPicture->src_frame_size);
+    }
+
+    if (!videoPicture->direct)
+    {
+        AVFrame * srcFrame = videoPicture->src_frame;
+
+        // reallocate the pooled frame only if the video resolution has changed
+        if (alloc_picture(videoState, videoPicture) < 0)
+        {
+            return -1;
+        }
+
+        // set VideoPicture AVFrame info using the last decoded frame
+        videoPicture->frame->pict_type = srcFrame->pict_type;
+        videoPicture->frame->pts = srcFrame->pts;
+        videoPicture->frame->pkt_dts = srcFrame->pkt_dts;
+        videoPicture->frame->key_frame = srcFrame->key_frame;
+        videoPicture->frame->coded_picture_number = srcFrame->coded_picture_number;
+        videoPicture->frame->display_picture_number = srcFrame->display_picture_number;
+        videoPicture->frame->width = videoState->video_ctx->width;
+        videoPicture->frame->height = videoState->video_ctx->height;
+        videoPicture->frame->format = AV_PIX_FMT_YUV420P;
+
+        // scale the image in srcFrame->data and put the resulting scaled image in
+        // frame->data, in bands converted in parallel: the conversion contexts
+        // are only rebuilt if the decoded frames format or resolution changes
+        int64_t scale_start = av_gettime_relative();
+        if (slice_scaler_scale(&videoState->scaler, srcFrame, videoPicture->frame) < 0)
+        {
+            return -1;
+        }
+        stats_record(&videoState->stats[PLAYER_STAGE_SCALE], scale_start);
+
+        // the converted copy is all video_display() needs
+        av_frame_unref(srcFrame);
+    }
+
+    // update VideoPicture queue write index
+    ++videoState->pictq_windex;
+
+    // if the write index has reached the VideoPicture queue size
+    if(videoState->pictq_windex == videoState->pictq_capacity)
+    {
+        // set it to 0
+        videoState->pictq_windex = 0;
+    }
+
+    // lock VideoPicture queue
+    SDL_LockMutex(videoState->pictq_mutex);
+
+    // increase VideoPicture queue size
+    videoState->pictq_size++;
+
+    // let the render thread upload the new picture ahead of its display time,
+    // and the presentation thread schedule it
+    render_wake(videoState);
+
+    // unlock VideoPicture queue
+    SDL_UnlockMutex(videoState->pictq_mutex);
+
+    return 0;
+}
+
+/**
+ * Step function of the video decoding SchedulerTask.
+ *
+ * Reads in packets from the video queue, packet_queue_get(), decodes the video
+ * packets into a frame, and then calls the queue_picture() function to convert
+ * and put the processed frame into the picture queue. Each step sends up to
+ * VIDEO_TASK_QUANTUM packets to the decoder. The task parks when the video queue
+ * is empty, woken up by packet_queue_put(), or when the picture queue is full,
+ * woken up by the render thread: the decoded frame is then kept in video_frame
+ * until there is room for it.
+ *
+ * @param   arg the VideoState.
+ *
+ * @return      a SCHEDULER_TASK_* value.
+ */
+int video_decode_step(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+
+    // the AVPacket used to retrieve data from the videoq and the AVFrame used
+    // to decode video packets are owned by the VideoState for the whole
+    // playback, they are only unreferenced between uses
+    AVPacket * packet = videoState->video_pkt;
+    AVFrame * pFrame = videoState->video_frame;
+
+    int ret;
+
+    for (int i = 0; i < VIDEO_TASK_QUANTUM;)
+    {
+        // check quit flag
+        if (videoState->quit)
+        {
+            goto done;
+        }
+
+        // a decoded frame is waiting for room in the VideoPicture queue
+        if (videoState->video_frame_pending)
+        {
+            SDL_LockMutex(videoState->pictq_mutex);
+            int full = videoState->pictq_size >= videoState->pictq_capacity;
+            SDL_UnlockMutex(videoState->pictq_mutex);
+
+            // the render thread wakes us up once it releases a VideoPicture
+            if (full)
+            {
+                return SCHEDULER_TASK_PARK;
+            }
+
+            videoState->video_frame_pending = 0;
+
+            if (queue_picture(videoState, pFrame, videoState->video_frame_pts) < 0)
+            {
+                goto done;
+            }
+
+            continue;
+        }
+
+        // get the decoded output data from the decoder, until it needs a new packet
+        if (videoState->video_receiving)
+        {
+            int64_t decode_start = av_gettime_relative();
+            ret = avcodec_receive_frame(videoState->video_ctx, pFrame);
+            videoState->video_decode_time += av_gettime_relative() - decode_start;
+
+            // check an entire frame was decoded
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            {
+                videoState->video_receiving = 0;
+                continue;
+            }
+            else if (ret < 0)
+            {
+                printf("Error while decoding.\n");
+                goto done;
+            }
+
+            stats_record_value(&videoState->stats[PLAYER_STAGE_VIDEO_DECODE], videoState->video_decode_time);
+            videoState->video_decode_time = 0;
+
+            // attempt to guess proper monotonic timestamps for decoded video frames
+            double pts = guess_correct_pts(videoState->video_ctx, pFrame->pts, pFrame->pkt_dts);
+
+            // in case we get an undefined timestamp value
+            if (pts == AV_NOPTS_VALUE)
+            {
+                // set pts to the default value of 0
+                pts = 0;
+            }
+
+            pts *= av_q2d(videoState->video_st->time_base);
+
+            // accurate seek: the frames before the seek target are only decoded,
+            // they are neither converted nor displayed
+            if (videoState->video_seek_pending)
+            {
+                if (pts < videoState->seek_target_time)
+                {
+                    av_frame_unref(pFrame);
+                    continue;
+                }
+
+                videoState->video_seek_pending = 0;
+            }
+
+            pts = synchronize_video(videoState, pFrame, pts);
+
+            // the frame would be dropped from the VideoPicture queue anyway:
+            // save its conversion and upload
+            if (video_frame_is_late(videoState, pts))
+            {
+                SDL_AtomicAdd(&videoState->frames_skipped, 1);
+                replay_trace(videoState, pts, PLAYER_TRACE_SKIPPED);
+                av_frame_unref(pFrame);
+                continue;
+            }
+
+            // queued as soon as the VideoPicture queue has room
+            videoState->video_frame_pending = 1;
+            videoState->video_frame_pts = pts;
+
+            continue;
+        }
+
+        // get a packet from the video PacketQueue, packet_queue_put() wakes us
+        // up if it is empty
+        int serial;
+        ret = packet_queue_get(&videoState->videoq, packet, 0, &serial);
+        if (ret < 0)
+        {
+            // means we quit getting packets
+            goto done;
+        }
+        else if (ret == 0)
+        {
+            // the replayed input is over: drain the frames the decoder still
+            // buffers, so that they are traced too, then the task is done
+            if (videoState->replay && videoState->replay_demux_done)
+            {
+                if (videoState->video_draining)
+                {
+                    goto done;
+                }
+
+                videoState->video_draining = 1;
+
+                if (avcodec_send_packet(videoState->video_ctx, NULL) < 0)
+                {
+                    printf("Error flushing the video decoder.\n");
+                    goto done;
+                }
+
+                videoState->video_receiving = 1;
+                continue;
+            }
+
+            return SCHEDULER_TASK_PARK;
+        }
+
+        // a seek flushed the queue: drop the frames and references held by the decoder
+        if (serial != videoState->video_pkt_serial)
+        {
+            avcodec_flush_buffers(videoState->video_ctx);
+            videoState->video_pkt_serial = serial;
+            videoState->video_seek_pending = videoState->accurate_seek;
+        }
+
+        // give the decoder raw compressed data in an AVPacket
+        int64_t decode_start = av_gettime_relative();
+        ret = avcodec_send_packet(videoState->video_ctx, packet);
+        videoState->video_decode_time += av_gettime_relative() - decode_start;
+
+        // wipe the packet
+        av_packet_unref(packet);
+
+        if (ret < 0)
+        {
+            printf("Error sending packet for decoding.\n");
+            goto done;
+        }
+
+        videoState->video_receiving = 1;
+        i++;
+    }
+
+    // let the tasks of the other players run
+    return SCHEDULER_TASK_YIELD;
+
+    // quit or decoding error: the task is done
+    done:
+    {
+        // wipe the frame, it is freed with the VideoState
+        av_frame_unref(pFrame);
+
+        return SCHEDULER_TASK_DONE;
+    };
+}
+
+/**
+ * Attempts to guess proper monotonic timestamps for decoded video frames which
+ * might have incorrect times.
+ *
+ * Input timestamps may wrap around, in which case the output will as well.
+ *
+ * @param   ctx             the video AVCodecContext.
+ * @param   reordered_pts   the pts field of the decoded AVPacket, as passed
+ *                          through AVFrame.pts.
+ * @param   dts             the pkt_dts field of the decoded AVPacket.
+ *
+ * @return                  one of the input values, may be AV_NOPTS_VALUE.
+ */
+static int64_t guess_correct_pts(AVCodecContext * ctx, int64_t reordered_pts, int64_t dts)
+{
+    int64_t pts;
+
+    if (dts != AV_NOPTS_VALUE)
+    {
+        ctx->pts_correction_num_faulty_dts += dts <= ctx->pts_correction_last_dts;
+        ctx->pts_correction_last_dts = dts;
+    }
+    else if (reordered_pts != AV_NOPTS_VALUE)
+    {
+        ctx->pts_correction_last_dts = reordered_pts;
+    }
+
+    if (reordered_pts != AV_NOPTS_VALUE)
+    {
+        ctx->pts_correction_num_faulty_pts += reordered_pts <= ctx->pts_correction_last_pts;
+        ctx->pts_correction_last_pts = reordered_pts;
+    }
+    else if (dts != AV_NOPTS_VALUE)
+    {
+        ctx->pts_correction_last_pts = dts;
+    }
+
+    if ((ctx->pts_correction_num_faulty_pts <= ctx->pts_correction_num_faulty_dts || dts == AV_NOPTS_VALUE) && reordered_pts != AV_NOPTS_VALUE)
+    {
+        pts = reordered_pts;
+    }
+    else
+    {
+        pts = dts;
+    }
+
+    return pts;
+}
+
+/**
+ * Updates the PTS of the last decoded video frame to be in sync with everything.
+ * This function will also deal with cases where we don't get a PTS value
+ * for our frame. At the same time we need to keep track of when the next frame
+ * is expected so we can set our refresh rate properly. We can accomplish this by
+ * using the VideoState internal video_clock value which keeps track of how much
+ * time has passed according to the video.
+ *
+ * You'll notice we account for repeated frames in this function, too.
+ *
+ * @param   videoState  the VideoState.
+ * @param   src_frame   last decoded video AVFrame, not yet queued in the
+ *                      VideoPicture queue.
+ * @param   pts         the pts of the last decoded video AVFrame obtained using
+ *                      FFmpeg guess_correct_pts.
+ *
+ * @return              the updated (synchronized) pts for the given video AVFrame.
+ */
+double synchronize_video(VideoState * videoState, AVFrame * src_frame, double pts)
+{
+    double frame_delay;
+
+    if (pts != 0)
+    {
+        // if we have pts, set video clock to it
+        videoState->video_clock = pts;
+    }
+    else
+    {
+        // if we aren't given a pts, set it to the clock
+        pts = videoState->video_clock;
+    }
+
+    // update the video clock
+    frame_delay = av_q2d(videoState->video_ctx->time_base);
+
+    // if we are repeating a frame, adjust clock accordingly
+    frame_delay += src_frame->repeat_pict * (frame_delay * 0.5);
+
+    // increase video clock to match the delay required for repeaing frames
+    videoState->video_clock += frame_delay;
+
+    return pts;
+}
+
+/**
+ * Decides whether the given decoded frame, which is about to be queued, is
+ * already late enough against the master clock to be dropped right away: its
+ * conversion, upload and display are then skipped altogether. Also updates the
+ * decoder skip level according to how far video lags behind.
+ * Frames are never dropped when video is the master clock, or when the clocks
+ * are too far apart to be in sync at all (e.g. right after a seek).
+ *
+ * @param   videoState  the VideoState.
+ * @param   pts         the synchronized pts of the decoded frame.
+ *
+ * @return              1 if the frame should be dropped, 0 otherwise.
+ */
+static int video_frame_is_late(VideoState * videoState, double pts)
+{
+    if (videoState->av_sync_type == AV_SYNC_VIDEO_MASTER)
+    {
+        return 0;
+    }
+
+    // how far behind the master clock the frame is
+    double lag = get_master_clock(videoState) - pts;
+
+    if (fabs(lag) >= AV_NOSYNC_THRESHOLD)
+    {
+        return 0;
+    }
+
+    update_decoder_skip_level(videoState, lag);
+
+    // later than one frame duration: the next frame is due already
+    return lag > videoState->frame_last_delay;
+}
+
+/**
+ * Escalates the work the video decoder skips when video keeps lagging behind the
+ * master clock by more than FRAME_DROP_ESCALATE_LAG for FRAME_DROP_ESCALATE_TIME:
+ * first the loop filter of every frame is skipped, then non-reference frames
+ * are not decoded at all. Each level is undone, one at a time, after the lag
+ * has stayed below AV_SYNC_THRESHOLD for as long. Only called from the video
+ * decoding task, between two decoding calls.
+ *
+ * @param   videoState  the VideoState.
+ * @param   lag         the current video lag behind the master clock, in seconds.
+ */
+static void update_decoder_skip_level(VideoState * videoState, double lag)
+{
+    double now = get_monotonic_time(videoState);
+    int level = SDL_AtomicGet(&videoState->decoder_skip_level);
+
+    if (lag > FRAME_DROP_ESCALATE_LAG && level < DECODER_SKIP_NONREF)
+    {
+        // lagging behind: escalate once it lasted long enough
+        if (videoState->lag_state_start <= 0)
+        {
+            videoState->lag_state_start = now;
+        }
+        else if (now - videoState->lag_state_start >= FRAME_DROP_ESCALATE_TIME)
+        {
+            level++;
+            videoState->lag_state_start = 0;
+        }
+    }
+    else if (lag < AV_SYNC_THRESHOLD && level > DECODER_SKIP_NONE)
+    {
+        // in sync: recover once it lasted long enough
+        if (videoState->lag_state_start >= 0)
+        {
+            videoState->lag_state_start = -now;
+        }
+        else if (now + videoState->lag_state_start >= FRAME_DROP_ESCALATE_TIME)
+        {
+            level--;
+            videoState->lag_state_start = 0;
+        }
+    }
+    else
+    {
+        videoState->lag_state_start = 0;
+    }
+
+    if (level != SDL_AtomicGet(&videoState->decoder_skip_level))
+    {
+        SDL_AtomicSet(&videoState->decoder_skip_level, level);
+
+        // the decoder picks these up with the next packet sent
+        videoState->video_ctx->skip_loop_filter = (level >= DECODER_SKIP_LOOP_FILTER) ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+        videoState->video_ctx->skip_frame = (level >= DECODER_SKIP_NONREF) ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+        if (_DEBUG_)
+            printf("Decoder skip level:\t\t%d (lag %f)\n", level, lag);
+    }
+}
+
+/**
+ * So we're going to use a fractional coefficient, say c, and So now let's say
+ * we've gotten N audio sample sets that have been out of sync. The amount we are
+ * out of sync can also vary a good deal, so we're going to take an average of how
+ * far each of those have been out of sync. So for example, the first call might
+ * have shown we were out of sync by 40ms, the next by 50ms, and so on. But we're
+ * not going to take a simple average because the most recent values are more
+ * important than the previous ones. So we're going to use a fractional coefficient,
+ * say c, and sum the differences like this: diff_sum = new_diff + diff_sum*c.
+ * When we are ready to find the average difference, we simply calculate
+ * avg_diff = diff_sum * (1-c).
+ *
+ * The correction is not applied to the output buffer anymore: the returned number
+ * of samples is handed to swr_set_compensation() by audio_resampling(), so the
+ * persistent SwrContext stretches or squeezes the audio smoothly instead of
+ * duplicating or truncating samples.
+ *
+ * @param   videoState  the VideoState.
+ * @param   nb_samples  number of samples (per channel) of the last decoded
+ *                      audio AVFrame, before resampling.
+ *
+ * @return              the wanted number of samples (per channel) for the last
+ *                      decoded audio AVFrame.
+ */
+int synchronize_audio(VideoState * videoState, int nb_samples)
+{
+    int wanted_nb_samples = nb_samples;
+    double ref_clock;
+
+    // audio is only corrected when it is not used as the master clock itself
+    if (videoState->av_sync_type != AV_SYNC_AUDIO_MASTER)
+    {
+        double diff, avg_diff;
+        int min_nb_samples, max_nb_samples;
+
+        ref_clock = get_master_clock(videoState);
+        diff = get_audio_clock(videoState) - ref_clock;
+
+        if (fabs(diff) < AV_NOSYNC_THRESHOLD)
+        {
+            // accumulate the diffs
+            videoState->audio_diff_cum = diff + videoState->audio_diff_avg_coef * videoState->audio_diff_cum;
+
+            if (videoState->audio_diff_avg_count < AUDIO_DIFF_AVG_NB)
+            {
+                videoState->audio_diff_avg_count++;
+            }
+            else
+            {
+                avg_diff = videoState->audio_diff_cum * (1.0 - videoState->audio_diff_avg_coef);
+
+                /**
+                 * So we're doing pretty well; we know approximately how off the audio
+                 * is from the video or whatever we're using for a clock. So let's now
+                 * calculate how many samples we need to add or lop off, without going
+                 * beyond SAMPLE_CORRECTION_PERCENT_MAX percent of the original frame.
+                 */
+                if (fabs(avg_diff) >= videoState->audio_diff_threshold)
+                {
+                    wanted_nb_samples = nb_samples + (int)(diff * videoState->audio_ctx->sample_rate);
+                    min_nb_samples = nb_samples * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100;
+                    max_nb_samples = nb_samples * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100;
+
+                    if (wanted_nb_samples < min_nb_samples)
+                    {
+                        wanted_nb_samples = min_nb_samples;
+                    }
+                    else if (wanted_nb_samples > max_nb_samples)
+                    {
+                        wanted_nb_samples = max_nb_samples;
+                    }
+                }
+            }
+        }
+        else
+        {
+            /* difference is TOO big; reset diff stuff */
+            videoState->audio_diff_avg_count = 0;
+            videoState->audio_diff_cum = 0;
+        }
+    }
+
+    // live mode: keep up with the live edge, whatever the master clock
+    if (videoState->live)
+    {
+        wanted_nb_samples = live_speed_correction(videoState, wanted_nb_samples);
+    }
+
+    return wanted_nb_samples;
+}
+
+/**
+ * Live mode speed correction. The media buffered ahead of the audio output (the
+ * audio PacketQueue and the AudioRing) is the distance from the live edge: it
+ * grows when the source clock runs faster than the audio device clock and
+ * shrinks when it runs slower. Its average is brought back to the jitter buffer
+ * depth by playing the audio slightly faster or slower, in proportion to the
+ * error, through the SwrContext compensation. The pitch change stays below
+ * LIVE_SPEED_CORRECTION_PERCENT_MAX percent, which is not audible.
+ *
+ * @param   videoState  the VideoState.
+ * @param   nb_samples  the wanted number of samples (per channel) of the last
+ *                      decoded audio AVFrame.
+ *
+ * @return              the wanted number of samples corrected for the latency.
+ */
+static int live_speed_correction(VideoState * videoState, int nb_samples)
+{
+    int bytes_per_sec = videoState->audio_ctx->sample_rate * 2 * audio_output_channels(videoState);
+    AudioRing * ring = &videoState->audio_ring;
+
+    double buffered = SDL_AtomicGet(&videoState->audioq.duration) / 1000.0 +
+                      (double)packet_queue_distance(SDL_AtomicGet(&ring->windex), SDL_AtomicGet(&ring->rindex)) / bytes_per_sec;
+
+    // average out the packet arrival jitter
+    if (videoState->live_latency == 0)
+    {
+        videoState->live_latency = buffered;
+    }
+    videoState->live_latency = LIVE_LATENCY_AVG_COEF * videoState->live_latency + (1.0 - LIVE_LATENCY_AVG_COEF) * buffered;
+
+    double error = videoState->live_latency - videoState->jitter_buffer;
+    if (fabs(error) < LIVE_LATENCY_TOLERANCE)
+    {
+        return nb_samples;
+    }
+
+    // full correction once off by a whole jitter buffer: too far behind the
+    // live edge (error > 0) means fewer samples, that is faster playback
+    double speed = av_clipd(error / videoState->jitter_buffer, -1.0, 1.0) * LIVE_SPEED_CORRECTION_PERCENT_MAX / 100.0;
+
+    return (int)lrint(nb_samples * (1.0 - speed));
+}
+
+/**
+ * This function is used as callback for the SDL_Thread.
+ *
+ * The presentation thread replaces the SDL timer events: it waits for the next
+ * decoded frame, gets its display deadline from video_refresh_timer(), sleeps
+ * until then on the monotonic clock and hands the frame over to the render
+ * thread. The hand over happens half a display refresh period early, since the
+ * vsync-bound present then shows the frame on the refresh closest to its
+ * deadline.
+ *
+ * @param   arg the data pointer passed to the SDL_Thread callback function.
+ *
+ * @return      0.
+ */
+int presentation_thread(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+
+    while (!videoState->quit)
+    {
+        // summarize the pipeline stats of the last interval
+        if (av_gettime_relative() >= videoState->stats_next_time)
+        {
+            stats_update(videoState);
+            videoState->stats_next_time = av_gettime_relative() + STATS_INTERVAL * 1000;
+        }
+
+        // check the video stream was correctly opened
+        if (!videoState->video_st)
+        {
+            sleep_until(videoState, get_monotonic_time(videoState) + PRESENTATION_IDLE_TIME);
+            continue;
+        }
+
+        SDL_LockMutex(videoState->pictq_mutex);
+
+        // wait for a decoded frame not handed over to the render thread yet:
+        // pictures handed over are still counted by pictq_size until presented.
+        // The wait is bounded so the stats keep being summarized meanwhile.
+        if (!videoState->quit && videoState->pictq_size - videoState->pictq_render_requests == 0)
+        {
+            SDL_CondWaitTimeout(videoState->render_cond, videoState->pictq_mutex, (Uint32)(PRESENTATION_IDLE_TIME * 1000));
+        }
+
+        int pictq_ready = videoState->pictq_size - videoState->pictq_render_requests;
+
+        SDL_UnlockMutex(videoState->pictq_mutex);
+
+        // check quit flag
+        if (videoState->quit)
+        {
+            break;
+        }
+
+        if (pictq_ready == 0)
+        {
+            continue;
+        }
+
+        // wait for the frame display time, or drop it
+        presentation_schedule(videoState);
+
+        // lock VideoPicture queue mutex
+        SDL_LockMutex(videoState->pictq_mutex);
+
+        // hand the frame over to the render thread to show it on the screen,
+        // it releases the VideoPicture once uploaded and presented (or dropped)
+        videoState->pictq_render_requests++;
+        render_wake(videoState);
+
+        // unlock VideoPicture queue mutex
+        SDL_UnlockMutex(videoState->pictq_mutex);
+    }
+
+    return 0;
+}
+
+/**
+ * Schedules the next frame of the VideoPicture queue: gets its display deadline
+ * from video_refresh_timer() and sleeps until then, or marks it as dropped if
+ * the next one is due already and decoded. The read index is moved to the next
+ * frame and the video clock set to the frame pts if it is shown. Called by the
+ * presentation thread, or by player_replay(), once the frame has been decoded.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the VideoPicture scheduled.
+ */
+static VideoPicture * presentation_schedule(VideoState * videoState)
+{
+    // compute when the frame must be on the screen
+    VideoPicture * videoPicture = &videoState->pictq[videoState->pictq_rindex];
+    double deadline = video_refresh_timer(videoState);
+
+    // drop the frame if the next one is due already and decoded
+    SDL_LockMutex(videoState->pictq_mutex);
+    int pictq_pending = videoState->pictq_size - videoState->pictq_render_requests;
+    SDL_UnlockMutex(videoState->pictq_mutex);
+
+    if (videoState->av_sync_type != AV_SYNC_VIDEO_MASTER && pictq_pending > 1 &&
+        get_monotonic_time(videoState) > deadline + videoState->frame_last_delay)
+    {
+        videoPicture->dropped = 1;
+        SDL_AtomicAdd(&videoState->frames_dropped, 1);
+    }
+    else
+    {
+        // wait until the frame display time
+        sleep_until(videoState, deadline - videoState->vsync_period / 2);
+
+        // the video clock follows the frames shown
+        SDL_AtomicLock(&videoState->video_clock_lock);
+        videoState->video_current_pts = videoPicture->pts;
+        videoState->video_current_pts_time = videoState->clock(videoState);
+        SDL_AtomicUnlock(&videoState->video_clock_lock);
+    }
+
+    // update read index for the next frame
+    if(++videoState->pictq_rindex == videoState->pictq_capacity)
+    {
+        videoState->pictq_rindex = 0;
+    }
+
+    return videoPicture;
+}
+
+/**
+ * Returns the current value of the clock the video frames are scheduled on.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return  the current monotonic time, in seconds.
+ */
+static double get_monotonic_time(VideoState * videoState)
+{
+    return videoState->clock(videoState) / 1000000.0;
+}
+
+/**
+ * Clock of the players while playing.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the av_gettime_relative() monotonic time, in microseconds.
+ */
+static int64_t wall_clock(VideoState * videoState)
+{
+    return av_gettime_relative();
+}
+
+/**
+ * Clock of the players under player_replay(): the virtual time, only moved by
+ * replay_advance().
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the virtual time, in microseconds.
+ */
+static int64_t replay_clock(VideoState * videoState)
+{
+    return videoState->replay_time;
+}
+
+/**
+ * Sleeps until the given monotonic clock deadline with sub-millisecond
+ * precision: the thread sleeps for most of the time, and only busy-waits
+ * during the last PRESENTATION_SPIN_TIME seconds. Returns early if the
+ * quit flag is set.
+ *
+ * @param   videoState  the VideoState.
+ * @param   deadline    the monotonic time to sleep until, in seconds.
+ */
+static void sleep_until(VideoState * videoState, double deadline)
+{
+    double remaining;
+
+    // the replay moves the virtual time forward instead
+    if (videoState->replay)
+    {
+        replay_advance(videoState, deadline);
+        return;
+    }
+
+    while (!videoState->quit && (remaining = deadline - get_monotonic_time(videoState)) > 0)
+    {
+        if (remaining > PRESENTATION_SPIN_TIME)
+        {
+            av_usleep((unsigned)((remaining - PRESENTATION_SPIN_TIME) * 1000000.0));
+        }
+    }
+}
+
+/**
+ * Runs the demux and decoding tasks of the given replayed VideoState on the
+ * calling thread, in a fixed order, until none of them has work left: the
+ * packet queues, the VideoPicture queue and the AudioRing are then as full as
+ * they can be at the current virtual time. The simulated video decoder takes
+ * replay_video_decode_time of virtual time for each frame, it is not run
+ * again until it is done with the last ones.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void replay_run_tasks(VideoState * videoState)
+{
+    int progress;
+
+    do
+    {
+        progress = 0;
+
+        if (!videoState->replay_demux_done)
+        {
+            int ret = demux_step(videoState);
+
+            videoState->replay_demux_done = ret == SCHEDULER_TASK_DONE;
+            progress |= ret != SCHEDULER_TASK_PARK;
+        }
+
+        if (videoState->video_st && !videoState->replay_video_done &&
+            videoState->replay_time >= videoState->replay_video_ready)
+        {
+            int frames = videoState->pictq_size + SDL_AtomicGet(&videoState->frames_skipped);
+            int ret = video_decode_step(videoState);
+
+            frames = videoState->pictq_size + SDL_AtomicGet(&videoState->frames_skipped) - frames;
+            if (frames > 0)
+            {
+                videoState->replay_video_ready = videoState->replay_time + frames * videoState->replay_video_decode_time;
+            }
+
+            videoState->replay_video_done = ret == SCHEDULER_TASK_DONE;
+            progress |= ret != SCHEDULER_TASK_PARK;
+        }
+
+        if (videoState->audio_st && !videoState->replay_audio_done)
+        {
+            int ret = audio_decode_step(videoState);
+
+            videoState->replay_audio_done = ret == SCHEDULER_TASK_DONE;
+            progress |= ret != SCHEDULER_TASK_PARK;
+        }
+    } while (progress && !videoState->quit);
+}
+
+/**
+ * Returns whether the audio of the given replayed VideoState is over: the input
+ * is demuxed, every audio packet decoded and the AudioRing played out, or the
+ * audio stream was given up.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              1 if the audio is over, 0 otherwise.
+ */
+static int replay_audio_over(VideoState * videoState)
+{
+    if (!videoState->audio_st || videoState->replay_audio_done || SDL_AtomicGet(&videoState->audio_disabled))
+    {
+        return 1;
+    }
+
+    return videoState->replay_demux_done &&
+           SDL_AtomicGet(&videoState->audioq.nb_packets) == 0 &&
+           videoState->audio_pending_size == 0 &&
+           packet_queue_distance(SDL_AtomicGet(&videoState->audio_ring.windex), SDL_AtomicGet(&videoState->audio_ring.rindex)) == 0;
+}
+
+/**
+ * Moves the virtual time of the given replayed VideoState forward to the given
+ * deadline. The simulated audio sink pulls each audio device buffer due
+ * meanwhile through audio_callback(), at its own virtual time, once the tasks
+ * have refilled the AudioRing.
+ *
+ * @param   videoState  the VideoState.
+ * @param   deadline    the virtual time to move to, in seconds.
+ */
+static void replay_advance(VideoState * videoState, double deadline)
+{
+    int64_t target = llrint(deadline * 1000000.0);
+
+    while (videoState->replay_audio_buf && !videoState->quit)
+    {
+        // computed from the number of buffers pulled, so it never drifts
+        int64_t callback_time = videoState->replay_audio_start + av_rescale(
+                videoState->replay_audio_callbacks * videoState->audio_buffer_samples,
+                1000000,
+                videoState->audio_ctx->sample_rate
+        );
+
+        if (callback_time > target)
+        {
+            break;
+        }
+
+        videoState->replay_time = FFMAX(videoState->replay_time, callback_time);
+
+        replay_run_tasks(videoState);
+        audio_callback(videoState, videoState->replay_audio_buf, videoState->audio_hw_buf_size);
+
+        videoState->replay_audio_callbacks++;
+    }
+
+    videoState->replay_time = FFMAX(videoState->replay_time, target);
+}
+
+/**
+ * Reports a frame of the given replayed VideoState to its trace callback, with
+ * the virtual time and the audio clock. Nothing is done while playing.
+ *
+ * @param   videoState  the VideoState.
+ * @param   pts         the frame pts, in seconds.
+ * @param   status      the PLAYER_TRACE_* of the frame.
+ */
+static void replay_trace(VideoState * videoState, double pts, int status)
+{
+    if (!videoState->replay || !videoState->replay_callback)
+    {
+        return;
+    }
+
+    PlayerTraceFrame frame;
+    frame.index = videoState->replay_frames++;
+    frame.status = status;
+    frame.pts = pts;
+    frame.time = videoState->replay_time / 1000000.0;
+    frame.audio_clock = videoState->audio_st ? get_audio_clock(videoState) : 0;
+    frame.av_diff = pts - frame.audio_clock;
+
+    videoState->replay_callback(videoState->replay_opaque, &frame);
+}
+
+/**
+ * Computes when the next frame of the VideoPicture queue should be shown, keeping
+ * it in sync with the master clock, and stores it in the VideoPicture. Called
+ * by the presentation thread once the frame has been decoded.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the display deadline of the frame, on the
+ *                      get_monotonic_time() clock.
+ */
+double video_refresh_timer(VideoState * videoState)
+{
+    // VideoPicture read index reference
+    VideoPicture * videoPicture;
+
+    // used for video frames display delay and audio video sync
+    double pts_delay;
+    double audio_ref_clock;
+    double sync_threshold;
+    double real_delay;
+    double audio_video_delay;
+
+    // get VideoPicture reference using the queue read index
+    videoPicture = &videoState->pictq[videoState->pictq_rindex];
+
+    if (_DEBUG_FRAMES_)
+    {
+        printf("Current Frame PTS:\t\t%f\n", videoPicture->pts);
+        printf("Last Frame PTS:\t\t\t%f\n", videoState->frame_last_pts);
+    }
+
+    // get last frame pts
+    pts_delay = videoPicture->pts - videoState->frame_last_pts;
+
+    if (_DEBUG_FRAMES_)
+        printf("PTS Delay:\t\t\t\t%f\n", pts_delay);
+
+    // if the obtained delay is incorrect
+    if (pts_delay <= 0 || pts_delay >= 1.0)
+    {
+        // use the previously calculated delay
+        pts_delay = videoState->frame_last_delay;
+    }
+
+    if (_DEBUG_FRAMES_)
+        printf("Corrected PTS Delay:\t%f\n", pts_delay);
+
+    // save delay information for the next time
+    videoState->frame_last_delay = pts_delay;
+    videoState->frame_last_pts = videoPicture->pts;
+
+    // in case the external clock is not used
+    if(videoState->av_sync_type != AV_SYNC_VIDEO_MASTER)
+    {
+        // update delay to stay in sync with the master clock: audio or video
+        audio_ref_clock = get_master_clock(videoState);
+
+        if (_DEBUG_FRAMES_)
+            printf("Ref Clock:\t\t\t\t%f\n", audio_ref_clock);
+
+        // calculate audio video delay accordingly to the master clock
+        audio_video_delay = videoPicture->pts - audio_ref_clock;
+
+        stats_record_value(&videoState->stats[PLAYER_STAGE_AV_SYNC], (int64_t)(fabs(audio_video_delay) * 1000000));
+        SDL_AtomicSet(&videoState->av_diff, (int)(av_clipd(audio_video_delay, -1000, 1000) * 1000000));
+
+        if (_DEBUG_FRAMES_)
+            printf("Audio Video Delay:\t\t%f\n", audio_video_delay);
+
+        // skip or repeat the frame taking into account the delay
+        sync_threshold = (pts_delay > AV_SYNC_THRESHOLD) ? pts_delay : AV_SYNC_THRESHOLD;
+
+        if (_DEBUG_FRAMES_)
+            printf("Sync Threshold:\t\t\t%f\n", sync_threshold);
+
+        // check audio video delay absolute value is below sync threshold
+        if(fabs(audio_video_delay) < AV_NOSYNC_THRESHOLD)
+        {
+            if(audio_video_delay <= -sync_threshold)
+            {
+                pts_delay = 0;
+            }
+            else if (audio_video_delay >= sync_threshold)
+            {
+                pts_delay = 2 * pts_delay;
+            }
+        }
+    }
+
+    if (_DEBUG_FRAMES_)
+        printf("Corrected PTS delay:\t%f\n", pts_delay);
+
+    videoState->frame_timer += pts_delay;
+
+    // compute the real delay
+    real_delay = videoState->frame_timer - get_monotonic_time(videoState);
+
+    if (_DEBUG_FRAMES_)
+        printf("Real Delay:\t\t\t\t%f\n\n", real_delay);
+
+    // the frame is too late to be caught up by showing the next ones sooner:
+    // show it right away and restart the schedule from now
+    if (real_delay < -AV_NOSYNC_THRESHOLD)
+    {
+        videoState->frame_timer -= real_delay;
+    }
+
+    videoPicture->display_time = videoState->frame_timer;
+
+    return videoPicture->display_time;
+}
+
+/**
+ * Calculates and returns the current audio clock reference value: the audio
+ * clock at the AudioRing write position, minus the samples still buffered in
+ * the ring and in the audio device.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the current audio clock reference value.
+ */
+double get_audio_clock(VideoState * videoState)
+{
+    // audio clock at the AudioRing write position
+    SDL_AtomicLock(&videoState->audio_clock_lock);
+    double pts = videoState->audio_ring_clock;
+    int windex = videoState->audio_ring_clock_windex;
+    SDL_AtomicUnlock(&videoState->audio_clock_lock);
+
+    int bytes_per_sec = 0;
+
+    if (videoState->audio_st)
+    {
+        int n = 2 * audio_output_channels(videoState);
+
+        bytes_per_sec = videoState->audio_ctx->sample_rate * n;
+    }
+
+    if (bytes_per_sec)
+    {
+        // samples still in the ring, not handed to the audio device yet
+        int ring_size = packet_queue_distance(windex, SDL_AtomicGet(&videoState->audio_ring.rindex));
+
+        // the device latency: the buffer just filled by the callback and the
+        // one being played, minus the time elapsed since that callback
+        Uint32 now = (Uint32)(videoState->clock(videoState) / 1000);
+        double elapsed = (Uint32)(now - (Uint32)SDL_AtomicGet(&videoState->audio_callback_time)) / 1000.0;
+        double hw_latency = 2.0 * videoState->audio_hw_buf_size / bytes_per_sec;
+
+        pts -= (double) ring_size / bytes_per_sec + hw_latency - FFMIN(elapsed, hw_latency / 2);
+    }
+
+    return pts;
+}
+
+/**
+ * Calculates and returns the current video clock reference value: the pts of
+ * the last frame shown, plus the time elapsed since.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the current video clock reference value.
+ */
+double get_video_clock(VideoState * videoState)
+{
+    SDL_AtomicLock(&videoState->video_clock_lock);
+    double pts = videoState->video_current_pts;
+    int64_t pts_time = videoState->video_current_pts_time;
+    SDL_AtomicUnlock(&videoState->video_clock_lock);
+
+    return pts + (videoState->clock(videoState) - pts_time) / 1000000.0;
+}
+
+/**
+ * Calculates and returns the current external clock reference value: a clock
+ * running at the computer clock rate, in the stream time. It is started from the
+ * audio clock, and set to it again whenever the two drift apart by more than
+ * AV_NOSYNC_THRESHOLD (after a seek, a timestamp discontinuity or a long stall
+ * of a live source), so it never runs away from the media being played.
+ * Without audio it starts from 0. Can be called from any thread.
+ *
+ * @return  the current external clock reference value.
+ */
+double get_external_clock(VideoState * videoState)
+{
+    // read before taking the lock: get_audio_clock() takes its own
+    double audio_clock = videoState->audio_st ? get_audio_clock(videoState) : 0;
+    int64_t now = videoState->clock(videoState);
+
+    SDL_AtomicLock(&videoState->external_clock_lock);
+
+    double clock = videoState->external_clock + (now - videoState->external_clock_time) / 1000000.0;
+
+    if (videoState->external_clock_time == 0 || (videoState->audio_st && fabs(clock - audio_clock) > AV_NOSYNC_THRESHOLD))
+    {
+        videoState->external_clock = audio_clock;
+        videoState->external_clock_time = now;
+        clock = audio_clock;
+    }
+
+    SDL_AtomicUnlock(&videoState->external_clock_lock);
+
+    return clock;
+}
+
+/**
+ * Checks the VideoState av_sync_type variable and then calls
+ * get_audio_clock, get_video_clock, or get_external_clock accordingly.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the reference clock according to the chosen AV sync type.
+ */
+double get_master_clock(VideoState * videoState)
+{
+    if (videoState->av_sync_type == AV_SYNC_VIDEO_MASTER)
+    {
+        return get_video_clock(videoState);
+    }
+    else if (videoState->av_sync_type == AV_SYNC_AUDIO_MASTER)
+    {
+        return get_audio_clock(videoState);
+    }
+    else if (videoState->av_sync_type == AV_SYNC_EXTERNAL_MASTER)
+    {
+        return get_external_clock(videoState);
+    }
+    else
+    {
+        fprintf(stderr, "Error: Undefined A/V sync type.");
+        return -1;
+    }
+}
+
+/**
+ * Creates the window of the given VideoState, sized after the video stream.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int window_open(VideoState * videoState)
+{
+    // create a window with the specified position, dimensions, and flags.
+    videoState->screen = SDL_CreateWindow(
+            "FFmpeg SDL Video Player",
+            SDL_WINDOWPOS_UNDEFINED,
+            SDL_WINDOWPOS_UNDEFINED,
+            videoState->video_ctx->width,
+            videoState->video_ctx->height,
+            SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI
+    );
+
+    // check window was correctly created
+    if (!videoState->screen)
+    {
+        printf("SDL: could not create window - exiting.\n");
+        return -1;
+    }
+
+    //
+    SDL_GL_SetSwapInterval(1);
+
+    return 0;
+}
+
+/**
+ * This function is used as callback for the SDL_Thread.
+ *
+ * The render thread owns the SDL_Renderer and the double-buffered textures. It
+ * uploads the next VideoPicture to the back texture as soon as it is decoded,
+ * ahead of its display time, so that the upload of frame N+1 overlaps the
+ * presentation of frame N. When the presentation thread requests the frame, the
+ * textures are swapped and presented, and the VideoPicture is given back to
+ * the video decoding task, which is thus never held up by a vsync-bound present.
+ * Not started if RENDER_ON_MAIN_THREAD: player_render() then does the same
+ * work on the main thread.
+ *
+ * @param   arg the data pointer passed to the SDL_Thread callback function.
+ *
+ * @return      < 0 in case of error, 0 otherwise.
+ */
+int render_thread(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+
+    if (render_open(videoState) < 0)
+    {
+        return -1;
+    }
+
+    for (;;)
+    {
+        SDL_LockMutex(videoState->pictq_mutex);
+
+        // wait for a frame to be presented, or a decoded one to be uploaded
+        while (!videoState->quit && !render_pending(videoState))
+        {
+            SDL_CondWait(videoState->render_cond, videoState->pictq_mutex);
+        }
+
+        SDL_UnlockMutex(videoState->pictq_mutex);
+
+        // check quit flag
+        if (videoState->quit)
+        {
+            break;
+        }
+
+        render_step(videoState);
+    }
+
+    // release the render resources, the renderer belongs to this thread
+    render_close(videoState);
+
+    return 0;
+}
+
+/**
+ * Creates the window, if not created yet, and the OpenGL context and shaders,
+ * or the 2D rendering context and its front and back textures. Called by the
+ * thread the frames are rendered on, once the video stream is opened.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int render_open(VideoState * videoState)
+{
+    if (!videoState->screen && window_open(videoState) < 0)
+    {
+        return -1;
+    }
+
+    // create the OpenGL context and shaders, or a 2D rendering context for the
+    // SDL_Window
+    if (videoState->renderer_type == PLAYER_RENDERER_GL)
+    {
+        videoState->gl = gl_renderer_create(videoState->screen);
+        if (!videoState->gl)
+        {
+            printf("OpenGL: could not create renderer - exiting.\n");
+            return -1;
+        }
+    }
+    else
+    {
+        videoState->renderer = SDL_CreateRenderer(videoState->screen, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
+        if (!videoState->renderer)
+        {
+            printf("SDL: could not create renderer - exiting: %s.\n", SDL_GetError());
+            return -1;
+        }
+    }
+
+    // retrieve the display refresh period the presentation is bound to
+    SDL_DisplayMode displayMode;
+    if (SDL_GetWindowDisplayMode(videoState->screen, &displayMode) == 0 && displayMode.refresh_rate > 0)
+    {
+        videoState->vsync_period = 1.0 / displayMode.refresh_rate;
+    }
+
+    // create the front and back textures for the rendering context, the
+    // GLRenderer creates its own on the first upload
+    for (int i = 0; i < 2 && videoState->renderer; i++)
+    {
+        videoState->textures[i] = SDL_CreateTexture(
+                videoState->renderer,
+                videoState->texture_formats[i],
+                SDL_TEXTUREACCESS_STREAMING,
+                videoState->video_ctx->width,
+                videoState->video_ctx->height
+        );
+    }
+
+    return 0;
+}
+
+/**
+ * Returns whether there is a frame to be presented, or a decoded one to be
+ * uploaded ahead of its display time. Called with the VideoPicture queue
+ * mutex locked.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              != 0 if render_step() has work to do, 0 otherwise.
+ */
+static int render_pending(VideoState * videoState)
+{
+    return videoState->pictq_render_requests > 0 ||
+           (!videoState->texture_back_ready && videoState->pictq_size > 0);
+}
+
+/**
+ * Uploads the next VideoPicture to the back texture, unless done already, and
+ * presents it if requested by the presentation thread. The VideoPicture is
+ * then given back to the video decoding task.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void render_step(VideoState * videoState)
+{
+    VideoPicture * videoPicture = &videoState->pictq[videoState->pictq_render_index];
+
+    SDL_LockMutex(videoState->pictq_mutex);
+    int dropped = videoState->pictq_render_requests > 0 && videoPicture->dropped;
+    SDL_UnlockMutex(videoState->pictq_mutex);
+
+    // upload the next picture to the back texture, unless done already or
+    // the picture has been dropped
+    if (!videoState->texture_back_ready && !dropped)
+    {
+        int64_t upload_start = av_gettime_relative();
+        video_upload(videoState, videoPicture, !videoState->texture_front);
+        stats_record(&videoState->stats[PLAYER_STAGE_UPLOAD], upload_start);
+        videoState->texture_back_ready = 1;
+    }
+
+    SDL_LockMutex(videoState->pictq_mutex);
+
+    // the picture was uploaded ahead of time, wait for its display time
+    if (videoState->pictq_render_requests == 0)
+    {
+        SDL_UnlockMutex(videoState->pictq_mutex);
+        return;
+    }
+
+    // keep the display deadline before the VideoPicture gets reused
+    double display_time = videoPicture->display_time;
+    dropped = videoPicture->dropped;
+
+    // the picture is now in the back texture: release the VideoPicture
+    videoState->pictq_render_requests--;
+    videoState->pictq_size--;
+
+    // wake the video decoding task up if it parked on the full VideoPicture queue
+    scheduler_task_wake(&videoState->video_task);
+
+    SDL_UnlockMutex(videoState->pictq_mutex);
+
+    // update the render index for the next frame
+    if (++videoState->pictq_render_index == videoState->pictq_capacity)
+    {
+        videoState->pictq_render_index = 0;
+    }
+
+    // a dropped picture is never shown, even if uploaded already
+    if (dropped)
+    {
+        videoState->texture_back_ready = 0;
+        return;
+    }
+
+    // swap the textures and show the new front one on the screen
+    videoState->texture_front = !videoState->texture_front;
+    videoState->texture_back_ready = 0;
+
+    video_display(videoState);
+
+    // measure how late the frame made it to the screen
+    videoState->frame_lateness = get_monotonic_time(videoState) - display_time;
+    if (videoState->frame_lateness > videoState->frame_lateness_max)
+    {
+        videoState->frame_lateness_max = videoState->frame_lateness;
+    }
+
+    if (_DEBUG_FRAMES_)
+        printf("Frame Lateness:\t\t\t%f (max %f)\n", videoState->frame_lateness, videoState->frame_lateness_max);
+}
+
+/**
+ * Releases the textures and the renderer, on the thread they were created on.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void render_close(VideoState * videoState)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (videoState->textures[i])
+        {
+            SDL_DestroyTexture(videoState->textures[i]);
+            videoState->textures[i] = NULL;
+        }
+    }
+
+    if (videoState->renderer)
+    {
+        SDL_DestroyRenderer(videoState->renderer);
+        videoState->renderer = NULL;
+    }
+
+    gl_renderer_free(&videoState->gl);
+}
+
+/**
+ * Wakes up the thread the frames are rendered on: the render thread, or the
+ * main thread through a PLAYER_EVENT_RENDER if RENDER_ON_MAIN_THREAD, at most
+ * one pending at a time. Also wakes up the presentation thread waiting for a
+ * decoded frame. Called with the VideoPicture queue mutex locked.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void render_wake(VideoState * videoState)
+{
+    SDL_CondBroadcast(videoState->render_cond);
+
+    if (RENDER_ON_MAIN_THREAD && SDL_AtomicGet(&videoState->render_started) &&
+        SDL_AtomicCAS(&videoState->render_event_pending, 0, 1))
+    {
+        SDL_Event event;
+        event.type = PLAYER_EVENT_RENDER;
+        event.user.data1 = videoState;
+
+        SDL_PushEvent(&event);
+    }
+}
+
+/**
+ * Uploads the given VideoPicture to one of the render textures, straight from
+ * the decoder planes when the frame is displayed directly. The texture is
+ * recreated if the frame does not come in its format. With --renderer=gl the
+ * frame goes to the GLRenderer textures set instead. Only ever called from the
+ * thread the frames are rendered on.
+ *
+ * @param   videoState      the VideoState.
+ * @param   videoPicture    the VideoPicture to be uploaded.
+ * @param   texture_index   the index of the texture to be updated.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+static int video_upload(VideoState * videoState, VideoPicture * videoPicture, int texture_index)
+{
+    // either the decoded frame itself or its converted copy
+    AVFrame * frame = videoPicture->direct ? videoPicture->src_frame : videoPicture->frame;
+
+    if (!frame)
+    {
+        return -1;
+    }
+
+    if (_DEBUG_FRAMES_)
+    {
+        // dump information about the frame being uploaded
+        printf(
+                "Frame %c (%d) pts %" PRId64 " dts %" PRId64 " key_frame %d [coded_picture_number %d, display_picture_number %d, %dx%d]\n",
+                av_get_picture_type_char(frame->pict_type),
+                videoState->video_ctx->frame_number,
+                frame->pts,
+                frame->pkt_dts,
+                frame->key_frame,
+                frame->coded_picture_number,
+                frame->display_picture_number,
+                frame->width,
+                frame->height
+        );
+    }
+
+    // the GLRenderer takes any supported format, the converted copies included
+    if (videoState->gl)
+    {
+        return gl_renderer_upload(videoState->gl, texture_index, frame);
+    }
+
+    // recreate the texture if the frames do not come in its format
+    Uint32 texture_format = videoPicture->direct ? get_texture_format(frame->format) : SDL_PIXELFORMAT_YV12;
+    if (texture_format != videoState->texture_formats[texture_index] || !videoState->textures[texture_index])
+    {
+        if (videoState->textures[texture_index])
+        {
+            SDL_DestroyTexture(videoState->textures[texture_index]);
+        }
+
+        videoState->textures[texture_index] = SDL_CreateTexture(
+                videoState->renderer,
+                texture_format,
+                SDL_TEXTUREACCESS_STREAMING,
+                videoState->video_ctx->width,
+                videoState->video_ctx->height
+        );
+        videoState->texture_formats[texture_index] = texture_format;
+
+        if (!videoState->textures[texture_index])
+        {
+            printf("SDL: could not create texture: %s.\n", SDL_GetError());
+            return -1;
+        }
+    }
+
+    // update the whole texture with the new pixel data
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+    if (texture_format == SDL_PIXELFORMAT_NV12)
+    {
+        SDL_UpdateNVTexture(
+                videoState->textures[texture_index],
+                NULL,
+                frame->data[0],
+                frame->linesize[0],
+                frame->data[1],
+                frame->linesize[1]
+        );
+    }
+    else
+#endif
+    {
+        SDL_UpdateYUVTexture(
+                videoState->textures[texture_index],
+                NULL,
+                frame->data[0],
+                frame->linesize[0],
+                frame->data[1],
+                frame->linesize[1],
+                frame->data[2],
+                frame->linesize[2]
+        );
+    }
+
+    return 0;
+}
+
+/**
+ * Retrieves the video aspect ratio first, which is just the width divided by the
+ * height. Then it scales the movie to fit as big as possible in our screen
+ * (SDL_Window). Then it centers the movie, and presents the front render
+ * texture. Only ever called from the render thread, so no lock is needed to
+ * access the renderer.
+ *
+ * @param   videoState  the VideoState.
+ */
+void video_display(VideoState * videoState)
+{
+    double aspect_ratio;
+
+    int w, h, x, y;
+
+    // the texture the last VideoPicture was uploaded to
+    SDL_Texture * texture = videoState->textures[videoState->texture_front];
+
+    if (texture || (videoState->gl && gl_renderer_has_frame(videoState->gl, videoState->texture_front)))
+    {
+        if (videoState->video_ctx->sample_aspect_ratio.num == 0)
+        {
+            aspect_ratio = 0;
+        }
+        else
+        {
+            aspect_ratio = av_q2d(videoState->video_ctx->sample_aspect_ratio) * videoState->video_ctx->width / videoState->video_ctx->height;
+        }
+
+        if (aspect_ratio <= 0.0)
+        {
+            aspect_ratio = (float)videoState->video_ctx->width /
+                           (float)videoState->video_ctx->height;
+        }
+
+        // get the size of a window's client area
+        int screen_width;
+        int screen_height;
+        SDL_GetWindowSize(videoState->screen, &screen_width, &screen_height);
+
+        // global SDL_Surface height
+        h = screen_height;
+
+        // retrieve width using the calculated aspect ratio and the screen height
+        w = ((int) rint(h * aspect_ratio)) & -3;
+
+        // if the new width is bigger than the screen width
+        if (w > screen_width)
+        {
+            // set the width to the screen width
+            w = screen_width;
+
+            // recalculate height using the calculated aspect ratio and the screen width
+            h = ((int) rint(w / aspect_ratio)) & -3;
+        }
+
+        // TODO: Add full screen support
+        x = (screen_width - w) / 2;
+        y = (screen_height - h) / 2;
+
+        // check the number of frames to decode was not exceeded
+        if (videoState->maxFramesToDecode <= 0 || ++videoState->currentFrameIndex < videoState->maxFramesToDecode)
+        {
+            // set blit area x and y coordinates, width and height
+            SDL_Rect rect;
+            rect.x = x;
+            rect.y = y;
+            rect.w = w;
+            rect.h = h;
+
+            if (videoState->gl)
+            {
+                // clear the window and draw the frame, converted and scaled by
+                // the fragment shader
+                gl_renderer_draw(videoState->gl, videoState->texture_front, &rect);
+            }
+            else
+            {
+                // clear the current rendering target with the drawing color
+                SDL_RenderClear(videoState->renderer);
+
+                // copy the texture to the blit area of the current rendering target
+                SDL_RenderCopy(videoState->renderer, texture, NULL, &rect);
+            }
+
+            if (SDL_AtomicGet(&videoState->stats_overlay))
+            {
+                stats_overlay_draw(videoState);
+            }
+
+            // update the screen with any rendering performed since the previous call
+            int64_t present_start = av_gettime_relative();
+            if (videoState->gl)
+            {
+                gl_renderer_present(videoState->gl);
+            }
+            else
+            {
+                SDL_RenderPresent(videoState->renderer);
+            }
+            stats_record(&videoState->stats[PLAYER_STAGE_PRESENT], present_start);
+
+            if (!videoState->first_display_time)
+            {
+                videoState->first_display_time = av_gettime_relative();
+            }
+        }
+        else
+        {
+            // create an SDLEvent of type PLAYER_EVENT_DONE
+            SDL_Event event;
+            event.type = PLAYER_EVENT_DONE;
+            event.user.data1 = videoState;
+
+            // push the event
+            SDL_PushEvent(&event);
+        }
+    }
+}
+
+/**
+ * Initialize the given PacketQueue and pre-allocate its AVPacket slots.
+ *
+ * @param   q           the PacketQueue to be initialized.
+ * @param   videoState  the player the PacketQueue belongs to.
+ * @param   consumer    the task woken up by each new AVPacket.
+ */
+void packet_queue_init(PacketQueue * q, VideoState * videoState, SchedulerTask * consumer, MemoryArena * arena)
+{
+    // alloc memory for the audio queue
+    memset(
+            q,
+            0,
+            sizeof(PacketQueue)
+    );
+
+    q->videoState = videoState;
+    q->consumer = consumer;
+    q->arena = arena;
+
+    // allocate the AVPacket pool once, the slots are reused for the whole playback
+    for (int i = 0; i < PACKET_QUEUE_CAPACITY; i++)
+    {
+        q->pkts[i] = av_packet_alloc();
+        if (!q->pkts[i])
+        {
+            printf("Could not allocate AVPacket.\n");
+            return;
+        }
+    }
+
+    // Returns the initialized and unlocked mutex or NULL on failure
+    q->mutex = SDL_CreateMutex();
+    if (!q->mutex)
+    {
+        // could not create mutex
+        printf("SDL_CreateMutex Error: %s.\n", SDL_GetError());
+        return;
+    }
+
+    // Returns a new condition variable or NULL on failure
+    q->cond = SDL_CreateCond();
+    if (!q->cond)
+    {
+        // could not create condition variable
+        printf("SDL_CreateCond Error: %s.\n", SDL_GetError());
+        return;
+    }
+}
+
+/**
+ * Releases the AVPacket slots, the queued data and the lock of the given
+ * PacketQueue. Nothing is done if it was never initialized.
+ *
+ * @param   q   the PacketQueue to be released.
+ */
+static void packet_queue_destroy(PacketQueue * q)
+{
+    if (!q->videoState)
+    {
+        return;
+    }
+
+    for (int i = 0; i < PACKET_QUEUE_CAPACITY; i++)
+    {
+        av_packet_free(&q->pkts[i]);
+    }
+
+    SDL_DestroyMutex(q->mutex);
+    SDL_DestroyCond(q->cond);
+    q->mutex = NULL;
+    q->cond = NULL;
+}
+
+/**
+ * Returns the maximum size in bytes of the packet queue of the given AVStream:
+ * PACKET_QUEUE_HIGH_DURATION seconds of its bitrate with a margin, at least
+ * min_size and at most the limit of the given memory arena. The bitrate of a
+ * video stream which does not declare it is estimated from its resolution and
+ * frame rate, the one of an audio stream from its uncompressed 16 bits rate.
+ *
+ * @param   videoState  the VideoState.
+ * @param   stream      the AVStream.
+ * @param   min_size    the minimum size of the packet queue, in bytes.
+ * @param   arena       the MemoryArena the packet queue draws from.
+ *
+ * @return              the packet queue maximum size, in bytes.
+ */
+static int packet_queue_max_size(VideoState * videoState, AVStream * stream, int min_size, MemoryArena * arena)
+{
+    AVCodecParameters * codecpar = stream->codecpar;
+    int64_t bit_rate = codecpar->bit_rate;
+
+    if (bit_rate <= 0 && codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        AVRational frame_rate = av_guess_frame_rate(videoState->pFormatCtx, stream, NULL);
+        double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 25;
+
+        bit_rate = (int64_t)((double)codecpar->width * codecpar->height * fps * VIDEO_BITS_PER_PIXEL);
+    }
+    else if (bit_rate <= 0 && codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+    {
+        bit_rate = (int64_t)codecpar->sample_rate * codecpar->channels * 16;
+    }
+
+    int64_t size = (int64_t)(bit_rate / 8 * PACKET_QUEUE_HIGH_DURATION * PACKET_QUEUE_BITRATE_MARGIN);
+
+    return (int)FFMIN(FFMAX(size, min_size), arena->limit);
+}
+
+/**
+ * Returns the number of ring slots between the two given free running indices.
+ * Also used for the AudioRing byte indices.
+ *
+ * @param   windex  the PacketQueue write index.
+ * @param   rindex  the PacketQueue read index.
+ *
+ * @return          windex - rindex, correct across index wrap-around.
+ */
+static inline int packet_queue_distance(int windex, int rindex)
+{
+    return (int)((unsigned)windex - (unsigned)rindex);
+}
+
+/**
+ * Returns the duration of the given AVPacket in milliseconds, using the given
+ * PacketQueue time base.
+ *
+ * @param   queue   the PacketQueue the AVPacket belongs to.
+ * @param   packet  the AVPacket.
+ *
+ * @return          the AVPacket duration in milliseconds, 0 if unknown.
+ */
+static inline int packet_queue_packet_duration(PacketQueue * queue, AVPacket * packet)
+{
+    if (packet->duration <= 0 || queue->time_base.den == 0)
+    {
+        return 0;
+    }
+
+    return (int)av_rescale_q(packet->duration, queue->time_base, (AVRational){1, 1000});
+}
+
+/**
+ * Wakes up the other side of the given PacketQueue, only if it is blocked
+ * waiting for the ring not to be empty (consumer) or full (producer).
+ *
+ * @param   queue   the PacketQueue to be signaled.
+ */
+static void packet_queue_wake(PacketQueue * queue)
+{
+    if (SDL_AtomicGet(&queue->waiting))
+    {
+        SDL_LockMutex(queue->mutex);
+        SDL_CondSignal(queue->cond);
+        SDL_UnlockMutex(queue->mutex);
+    }
+}
+
+/**
+ * Put the given AVPacket in the given PacketQueue. The AVPacket reference is
+ * moved into a pre-allocated slot of the ring, the caller's AVPacket is reset.
+ * Blocks only if the ring is full.
+ *
+ * @param  queue    the queue to be used for the insert
+ * @param  packet   the AVPacket to be inserted in the queue
+ *
+ * @return          0 if the AVPacket is correctly inserted in the given PacketQueue,
+ *                  < 0 if the quit flag is set or its data could not be
+ *                  referenced, the AVPacket is then unreferenced.
+ */
+int packet_queue_put(PacketQueue * queue, AVPacket * packet)
+{
+    // the queued AVPacket must own its data: the caller reuses its own one
+    int ret = av_packet_make_refcounted(packet);
+    if (ret < 0)
+    {
+        printf("Could not reference the AVPacket data.\n");
+        av_packet_unref(packet);
+        return ret;
+    }
+
+    int windex = SDL_AtomicGet(&queue->windex);
+
+    // check the ring is full
+    if (packet_queue_distance(windex, SDL_AtomicGet(&queue->rindex)) >= PACKET_QUEUE_CAPACITY)
+    {
+        // lock mutex
+        SDL_LockMutex(queue->mutex);
+
+        // tell the consumer to signal us, then check again before waiting
+        SDL_AtomicSet(&queue->waiting, 1);
+
+        while (packet_queue_distance(windex, SDL_AtomicGet(&queue->rindex)) >= PACKET_QUEUE_CAPACITY &&
+               !queue->videoState->quit)
+        {
+            // unlock mutex and wait for cond signal, then lock mutex again
+            SDL_CondWait(queue->cond, queue->mutex);
+        }
+
+        SDL_AtomicSet(&queue->waiting, 0);
+
+        // unlock mutex
+        SDL_UnlockMutex(queue->mutex);
+
+        // check quit flag
+        if (queue->videoState->quit)
+        {
+            return -1;
+        }
+    }
+
+    // the slot pointed by the write index is owned by the producer until published
+    AVPacket * slot = queue->pkts[windex & (PACKET_QUEUE_CAPACITY - 1)];
+
+    // move the reference counted data into the slot, no copy involved
+    av_packet_move_ref(slot, packet);
+
+    // increase the number of AVPackets, the size and the duration of the queue
+    SDL_AtomicAdd(&queue->nb_packets, 1);
+    SDL_AtomicAdd(&queue->size, slot->size);
+    SDL_AtomicAdd(&queue->duration, packet_queue_packet_duration(queue, slot));
+    memory_arena_charge(queue->arena, slot->size);
+
+    // publish the packet to the consumer
+    SDL_AtomicSet(&queue->windex, (int)((unsigned)windex + 1));
+
+    // notify packet_queue_get if it is waiting for a new packet
+    packet_queue_wake(queue);
+
+    // and the decoding task, in case it parked on the empty queue
+    scheduler_task_wake(queue->consumer);
+
+    return 0;
+}
+
+/**
+ * Get the first AVPacket from the given PacketQueue.
+ *
+ * @param   queue       the PacketQueue to extract from.
+ * @param   packet      the first AVPacket extracted from the queue.
+ * @param   blocking    0 to avoid waiting for an AVPacket to be inserted in the given
+ *                      queue, != 0 otherwise.
+ * @param   serial      if not NULL, set to the serial of the queue the extracted
+ *                      AVPacket was put with.
+ *
+ * @return              < 0 if returning because the quit flag is set, 0 if the queue
+ *                      is empty, 1 if it is not empty and a packet was extracted.
+ */
+static int packet_queue_get(PacketQueue * queue, AVPacket * packet, int blocking, int * serial)
+{
+    for (;;)
+    {
+        // check quit flag
+        if (queue->videoState->quit)
+        {
+            return -1;
+        }
+
+        int rindex = SDL_AtomicGet(&queue->rindex);
+
+        // read the serial before the flush index: packet_queue_flush() updates
+        // them the other way round, so no AVPacket put before the flush can be
+        // returned with the new serial
+        int queue_serial = SDL_AtomicGet(&queue->serial);
+
+        // discard the AVPackets left behind by packet_queue_flush()
+        if (packet_queue_distance(SDL_AtomicGet(&queue->flush_index), rindex) > 0)
+        {
+            AVPacket * slot = queue->pkts[rindex & (PACKET_QUEUE_CAPACITY - 1)];
+
+            SDL_AtomicAdd(&queue->nb_packets, -1);
+            SDL_AtomicAdd(&queue->size, -slot->size);
+            SDL_AtomicAdd(&queue->duration, -packet_queue_packet_duration(queue, slot));
+            memory_arena_release(queue->arena, slot->size);
+
+            av_packet_unref(slot);
+
+            SDL_AtomicSet(&queue->rindex, (int)((unsigned)rindex + 1));
+            packet_queue_wake(queue);
+
+            continue;
+        }
+
+        // if the write index is ahead of the read index, the queue is not empty
+        if (SDL_AtomicGet(&queue->windex) != rindex)
+        {
+            // the slot pointed by the read index is owned by the consumer until released
+            AVPacket * slot = queue->pkts[rindex & (PACKET_QUEUE_CAPACITY - 1)];
+
+            // decrease the number of packets, the size and the duration of the queue
+            SDL_AtomicAdd(&queue->nb_packets, -1);
+            SDL_AtomicAdd(&queue->size, -slot->size);
+            SDL_AtomicAdd(&queue->duration, -packet_queue_packet_duration(queue, slot));
+            memory_arena_release(queue->arena, slot->size);
+
+            // point packet to the extracted packet, this will return to the calling function
+            av_packet_move_ref(packet, slot);
+
+            // the demux thread may be holding an AVPacket for this ring
+            int was_full = packet_queue_distance(SDL_AtomicGet(&queue->windex), rindex) >= PACKET_QUEUE_CAPACITY;
+
+            if (serial)
+            {
+                *serial = queue_serial;
+            }
+
+            // release the slot to the producer
+            SDL_AtomicSet(&queue->rindex, (int)((unsigned)rindex + 1));
+
+            // notify packet_queue_put if it is waiting for a free slot
+            packet_queue_wake(queue);
+
+            // wake the demux thread up if it is waiting for space in the queue
+            if (SDL_AtomicGet(&queue->videoState->read_waiting) && (was_full || packet_queue_is_low(queue)))
+            {
+                demux_wake(queue->videoState);
+            }
+
+            return 1;
+        }
+        else if (!blocking)
+        {
+            return 0;
+        }
+
+        // lock mutex
+        SDL_LockMutex(queue->mutex);
+
+        // tell the producer to signal us, then check again before waiting
+        SDL_AtomicSet(&queue->waiting, 1);
+
+        while (SDL_AtomicGet(&queue->windex) == rindex && !queue->videoState->quit)
+        {
+            // unlock mutex and wait for cond signal, then lock mutex again
+            SDL_CondWait(queue->cond, queue->mutex);
+        }
+
+        SDL_AtomicSet(&queue->waiting, 0);
+
+        // unlock mutex
+        SDL_UnlockMutex(queue->mutex);
+    }
+}
+
+/**
+ * Discards all the AVPackets currently in the given PacketQueue.
+ *
+ * Must only be called by the producer. The consumer owns the AVPackets it has
+ * not read yet, so the flush only records the current write index: the discarded
+ * AVPackets are released by packet_queue_get() before returning the next one, and
+ * the serial of the queue is increased to tell the consumer to flush its decoder.
+ *
+ * @param queue the PacketQueue to be flushed.
+ */
+static void packet_queue_flush(PacketQueue * queue)
+{
+    SDL_AtomicSet(&queue->flush_index, SDL_AtomicGet(&queue->windex));
+    SDL_AtomicIncRef(&queue->serial);
+
+    // let the consumer release the discarded AVPackets
+    packet_queue_wake(queue);
+}
+
+/**
+ * Checks the given PacketQueue is above its high watermark: more than max_size
+ * bytes or more than PACKET_QUEUE_HIGH_DURATION seconds of media.
+ *
+ * @param   queue   the PacketQueue to be checked.
+ *
+ * @return          != 0 if the PacketQueue is full, 0 otherwise.
+ */
+static int packet_queue_is_full(PacketQueue * queue)
+{
+    return SDL_AtomicGet(&queue->size) > queue->max_size ||
+           SDL_AtomicGet(&queue->duration) > (int)(PACKET_QUEUE_HIGH_DURATION * 1000);
+}
+
+/**
+ * Checks the given PacketQueue is below its low watermark: less than
+ * PACKET_QUEUE_LOW_SIZE_PERCENT of max_size bytes and less than
+ * PACKET_QUEUE_LOW_DURATION seconds of media. Using the duration as well keeps a
+ * low bitrate stream, which is never big in bytes, from asking for more data
+ * while it already holds plenty of media.
+ *
+ * @param   queue   the PacketQueue to be checked.
+ *
+ * @return          != 0 if the PacketQueue is low, 0 otherwise.
+ */
+static int packet_queue_is_low(PacketQueue * queue)
+{
+    return SDL_AtomicGet(&queue->size) < queue->max_size / 100 * PACKET_QUEUE_LOW_SIZE_PERCENT &&
+           SDL_AtomicGet(&queue->duration) < (int)(PACKET_QUEUE_LOW_DURATION * 1000);
+}
+
+/**
+ * Checks whether the ring of the given PacketQueue has a free slot, so that
+ * packet_queue_put() does not block.
+ *
+ * @param   queue   the PacketQueue.
+ *
+ * @return          != 0 if there is a free slot, 0 otherwise.
+ */
+static int packet_queue_has_room(PacketQueue * queue)
+{
+    return packet_queue_distance(SDL_AtomicGet(&queue->windex), SDL_AtomicGet(&queue->rindex)) < PACKET_QUEUE_CAPACITY;
+}
+
+/**
+ * Checks whether the demux thread should stop reading: at least one of the
+ * opened packet queues is above its high watermark and none of them is below its
+ * low watermark, so a starving stream is never stalled by a full one.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              != 0 if the demux thread should park, 0 otherwise.
+ */
+static int packet_queues_full(VideoState * videoState)
+{
+    int full = 0;
+
+    if (videoState->audio_st && !SDL_AtomicGet(&videoState->audio_disabled))
+    {
+        if (packet_queue_is_low(&videoState->audioq))
+        {
+            return 0;
+        }
+
+        full |= packet_queue_is_full(&videoState->audioq);
+    }
+
+    if (videoState->video_st)
+    {
+        if (packet_queue_is_low(&videoState->videoq))
+        {
+            return 0;
+        }
+
+        full |= packet_queue_is_full(&videoState->videoq);
+    }
+
+    return full;
+}
+
+/**
+ * Checks whether a parked demux thread should resume reading: at least one
+ * of the opened packet queues is below its low watermark.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              != 0 if the demux thread should resume, 0 otherwise.
+ */
+static int packet_queues_low(VideoState * videoState)
+{
+    return (videoState->audio_st && packet_queue_is_low(&videoState->audioq)) ||
+           (videoState->video_st && packet_queue_is_low(&videoState->videoq));
+}
+
+/**
+ * Wakes the demux thread up if it parked waiting for space in the packet
+ * queues, or if it is waiting after a transient read error, for a seek or quit.
+ *
+ * @param   videoState  the VideoState.
+ */
+static void demux_wake(VideoState * videoState)
+{
+    SDL_LockMutex(videoState->continue_read_mutex);
+    videoState->demux_wakeup = 1;
+    SDL_CondSignal(videoState->continue_read_cond);
+    SDL_UnlockMutex(videoState->continue_read_mutex);
+}
+
+/**
+ * Step function of the audio decoding SchedulerTask.
+ *
+ * Pulls in data from audio_decode_frame() and writes it to the AudioRing read
+ * by audio_callback(), so that the callback never decodes inline. Each step
+ * decodes up to AUDIO_TASK_QUANTUM audio frames. The task parks when no
+ * AVPacket is available, woken up by packet_queue_put(), or when the ring is
+ * full, woken up by audio_callback(): the resampled data is then kept until
+ * there is room for it. After each write, the audio clock at the ring write
+ * position is published for get_audio_clock(). A failure ends the step, after
+ * AUDIO_DECODE_MAX_ERRORS in a row the audio stream is given up. The task is
+ * joined and the audio device closed by player_close().
+ *
+ * @param   arg the VideoState.
+ *
+ * @return      a SCHEDULER_TASK_* value.
+ */
+int audio_decode_step(void * arg)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)arg;
+    AudioRing * ring = &videoState->audio_ring;
+
+    double pts;
+
+    // the audio stream was given up: only release the AVPackets still queued,
+    // the demux thread held one back if the queue was full
+    if (SDL_AtomicGet(&videoState->audio_disabled))
+    {
+        while (packet_queue_get(&videoState->audioq, videoState->audio_pkt, 0, NULL) > 0)
+        {
+            av_packet_unref(videoState->audio_pkt);
+        }
+
+        return videoState->quit ? SCHEDULER_TASK_DONE : SCHEDULER_TASK_PARK;
+    }
+
+    for (int i = 0; i < AUDIO_TASK_QUANTUM; i++)
+    {
+        // check quit flag
+        if (videoState->quit)
+        {
+            return SCHEDULER_TASK_DONE;
+        }
+
+        // decode and resample the next audio frame, unless the last one is
+        // still waiting for room in the ring
+        if (videoState->audio_pending_size == 0)
+        {
+            uint8_t * audio_buf = NULL;
+
+            int audio_size = audio_decode_frame(videoState, &audio_buf, &pts);
+            if (audio_size < 0)
+            {
+                if (videoState->quit)
+                {
+                    return SCHEDULER_TASK_DONE;
+                }
+
+                // report the first failure of a series only
+                if (videoState->audio_decode_errors++ == 0)
+                {
+                    printf("audio_decode_frame() failed.\n");
+                }
+
+                // a decoder stuck in an error state would fail forever: give
+                // the audio up and let the video run on its own clock
+                if (videoState->audio_decode_errors >= AUDIO_DECODE_MAX_ERRORS)
+                {
+                    printf("Too many audio decoding errors, audio disabled.\n");
+
+                    // without video, the external clock keeps running
+                    if (videoState->av_sync_type == AV_SYNC_AUDIO_MASTER)
+                    {
+                        videoState->av_sync_type = videoState->video_st ? AV_SYNC_VIDEO_MASTER : AV_SYNC_EXTERNAL_MASTER;
+                    }
+
+                    SDL_AtomicSet(&videoState->audio_disabled, 1);
+                    demux_wake(videoState);
+
+                    return SCHEDULER_TASK_YIELD;
+                }
+
+                // back off: let the other tasks run before trying again
+                return SCHEDULER_TASK_YIELD;
+            }
+            else if (audio_size == 0)
+            {
+                // no AVPacket available yet
+                return SCHEDULER_TASK_PARK;
+            }
+
+            // should never happen: the ring holds several decoded frames
+            if (audio_size > ring->capacity)
+            {
+                audio_size = ring->capacity;
+            }
+
+            videoState->audio_decode_errors = 0;
+            videoState->audio_pending_buf = audio_buf;
+            videoState->audio_pending_size = audio_size;
+        }
+
+        uint8_t * audio_buf = videoState->audio_pending_buf;
+        int audio_size = videoState->audio_pending_size;
+
+        // wait for enough room in the ring, audio_callback() wakes us up
+        int windex = SDL_AtomicGet(&ring->windex);
+        if (ring->capacity - packet_queue_distance(windex, SDL_AtomicGet(&ring->rindex)) < audio_size)
+        {
+            return SCHEDULER_TASK_PARK;
+        }
+
+        // copy the samples, in two parts if wrapping around the ring end
+        int offset = (int)((unsigned)windex & (unsigned)(ring->capacity - 1));
+        int len1 = FFMIN(audio_size, ring->capacity - offset);
+        memcpy(ring->data + offset, audio_buf, len1);
+        memcpy(ring->data, audio_buf + len1, audio_size - len1);
+
+        videoState->audio_pending_size = 0;
+
+        // publish the samples along with the audio clock at the write position
+        SDL_AtomicLock(&videoState->audio_clock_lock);
+        videoState->audio_ring_clock = videoState->audio_clock;
+        videoState->audio_ring_clock_windex = (int)((unsigned)windex + (unsigned)audio_size);
+        SDL_AtomicSet(&ring->windex, videoState->audio_ring_clock_windex);
+        SDL_AtomicUnlock(&videoState->audio_clock_lock);
+    }
+
+    // let the tasks of the other players run
+    return SCHEDULER_TASK_YIELD;
+}
+
+/**
+ * Copies as many bytes as the amount defined by len from the AudioRing to
+ * stream. Silence is output for whatever the audio decoding task did not
+ * provide in time. Never blocks, nor decodes.
+ *
+ * @param   userdata    the pointer we gave to SDL.
+ * @param   stream      the buffer we will be writing audio data to.
+ * @param   len         the size of that buffer.
+ */
+void audio_callback(void * userdata, Uint8 * stream, int len)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)userdata;
+    AudioRing * ring = &videoState->audio_ring;
+
+    // check quit flag
+    if (videoState->quit)
+    {
+        memset(stream, 0, len);
+        return;
+    }
+
+    int rindex = SDL_AtomicGet(&ring->rindex);
+    int available = packet_queue_distance(SDL_AtomicGet(&ring->windex), rindex);
+    int size = FFMIN(available, len);
+
+    // copy the samples, in two parts if wrapping around the ring end
+    int offset = (int)((unsigned)rindex & (unsigned)(ring->capacity - 1));
+    int len1 = FFMIN(size, ring->capacity - offset);
+    memcpy(stream, ring->data + offset, len1);
+    memcpy(stream + len1, ring->data, size - len1);
+
+    // output silence in case of underrun
+    memset(stream + size, 0, len - size);
+
+    // give the room back to the audio decoding task, and wake it up in case it
+    // parked on the full ring or is rebuffering
+    SDL_AtomicSet(&ring->rindex, (int)((unsigned)rindex + (unsigned)size));
+    SDL_AtomicSet(&videoState->audio_callback_time, (int)(videoState->clock(videoState) / 1000));
+
+    scheduler_task_wake(&videoState->audio_task);
+}
+
+/**
+ * Get a packet from the queue if available. Decode the extracted packet. Once
+ * we have the frame, resample it and hand the resampled data out without any
+ * copy. The AVPacket and AVFrame used are owned by the VideoState, nothing is
+ * allocated per call. Never blocks waiting for AVPackets.
+ *
+ * @param   videoState  the VideoState.
+ * @param   audio_buf   set to the resampled audio data, owned by the
+ *                      audio resampler and valid until the next call.
+ * @param   pts_ptr     a pointer to the pts of the decoded audio frame.
+ *
+ * @return              the size of the audio data, 0 if no AVPacket is available
+ *                      yet (or the jitter buffer is being filled), -1 in case of
+ *                      error or quit.
+ */
+int audio_decode_frame(VideoState * videoState, uint8_t ** audio_buf, double * pts_ptr)
+{
+    // the AVPacket and AVFrame are owned by the VideoState for the whole
+    // playback: they are only unreferenced between uses, never reallocated
+    AVPacket * avPacket = videoState->audio_pkt;
+    AVFrame * avFrame = videoState->audio_frame;
+
+    double pts;
+    int n;
+
+    int data_size = 0;
+
+    // infinite loop: read AVPackets from the audio PacketQueue, decode them into
+    // audio frames, resample the obtained frame and update the audio buffer
+    for (;;)
+    {
+        // check quit flag
+        if (videoState->quit)
+        {
+            return -1;
+        }
+
+        // get decoded output data from decoder, if any is pending
+        int64_t decode_start = av_gettime_relative();
+        int ret = avcodec_receive_frame(videoState->audio_ctx, avFrame);
+        videoState->audio_decode_time += av_gettime_relative() - decode_start;
+
+        // check an entire audio frame was decoded
+        if (ret == 0)
+        {
+            stats_record_value(&videoState->stats[PLAYER_STAGE_AUDIO_DECODE], videoState->audio_decode_time);
+            videoState->audio_decode_time = 0;
+
+            // keep audio_clock up-to-date
+            if (avFrame->pts != AV_NOPTS_VALUE)
+            {
+                videoState->audio_clock = av_q2d(videoState->audio_st->time_base) * avFrame->pts;
+            }
+
+            // accurate seek: drop the frames ending before the seek target
+            // without resampling them
+            if (videoState->audio_seek_pending)
+            {
+                if (avFrame->pts != AV_NOPTS_VALUE &&
+                    videoState->audio_clock + (double)avFrame->nb_samples / avFrame->sample_rate <= videoState->seek_target_time)
+                {
+                    av_frame_unref(avFrame);
+                    continue;
+                }
+
+                videoState->audio_seek_pending = 0;
+            }
+
+            // apply audio resampling to the decoded frame
+            int64_t resample_start = av_gettime_relative();
+            data_size = audio_resampling(
+                    videoState,
+                    avFrame,
+                    AV_SAMPLE_FMT_S16,
+                    NULL
+            );
+            stats_record(&videoState->stats[PLAYER_STAGE_RESAMPLE], resample_start);
+            *audio_buf = videoState->audio_resampler->resampled_data ? videoState->audio_resampler->resampled_data[0] : NULL;
+
+            // release the decoded frame buffers, the AVFrame itself is kept
+            av_frame_unref(avFrame);
+
+            if (data_size <= 0)
+            {
+                // no data yet, get more frames
+                continue;
+            }
+
+            // keep audio_clock up-to-date
+            pts = videoState->audio_clock;
+            *pts_ptr = pts;
+            n = 2 * audio_output_channels(videoState);
+            videoState->audio_clock += (double)data_size / (double)(n * videoState->audio_ctx->sample_rate);
+
+            // we have the data, return it and come back for more later
+            return data_size;
+        }
+        else if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+        {
+            printf("avcodec_receive_frame decoding error.\n");
+            return -1;
+        }
+
+        // the decoder needs more data: on an underrun, wait for the jitter buffer
+        // to be filled again before going on
+        if (videoState->jitter_buffer > 0 && !jitter_buffer_ready(videoState))
+        {
+            return 0;
+        }
+
+        // get more audio AVPacket
+        int serial;
+        ret = packet_queue_get(&videoState->audioq, avPacket, 0, &serial);
+
+        // if packet_queue_get returns < 0, the quit flag was set
+        if (ret < 0)
+        {
+            return -1;
+        }
+        else if (ret == 0)
+        {
+            return 0;
+        }
+
+        // a seek flushed the queue: drop the samples buffered by the decoder
+        if (serial != videoState->audio_pkt_serial)
+        {
+            avcodec_flush_buffers(videoState->audio_ctx);
+            videoState->audio_pkt_serial = serial;
+            videoState->audio_seek_pending = videoState->accurate_seek;
+        }
+
+        // give the decoder raw compressed data in an AVPacket
+        decode_start = av_gettime_relative();
+        ret = avcodec_send_packet(videoState->audio_ctx, avPacket);
+        videoState->audio_decode_time += av_gettime_relative() - decode_start;
+
+        // wipe the packet
+        av_packet_unref(avPacket);
+
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+        {
+            // if error, skip the packet
+            printf("Error sending audio packet for decoding.\n");
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Resamples the audio data retrieved using FFmpeg before playing it.
+ *
+ * The SwrContext and the output samples buffer are owned by the VideoState
+ * (videoState->audio_resampler): the context is only rebuilt when the input
+ * channel layout, sample format or sample rate changes, so the resampler filter
+ * history is preserved across frames, and the buffer only grows, it is never
+ * freed per frame.
+ *
+ * @param   videoState          the VideoState.
+ * @param   decoded_audio_frame the decoded audio frame.
+ * @param   out_sample_fmt      audio output sample format (e.g. AV_SAMPLE_FMT_S16).
+ * @param   out_buf             audio output buffer, NULL to leave the resampled
+ *                              data in the AudioResamplingState buffer only.
+ *
+ * @return                      the size of the resampled audio data.
+ */
+static int audio_resampling(VideoState * videoState, AVFrame * decoded_audio_frame, enum AVSampleFormat out_sample_fmt, uint8_t * out_buf)
+{
+    // retrieve the AudioResamplingState created in stream_component_open()
+    AudioResamplingState * arState = videoState->audio_resampler;
+
+    if (!arState)
+    {
+        printf("audio resampler not initialized.\n");
+        return -1;
+    }
+
+    // the output format is chosen when the audio device is opened
+    if (out_sample_fmt != arState->out_sample_fmt)
+    {
+        printf("unexpected output sample format.\n");
+        return -1;
+    }
+
+    // get input audio channels
+    int64_t in_channel_layout = (decoded_audio_frame->channels ==
+                                 av_get_channel_layout_nb_channels(decoded_audio_frame->channel_layout)) ?
+                                decoded_audio_frame->channel_layout :
+                                av_get_default_channel_layout(decoded_audio_frame->channels);
+
+    // check input audio channels correctly retrieved
+    if (in_channel_layout <= 0)
+    {
+        printf("in_channel_layout error.\n");
+        return -1;
+    }
+
+    // retrieve number of audio samples (per channel)
+    arState->in_nb_samples = decoded_audio_frame->nb_samples;
+    if (arState->in_nb_samples <= 0)
+    {
+        printf("in_nb_samples error.\n");
+        return -1;
+    }
+
+    // rebuild the SwrContext only if the input audio format actually changed
+    if (!arState->swr_ctx ||
+        in_channel_layout != arState->in_channel_layout ||
+        decoded_audio_frame->format != arState->in_sample_fmt ||
+        decoded_audio_frame->sample_rate != arState->in_sample_rate)
+    {
+        int ret = audio_resampling_init(
+                arState,
+                in_channel_layout,
+                decoded_audio_frame->format,
+                decoded_audio_frame->sample_rate
+        );
+
+        if (ret < 0)
+        {
+            return -1;
+        }
+    }
+
+    // get the number of samples this frame should produce to stay in sync
+    int wanted_nb_samples = synchronize_audio(videoState, arState->in_nb_samples);
+
+    // stretch or squeeze the audio inside the resampler instead of editing the output
+    if (wanted_nb_samples != arState->in_nb_samples)
+    {
+        int ret = swr_set_compensation(
+                arState->swr_ctx,
+                (wanted_nb_samples - arState->in_nb_samples) * arState->out_sample_rate / arState->in_sample_rate,
+                wanted_nb_samples * arState->out_sample_rate / arState->in_sample_rate
+        );
+
+        if (ret < 0)
+        {
+            printf("swr_set_compensation() failed.\n");
+            return -1;
+        }
+    }
+
+    // retrieve output samples number taking into account the progressive delay
+    // and the compensation; a small margin covers the resampler rounding
+    arState->out_nb_samples = av_rescale_rnd(
+            swr_get_delay(arState->swr_ctx, arState->in_sample_rate) + wanted_nb_samples,
+            arState->out_sample_rate,
+            arState->in_sample_rate,
+            AV_ROUND_UP
+    ) + 256;
+
+    // check output samples number was correctly rescaled
+    if (arState->out_nb_samples <= 0)
+    {
+        printf("av_rescale_rnd error\n");
+        return -1;
+    }
+
+    // grow the output buffer if needed: it is kept for the whole playback
+    if (arState->out_nb_samples > arState->max_out_nb_samples)
+    {
+        int ret;
+
+        if (arState->resampled_data)
+        {
+            // free memory block and set pointer to NULL
+            av_freep(&arState->resampled_data[0]);
+
+            // Allocate a samples buffer for out_nb_samples samples
+            ret = av_samples_alloc(
+                    arState->resampled_data,
+                    &arState->out_linesize,
+                    arState->out_nb_channels,
+                    arState->out_nb_samples,
+                    arState->out_sample_fmt,
+                    1
+            );
+        }
+        else
+        {
+            // allocate data pointers array for arState->resampled_data and fill data
+            // pointers and linesize accordingly
+            ret = av_samples_alloc_array_and_samples(
+                    &arState->resampled_data,
+                    &arState->out_linesize,
+                    arState->out_nb_channels,
+                    arState->out_nb_samples,
+                    arState->out_sample_fmt,
+                    1
+            );
+        }
+
+        // check samples buffer correctly allocated
+        if (ret < 0)
+        {
+            printf("av_samples_alloc failed.\n");
+            arState->max_out_nb_samples = 0;
+
+            if (arState->arena)
+            {
+                memory_arena_release(arState->arena, arState->buffer_size);
+                arState->buffer_size = 0;
+            }
+
+            return -1;
+        }
+
+        arState->max_out_nb_samples = arState->out_nb_samples;
+
+        // the output buffer is drawn from the audio arena
+        int buffer_size = av_samples_get_buffer_size(NULL, arState->out_nb_channels, arState->out_nb_samples, arState->out_sample_fmt, 1);
+        if (arState->arena && buffer_size > 0)
+        {
+            memory_arena_release(arState->arena, arState->buffer_size);
+            memory_arena_charge(arState->arena, buffer_size);
+            arState->buffer_size = buffer_size;
+        }
+    }
+
+    // do the actual audio data resampling
+    int ret = swr_convert(
+            arState->swr_ctx,
+            arState->resampled_data,
+            arState->out_nb_samples,
+            (const uint8_t **) decoded_audio_frame->data,
+            decoded_audio_frame->nb_samples
+    );
+
+    // check audio conversion was successful
+    if (ret < 0)
+    {
+        printf("swr_convert_error.\n");
+        return -1;
+    }
+
+    // get the required buffer size for the given audio parameters
+    arState->resampled_data_size = av_samples_get_buffer_size(
+            &arState->out_linesize,
+            arState->out_nb_channels,
+            ret,
+            arState->out_sample_fmt,
+            1
+    );
+
+    // check audio buffer size
+    if (arState->resampled_data_size < 0)
+    {
+        printf("av_samples_get_buffer_size error.\n");
+        return -1;
+    }
+
+    // copy the resampled data to the output buffer, if any
+    if (out_buf)
+    {
+        memcpy(out_buf, arState->resampled_data[0], arState->resampled_data_size);
+    }
+
+    return arState->resampled_data_size;
+}
+
+/**
+ * (Re)initializes the SwrContext of the given AudioResamplingState for the given
+ * input audio format. Any previous SwrContext is freed first.
+ *
+ * @param   arState             the AudioResamplingState to be (re)initialized.
+ * @param   in_channel_layout   input audio channel layout.
+ * @param   in_sample_fmt       input audio sample format.
+ * @param   in_sample_rate      input audio sample rate.
+ *
+ * @return                      < 0 in case of error, 0 otherwise.
+ */
+static int audio_resampling_init(AudioResamplingState * arState, int64_t in_channel_layout, enum AVSampleFormat in_sample_fmt, int in_sample_rate)
+{
+    // free the previous SwrContext, if any
+    swr_free(&arState->swr_ctx);
+
+    arState->swr_ctx = swr_alloc();
+    if (!arState->swr_ctx)
+    {
+        printf("swr_alloc error.\n");
+        return -1;
+    }
+
+    // Set SwrContext parameters for resampling
+    av_opt_set_int(arState->swr_ctx, "in_channel_layout", in_channel_layout, 0);
+    av_opt_set_int(arState->swr_ctx, "in_sample_rate", in_sample_rate, 0);
+    av_opt_set_sample_fmt(arState->swr_ctx, "in_sample_fmt", in_sample_fmt, 0);
+    av_opt_set_int(arState->swr_ctx, "out_channel_layout", arState->out_channel_layout, 0);
+    av_opt_set_int(arState->swr_ctx, "out_sample_rate", arState->out_sample_rate, 0);
+    av_opt_set_sample_fmt(arState->swr_ctx, "out_sample_fmt", arState->out_sample_fmt, 0);
+
+    // initialize SWR context after user parameters have been set
+    int ret = swr_init(arState->swr_ctx);
+    if (ret < 0)
+    {
+        printf("Failed to initialize the resampling context.\n");
+        swr_free(&arState->swr_ctx);
+        return -1;
+    }
+
+    // remember the input format the SwrContext was built for
+    arState->in_channel_layout = in_channel_layout;
+    arState->in_sample_fmt = in_sample_fmt;
+    arState->in_sample_rate = in_sample_rate;
+
+    return 0;
+}
+
+/**
+ * Initializes an instance of the AudioResamplingState Struct for the given audio
+ * codec context. The output channel layout and sample rate are the ones used to
+ * open the audio device. The SwrContext itself is created by audio_resampling()
+ * when the first decoded audio frame is available.
+ *
+ * @param   audio_ctx       the audio codec context to be used.
+ * @param   out_sample_fmt  audio output sample format (e.g. AV_SAMPLE_FMT_S16).
+ *
+ * @return                  the allocated and initialized AudioResamplingState
+ *                          struct instance, NULL in case of error.
+ */
+AudioResamplingState * getAudioResampling(AVCodecContext * audio_ctx, enum AVSampleFormat out_sample_fmt)
+{
+    AudioResamplingState * audioResampling = av_mallocz(sizeof(AudioResamplingState));
+    if (!audioResampling)
+    {
+        return NULL;
+    }
+
+    // set output audio channels based on the input audio channels
+    audioResampling->out_channel_layout = audio_output_layout(audio_ctx->channels);
+
+    audioResampling->swr_ctx = NULL;
+    audioResampling->in_channel_layout = 0;
+    audioResampling->in_sample_fmt = AV_SAMPLE_FMT_NONE;
+    audioResampling->in_sample_rate = 0;
+    audioResampling->out_sample_fmt = out_sample_fmt;
+    audioResampling->out_sample_rate = audio_ctx->sample_rate;
+    audioResampling->out_nb_channels = av_get_channel_layout_nb_channels(audioResampling->out_channel_layout);
+    audioResampling->out_linesize = 0;
+    audioResampling->in_nb_samples = 0;
+    audioResampling->out_nb_samples = 0;
+    audioResampling->max_out_nb_samples = 0;
+    audioResampling->resampled_data = NULL;
+    audioResampling->resampled_data_size = 0;
+    audioResampling->arena = NULL;
+    audioResampling->buffer_size = 0;
+
+    return audioResampling;
+}
+
+/**
+ * Returns the channel layout the decoded audio with the given number of
+ * channels is resampled to, the one the audio device is opened with: mono,
+ * stereo, or surround for anything else.
+ *
+ * @param   channels    the number of decoded audio channels.
+ *
+ * @return              the output channel layout.
+ */
+static uint64_t audio_output_layout(int channels)
+{
+    if (channels == 1)
+    {
+        return AV_CH_LAYOUT_MONO;
+    }
+    else if (channels == 2)
+    {
+        return AV_CH_LAYOUT_STEREO;
+    }
+
+    return AV_CH_LAYOUT_SURROUND;
+}
+
+/**
+ * Returns the number of interleaved channels of the resampled audio buffers.
+ * The device buffers, the AudioRing and the audio clock are sized on these, not
+ * on the decoded audio channels.
+ *
+ * @param   videoState  the VideoState.
+ *
+ * @return              the number of output channels.
+ */
+static int audio_output_channels(VideoState * videoState)
+{
+    return av_get_channel_layout_nb_channels(audio_output_layout(videoState->audio_ctx->channels));
+}
+
+/**
+ * Frees the given AudioResamplingState together with its SwrContext and output
+ * samples buffer, and sets the pointer to NULL.
+ *
+ * @param   arState the AudioResamplingState to be freed.
+ */
+void freeAudioResampling(AudioResamplingState ** arState)
+{
+    if (!arState || !*arState)
+    {
+        return;
+    }
+
+    if ((*arState)->resampled_data)
+    {
+        // free memory block and set pointer to NULL
+        av_freep(&(*arState)->resampled_data[0]);
+    }
+
+    av_freep(&(*arState)->resampled_data);
+
+    if ((*arState)->arena)
+    {
+        memory_arena_release((*arState)->arena, (*arState)->buffer_size);
+    }
+
+    // free the allocated SwrContext and set the pointer to NULL
+    swr_free(&(*arState)->swr_ctx);
+
+    av_freep(arState);
+}
+
+/**
+ * Requests the demux thread to seek to the given position. The request is ignored
+ * if the previous one has not been served yet.
+ *
+ * @param videoState    the VideoState.
+ * @param pos           the seek target, in AV_TIME_BASE units.
+ * @param rel           the seek offset from the current position, in AV_TIME_BASE
+ *                      units: the demuxer is not allowed to land on the other
+ *                      side of the current position.
+ */
+void stream_seek(VideoState * videoState, int64_t pos, int64_t rel)
+{
+    if (!videoState->seek_req)
+    {
+        videoState->seek_pos = pos;
+        videoState->seek_rel = rel;
+        videoState->seek_req = 1;
+
+        // wake the demux thread up in case it parked on the packet queues
+        demux_wake(videoState);
+    }
+}
\ No newline at end of file
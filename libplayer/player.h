@@ -0,0 +1,499 @@
+/**
+*
+*   File:   player.h
+*           libplayer: an embeddable FFmpeg and SDL2 media player, built from the
+*           tutorial07.c playback engine.
+*
+*           Each Player holds the whole state of one playback (demuxer, packet
+*           queues, decoding, demux, render and presentation threads, clocks,
+*           audio device and window), nothing is global: several independent
+*           players can run in the same process. Their decoding and scaling run
+*           as tasks on a pool of worker threads shared by all of them, which
+*           also share the video decoder threads budget; the blocking input
+*           reads stay on the demux thread of each player.
+*
+*           The host owns the SDL event loop: it calls SDL_Init() and SDL_Quit(),
+*           pumps the events and forwards the user input using the functions
+*           below. A player pushes a PLAYER_EVENT_DONE SDL_Event, with data1 set
+*           to the Player, once its playback ends; the player must then be
+*           closed with player_close().
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+/**
+ * SDL_Event type pushed when the playback of a Player ends: end of the input,
+ * maximum number of frames reached or error. event.user.data1 is the Player.
+ */
+#define PLAYER_EVENT_DONE (SDL_USEREVENT + 1)
+
+/**
+ * SDL_Event type pushed when a Player has frames to upload or present, on the
+ * platforms where SDL only renders from the main thread (macOS): the host must
+ * then call player_render(event.user.data1) from the main thread. Never pushed
+ * elsewhere, the render thread of each Player renders.
+ */
+#define PLAYER_EVENT_RENDER (SDL_USEREVENT + 2)
+
+/**
+ * Set if the frames are rendered on the main thread, see PLAYER_EVENT_RENDER.
+ */
+#if defined(__APPLE__)
+#define RENDER_ON_MAIN_THREAD 1
+#else
+#define RENDER_ON_MAIN_THREAD 0
+#endif
+
+/**
+ * Input backends, selected with --io=default|prefetch|mmap: the libavformat
+ * file protocol, a custom AVIOContext fed by a read-ahead thread, or a custom
+ * AVIOContext reading from the memory mapped file.
+ */
+#define INPUT_IO_DEFAULT 0
+#define INPUT_IO_PREFETCH 1
+#define INPUT_IO_MMAP 2
+
+/**
+ * Pseudo hardware device type used to request the automatic device selection.
+ */
+#define HW_DEVICE_TYPE_AUTO -1
+
+/**
+ * Player priorities, --priority=low|normal|high: the tasks of the higher
+ * priority players run first on the shared workers, and the share of a player
+ * in the decoder threads budget doubles with each level.
+ */
+#define PLAYER_PRIORITY_LOW 0
+#define PLAYER_PRIORITY_NORMAL 1
+#define PLAYER_PRIORITY_HIGH 2
+
+/**
+ * Video renderers, selected with --renderer=sdl|gl: the SDL_Renderer, or the
+ * OpenGL renderer converting and scaling the frames in a fragment shader.
+ */
+#define PLAYER_RENDERER_SDL 0
+#define PLAYER_RENDERER_GL 1
+
+/**
+ * A/V sync master clocks, selected with --sync=audio|video|external.
+ */
+#define PLAYER_SYNC_AUDIO 0
+#define PLAYER_SYNC_VIDEO 1
+#define PLAYER_SYNC_EXTERNAL 2
+
+/**
+ * Frame status reported by player_replay(): shown, dropped from the picture
+ * queue by the presentation, or skipped right after decoding.
+ */
+#define PLAYER_TRACE_SHOWN 0
+#define PLAYER_TRACE_DROPPED 1
+#define PLAYER_TRACE_SKIPPED 2
+
+/**
+ * A player instance. Opaque, only accessed through the functions below.
+ */
+typedef struct VideoState Player;
+
+/**
+ * Playback options, set to their defaults by player_options_default() and
+ * parsed from the command line arguments by player_parse_option().
+ */
+typedef struct PlayerOptions
+{
+    /**
+     * Maximum number of frames to be displayed, 0 plays the whole input.
+     */
+    long    max_frames;
+
+    /**
+     * Decoded pictures queue size.
+     */
+    int     pictq_size;
+
+    /**
+     * Video decoding: the number of decoder threads (0 for a share of the
+     * decoder threads budget), the FF_THREAD_* threading types and the
+     * AVHWDeviceType (AV_HWDEVICE_TYPE_NONE for software decoding,
+     * HW_DEVICE_TYPE_AUTO for the platform devices).
+     */
+    int     video_decoder_threads;
+    int     video_decoder_thread_type;
+    int     hw_device_type;
+
+    /**
+     * Audio device buffer size in samples, 0 to derive it from the sample rate.
+     */
+    int     audio_buffer_samples;
+
+    /**
+     * Seeking and startup flags.
+     */
+    int     accurate_seek;
+    int     seek_index;
+    int     fast_start;
+
+    /**
+     * Input backend (INPUT_IO_*), its buffer size and the read-ahead of the
+     * prefetch backend, in bytes.
+     */
+    int     input_io;
+    int     input_io_buffer_size;
+    int     input_prefetch_size;
+
+    /**
+     * Network inputs: the jitter buffer depth in milliseconds, < 0 for the
+     * default, and the live mode flag.
+     */
+    int     jitter_buffer;
+    int     live;
+
+    /**
+     * Pipeline stats dump file, NULL if none: JSON lines if its name ends in
+     * .json, CSV otherwise.
+     */
+    const char *    stats_file;
+
+    /**
+     * Scheduling: the player priority (PLAYER_PRIORITY_*), then the number of
+     * shared worker threads and the decoder threads budget, both 0 for one
+     * per core. The latter two only apply if no other player is opened.
+     */
+    int     priority;
+    int     workers;
+    int     decoder_thread_budget;
+
+    /**
+     * Number of bands the sws_scale() conversion is split in, converted in
+     * parallel on the shared workers, 0 to pick it from the frame height.
+     */
+    int     scale_slices;
+
+    /**
+     * Video renderer, PLAYER_RENDERER_*.
+     */
+    int     renderer;
+
+    /**
+     * Memory budget of the player, in bytes, split between the memory arenas
+     * (PLAYER_MEMORY_*).
+     */
+    int     memory_budget;
+
+    /**
+     * A/V sync master clock, PLAYER_SYNC_*.
+     */
+    int     av_sync_type;
+} PlayerOptions;
+
+/**
+ * Pipeline stages and measures timed by the instrumentation.
+ */
+enum
+{
+    PLAYER_STAGE_DEMUX,
+    PLAYER_STAGE_VIDEO_DECODE,
+    PLAYER_STAGE_SCALE,
+    PLAYER_STAGE_UPLOAD,
+    PLAYER_STAGE_PRESENT,
+    PLAYER_STAGE_AV_SYNC,
+    PLAYER_STAGE_AUDIO_DECODE,
+    PLAYER_STAGE_RESAMPLE,
+    PLAYER_STAGE_NB
+};
+
+/**
+ * Memory arenas of a player: the video and audio packet queues, the decoded
+ * pictures queue, the decoded audio buffers and the input backend buffers.
+ */
+enum
+{
+    PLAYER_MEMORY_VIDEOQ,
+    PLAYER_MEMORY_AUDIOQ,
+    PLAYER_MEMORY_PICTURES,
+    PLAYER_MEMORY_AUDIO,
+    PLAYER_MEMORY_INPUT,
+    PLAYER_MEMORY_NB
+};
+
+/**
+ * Usage of a memory arena, in bytes: currently allocated, peak since
+ * player_open() and the arena share of the memory budget.
+ */
+typedef struct PlayerMemoryStats
+{
+    int     current;
+    int     peak;
+    int     limit;
+} PlayerMemoryStats;
+
+/**
+ * Latency summary of a pipeline stage over one stats interval, in milliseconds.
+ * The percentiles are the upper bounds of their histogram buckets.
+ */
+typedef struct PlayerStageStats
+{
+    int     count;
+    double  mean;
+    double  p50;
+    double  p99;
+    double  max;
+} PlayerStageStats;
+
+/**
+ * Pipeline stats of the last stats interval. time is in seconds since
+ * player_open(). The queue depths and av_diff (in milliseconds) are sampled at
+ * the end of the interval, the dropped frames counters are totals since the
+ * playback start.
+ */
+typedef struct PlayerIntervalStats
+{
+    double              time;
+    PlayerStageStats    stages[PLAYER_STAGE_NB];
+    int                 audioq_packets;
+    int                 audioq_size;
+    int                 videoq_packets;
+    int                 videoq_size;
+    int                 pictq_size;
+    double              av_diff;
+    int                 frames_dropped;
+    int                 frames_skipped;
+} PlayerIntervalStats;
+
+/**
+ * Player stats, filled by player_get_stats(). The times are in milliseconds,
+ * the startup ones since player_open() and < 0 if the step was not reached.
+ * The input backend counters are 0 with INPUT_IO_DEFAULT.
+ */
+typedef struct PlayerStats
+{
+    /**
+     * Current playback position, on the master clock, in seconds.
+     */
+    double              position;
+
+    /**
+     * Last stats interval.
+     */
+    PlayerIntervalStats interval;
+
+    /**
+     * Late frames drop policy.
+     */
+    int                 frames_dropped;
+    int                 frames_skipped;
+    int                 decoder_skip_level;
+
+    /**
+     * Network inputs rebuffering.
+     */
+    int                 rebuffer_count;
+    double              rebuffer_time;
+
+    /**
+     * Startup timing.
+     */
+    double              open_time;
+    double              probe_time;
+    double              codec_open_time;
+    double              first_packet_time;
+    double              first_display_time;
+
+    /**
+     * Input backend: bytes read, time spent reading and time the demuxer waited
+     * for data.
+     */
+    int64_t             input_bytes;
+    double              input_time;
+    double              input_stall_time;
+
+    /**
+     * Sliced conversion: the bands the last converted frame was split in, and
+     * the shared workers converting them.
+     */
+    int                 scale_slices;
+    int                 scale_workers;
+
+    /**
+     * Memory budget, in bytes, and the usage of each memory arena, indexed by
+     * PLAYER_MEMORY_*.
+     */
+    int                 memory_budget;
+    PlayerMemoryStats   memory[PLAYER_MEMORY_NB];
+} PlayerStats;
+
+/**
+ * Frame reported by player_replay(), in the order the frames were shown,
+ * dropped or skipped. The times are in seconds: the frame pts, the virtual
+ * time it was shown, dropped or skipped at, the audio clock at that time and
+ * the A/V difference, pts - audio_clock.
+ */
+typedef struct PlayerTraceFrame
+{
+    int     index;
+    int     status;
+    double  pts;
+    double  time;
+    double  audio_clock;
+    double  av_diff;
+} PlayerTraceFrame;
+
+/**
+ * player_replay() trace callback.
+ *
+ * @param   opaque  the callback argument given to player_replay().
+ * @param   frame   the frame, only valid during the call.
+ */
+typedef void (* PlayerTraceCallback)(void * opaque, const PlayerTraceFrame * frame);
+
+/**
+ * Sets the given PlayerOptions to their default values.
+ *
+ * @param   options the PlayerOptions to be initialized.
+ */
+void player_options_default(PlayerOptions * options);
+
+/**
+ * Parses the given command line option (e.g. --threads=4) into the given
+ * PlayerOptions. An error message is printed if the option is unknown or its
+ * value invalid.
+ *
+ * @param   options the PlayerOptions to be updated.
+ * @param   arg     the command line option.
+ *
+ * @return          < 0 if the option is unknown or invalid, 0 otherwise.
+ */
+int player_parse_option(PlayerOptions * options, const char * arg);
+
+/**
+ * Prints the usage of the options parsed by player_parse_option().
+ */
+void player_print_options();
+
+/**
+ * Creates a Player for the given media file or url. Nothing is read until
+ * player_play() is called.
+ *
+ * @param   url     media file name or url.
+ * @param   options the playback options, copied.
+ *
+ * @return          the new Player, NULL in case of error.
+ */
+Player * player_open(const char * url, const PlayerOptions * options);
+
+/**
+ * Starts the playback: the input is opened and demuxed, and its window and
+ * audio device are opened, on the player threads.
+ *
+ * @param   player  the Player.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+int player_play(Player * player);
+
+/**
+ * Replays the input on the calling thread instead of starting the playback,
+ * as fast as it can be decoded, against a virtual clock and a simulated audio
+ * device: no window nor audio device is opened. The same input and options
+ * give the same trace on any machine. Returns at the end of the input, the
+ * player must then be closed with player_close().
+ *
+ * @param   player              the Player, not playing.
+ * @param   video_decode_time   virtual time taken to decode each video frame,
+ *                              in seconds, 0 for instant decoding.
+ * @param   callback            called for each frame shown, dropped or skipped,
+ *                              may be NULL.
+ * @param   opaque              the callback argument.
+ *
+ * @return                      < 0 in case of error, 0 otherwise.
+ */
+int player_replay(Player * player, double video_decode_time, PlayerTraceCallback callback, void * opaque);
+
+/**
+ * Runs the input through the demuxing, decoding, conversion and audio
+ * resampling of the playback on the calling thread, as fast as possible, for
+ * benchmarking: as player_replay() with instant virtual decoding, but the
+ * video decoder threads and hardware device of the options are used, so the
+ * trace is not deterministic. Once it returns, the last stats interval of
+ * player_get_stats() covers the whole run. The player must then be closed with
+ * player_close().
+ *
+ * @param   player      the Player, not playing.
+ * @param   convert     != 0 to convert every decoded frame with the sliced
+ *                      sws_scale(), even those the renderer uploads directly.
+ * @param   callback    called for each frame shown, dropped or skipped, may be
+ *                      NULL.
+ * @param   opaque      the callback argument.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+int player_bench(Player * player, int convert, PlayerTraceCallback callback, void * opaque);
+
+/**
+ * Seeks by the given offset from the current playback position.
+ *
+ * @param   player  the Player.
+ * @param   offset  the seek offset, in seconds, negative to seek backward.
+ */
+void player_seek(Player * player, double offset);
+
+/**
+ * Fills the given PlayerStats with the current stats of the given Player.
+ *
+ * @param   player  the Player.
+ * @param   stats   the PlayerStats to be filled.
+ */
+void player_get_stats(Player * player, PlayerStats * stats);
+
+/**
+ * Shows or hides the pipeline stats overlay drawn over the video.
+ *
+ * @param   player  the Player.
+ */
+void player_toggle_stats_overlay(Player * player);
+
+/**
+ * Returns the SDL window id of the given Player, used to route the window and
+ * keyboard events to it.
+ *
+ * @param   player  the Player.
+ *
+ * @return          the SDL window id, 0 if the window is not opened yet.
+ */
+Uint32 player_get_window_id(Player * player);
+
+/**
+ * Uploads and presents the pending frames of the given Player: to be called
+ * from the main thread on each PLAYER_EVENT_RENDER. Does nothing if the
+ * frames are rendered by the render thread of the Player.
+ *
+ * @param   player  the Player.
+ */
+void player_render(Player * player);
+
+/**
+ * Returns whether the playback of the given Player has ended.
+ *
+ * @param   player  the Player.
+ *
+ * @return          != 0 if the playback has ended, 0 otherwise.
+ */
+int player_is_done(Player * player);
+
+/**
+ * Stops the playback, waits for the player threads and releases all of the
+ * resources of the given Player, including its pending PLAYER_EVENT_DONE and
+ * PLAYER_EVENT_RENDER events. To be called from the main thread.
+ *
+ * @param   player  the Player, may be NULL.
+ */
+void player_close(Player * player);
+
+#endif // PLAYER_H
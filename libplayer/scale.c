@@ -0,0 +1,295 @@
+/**
+*
+*   File:   scale.c
+*           libplayer sliced scaler: the bands of a frame are claimed one at a
+*           time by the caller and the helper tasks, each converted with its own
+*           SwsContext. See scale.h.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <libavutil/common.h>
+#include <libavutil/pixdesc.h>
+#include "scale.h"
+
+/**
+ * Value of next_slice between two conversions: past the last band of any
+ * conversion, the late helpers claim nothing.
+ */
+#define SCALE_SLICES_CLOSED (1 << 30)
+
+/**
+ * Methods declaration.
+ */
+static int slice_scaler_step(void * arg);
+
+static int slice_scaler_run_slice(SliceScaler * scaler);
+
+/**
+ * Initializes the given SliceScaler.
+ *
+ * @param   scaler      the SliceScaler.
+ * @param   nb_slices   the number of bands, 0 for auto.
+ * @param   flags       the SWS_* flags.
+ * @param   priority    the helper tasks priority.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+int slice_scaler_init(SliceScaler * scaler, int nb_slices, int flags, int priority)
+{
+    memset(scaler, 0, sizeof(SliceScaler));
+
+    scaler->nb_slices = av_clip(nb_slices, 0, SCALE_MAX_SLICES);
+    scaler->flags = flags;
+    scaler->priority = priority;
+    SDL_AtomicSet(&scaler->next_slice, SCALE_SLICES_CLOSED);
+
+    scaler->mutex = SDL_CreateMutex();
+    scaler->cond = SDL_CreateCond();
+    if (!scaler->mutex || !scaler->cond)
+    {
+        printf("Could not create the scaler locks: %s.\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Converts the given source frame into the given destination frame.
+ *
+ * @param   scaler  the SliceScaler.
+ * @param   src     the source AVFrame.
+ * @param   dst     the destination AVFrame.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+int slice_scaler_scale(SliceScaler * scaler, const AVFrame * src, AVFrame * dst)
+{
+    const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(src->format);
+
+    // the bands need a 1:1 vertical conversion and planes which can be offset
+    // by rows: the palette of the paletted formats cannot
+    int workers = scheduler_workers();
+    int nb_slices = 1;
+
+    if (workers > 0 && src->height == dst->height && desc && !(desc->flags & AV_PIX_FMT_FLAG_PAL))
+    {
+        nb_slices = scaler->nb_slices > 0 ?
+                    scaler->nb_slices :
+                    av_clip(src->height / SCALE_SLICE_MIN_HEIGHT, 1, FFMIN(workers, SCALE_MAX_SLICES));
+    }
+
+    int slice_height = FFALIGN((src->height + nb_slices - 1) / nb_slices, SCALE_SLICE_ALIGN);
+    if (nb_slices == 1 || slice_height >= src->height)
+    {
+        nb_slices = 1;
+        slice_height = src->height;
+    }
+    else
+    {
+        // the alignment may leave the last bands empty
+        nb_slices = (src->height + slice_height - 1) / slice_height;
+    }
+
+    // the contexts are built by the caller, the helpers never fail
+    for (int i = 0; i < nb_slices; i++)
+    {
+        int src_height = nb_slices > 1 ? FFMIN(slice_height, src->height - i * slice_height) : src->height;
+        int dst_height = nb_slices > 1 ? src_height : dst->height;
+
+        scaler->sws_ctx[i] = sws_getCachedContext(scaler->sws_ctx[i],
+                                                  src->width,
+                                                  src_height,
+                                                  src->format,
+                                                  dst->width,
+                                                  dst_height,
+                                                  dst->format,
+                                                  scaler->flags,
+                                                  NULL,
+                                                  NULL,
+                                                  NULL
+        );
+        if (!scaler->sws_ctx[i])
+        {
+            printf("Could not initialize the conversion context.\n");
+            return -1;
+        }
+    }
+
+    // next_slice is closed: the job can be set
+    scaler->job_slices = nb_slices;
+    scaler->slice_height = slice_height;
+
+    if (nb_slices == 1)
+    {
+        sws_scale(
+                scaler->sws_ctx[0],
+                (uint8_t const * const *)src->data,
+                src->linesize,
+                0,
+                src->height,
+                dst->data,
+                dst->linesize
+        );
+
+        return 0;
+    }
+
+    // the helper tasks are initialized the first time they are needed
+    for (; scaler->nb_tasks < nb_slices - 1; scaler->nb_tasks++)
+    {
+        scheduler_task_init(&scaler->tasks[scaler->nb_tasks], slice_scaler_step, scaler, scaler->priority);
+    }
+
+    // set the frames, then open the job to the helpers
+    scaler->src = src;
+    scaler->dst = dst;
+    SDL_AtomicSet(&scaler->done_slices, 0);
+    SDL_AtomicSet(&scaler->next_slice, 0);
+
+    for (int i = 0; i < nb_slices - 1; i++)
+    {
+        scheduler_task_wake(&scaler->tasks[i]);
+    }
+
+    // convert the bands not claimed by the helpers yet
+    while (slice_scaler_run_slice(scaler) == 0);
+
+    // all of the bands are claimed: only wait for the ones being converted
+    SDL_LockMutex(scaler->mutex);
+    while (SDL_AtomicGet(&scaler->done_slices) < nb_slices)
+    {
+        SDL_CondWait(scaler->cond, scaler->mutex);
+    }
+    SDL_UnlockMutex(scaler->mutex);
+
+    SDL_AtomicSet(&scaler->next_slice, SCALE_SLICES_CLOSED);
+
+    return 0;
+}
+
+/**
+ * Stops the helper tasks and frees the SwsContexts of the given SliceScaler.
+ *
+ * @param   scaler  the SliceScaler, may be zeroed.
+ */
+void slice_scaler_free(SliceScaler * scaler)
+{
+    scaler->quit = 1;
+
+    for (int i = 0; i < scaler->nb_tasks; i++)
+    {
+        scheduler_task_join(&scaler->tasks[i]);
+    }
+    scaler->nb_tasks = 0;
+
+    for (int i = 0; i < SCALE_MAX_SLICES; i++)
+    {
+        sws_freeContext(scaler->sws_ctx[i]);
+        scaler->sws_ctx[i] = NULL;
+    }
+
+    if (scaler->cond)
+    {
+        SDL_DestroyCond(scaler->cond);
+        scaler->cond = NULL;
+    }
+
+    if (scaler->mutex)
+    {
+        SDL_DestroyMutex(scaler->mutex);
+        scaler->mutex = NULL;
+    }
+}
+
+/**
+ * Step function of the helper tasks: converts bands until none is left to be
+ * claimed.
+ *
+ * @param   arg the SliceScaler.
+ *
+ * @return      SCHEDULER_TASK_DONE once the SliceScaler is freed,
+ *              SCHEDULER_TASK_PARK otherwise.
+ */
+static int slice_scaler_step(void * arg)
+{
+    SliceScaler * scaler = (SliceScaler *)arg;
+
+    if (scaler->quit)
+    {
+        return SCHEDULER_TASK_DONE;
+    }
+
+    while (slice_scaler_run_slice(scaler) == 0);
+
+    return SCHEDULER_TASK_PARK;
+}
+
+/**
+ * Claims the next band of the current conversion and converts it. The last
+ * band converted signals the caller.
+ *
+ * @param   scaler  the SliceScaler.
+ *
+ * @return          < 0 if there is no band left, 0 otherwise.
+ */
+static int slice_scaler_run_slice(SliceScaler * scaler)
+{
+    int slice = SDL_AtomicAdd(&scaler->next_slice, 1);
+    if (slice >= scaler->job_slices)
+    {
+        return -1;
+    }
+
+    const AVFrame * src = scaler->src;
+    AVFrame * dst = scaler->dst;
+    const AVPixFmtDescriptor * src_desc = av_pix_fmt_desc_get(src->format);
+    const AVPixFmtDescriptor * dst_desc = av_pix_fmt_desc_get(dst->format);
+
+    int y = slice * scaler->slice_height;
+    int height = FFMIN(scaler->slice_height, src->height - y);
+
+    // the chroma planes 1 and 2 are subsampled, the luma and alpha ones are not
+    const uint8_t * src_data[AV_NUM_DATA_POINTERS] = {NULL};
+    uint8_t * dst_data[AV_NUM_DATA_POINTERS] = {NULL};
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (src->data[i])
+        {
+            int rows = (i == 1 || i == 2) ? y >> src_desc->log2_chroma_h : y;
+            src_data[i] = src->data[i] + rows * src->linesize[i];
+        }
+
+        if (dst->data[i])
+        {
+            int rows = (i == 1 || i == 2) ? y >> dst_desc->log2_chroma_h : y;
+            dst_data[i] = dst->data[i] + rows * dst->linesize[i];
+        }
+    }
+
+    sws_scale(
+            scaler->sws_ctx[slice],
+            src_data,
+            src->linesize,
+            0,
+            height,
+            dst_data,
+            dst->linesize
+    );
+
+    // the caller may be waiting for this band
+    if (SDL_AtomicAdd(&scaler->done_slices, 1) + 1 == scaler->job_slices)
+    {
+        SDL_LockMutex(scaler->mutex);
+        SDL_CondSignal(scaler->cond);
+        SDL_UnlockMutex(scaler->mutex);
+    }
+
+    return 0;
+}
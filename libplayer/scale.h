@@ -0,0 +1,123 @@
+/**
+*
+*   File:   scale.h
+*           libplayer sliced scaler: converts a frame with sws_scale() split in
+*           horizontal bands, each with its own SwsContext, converted in
+*           parallel on the shared scheduler workers.
+*
+*           The caller converts bands too, and only waits for the bands already
+*           being converted by the workers: a SliceScaler used from a scheduler
+*           task never waits for a queued task.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+#include <SDL2/SDL.h>
+#include "scheduler.h"
+
+/**
+ * Maximum number of bands of a frame.
+ */
+#define SCALE_MAX_SLICES 16
+
+/**
+ * Minimum height of a band, in rows, when the number of bands is picked
+ * automatically: smaller frames are not worth splitting.
+ */
+#define SCALE_SLICE_MIN_HEIGHT 270
+
+/**
+ * Bands are a multiple of this many rows high, keeping the chroma planes of
+ * the subsampled formats aligned on the band boundaries.
+ */
+#define SCALE_SLICE_ALIGN 16
+
+/**
+ * A sliced scaler, owned by its caller.
+ */
+typedef struct SliceScaler
+{
+    /**
+     * Options: the number of bands (0 picks it from the frame height and the
+     * number of workers), the SWS_* flags and the helper tasks priority.
+     */
+    int                     nb_slices;
+    int                     flags;
+    int                     priority;
+
+    /**
+     * One SwsContext per band, only rebuilt when the format or the resolution
+     * of the frames changes.
+     */
+    struct SwsContext *     sws_ctx[SCALE_MAX_SLICES];
+
+    /**
+     * Current conversion, or the last one: the frames, the number and height
+     * of its bands, the next band to be claimed and the bands converted.
+     * next_slice is kept past the last band between two conversions.
+     */
+    const AVFrame *         src;
+    AVFrame *               dst;
+    int                     job_slices;
+    int                     slice_height;
+    SDL_atomic_t            next_slice;
+    SDL_atomic_t            done_slices;
+
+    /**
+     * Signaled when the last band is converted.
+     */
+    SDL_mutex *             mutex;
+    SDL_cond *              cond;
+
+    /**
+     * Helper tasks converting the bands on the workers, initialized the first
+     * time they are needed.
+     */
+    SchedulerTask           tasks[SCALE_MAX_SLICES - 1];
+    int                     nb_tasks;
+    int                     quit;
+} SliceScaler;
+
+/**
+ * Initializes the given SliceScaler.
+ *
+ * @param   scaler      the SliceScaler.
+ * @param   nb_slices   the number of bands (1-SCALE_MAX_SLICES), 0 to pick it
+ *                      from the frame height and the number of workers.
+ * @param   flags       the SWS_* flags of the SwsContexts.
+ * @param   priority    the SCHEDULER_PRIORITY_* of the helper tasks.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+int slice_scaler_init(SliceScaler * scaler, int nb_slices, int flags, int priority);
+
+/**
+ * Converts the given source frame into the given destination frame, whose
+ * width, height, format and planes must be set. The frame is only split if
+ * both have the same height and the scheduler is started, otherwise it is
+ * converted at once by the caller.
+ *
+ * @param   scaler  the SliceScaler.
+ * @param   src     the source AVFrame.
+ * @param   dst     the destination AVFrame.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+int slice_scaler_scale(SliceScaler * scaler, const AVFrame * src, AVFrame * dst);
+
+/**
+ * Stops the helper tasks and frees the SwsContexts of the given SliceScaler.
+ * Must be called before the scheduler reference of the caller is released.
+ *
+ * @param   scaler  the SliceScaler, may be zeroed.
+ */
+void slice_scaler_free(SliceScaler * scaler);
+
+#endif // SCALE_H
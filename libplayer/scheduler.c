@@ -0,0 +1,614 @@
+/**
+*
+*   File:   scheduler.c
+*           libplayer shared scheduler: a pool of worker threads with one task
+*           queue per worker and priority, idle workers steal the tasks queued
+*           on the others. See scheduler.h.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_thread.h>
+#include "scheduler.h"
+
+/**
+ * SchedulerTask states: parked, queued on a worker, running, woken up while
+ * running (it is queued again once its step returns) and done.
+ */
+#define SCHEDULER_TASK_STATE_IDLE 0
+#define SCHEDULER_TASK_STATE_QUEUED 1
+#define SCHEDULER_TASK_STATE_RUNNING 2
+#define SCHEDULER_TASK_STATE_WOKEN 3
+#define SCHEDULER_TASK_STATE_DONE 4
+
+/**
+ * A FIFO of SchedulerTasks, linked through their next field. size is read
+ * without the lock by the workers looking for a task to steal.
+ */
+typedef struct SchedulerQueue
+{
+    SDL_SpinLock        lock;
+    SchedulerTask *     head;
+    SchedulerTask *     tail;
+    SDL_atomic_t        size;
+} SchedulerQueue;
+
+/**
+ * A worker thread and its queues, one per priority.
+ */
+typedef struct SchedulerWorker
+{
+    SDL_Thread *            tid;
+    int                     index;
+    SchedulerQueue          queues[SCHEDULER_PRIORITY_NB];
+    struct Scheduler *      scheduler;
+} SchedulerWorker;
+
+/**
+ * The shared scheduler.
+ */
+typedef struct Scheduler
+{
+    /**
+     * References taken by scheduler_acquire(), the sum of their priority
+     * weights, the video decoder threads budget they share and the threads of
+     * the budget taken by the opened decoders.
+     */
+    int                 refs;
+    SDL_atomic_t        total_weight;
+    int                 decoder_threads;
+    SDL_atomic_t        decoder_threads_used;
+
+    /**
+     * Worker threads, the worker of the calling thread is kept in the tls
+     * slot, next_worker spreads the tasks woken from the other threads.
+     * started_workers publishes nb_workers once all of them are started, and
+     * is cleared before they are stopped, for scheduler_workers().
+     */
+    SchedulerWorker     workers[SCHEDULER_MAX_WORKERS];
+    int                 nb_workers;
+    SDL_atomic_t        started_workers;
+    SDL_TLSID           tls;
+    SDL_atomic_t        next_worker;
+
+    /**
+     * The idle workers sleep on cond until a task is queued: pending counts the
+     * queued tasks, nb_sleeping the sleeping workers.
+     */
+    SDL_mutex *         mutex;
+    SDL_cond *          cond;
+    SDL_atomic_t        pending;
+    SDL_atomic_t        nb_sleeping;
+    int                 quit;
+
+    /**
+     * Signaled each time a task is done, for scheduler_task_join().
+     */
+    SDL_mutex *         done_mutex;
+    SDL_cond *          done_cond;
+} Scheduler;
+
+/**
+ * The scheduler shared by all of the players of the process, and the mutex
+ * serializing its start and stop: they create and join threads, a spin lock
+ * would make the other callers spin meanwhile. The mutex is created on first
+ * use, it cannot be initialized statically, and kept across restarts.
+ */
+static Scheduler scheduler;
+static SDL_mutex * scheduler_mutex;
+
+/**
+ * Methods declaration.
+ */
+static int scheduler_worker(void * arg);
+
+static void scheduler_push(Scheduler * s, SchedulerTask * task);
+
+static SchedulerTask * scheduler_take(Scheduler * s, SchedulerWorker * worker);
+
+static void scheduler_run(Scheduler * s, SchedulerTask * task);
+
+static void scheduler_stop(Scheduler * s);
+
+static SDL_mutex * scheduler_lock();
+
+/**
+ * Returns the weight of the given priority in the decoder threads budget
+ * sharing: each priority level doubles it.
+ *
+ * @param   priority    the SCHEDULER_PRIORITY_*.
+ *
+ * @return              the weight.
+ */
+static inline int scheduler_weight(int priority)
+{
+    return 1 << priority;
+}
+
+/**
+ * Takes a reference on the shared scheduler, starting it the first time.
+ *
+ * @param   workers         number of worker threads, 0 for one per core.
+ * @param   decoder_threads video decoder threads budget, 0 for one per core.
+ * @param   priority        the priority of the caller.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+int scheduler_acquire(int workers, int decoder_threads, int priority)
+{
+    Scheduler * s = &scheduler;
+    int ret = 0;
+
+    SDL_mutex * mutex = scheduler_lock();
+    if (!mutex)
+    {
+        printf("Could not create the scheduler mutex: %s.\n", SDL_GetError());
+        return -1;
+    }
+
+    if (s->refs == 0)
+    {
+        // the tls slot cannot be freed, it is kept across restarts
+        SDL_TLSID tls = s->tls;
+
+        memset(s, 0, sizeof(Scheduler));
+
+        s->nb_workers = workers > 0 ? workers : SDL_GetCPUCount();
+        s->nb_workers = s->nb_workers < SCHEDULER_MAX_WORKERS ? s->nb_workers : SCHEDULER_MAX_WORKERS;
+        s->decoder_threads = decoder_threads > 0 ? decoder_threads : SDL_GetCPUCount();
+
+        s->tls = tls ? tls : SDL_TLSCreate();
+        s->mutex = SDL_CreateMutex();
+        s->cond = SDL_CreateCond();
+        s->done_mutex = SDL_CreateMutex();
+        s->done_cond = SDL_CreateCond();
+
+        if (!s->tls || !s->mutex || !s->cond || !s->done_mutex || !s->done_cond)
+        {
+            printf("Could not create the scheduler locks: %s.\n", SDL_GetError());
+            scheduler_stop(s);
+            ret = -1;
+            goto end;
+        }
+
+        for (int i = 0; i < s->nb_workers; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "Player Worker %d", i);
+
+            s->workers[i].index = i;
+            s->workers[i].scheduler = s;
+            s->workers[i].tid = SDL_CreateThread(scheduler_worker, name, &s->workers[i]);
+            if (!s->workers[i].tid)
+            {
+                printf("Could not start scheduler worker SDL_Thread: %s.\n", SDL_GetError());
+                scheduler_stop(s);
+                ret = -1;
+                goto end;
+            }
+        }
+
+        SDL_AtomicSet(&s->started_workers, s->nb_workers);
+    }
+
+    s->refs++;
+    SDL_AtomicAdd(&s->total_weight, scheduler_weight(priority));
+
+    end:
+    {
+        SDL_UnlockMutex(mutex);
+        return ret;
+    };
+}
+
+/**
+ * Releases a reference taken by scheduler_acquire(), the last one stops the
+ * worker threads.
+ *
+ * @param   priority    the priority given to scheduler_acquire().
+ */
+void scheduler_release(int priority)
+{
+    Scheduler * s = &scheduler;
+
+    // taken by scheduler_acquire(), the mutex exists
+    SDL_mutex * mutex = scheduler_lock();
+
+    SDL_AtomicAdd(&s->total_weight, -scheduler_weight(priority));
+
+    if (--s->refs == 0)
+    {
+        scheduler_stop(s);
+    }
+
+    SDL_UnlockMutex(mutex);
+}
+
+/**
+ * Takes the share of the video decoder threads budget of a caller of the given
+ * priority, capped to the threads left.
+ *
+ * @param   priority    the priority of the caller.
+ *
+ * @return              the number of decoder threads, at least 1.
+ */
+int scheduler_decoder_threads_acquire(int priority)
+{
+    Scheduler * s = &scheduler;
+    int threads = 1;
+
+    int total_weight = SDL_AtomicGet(&s->total_weight);
+    if (total_weight > 0)
+    {
+        threads = s->decoder_threads * scheduler_weight(priority) / total_weight;
+    }
+
+    // take what is left of the budget, unless another caller took it meanwhile;
+    // a decoder always gets one thread, even past the budget
+    for (;;)
+    {
+        int used = SDL_AtomicGet(&s->decoder_threads_used);
+        int left = s->decoder_threads - used;
+
+        int taken = threads < left ? threads : left;
+        taken = taken > 1 ? taken : 1;
+
+        if (SDL_AtomicCAS(&s->decoder_threads_used, used, used + taken))
+        {
+            return taken;
+        }
+    }
+}
+
+/**
+ * Gives back video decoder threads taken by scheduler_decoder_threads_acquire().
+ *
+ * @param   threads the number of decoder threads.
+ */
+void scheduler_decoder_threads_release(int threads)
+{
+    SDL_AtomicAdd(&scheduler.decoder_threads_used, -threads);
+}
+
+/**
+ * Returns the number of worker threads of the shared scheduler. Lock-free, it is
+ * called for each converted frame.
+ *
+ * @return  the number of workers, 0 if the scheduler is not started.
+ */
+int scheduler_workers()
+{
+    return SDL_AtomicGet(&scheduler.started_workers);
+}
+
+/**
+ * Initializes the given SchedulerTask, parked.
+ *
+ * @param   task        the SchedulerTask.
+ * @param   func        the step function.
+ * @param   arg         the step function argument.
+ * @param   priority    the task priority.
+ */
+void scheduler_task_init(SchedulerTask * task, SchedulerTaskFunc func, void * arg, int priority)
+{
+    task->func = func;
+    task->arg = arg;
+    task->priority = priority;
+    task->next = NULL;
+    SDL_AtomicSet(&task->state, SCHEDULER_TASK_STATE_IDLE);
+}
+
+/**
+ * Queues the given SchedulerTask if it is parked, or makes it run once more if
+ * it is running.
+ *
+ * @param   task    the SchedulerTask, may be NULL.
+ */
+void scheduler_task_wake(SchedulerTask * task)
+{
+    if (!task || !task->func)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        int state = SDL_AtomicGet(&task->state);
+
+        if (state == SCHEDULER_TASK_STATE_IDLE)
+        {
+            // only one of the concurrent wake-ups queues the task
+            if (SDL_AtomicCAS(&task->state, state, SCHEDULER_TASK_STATE_QUEUED))
+            {
+                scheduler_push(&scheduler, task);
+                return;
+            }
+        }
+        else if (state == SCHEDULER_TASK_STATE_RUNNING)
+        {
+            // scheduler_run() queues it again once its step returns
+            if (SDL_AtomicCAS(&task->state, state, SCHEDULER_TASK_STATE_WOKEN))
+            {
+                return;
+            }
+        }
+        else
+        {
+            // already queued, woken or done
+            return;
+        }
+    }
+}
+
+/**
+ * Wakes the given SchedulerTask up and waits for it to be done.
+ *
+ * @param   task    the SchedulerTask.
+ */
+void scheduler_task_join(SchedulerTask * task)
+{
+    Scheduler * s = &scheduler;
+
+    if (!task->func)
+    {
+        return;
+    }
+
+    scheduler_task_wake(task);
+
+    SDL_LockMutex(s->done_mutex);
+    while (SDL_AtomicGet(&task->state) != SCHEDULER_TASK_STATE_DONE)
+    {
+        SDL_CondWait(s->done_cond, s->done_mutex);
+    }
+    SDL_UnlockMutex(s->done_mutex);
+}
+
+/**
+ * This function is used as callback for the SDL_Thread.
+ *
+ * Runs the tasks of its own queues and steals the ones of the other workers,
+ * the higher priorities first, and sleeps while there is none.
+ *
+ * @param   arg the SchedulerWorker.
+ *
+ * @return      0.
+ */
+static int scheduler_worker(void * arg)
+{
+    SchedulerWorker * worker = (SchedulerWorker *)arg;
+    Scheduler * s = worker->scheduler;
+
+    // the tasks woken by this thread are queued on this worker
+    SDL_TLSSet(s->tls, worker, NULL);
+
+    for (;;)
+    {
+        SchedulerTask * task = scheduler_take(s, worker);
+        if (task)
+        {
+            scheduler_run(s, task);
+            continue;
+        }
+
+        SDL_LockMutex(s->mutex);
+
+        // tell scheduler_push() to signal us, then check again before waiting
+        SDL_AtomicIncRef(&s->nb_sleeping);
+
+        while (!s->quit && SDL_AtomicGet(&s->pending) == 0)
+        {
+            SDL_CondWait(s->cond, s->mutex);
+        }
+
+        SDL_AtomicDecRef(&s->nb_sleeping);
+
+        int quit = s->quit;
+
+        SDL_UnlockMutex(s->mutex);
+
+        if (quit)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Queues the given SchedulerTask on the worker of the calling thread, or on the
+ * next worker if not called from a worker, and wakes a sleeping worker up.
+ *
+ * @param   s       the Scheduler.
+ * @param   task    the SchedulerTask, in the SCHEDULER_TASK_STATE_QUEUED state.
+ */
+static void scheduler_push(Scheduler * s, SchedulerTask * task)
+{
+    SchedulerWorker * worker = (SchedulerWorker *)SDL_TLSGet(s->tls);
+    if (!worker)
+    {
+        unsigned next = (unsigned)SDL_AtomicAdd(&s->next_worker, 1);
+        worker = &s->workers[next % (unsigned)s->nb_workers];
+    }
+
+    SchedulerQueue * queue = &worker->queues[task->priority];
+
+    task->next = NULL;
+
+    SDL_AtomicLock(&queue->lock);
+    if (queue->tail)
+    {
+        queue->tail->next = task;
+    }
+    else
+    {
+        queue->head = task;
+    }
+    queue->tail = task;
+    SDL_AtomicIncRef(&queue->size);
+    SDL_AtomicUnlock(&queue->lock);
+
+    SDL_AtomicIncRef(&s->pending);
+
+    // a worker going to sleep either sees the pending task or is signaled
+    if (SDL_AtomicGet(&s->nb_sleeping) > 0)
+    {
+        SDL_LockMutex(s->mutex);
+        SDL_CondSignal(s->cond);
+        SDL_UnlockMutex(s->mutex);
+    }
+}
+
+/**
+ * Takes the next SchedulerTask to be run by the given worker: for each priority,
+ * the highest first, its own queue then the ones of the other workers.
+ *
+ * @param   s       the Scheduler.
+ * @param   worker  the SchedulerWorker.
+ *
+ * @return          the SchedulerTask, NULL if none is queued.
+ */
+static SchedulerTask * scheduler_take(Scheduler * s, SchedulerWorker * worker)
+{
+    for (int priority = SCHEDULER_PRIORITY_NB - 1; priority >= 0; priority--)
+    {
+        for (int i = 0; i < s->nb_workers; i++)
+        {
+            SchedulerQueue * queue = &s->workers[(worker->index + i) % s->nb_workers].queues[priority];
+
+            if (SDL_AtomicGet(&queue->size) == 0)
+            {
+                continue;
+            }
+
+            SDL_AtomicLock(&queue->lock);
+
+            SchedulerTask * task = queue->head;
+            if (task)
+            {
+                queue->head = task->next;
+                if (!queue->head)
+                {
+                    queue->tail = NULL;
+                }
+                SDL_AtomicDecRef(&queue->size);
+            }
+
+            SDL_AtomicUnlock(&queue->lock);
+
+            if (task)
+            {
+                SDL_AtomicDecRef(&s->pending);
+                return task;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Runs one step of the given SchedulerTask, then parks it, queues it again or
+ * marks it done according to the step result. A task woken up while running is
+ * queued again instead of being parked.
+ *
+ * @param   s       the Scheduler.
+ * @param   task    the SchedulerTask, taken from a queue.
+ */
+static void scheduler_run(Scheduler * s, SchedulerTask * task)
+{
+    SDL_AtomicSet(&task->state, SCHEDULER_TASK_STATE_RUNNING);
+
+    int ret = task->func(task->arg);
+
+    if (ret == SCHEDULER_TASK_DONE)
+    {
+        SDL_LockMutex(s->done_mutex);
+        SDL_AtomicSet(&task->state, SCHEDULER_TASK_STATE_DONE);
+        SDL_CondBroadcast(s->done_cond);
+        SDL_UnlockMutex(s->done_mutex);
+    }
+    else if (ret == SCHEDULER_TASK_YIELD ||
+             !SDL_AtomicCAS(&task->state, SCHEDULER_TASK_STATE_RUNNING, SCHEDULER_TASK_STATE_IDLE))
+    {
+        // the quantum is used up or the task was woken up while running: let
+        // the other queued tasks run first
+        SDL_AtomicSet(&task->state, SCHEDULER_TASK_STATE_QUEUED);
+        scheduler_push(s, task);
+    }
+}
+
+/**
+ * Stops the worker threads and releases the scheduler resources. No task may be
+ * queued.
+ *
+ * @param   s   the Scheduler.
+ */
+static void scheduler_stop(Scheduler * s)
+{
+    SDL_AtomicSet(&s->started_workers, 0);
+
+    if (s->mutex)
+    {
+        SDL_LockMutex(s->mutex);
+        s->quit = 1;
+        SDL_CondBroadcast(s->cond);
+        SDL_UnlockMutex(s->mutex);
+    }
+
+    for (int i = 0; i < s->nb_workers; i++)
+    {
+        if (s->workers[i].tid)
+        {
+            SDL_WaitThread(s->workers[i].tid, NULL);
+            s->workers[i].tid = NULL;
+        }
+    }
+
+    SDL_DestroyMutex(s->mutex);
+    SDL_DestroyCond(s->cond);
+    SDL_DestroyMutex(s->done_mutex);
+    SDL_DestroyCond(s->done_cond);
+
+    s->mutex = NULL;
+    s->cond = NULL;
+    s->done_mutex = NULL;
+    s->done_cond = NULL;
+}
+
+/**
+ * Locks the mutex serializing the scheduler start and stop, creating it the
+ * first time: concurrent first callers may each create one, a single one is
+ * kept.
+ *
+ * @return  the locked mutex, NULL if it could not be created.
+ */
+static SDL_mutex * scheduler_lock()
+{
+    SDL_mutex * mutex = (SDL_mutex *)SDL_AtomicGetPtr((void **)&scheduler_mutex);
+
+    if (!mutex)
+    {
+        mutex = SDL_CreateMutex();
+        if (!mutex)
+        {
+            return NULL;
+        }
+
+        if (!SDL_AtomicCASPtr((void **)&scheduler_mutex, NULL, mutex))
+        {
+            SDL_DestroyMutex(mutex);
+            mutex = (SDL_mutex *)SDL_AtomicGetPtr((void **)&scheduler_mutex);
+        }
+    }
+
+    SDL_LockMutex(mutex);
+
+    return mutex;
+}
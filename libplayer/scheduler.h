@@ -0,0 +1,161 @@
+/**
+*
+*   File:   scheduler.h
+*           libplayer shared scheduler: one pool of worker threads runs the
+*           decoding and scaling tasks of all of the players of the process,
+*           instead of each player starting its own threads, and the video
+*           decoder threads budget is shared among the players. The tasks must
+*           not block on I/O: they would hold a worker of every player.
+*
+*           A SchedulerTask is a resumable step function: it runs until it has
+*           no work left (SCHEDULER_TASK_PARK), until its quantum is used up
+*           (SCHEDULER_TASK_YIELD) or for good (SCHEDULER_TASK_DONE). A parked
+*           task runs again once scheduler_task_wake() is called, wake-ups
+*           while it runs are never lost. A task never blocks waiting for
+*           another task.
+*
+*           Each worker has its own queues, one per priority: the tasks woken
+*           by a worker are queued on it, idle workers steal from the others.
+*           Higher priority tasks always run first.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 11/27/18.
+*
+**/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <SDL2/SDL.h>
+
+/**
+ * Task priorities, the higher first. Also the PLAYER_PRIORITY_* values.
+ */
+#define SCHEDULER_PRIORITY_LOW 0
+#define SCHEDULER_PRIORITY_NORMAL 1
+#define SCHEDULER_PRIORITY_HIGH 2
+#define SCHEDULER_PRIORITY_NB 3
+
+/**
+ * SchedulerTaskFunc return values.
+ */
+#define SCHEDULER_TASK_PARK 0
+#define SCHEDULER_TASK_YIELD 1
+#define SCHEDULER_TASK_DONE 2
+
+/**
+ * Maximum number of worker threads.
+ */
+#define SCHEDULER_MAX_WORKERS 64
+
+/**
+ * Step function of a SchedulerTask.
+ *
+ * @param   arg the SchedulerTask argument.
+ *
+ * @return      one of the SCHEDULER_TASK_* values.
+ */
+typedef int (* SchedulerTaskFunc)(void * arg);
+
+/**
+ * A task, owned by its caller. Embedded in the structure it works on, it is
+ * queued without any allocation.
+ */
+typedef struct SchedulerTask
+{
+    SchedulerTaskFunc       func;
+    void *                  arg;
+    int                     priority;
+
+    /**
+     * SCHEDULER_TASK_STATE_* value, see scheduler.c.
+     */
+    SDL_atomic_t            state;
+
+    /**
+     * Next task of the worker queue.
+     */
+    struct SchedulerTask *  next;
+} SchedulerTask;
+
+/**
+ * Takes a reference on the shared scheduler, starting it the first time.
+ *
+ * @param   workers         number of worker threads, 0 for one per core. Only
+ *                          used when the scheduler is started.
+ * @param   decoder_threads video decoder threads budget shared by the players,
+ *                          0 for one per core. Only used when the scheduler is
+ *                          started.
+ * @param   priority        the SCHEDULER_PRIORITY_* of the caller, weighting
+ *                          its share of the decoder threads budget.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+int scheduler_acquire(int workers, int decoder_threads, int priority);
+
+/**
+ * Releases a reference taken by scheduler_acquire(), the last one stops the
+ * worker threads. The tasks of the caller must be done.
+ *
+ * @param   priority    the priority given to scheduler_acquire().
+ */
+void scheduler_release(int priority);
+
+/**
+ * Takes the share of the video decoder threads budget of a caller of the given
+ * priority, in proportion to the priorities of all of the current scheduler
+ * references, and capped to the threads not taken yet by the other callers: a
+ * decoder cannot change its thread count once opened, so the shares already
+ * taken are never shrunk, the callers opening their decoder later get less.
+ * The threads must be given back with scheduler_decoder_threads_release().
+ *
+ * @param   priority    the SCHEDULER_PRIORITY_* of the caller.
+ *
+ * @return              the number of decoder threads, at least 1.
+ */
+int scheduler_decoder_threads_acquire(int priority);
+
+/**
+ * Gives back video decoder threads taken by scheduler_decoder_threads_acquire(),
+ * once the decoder using them is closed.
+ *
+ * @param   threads the number of decoder threads.
+ */
+void scheduler_decoder_threads_release(int threads);
+
+/**
+ * Returns the number of worker threads of the shared scheduler.
+ *
+ * @return  the number of workers, 0 if the scheduler is not started.
+ */
+int scheduler_workers();
+
+/**
+ * Initializes the given SchedulerTask, parked. It runs once woken up.
+ *
+ * @param   task        the SchedulerTask.
+ * @param   func        the step function.
+ * @param   arg         the step function argument.
+ * @param   priority    the task SCHEDULER_PRIORITY_*.
+ */
+void scheduler_task_init(SchedulerTask * task, SchedulerTaskFunc func, void * arg, int priority);
+
+/**
+ * Queues the given SchedulerTask if it is parked, or makes it run once more if
+ * it is running. Does nothing for a task not initialized, already queued or
+ * done. Never blocks, may be called from any thread.
+ *
+ * @param   task    the SchedulerTask, may be NULL.
+ */
+void scheduler_task_wake(SchedulerTask * task);
+
+/**
+ * Wakes the given SchedulerTask up and waits for it to be done: its step
+ * function must return SCHEDULER_TASK_DONE once the caller asked it to stop.
+ * Returns at once for a task not initialized.
+ *
+ * @param   task    the SchedulerTask.
+ */
+void scheduler_task_join(SchedulerTask * task);
+
+#endif // SCHEDULER_H
@@ -1,37 +1,49 @@
 /**
  *
  *   File:   player-sdl2.c
+ *           SDL2 media player built on libplayer: each of the given inputs is
+ *           played by an independent Player in its own window. The SDL event
+ *           loop is run here and the user input forwarded to the Player owning
+ *           the focused window.
+ *
+ *           Usage: ./player-sdl2 [options] <filename|url> ...
  *
  *   Author: Rambod Rahmani <rambodrahmani@autistici.org>
  *           Created on 11/27/18.
  *
  **/
 
-#include <inttypes.h>
-#include <math.h>
-#include <limits.h>
-#include <signal.h>
-#include <stdint.h>
-
-#include <libavutil/avstring.h>
-#include <libavutil/eval.h>
-#include <libavutil/mathematics.h>
-#include <libavutil/pixdesc.h>
-#include <libavutil/imgutils.h>
-#include <libavutil/dict.h>
-#include <libavutil/parseutils.h>
-#include <libavutil/samplefmt.h>
-#include <libavutil/avassert.h>
-#include <libavutil/time.h>
-#include <libavformat/avformat.h>
-#include <libavdevice/avdevice.h>
-#include <libswscale/swscale.h>
-#include <libavutil/opt.h>
-#include <libavcodec/avfft.h>
-#include <libswresample/swresample.h>
-#include <libavfilter/avfilter.h>
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "player.h"
+
+/**
+ * Prevents SDL from overriding main().
+ */
+#ifdef __MINGW32__
+#undef main
+#endif
+
+/**
+ * Maximum number of inputs played at the same time.
+ */
+#define MAX_PLAYERS 64
+
+/**
+ * Stats file name size, the per player stats file names included.
+ */
+#define STATS_FILE_NAME_SIZE 1024
+
+/**
+ * Methods declaration.
+ */
+void printHelpMenu();
+
+void printReport(Player * player, const char * url, int nb_players);
+
+int findPlayer(Player * players[], int nb_players, Uint32 windowID);
 
 /**
  * Entry point.
@@ -43,6 +55,337 @@
  */
 int main(int argc, char * argv[])
 {
+    PlayerOptions options;
+    player_options_default(&options);
+
+    // the options start with --, the other arguments are the inputs
+    const char * urls[MAX_PLAYERS];
+    int nb_urls = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (player_parse_option(&options, argv[i]) < 0)
+            {
+                printHelpMenu();
+                return -1;
+            }
+        }
+        else if (nb_urls < MAX_PLAYERS)
+        {
+            urls[nb_urls++] = argv[i];
+        }
+        else
+        {
+            printf("Too many inputs, at most %d can be played.\n", MAX_PLAYERS);
+            return -1;
+        }
+    }
+
+    // at least one input is needed
+    if (nb_urls == 0)
+    {
+        printHelpMenu();
+        return -1;
+    }
+
+    // the players only hold references to the video, audio and timer subsystems:
+    // the event loop below needs SDL to stay initialized until all of them are
+    // closed
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0)
+    {
+        printf("Could not initialize SDL - %s\n.", SDL_GetError());
+        return -1;
+    }
+
+    // the stats file is shared by all of the players unless several inputs are
+    // given: each player then writes name-N.ext
+    const char * stats_file = options.stats_file;
+    char stats_file_names[MAX_PLAYERS][STATS_FILE_NAME_SIZE];
+
+    Player * players[MAX_PLAYERS];
+    int nb_players = 0;
+
+    for (int i = 0; i < nb_urls; i++)
+    {
+        if (stats_file && nb_urls > 1)
+        {
+            const char * ext = strrchr(stats_file, '.');
+            int base = ext ? (int)(ext - stats_file) : (int)strlen(stats_file);
+
+            snprintf(stats_file_names[i], STATS_FILE_NAME_SIZE, "%.*s-%d%s", base, stats_file, i, ext ? ext : "");
+            options.stats_file = stats_file_names[i];
+        }
+
+        Player * player = player_open(urls[i], &options);
+        if (!player)
+        {
+            printf("Could not open %s.\n", urls[i]);
+            continue;
+        }
+
+        if (player_play(player) < 0)
+        {
+            printf("Could not play %s.\n", urls[i]);
+            player_close(player);
+            continue;
+        }
+
+        // keep the urls aligned with the players for the reports
+        urls[nb_players] = urls[i];
+        players[nb_players++] = player;
+    }
+
+    // infinite loop waiting for fired events, until all of the players are closed
+    SDL_Event event;
+    while (nb_players > 0)
+    {
+        // wait indefinitely for the next available event
+        if (SDL_WaitEvent(&event) == 0)
+        {
+            printf("SDL_WaitEvent failed: %s.\n", SDL_GetError());
+            break;
+        }
+
+        // index of the player the event is addressed to, -1 if none
+        int p = -1;
+
+        // switch on the retrieved event type
+        switch(event.type)
+        {
+            case SDL_KEYDOWN:
+            {
+                p = findPlayer(players, nb_players, event.key.windowID);
+                if (p < 0)
+                {
+                    break;
+                }
+
+                switch(event.key.keysym.sym)
+                {
+                    case SDLK_LEFT:
+                    {
+                        player_seek(players[p], -10.0);
+                    }
+                    break;
+
+                    case SDLK_RIGHT:
+                    {
+                        player_seek(players[p], 10.0);
+                    }
+                    break;
+
+                    case SDLK_DOWN:
+                    {
+                        player_seek(players[p], -60.0);
+                    }
+                    break;
+
+                    case SDLK_UP:
+                    {
+                        player_seek(players[p], 60.0);
+                    }
+                    break;
+
+                    case SDLK_i:
+                    {
+                        // toggle the pipeline stats overlay
+                        player_toggle_stats_overlay(players[p]);
+                    }
+                    break;
+
+                    default:
+                    {
+                        // nothing to do
+                    }
+                    break;
+                }
+
+                // keys do not close players
+                p = -1;
+            }
+            break;
+
+            case SDL_WINDOWEVENT:
+            {
+                // closing a window closes its player only
+                if (event.window.event == SDL_WINDOWEVENT_CLOSE)
+                {
+                    p = findPlayer(players, nb_players, event.window.windowID);
+                }
+            }
+            break;
+
+            case PLAYER_EVENT_RENDER:
+            {
+                // the frames are rendered on the main thread on this platform
+                player_render(event.user.data1);
+            }
+            break;
+
+            case PLAYER_EVENT_DONE:
+            {
+                // the playback ended
+                for (int i = 0; i < nb_players; i++)
+                {
+                    if (players[i] == event.user.data1)
+                    {
+                        p = i;
+                        break;
+                    }
+                }
+            }
+            break;
+
+            case SDL_QUIT:
+            {
+                // close all of the players
+                while (nb_players > 0)
+                {
+                    nb_players--;
+                    printReport(players[nb_players], urls[nb_players], nb_urls);
+                    player_close(players[nb_players]);
+                }
+            }
+            break;
+
+            default:
+            {
+                // nothing to do
+            }
+            break;
+        }
+
+        // close the player the event was addressed to and compact the array
+        if (p >= 0)
+        {
+            printReport(players[p], urls[p], nb_urls);
+            player_close(players[p]);
+
+            nb_players--;
+            for (int i = p; i < nb_players; i++)
+            {
+                players[i] = players[i + 1];
+                urls[i] = urls[i + 1];
+            }
+        }
+    }
+
+    SDL_Quit();
+
     return 0;
 }
 
+/**
+ * Print help menu containing usage information.
+ */
+void printHelpMenu()
+{
+    printf("Invalid arguments.\n\n");
+    printf("Usage: ./player-sdl2 [options] <filename|url> ...\n\n");
+    printf("Each input is played in its own window, at most %d.\n\n", MAX_PLAYERS);
+    player_print_options();
+    printf("\nWith several inputs, each one writes its own --stats file: FILE-N.ext.\n\n");
+    printf("e.g: ./player-sdl2 --threads=4 /home/rambodrahmani/Videos/video.mp4\n");
+}
+
+/**
+ * Prints the late frames drop policy counters, the input backend and
+ * rebuffering stats, the startup timing and the memory usage of the given
+ * Player.
+ *
+ * @param   player      the Player.
+ * @param   url         the Player input, printed as prefix if more than one
+ *                      Player was opened.
+ * @param   nb_players  the number of players opened.
+ */
+void printReport(Player * player, const char * url, int nb_players)
+{
+    PlayerStats stats;
+    player_get_stats(player, &stats);
+
+    const char * prefix = nb_players > 1 ? url : "";
+    const char * separator = nb_players > 1 ? ": " : "";
+
+    // report the late frames drop policy counters
+    printf("%s%sFrames dropped: %d, skipped after decoding: %d, decoder skip level: %d.\n",
+           prefix, separator,
+           stats.frames_dropped,
+           stats.frames_skipped,
+           stats.decoder_skip_level);
+
+    // report the input backend throughput and the time the demuxer waited for data
+    if (stats.input_bytes > 0)
+    {
+        printf("%s%sInput: %.1f MB read, %.1f MB/s, stalled %.1f ms.\n",
+               prefix, separator,
+               stats.input_bytes / (1024.0 * 1024.0),
+               stats.input_time > 0 ? stats.input_bytes / (1024.0 * 1024.0) / (stats.input_time / 1000.0) : 0.0,
+               stats.input_stall_time);
+    }
+
+    if (stats.rebuffer_count > 0)
+    {
+        printf("%s%sRebuffering: %d times, %.1f ms.\n", prefix, separator, stats.rebuffer_count, stats.rebuffer_time);
+    }
+
+    // report the startup timing: each step since player_open(), the last one is
+    // the time to first frame
+    const char * startup_steps[] = {"open", "probe", "codec open", "first packet", "first display"};
+    double startup_times[] = {
+            stats.open_time,
+            stats.probe_time,
+            stats.codec_open_time,
+            stats.first_packet_time,
+            stats.first_display_time
+    };
+
+    printf("%s%sStartup timing:", prefix, separator);
+    for (int i = 0; i < sizeof(startup_times) / sizeof(startup_times[0]); i++)
+    {
+        if (startup_times[i] >= 0)
+        {
+            printf(" %s %.1f ms", startup_steps[i], startup_times[i]);
+        }
+        else
+        {
+            printf(" %s n/a", startup_steps[i]);
+        }
+    }
+    printf(".\n");
+
+    // report the peak usage of each memory arena against its share of the budget
+    const char * memory_arenas[] = {"video queue", "audio queue", "pictures", "audio", "input"};
+
+    printf("%s%sMemory peak (budget %d MB):", prefix, separator, stats.memory_budget / (1024 * 1024));
+    for (int i = 0; i < PLAYER_MEMORY_NB; i++)
+    {
+        printf(" %s %.1f/%.1f MB", memory_arenas[i],
+               stats.memory[i].peak / (1024.0 * 1024.0),
+               stats.memory[i].limit / (1024.0 * 1024.0));
+    }
+    printf(".\n");
+}
+
+/**
+ * Finds the Player owning the given SDL window.
+ *
+ * @param   players     the players.
+ * @param   nb_players  the number of players.
+ * @param   windowID    the SDL window id.
+ *
+ * @return              the index of the Player, -1 if none.
+ */
+int findPlayer(Player * players[], int nb_players, Uint32 windowID)
+{
+    for (int i = 0; i < nb_players; i++)
+    {
+        if (player_get_window_id(players[i]) == windowID)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,595 @@
+/**
+ *
+ *   File:   replay.c
+ *           Deterministic A/V sync regression harness built on libplayer: each
+ *           input is replayed by player_replay() against a virtual clock and a
+ *           simulated audio device, as fast as it can be decoded, and the trace
+ *           of the frames shown, dropped and skipped is written as CSV. The same
+ *           input and options give the same trace on any machine, so the traces
+ *           can be recorded once as golden files and checked against later.
+ *
+ *           -bench replays each input with each of the master clocks and
+ *           reports the A/V difference percentiles, the dropped and skipped
+ *           frames and the replay speed.
+ *
+ *           Usage: ./replay [options] [-o FILE | -record DIR | -check DIR | -bench] [file ...]
+ *           With no file, the video shipped with the repository is used.
+ *
+ *   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *           Created on 11/27/18.
+ *
+ **/
+
+/**
+ * The players initialize the SDL subsystems they use: main() is not replaced.
+ */
+#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include "player.h"
+
+/**
+ * Directory of the default corpus, set by CMake to the repository root.
+ */
+#ifndef REPLAY_CORPUS_DIR
+#define REPLAY_CORPUS_DIR "."
+#endif
+
+/**
+ * Suffix of the golden trace files: <dir>/<input basename>.<sync>.trace.csv,
+ * one per master clock.
+ */
+#define REPLAY_TRACE_SUFFIX ".trace.csv"
+
+/**
+ * Default tolerance of -check on the times and clocks, in seconds: the traces
+ * are deterministic, this only absorbs the CSV rounding.
+ */
+#define REPLAY_TOLERANCE 0.000002
+
+/**
+ * Trace file path size.
+ */
+#define REPLAY_PATH_SIZE 1024
+
+/**
+ * Trace line size.
+ */
+#define REPLAY_LINE_SIZE 256
+
+/**
+ * The frames trace of a replay, grown by the trace callback.
+ */
+typedef struct ReplayTrace
+{
+    PlayerTraceFrame *  frames;
+    int                 nb_frames;
+    int                 capacity;
+
+    // set if the trace could not be grown
+    int                 error;
+} ReplayTrace;
+
+/**
+ * Names of the PLAYER_TRACE_* frame status, as written in the traces.
+ */
+static const char * trace_status_names[] = {
+        "shown",
+        "dropped",
+        "skipped"
+};
+
+/**
+ * Names of the PLAYER_SYNC_* master clocks.
+ */
+static const char * sync_names[] = {
+        "audio",
+        "video",
+        "external"
+};
+
+/**
+ * Methods declaration.
+ */
+void printHelpMenu();
+
+static void trace_frame(void * opaque, const PlayerTraceFrame * frame);
+
+static int replay_file(const char * url, PlayerOptions * options, double decode_time, ReplayTrace * trace);
+
+static void write_trace(FILE * file, const ReplayTrace * trace);
+
+static int check_trace(const char * path, const ReplayTrace * trace, double tolerance);
+
+static void print_bench(const char * url, int sync, const ReplayTrace * trace, double elapsed);
+
+static int compare_double(const void * a, const void * b);
+
+/**
+ * Entry point.
+ *
+ * @param   argc    command line arguments counter.
+ * @param   argv    command line arguments.
+ *
+ * @return          execution exit code: 1 if a -check trace differs.
+ */
+int main(int argc, char * argv[])
+{
+    static const char * default_corpus[] = {
+            REPLAY_CORPUS_DIR "/Iron_Man-Trailer_HD.mp4"
+    };
+
+    PlayerOptions options;
+    player_options_default(&options);
+
+    // parse the options, the -- ones are the player options and the remaining
+    // arguments are the inputs
+    const char * output = NULL;
+    const char * record_dir = NULL;
+    const char * check_dir = NULL;
+    int bench = 0;
+    double decode_time = 0;
+    double tolerance = REPLAY_TOLERANCE;
+    const char ** files = NULL;
+    int nb_files = 0;
+    char * pEnd;
+
+    files = av_mallocz_array(argc, sizeof(char *));
+    if (!files)
+    {
+        printf("Could not allocate the input files list.\n");
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (player_parse_option(&options, argv[i]) < 0)
+            {
+                printHelpMenu();
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+        {
+            record_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-check") == 0 && i + 1 < argc)
+        {
+            check_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-bench") == 0)
+        {
+            bench = 1;
+        }
+        else if (strcmp(argv[i], "-decode-time") == 0 && i + 1 < argc)
+        {
+            decode_time = strtod(argv[++i], &pEnd) / 1000.0;
+
+            if (*pEnd != '\0' || decode_time < 0)
+            {
+                printf("Invalid video decode time: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = strtod(argv[++i], &pEnd) / 1000.0;
+
+            if (*pEnd != '\0' || tolerance < 0)
+            {
+                printf("Invalid tolerance: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            printHelpMenu();
+            goto fail;
+        }
+        else
+        {
+            files[nb_files++] = argv[i];
+        }
+    }
+
+    // one mode at a time
+    if ((output != NULL) + (record_dir != NULL) + (check_dir != NULL) + bench > 1)
+    {
+        printHelpMenu();
+        goto fail;
+    }
+
+    // no input files: replay the default corpus
+    if (nb_files == 0)
+    {
+        for (int i = 0; i < FF_ARRAY_ELEMS(default_corpus); i++)
+        {
+            files[nb_files++] = default_corpus[i];
+        }
+    }
+
+    // headless: no window nor audio device is opened by the replay, the dummy
+    // drivers let SDL initialize without a display or a sound card
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+    FILE * out = stdout;
+    if (output)
+    {
+        out = fopen(output, "w");
+        if (!out)
+        {
+            printf("Could not open %s.\n", output);
+            goto fail;
+        }
+    }
+
+    int ret = 0;
+    int mismatches = 0;
+
+    for (int f = 0; f < nb_files; f++)
+    {
+        // -bench: each of the master clocks, the given one otherwise
+        int first_sync = bench ? PLAYER_SYNC_AUDIO : options.av_sync_type;
+        int last_sync = bench ? PLAYER_SYNC_EXTERNAL : options.av_sync_type;
+
+        for (int sync = first_sync; sync <= last_sync; sync++)
+        {
+            ReplayTrace trace = {0};
+            options.av_sync_type = sync;
+
+            int64_t start = av_gettime_relative();
+            if (replay_file(files[f], &options, decode_time, &trace) < 0)
+            {
+                printf("Could not replay %s.\n", files[f]);
+                av_freep(&trace.frames);
+                ret = -1;
+                continue;
+            }
+            double elapsed = (av_gettime_relative() - start) / 1000000.0;
+
+            // the golden trace of each input is named after its basename and
+            // the master clock, the traces of each clock differ
+            char path[REPLAY_PATH_SIZE];
+            const char * basename = strrchr(files[f], '/');
+            basename = basename ? basename + 1 : files[f];
+            snprintf(path, sizeof(path), "%s/%s.%s%s", record_dir ? record_dir : check_dir, basename, sync_names[sync], REPLAY_TRACE_SUFFIX);
+
+            if (record_dir)
+            {
+                FILE * file = fopen(path, "w");
+                if (!file)
+                {
+                    printf("Could not open %s.\n", path);
+                    ret = -1;
+                }
+                else
+                {
+                    write_trace(file, &trace);
+                    fclose(file);
+                    printf("Recorded %d frames of %s in %s.\n", trace.nb_frames, files[f], path);
+                }
+            }
+            else if (check_dir)
+            {
+                int check = check_trace(path, &trace, tolerance);
+                if (check < 0)
+                {
+                    ret = -1;
+                }
+                else if (check > 0)
+                {
+                    printf("FAIL %s: the trace differs from %s.\n", files[f], path);
+                    mismatches++;
+                }
+                else
+                {
+                    printf("PASS %s: %d frames.\n", files[f], trace.nb_frames);
+                }
+            }
+            else if (bench)
+            {
+                print_bench(files[f], sync, &trace, elapsed);
+            }
+            else
+            {
+                // the traces of several inputs follow each other
+                if (nb_files > 1)
+                {
+                    fprintf(out, "# %s\n", files[f]);
+                }
+                write_trace(out, &trace);
+            }
+
+            av_freep(&trace.frames);
+        }
+    }
+
+    if (output)
+    {
+        fclose(out);
+    }
+
+    av_free(files);
+
+    if (mismatches > 0)
+    {
+        return 1;
+    }
+
+    return ret;
+
+    // in case of failure
+    fail:
+    {
+        av_free(files);
+
+        return -1;
+    };
+}
+
+/**
+ * Print help menu containing usage information.
+ */
+void printHelpMenu()
+{
+    printf("Invalid arguments.\n\n");
+    printf("Usage: ./replay [options] [file ...]\n\n");
+    printf("    -o FILE         write the trace to the given file instead of the standard output.\n");
+    printf("    -record DIR     write the trace of each file to DIR/<file>.<sync>%s.\n", REPLAY_TRACE_SUFFIX);
+    printf("    -check DIR      compare the trace of each file with DIR/<file>.<sync>%s, exits with 1\n", REPLAY_TRACE_SUFFIX);
+    printf("                    if any differs.\n");
+    printf("    -bench          report the A/V difference, dropped and skipped frames and the replay\n");
+    printf("                    speed of each file with each master clock.\n");
+    printf("    -decode-time MS virtual time taken to decode each video frame (default 0).\n");
+    printf("    -tolerance MS   -check tolerance on the times and clocks (default %g).\n\n", REPLAY_TOLERANCE * 1000);
+    player_print_options();
+    printf("\nWith no file, the repository corpus is used:\n");
+    printf("    %s/Iron_Man-Trailer_HD.mp4\n\n", REPLAY_CORPUS_DIR);
+    printf("e.g: ./replay -record ../replay/golden --sync=audio\n");
+    printf("     ./replay -check ../replay/golden --sync=audio\n");
+}
+
+/**
+ * PlayerTraceCallback appending each frame to the given ReplayTrace.
+ *
+ * @param   opaque  the ReplayTrace.
+ * @param   frame   the frame.
+ */
+static void trace_frame(void * opaque, const PlayerTraceFrame * frame)
+{
+    ReplayTrace * trace = opaque;
+
+    if (trace->nb_frames == trace->capacity)
+    {
+        int capacity = FFMAX(2 * trace->capacity, 1024);
+        PlayerTraceFrame * frames = av_realloc_array(trace->frames, capacity, sizeof(PlayerTraceFrame));
+        if (!frames)
+        {
+            trace->error = 1;
+            return;
+        }
+
+        trace->frames = frames;
+        trace->capacity = capacity;
+    }
+
+    trace->frames[trace->nb_frames++] = *frame;
+}
+
+/**
+ * Replays the given input with the given options, the frames are appended to
+ * the given ReplayTrace.
+ *
+ * @param   url             the input.
+ * @param   options         the player options.
+ * @param   decode_time     virtual time taken to decode each video frame.
+ * @param   trace           the ReplayTrace.
+ *
+ * @return                  < 0 in case of error, 0 otherwise.
+ */
+static int replay_file(const char * url, PlayerOptions * options, double decode_time, ReplayTrace * trace)
+{
+    Player * player = player_open(url, options);
+    if (!player)
+    {
+        return -1;
+    }
+
+    int ret = player_replay(player, decode_time, trace_frame, trace);
+
+    player_close(player);
+
+    if (trace->error)
+    {
+        printf("Could not allocate the trace.\n");
+        return -1;
+    }
+
+    return ret;
+}
+
+/**
+ * Writes the given ReplayTrace as CSV, one frame per line.
+ *
+ * @param   file    the output file.
+ * @param   trace   the ReplayTrace.
+ */
+static void write_trace(FILE * file, const ReplayTrace * trace)
+{
+    fprintf(file, "index,status,pts,time,audio_clock,av_diff\n");
+
+    for (int i = 0; i < trace->nb_frames; i++)
+    {
+        const PlayerTraceFrame * frame = &trace->frames[i];
+
+        fprintf(file, "%d,%s,%.6f,%.6f,%.6f,%.6f\n",
+                frame->index,
+                trace_status_names[frame->status],
+                frame->pts,
+                frame->time,
+                frame->audio_clock,
+                frame->av_diff);
+    }
+}
+
+/**
+ * Compares the given ReplayTrace with the golden trace in the given file: the
+ * same frames with the same status, their pts, times and audio clocks within
+ * the given tolerance. The first difference found is printed.
+ *
+ * @param   path        the golden trace file.
+ * @param   trace       the ReplayTrace.
+ * @param   tolerance   the tolerance on the times and clocks, in seconds.
+ *
+ * @return              < 0 in case of error, 1 if the traces differ, 0 otherwise.
+ */
+static int check_trace(const char * path, const ReplayTrace * trace, double tolerance)
+{
+    FILE * file = fopen(path, "r");
+    if (!file)
+    {
+        printf("Could not open %s.\n", path);
+        return -1;
+    }
+
+    char line[REPLAY_LINE_SIZE];
+    int nb_frames = 0;
+    int ret = 0;
+
+    while (ret == 0 && fgets(line, sizeof(line), file))
+    {
+        PlayerTraceFrame golden;
+        char status[16];
+
+        // skip the header and the comments
+        if (sscanf(line, "%d,%15[^,],%lf,%lf,%lf,%lf",
+                   &golden.index, status, &golden.pts, &golden.time, &golden.audio_clock, &golden.av_diff) != 6)
+        {
+            continue;
+        }
+
+        if (nb_frames >= trace->nb_frames)
+        {
+            printf("    frame %d: missing, the trace ends after %d frames.\n", golden.index, trace->nb_frames);
+            ret = 1;
+            break;
+        }
+
+        const PlayerTraceFrame * frame = &trace->frames[nb_frames++];
+
+        if (strcmp(status, trace_status_names[frame->status]) != 0 ||
+            fabs(frame->pts - golden.pts) > tolerance ||
+            fabs(frame->time - golden.time) > tolerance ||
+            fabs(frame->audio_clock - golden.audio_clock) > tolerance)
+        {
+            printf("    frame %d: expected %s pts %.6f at %.6f (audio clock %.6f),\n",
+                   golden.index, status, golden.pts, golden.time, golden.audio_clock);
+            printf("    got %s pts %.6f at %.6f (audio clock %.6f).\n",
+                   trace_status_names[frame->status], frame->pts, frame->time, frame->audio_clock);
+            ret = 1;
+        }
+    }
+
+    if (ret == 0 && nb_frames < trace->nb_frames)
+    {
+        printf("    frame %d: unexpected, the golden trace ends after %d frames.\n", trace->frames[nb_frames].index, nb_frames);
+        ret = 1;
+    }
+
+    fclose(file);
+
+    return ret;
+}
+
+/**
+ * Prints the A/V difference percentiles of the frames shown, the number of
+ * frames dropped and skipped and the replay speed of the given ReplayTrace.
+ *
+ * @param   url         the input.
+ * @param   sync        the PLAYER_SYNC_* master clock of the replay.
+ * @param   trace       the ReplayTrace.
+ * @param   elapsed     wall time taken by the replay, in seconds.
+ */
+static void print_bench(const char * url, int sync, const ReplayTrace * trace, double elapsed)
+{
+    double * diffs = av_malloc_array(FFMAX(trace->nb_frames, 1), sizeof(double));
+    if (!diffs)
+    {
+        printf("Could not allocate the A/V differences.\n");
+        return;
+    }
+
+    int nb_shown = 0;
+    int nb_dropped = 0;
+    int nb_skipped = 0;
+
+    for (int i = 0; i < trace->nb_frames; i++)
+    {
+        switch (trace->frames[i].status)
+        {
+            case PLAYER_TRACE_SHOWN:
+            {
+                diffs[nb_shown++] = fabs(trace->frames[i].av_diff);
+            }
+            break;
+
+            case PLAYER_TRACE_DROPPED:
+            {
+                nb_dropped++;
+            }
+            break;
+
+            default:
+            {
+                nb_skipped++;
+            }
+            break;
+        }
+    }
+
+    qsort(diffs, nb_shown, sizeof(double), compare_double);
+
+    // the virtual time of the last frame is the media time replayed
+    double media_time = trace->nb_frames > 0 ? trace->frames[trace->nb_frames - 1].time : 0;
+
+    printf("%s, sync %s:\n", url, sync_names[sync]);
+    if (nb_shown > 0)
+    {
+        printf("    |A/V diff| ms: p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+               diffs[(nb_shown - 1) * 50 / 100] * 1000,
+               diffs[(nb_shown - 1) * 90 / 100] * 1000,
+               diffs[(nb_shown - 1) * 99 / 100] * 1000,
+               diffs[nb_shown - 1] * 1000);
+    }
+    printf("    frames: %d shown, %d dropped, %d skipped\n", nb_shown, nb_dropped, nb_skipped);
+    printf("    speed: %.1fx realtime (%.2f s replayed in %.2f s)\n",
+           elapsed > 0 ? media_time / elapsed : 0, media_time, elapsed);
+
+    av_free(diffs);
+}
+
+/**
+ * qsort() comparison function of doubles.
+ */
+static int compare_double(const void * a, const void * b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
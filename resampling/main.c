@@ -1,6 +1,15 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/common.h>
 #include <libavutil/opt.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/samplefmt.h>
+#include <libavutil/time.h>
 #include <libswresample/swresample.h>
 static int get_format_from_sample_fmt(const char **fmt,
                                       enum AVSampleFormat sample_fmt)
@@ -45,6 +54,544 @@ static void fill_samples(double *dst, int nb_samples, int nb_channels, int sampl
         *t += tincr;
     }
 }
+/**
+ * Resampler benchmark (-bench): a matrix of input/output rates, channel
+ * layouts and sample formats is run through each swr engine configuration, on
+ * a generated sine and on real files, and one CSV row is printed per run.
+ */
+#define BENCH_DURATION 5          /* seconds of each signal */
+#define BENCH_CHUNK 1024          /* input samples per swr_convert() call */
+#define BENCH_SINE_FREQ 997.0     /* not a divisor of the usual rates */
+#define BENCH_SINE_AMPLITUDE 0.5
+#define BENCH_EDGE 4096           /* output samples ignored at each end by the quality metric */
+#define BENCH_MAX_LAG 64          /* alignment search of the reference comparison, in samples */
+#define BENCH_LAG_WINDOW 16384
+
+/* the reference of the real files: a long, finely interpolated swr filter */
+#define BENCH_REFERENCE_OPTS "filter_size=256:phase_shift=14:linear_interp=1"
+
+typedef struct Signal {
+    char name[256];
+    uint8_t **data;
+    int64_t nb_samples;
+    int sample_rate;
+    int64_t ch_layout;
+    enum AVSampleFormat sample_fmt;
+    double sine_freq;   /* 0 for a real file */
+} Signal;
+
+typedef struct Engine {
+    const char *name;
+    const char *opts;   /* swr AVOptions, key=value:... */
+    int unavailable;
+} Engine;
+
+typedef struct Result {
+    int64_t out_samples;
+    double seconds;     /* spent in swr_convert() */
+    int64_t latency_us; /* largest swr_get_delay() while streaming */
+    double *ch0;        /* first output channel, for the quality metric */
+    int64_t ch0_size;
+} Result;
+
+static Engine bench_engines[] = {
+    { "swr",             NULL                                },
+    { "swr-fs16",        "filter_size=16"                    },
+    { "swr-fs64-ps12",   "filter_size=64:phase_shift=12"     },
+    { "swr-nointerp",    "linear_interp=0"                   },
+    { "swr-exact",       "exact_rational=1"                  },
+    { "soxr",            "resampler=soxr:precision=20"       },
+    { "soxr-vhq",        "resampler=soxr:precision=28"       },
+};
+
+static const int bench_rates[][2] = {
+    { 44100, 48000 }, { 48000, 44100 }, { 96000, 48000 },
+    { 48000, 96000 }, { 22050, 48000 }, { 48000, 48000 },
+};
+
+static const int64_t bench_layouts[][2] = {
+    { AV_CH_LAYOUT_STEREO, AV_CH_LAYOUT_STEREO },
+    { AV_CH_LAYOUT_MONO,   AV_CH_LAYOUT_STEREO },
+    { AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_STEREO },
+};
+
+static const enum AVSampleFormat bench_formats[][2] = {
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S16  },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_FLTP },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16  },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_FLTP },
+    { AV_SAMPLE_FMT_DBL,  AV_SAMPLE_FMT_S32  },
+};
+
+/* the output side of the real files matrix, their input is what they decode to */
+static const int bench_file_rates[] = { 44100, 48000, 96000 };
+static const int64_t bench_file_layouts[] = { AV_CH_LAYOUT_MONO, AV_CH_LAYOUT_STEREO, AV_CH_LAYOUT_5POINT1 };
+static const enum AVSampleFormat bench_file_formats[] = { AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP };
+
+/**
+ * Sample i of channel ch, packed or planar, as a double in [-1, 1].
+ */
+static double get_sample(uint8_t **data, enum AVSampleFormat fmt, int nb_channels, int ch, int64_t i)
+{
+    int planar = av_sample_fmt_is_planar(fmt);
+    const uint8_t *p = planar ? data[ch] : data[0];
+    int64_t idx = planar ? i : i * nb_channels + ch;
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:  return (((const uint8_t *)p)[idx] - 128) / 128.0;
+    case AV_SAMPLE_FMT_S16: return ((const int16_t *)p)[idx] / 32768.0;
+    case AV_SAMPLE_FMT_S32: return ((const int32_t *)p)[idx] / 2147483648.0;
+    case AV_SAMPLE_FMT_FLT: return ((const float *)p)[idx];
+    case AV_SAMPLE_FMT_DBL: return ((const double *)p)[idx];
+    default:                return 0;
+    }
+}
+
+static void set_sample(uint8_t **data, enum AVSampleFormat fmt, int nb_channels, int ch, int64_t i, double v)
+{
+    int planar = av_sample_fmt_is_planar(fmt);
+    uint8_t *p = planar ? data[ch] : data[0];
+    int64_t idx = planar ? i : i * nb_channels + ch;
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:  ((uint8_t *)p)[idx] = av_clip_uint8(lrint(v * 128) + 128); break;
+    case AV_SAMPLE_FMT_S16: ((int16_t *)p)[idx] = av_clip_int16(lrint(v * 32768)); break;
+    case AV_SAMPLE_FMT_S32: ((int32_t *)p)[idx] = (int32_t)av_clipl_int32(llrint(v * 2147483648.0)); break;
+    case AV_SAMPLE_FMT_FLT: ((float *)p)[idx] = v; break;
+    case AV_SAMPLE_FMT_DBL: ((double *)p)[idx] = v; break;
+    default:                break;
+    }
+}
+
+/**
+ * Points dst at sample offset of data.
+ */
+static void offset_samples(const uint8_t **dst, uint8_t **data, enum AVSampleFormat fmt, int nb_channels, int64_t offset)
+{
+    int bps = av_get_bytes_per_sample(fmt);
+    int i;
+    if (av_sample_fmt_is_planar(fmt)) {
+        for (i = 0; i < nb_channels; i++)
+            dst[i] = data[i] + offset * bps;
+    } else {
+        dst[0] = data[0] + offset * bps * nb_channels;
+    }
+}
+
+static void free_signal(Signal *sig)
+{
+    if (sig->data)
+        av_freep(&sig->data[0]);
+    av_freep(&sig->data);
+}
+
+/**
+ * duration seconds of a sine, the same on all of the channels.
+ */
+static int generate_signal(Signal *sig, int sample_rate, int64_t ch_layout, enum AVSampleFormat fmt, int duration)
+{
+    int nb_channels = av_get_channel_layout_nb_channels(ch_layout);
+    int64_t i;
+    int ch, ret;
+
+    memset(sig, 0, sizeof(*sig));
+    snprintf(sig->name, sizeof(sig->name), "sine%.0f", BENCH_SINE_FREQ);
+    sig->nb_samples = (int64_t)sample_rate * duration;
+    sig->sample_rate = sample_rate;
+    sig->ch_layout = ch_layout;
+    sig->sample_fmt = fmt;
+    sig->sine_freq = BENCH_SINE_FREQ;
+
+    ret = av_samples_alloc_array_and_samples(&sig->data, NULL, nb_channels, sig->nb_samples, fmt, 0);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < sig->nb_samples; i++) {
+        double v = BENCH_SINE_AMPLITUDE * sin(2 * M_PI * BENCH_SINE_FREQ * i / sample_rate);
+        for (ch = 0; ch < nb_channels; ch++)
+            set_sample(sig->data, fmt, nb_channels, ch, i, v);
+    }
+    return 0;
+}
+
+/**
+ * Decodes the first duration seconds of the audio stream of filename, in the
+ * decoder sample format.
+ */
+static int load_signal(Signal *sig, const char *filename, int duration)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *dec_ctx = NULL;
+    AVCodec *dec = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int64_t capacity;
+    int stream_index, nb_channels, ret;
+    const char *base = strrchr(filename, '/');
+
+    memset(sig, 0, sizeof(*sig));
+    snprintf(sig->name, sizeof(sig->name), "%s", base ? base + 1 : filename);
+
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avformat_open_input(&fmt_ctx, filename, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0) {
+        fprintf(stderr, "Could not open %s\n", filename);
+        goto end;
+    }
+    if ((ret = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &dec, 0)) < 0) {
+        fprintf(stderr, "Could not find an audio stream in %s\n", filename);
+        goto end;
+    }
+    stream_index = ret;
+
+    dec_ctx = avcodec_alloc_context3(dec);
+    if (!dec_ctx) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec_ctx, fmt_ctx->streams[stream_index]->codecpar)) < 0 ||
+        (ret = avcodec_open2(dec_ctx, dec, NULL)) < 0) {
+        fprintf(stderr, "Could not open the decoder of %s\n", filename);
+        goto end;
+    }
+
+    sig->sample_rate = dec_ctx->sample_rate;
+    sig->sample_fmt = dec_ctx->sample_fmt;
+    sig->ch_layout = dec_ctx->channel_layout ? dec_ctx->channel_layout :
+                     av_get_default_channel_layout(dec_ctx->channels);
+    nb_channels = av_get_channel_layout_nb_channels(sig->ch_layout);
+    capacity = (int64_t)sig->sample_rate * duration;
+
+    ret = av_samples_alloc_array_and_samples(&sig->data, NULL, nb_channels, capacity, sig->sample_fmt, 0);
+    if (ret < 0)
+        goto end;
+
+    while (sig->nb_samples < capacity && (ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        if (pkt->stream_index == stream_index && avcodec_send_packet(dec_ctx, pkt) >= 0) {
+            while (sig->nb_samples < capacity && avcodec_receive_frame(dec_ctx, frame) >= 0) {
+                int n = FFMIN(frame->nb_samples, capacity - sig->nb_samples);
+                if (frame->channels == nb_channels && frame->format == sig->sample_fmt) {
+                    av_samples_copy(sig->data, frame->extended_data, sig->nb_samples, 0, n,
+                                    nb_channels, sig->sample_fmt);
+                    sig->nb_samples += n;
+                }
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    ret = sig->nb_samples > 0 ? 0 : AVERROR_INVALIDDATA;
+    if (ret < 0)
+        fprintf(stderr, "Could not decode any sample of %s\n", filename);
+end:
+    if (ret < 0)
+        free_signal(sig);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&dec_ctx);
+    avformat_close_input(&fmt_ctx);
+    return ret;
+}
+
+/**
+ * Streams sig through a new SwrContext in BENCH_CHUNK input samples, then
+ * flushes it. Only the swr_convert() calls are timed.
+ */
+static int run_resampler(const Signal *sig, int out_rate, int64_t out_layout, enum AVSampleFormat out_fmt,
+                         const char *opts, Result *res)
+{
+    int in_channels = av_get_channel_layout_nb_channels(sig->ch_layout);
+    int out_channels = av_get_channel_layout_nb_channels(out_layout);
+    const uint8_t *in[64] = { NULL };
+    uint8_t **out = NULL;
+    int max_out = 0, ret;
+    int64_t offset = 0;
+    struct SwrContext *swr_ctx;
+
+    memset(res, 0, sizeof(*res));
+    res->ch0_size = av_rescale_rnd(sig->nb_samples, out_rate, sig->sample_rate, AV_ROUND_UP) + BENCH_CHUNK;
+    res->ch0 = av_malloc_array(res->ch0_size, sizeof(double));
+    if (!res->ch0)
+        return AVERROR(ENOMEM);
+
+    swr_ctx = swr_alloc_set_opts(NULL, out_layout, out_fmt, out_rate,
+                                 sig->ch_layout, sig->sample_fmt, sig->sample_rate, 0, NULL);
+    if (!swr_ctx)
+        return AVERROR(ENOMEM);
+    if ((opts && (ret = av_set_options_string(swr_ctx, opts, "=", ":")) < 0) ||
+        (ret = swr_init(swr_ctx)) < 0)
+        goto end;
+
+    for (;;) {
+        int in_count = (int)FFMIN(BENCH_CHUNK, sig->nb_samples - offset);
+        int needed = (int)av_rescale_rnd(swr_get_delay(swr_ctx, sig->sample_rate) + FFMAX(in_count, 0),
+                                         out_rate, sig->sample_rate, AV_ROUND_UP);
+        int64_t start, delay, i;
+
+        if (needed > max_out) {
+            if (out)
+                av_freep(&out[0]);
+            av_freep(&out);
+            if ((ret = av_samples_alloc_array_and_samples(&out, NULL, out_channels, needed, out_fmt, 0)) < 0)
+                goto end;
+            max_out = needed;
+        }
+
+        /* no input left: flush the delayed samples */
+        if (in_count > 0)
+            offset_samples(in, sig->data, sig->sample_fmt, in_channels, offset);
+
+        start = av_gettime_relative();
+        ret = swr_convert(swr_ctx, out, max_out, in_count > 0 ? in : NULL, FFMAX(in_count, 0));
+        res->seconds += (av_gettime_relative() - start) / 1000000.0;
+        if (ret < 0)
+            goto end;
+
+        delay = swr_get_delay(swr_ctx, 1000000);
+        res->latency_us = FFMAX(res->latency_us, delay);
+
+        for (i = 0; i < ret && res->out_samples + i < res->ch0_size; i++)
+            res->ch0[res->out_samples + i] = get_sample(out, out_fmt, out_channels, 0, i);
+        res->out_samples += ret;
+
+        if (in_count > 0)
+            offset += in_count;
+        else if (ret == 0)
+            break;
+    }
+    res->out_samples = FFMIN(res->out_samples, res->ch0_size);
+    ret = 0;
+end:
+    if (out)
+        av_freep(&out[0]);
+    av_freep(&out);
+    swr_free(&swr_ctx);
+    return ret;
+}
+
+/**
+ * SNR of x against the best fitting sine of frequency freq: the fitted sine
+ * energy over the residual energy, in dB.
+ */
+static double sine_snr(const double *x, int64_t n, double freq, int rate)
+{
+    double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, det, a, b, signal = 0, noise = 0;
+    double w = 2 * M_PI * freq / rate;
+    int64_t i;
+
+    if (n <= 2 * BENCH_EDGE)
+        return NAN;
+
+    for (i = BENCH_EDGE; i < n - BENCH_EDGE; i++) {
+        double s = sin(w * i), c = cos(w * i);
+        ss += s * s; sc += s * c; cc += c * c;
+        xs += x[i] * s; xc += x[i] * c;
+    }
+    det = ss * cc - sc * sc;
+    a = (xs * cc - xc * sc) / det;
+    b = (xc * ss - xs * sc) / det;
+
+    for (i = BENCH_EDGE; i < n - BENCH_EDGE; i++) {
+        double fit = a * sin(w * i) + b * cos(w * i);
+        signal += fit * fit;
+        noise += (x[i] - fit) * (x[i] - fit);
+    }
+    return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+/**
+ * SNR of x against the reference output ref, aligned on the lag with the best
+ * correlation and scaled by the least squares gain, in dB.
+ */
+static double reference_snr(const double *x, int64_t n, const double *ref, int64_t ref_n)
+{
+    int64_t len = FFMIN(n, ref_n), i;
+    double best = -INFINITY, xr = 0, rr = 0, gain, signal = 0, noise = 0;
+    int lag, best_lag = 0;
+
+    if (len <= 2 * BENCH_EDGE)
+        return NAN;
+
+    for (lag = -BENCH_MAX_LAG; lag <= BENCH_MAX_LAG; lag++) {
+        double corr = 0;
+        for (i = BENCH_EDGE; i < FFMIN(BENCH_EDGE + BENCH_LAG_WINDOW, len - BENCH_EDGE); i++)
+            corr += x[i + lag] * ref[i];
+        if (corr > best) {
+            best = corr;
+            best_lag = lag;
+        }
+    }
+
+    for (i = BENCH_EDGE; i < len - BENCH_EDGE; i++) {
+        xr += x[i + best_lag] * ref[i];
+        rr += ref[i] * ref[i];
+    }
+    gain = rr > 0 ? xr / rr : 0;
+
+    for (i = BENCH_EDGE; i < len - BENCH_EDGE; i++) {
+        double r = gain * ref[i];
+        signal += r * r;
+        noise += (x[i + best_lag] - r) * (x[i + best_lag] - r);
+    }
+    return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+static void print_csv_header(FILE *csv)
+{
+    fprintf(csv, "signal,in_rate,out_rate,in_layout,out_layout,in_fmt,out_fmt,engine,"
+                 "in_samples,out_samples,seconds,samples_per_s,latency_us,snr_db,quality_ref\n");
+}
+
+/**
+ * Runs sig through engine and prints its CSV row, ref being the reference
+ * output of a real file. Unavailable engines, e.g. soxr when libswresample is
+ * built without it, are reported once and skipped.
+ */
+static int bench_run(FILE *csv, const Signal *sig, int out_rate, int64_t out_layout, enum AVSampleFormat out_fmt,
+                     Engine *engine, const Result *ref)
+{
+    char in_layout_name[64], out_layout_name[64];
+    Result res;
+    double snr;
+    int ret;
+
+    if (engine->unavailable)
+        return 0;
+
+    ret = run_resampler(sig, out_rate, out_layout, out_fmt, engine->opts, &res);
+    if (ret < 0) {
+        av_freep(&res.ch0);
+        if (ret == AVERROR_OPTION_NOT_FOUND || ret == AVERROR(EINVAL)) {
+            fprintf(stderr, "Engine %s unavailable, skipped\n", engine->name);
+            engine->unavailable = 1;
+            return 0;
+        }
+        fprintf(stderr, "Error while resampling %s with %s\n", sig->name, engine->name);
+        return ret;
+    }
+
+    snr = sig->sine_freq > 0 ? sine_snr(res.ch0, res.out_samples, sig->sine_freq, out_rate) :
+                               reference_snr(res.ch0, res.out_samples, ref->ch0, ref->out_samples);
+
+    av_get_channel_layout_string(in_layout_name, sizeof(in_layout_name), 0, sig->ch_layout);
+    av_get_channel_layout_string(out_layout_name, sizeof(out_layout_name), 0, out_layout);
+
+    fprintf(csv, "%s,%d,%d,%s,%s,%s,%s,%s,%"PRId64",%"PRId64",%.6f,%.0f,%"PRId64",%.2f,%s\n",
+            sig->name, sig->sample_rate, out_rate, in_layout_name, out_layout_name,
+            av_get_sample_fmt_name(sig->sample_fmt), av_get_sample_fmt_name(out_fmt), engine->name,
+            sig->nb_samples, res.out_samples, res.seconds,
+            res.seconds > 0 ? sig->nb_samples / res.seconds : 0.0,
+            res.latency_us, snr, sig->sine_freq > 0 ? "sine" : "reference");
+    fflush(csv);
+
+    av_freep(&res.ch0);
+    return 0;
+}
+
+/**
+ * Engines are only compared when the rate changes: otherwise swr does not
+ * resample and the first one is enough.
+ */
+static int bench_engines_run(FILE *csv, const Signal *sig, int out_rate, int64_t out_layout,
+                             enum AVSampleFormat out_fmt, const Result *ref)
+{
+    int nb_engines = sig->sample_rate == out_rate ? 1 : (int)FF_ARRAY_ELEMS(bench_engines);
+    int i, ret;
+
+    for (i = 0; i < nb_engines; i++)
+        if ((ret = bench_run(csv, sig, out_rate, out_layout, out_fmt, &bench_engines[i], ref)) < 0)
+            return ret;
+    return 0;
+}
+
+static int bench_generated(FILE *csv, int duration)
+{
+    int r, l, f, ret;
+
+    for (r = 0; r < FF_ARRAY_ELEMS(bench_rates); r++) {
+        for (l = 0; l < FF_ARRAY_ELEMS(bench_layouts); l++) {
+            for (f = 0; f < FF_ARRAY_ELEMS(bench_formats); f++) {
+                Signal sig;
+                if ((ret = generate_signal(&sig, bench_rates[r][0], bench_layouts[l][0], bench_formats[f][0], duration)) < 0) {
+                    fprintf(stderr, "Could not generate the signal\n");
+                    return ret;
+                }
+                ret = bench_engines_run(csv, &sig, bench_rates[r][1], bench_layouts[l][1], bench_formats[f][1], NULL);
+                free_signal(&sig);
+                if (ret < 0)
+                    return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+static int bench_file(FILE *csv, const char *filename, int duration)
+{
+    Signal sig;
+    int r, l, f, ret = 0;
+
+    if ((ret = load_signal(&sig, filename, duration)) < 0)
+        return ret;
+
+    for (r = 0; r < FF_ARRAY_ELEMS(bench_file_rates) && ret >= 0; r++) {
+        for (l = 0; l < FF_ARRAY_ELEMS(bench_file_layouts) && ret >= 0; l++) {
+            /* one reference per output rate and layout, in double precision */
+            Result ref;
+            ret = run_resampler(&sig, bench_file_rates[r], bench_file_layouts[l], AV_SAMPLE_FMT_DBL,
+                                BENCH_REFERENCE_OPTS, &ref);
+            if (ret < 0)
+                fprintf(stderr, "Could not compute the reference of %s\n", sig.name);
+            for (f = 0; f < FF_ARRAY_ELEMS(bench_file_formats) && ret >= 0; f++)
+                ret = bench_engines_run(csv, &sig, bench_file_rates[r], bench_file_layouts[l],
+                                        bench_file_formats[f], &ref);
+            av_freep(&ref.ch0);
+        }
+    }
+    free_signal(&sig);
+    return ret;
+}
+
+static int benchmark(int argc, char **argv)
+{
+    int duration = BENCH_DURATION, generated = 1, i, ret = 0;
+    FILE *csv = stdout;
+    char *end;
+
+    for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-duration") && i + 1 < argc) {
+            duration = (int)strtol(argv[++i], &end, 10);
+            if (*end != '\0' || duration < 1) {
+                fprintf(stderr, "Invalid duration %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            csv = fopen(argv[++i], "w");
+            if (!csv) {
+                fprintf(stderr, "Could not open %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-files-only")) {
+            generated = 0;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    print_csv_header(csv);
+
+    if (generated)
+        ret = bench_generated(csv, duration);
+    for (; i < argc && ret >= 0; i++)
+        ret = bench_file(csv, argv[i], duration);
+
+    if (csv != stdout)
+        fclose(csv);
+    return ret < 0;
+}
+
 int main(int argc, char **argv)
 {
     int64_t src_ch_layout = AV_CH_LAYOUT_STEREO, dst_ch_layout = AV_CH_LAYOUT_SURROUND;
@@ -61,12 +608,18 @@ int main(int argc, char **argv)
     struct SwrContext *swr_ctx;
     double t;
     int ret;
+    if (argc >= 2 && !strcmp(argv[1], "-bench"))
+        return benchmark(argc - 2, argv + 2);
     if (argc != 2) {
         fprintf(stderr, "Usage: %s output_file\n"
+                "       %s -bench [-duration seconds] [-files-only] [-o results.csv] [file ...]\n"
                 "API example program to show how to resample an audio stream with libswresample.\n"
                 "This program generates a series of audio frames, resamples them to a specified "
-                "output format and rate and saves them to an output file named output_file.\n",
-            argv[0]);
+                "output format and rate and saves them to an output file named output_file.\n"
+                "With -bench, a matrix of rates, channel layouts and sample formats is resampled "
+                "with each swr engine configuration, from a generated sine and from the given files, "
+                "and the throughput, latency and SNR of each run are printed as CSV.\n",
+            argv[0], argv[0]);
         exit(1);
     }
     dst_filename = argv[1];
@@ -0,0 +1,903 @@
+/**
+*
+*   File:   thumbnail.c
+*           Headless batch thumbnail extraction, building on saveFrame() in
+*           tutorial01.c: for each input file, N evenly spaced keyframes are
+*           sought to and decoded, the non-keyframes are never decoded, and each
+*           frame is scaled straight to the thumbnail size with a single
+*           sws_scale() call. The thumbnails are written as JPEG, PNG, PPM or
+*           raw RGB24 through buffered I/O. The files are processed in
+*           parallel, one per worker thread, and the throughput is reported in
+*           files/s.
+*
+*           Compiled using
+*               gcc -o thumbnail thumbnail.c -lavutil -lavformat -lavcodec -lswscale -lpthread -lz -lm
+*           on Arch Linux.
+*
+*           Usage: ./thumbnail [-n N] [-size WxH] [-format F] [-q Q] [-jobs N] [-o DIR] file ...
+*
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/time.h>
+#include <libavutil/avstring.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+
+/**
+ * Default and maximum number of thumbnails per file.
+ */
+#define THUMBNAIL_COUNT 10
+#define THUMBNAIL_MAX_COUNT 1000
+
+/**
+ * Default thumbnail width, the height follows the video aspect ratio.
+ */
+#define THUMBNAIL_WIDTH 320
+
+/**
+ * Maximum thumbnail width and height.
+ */
+#define THUMBNAIL_MAX_SIZE 8192
+
+/**
+ * Default JPEG quality: the MJPEG encoder qscale, from 2 (best) to 31.
+ */
+#define THUMBNAIL_JPEG_QUALITY 3
+
+/**
+ * Maximum number of worker threads.
+ */
+#define THUMBNAIL_MAX_JOBS 64
+
+/**
+ * Size of the stdio buffer of each worker: a thumbnail is written to disk in
+ * one go.
+ */
+#define THUMBNAIL_IO_BUFFER_SIZE (256 * 1024)
+
+/**
+ * Output file path size.
+ */
+#define THUMBNAIL_PATH_SIZE 1024
+
+/**
+ * Memory alignment, in bytes, of the thumbnails planes and lines.
+ */
+#define THUMBNAIL_ALIGN 32
+
+/**
+ * Maximum number of keyframes decoded for one thumbnail: the keyframe found
+ * by a seek may be the one of the previous thumbnail, the next ones are then
+ * tried.
+ */
+#define THUMBNAIL_MAX_ATTEMPTS 4
+
+/**
+ * Output formats.
+ */
+enum
+{
+    THUMBNAIL_FORMAT_JPEG,
+    THUMBNAIL_FORMAT_PNG,
+    THUMBNAIL_FORMAT_PPM,
+    THUMBNAIL_FORMAT_RAW
+};
+
+/**
+ * Extraction options.
+ */
+typedef struct ThumbnailOptions
+{
+    int             count;
+    int             width;
+    int             height;
+    int             format;
+    int             quality;
+    int             jobs;
+    const char *    output_dir;
+} ThumbnailOptions;
+
+/**
+ * The input files and the next one to be processed, shared by the workers.
+ */
+typedef struct ThumbnailJob
+{
+    const ThumbnailOptions *    options;
+    const char **               files;
+    int                         nb_files;
+    int                         next_file;
+    pthread_mutex_t             mutex;
+} ThumbnailJob;
+
+/**
+ * A worker thread: the packet, frames, conversion and encoding contexts and
+ * the I/O buffer are reused for all of the files it processes.
+ */
+typedef struct ThumbnailWorker
+{
+    ThumbnailJob *          job;
+    pthread_t               tid;
+
+    AVPacket *              packet;
+    AVFrame *               frame;
+    AVFrame *               thumb;
+    struct SwsContext *     sws_ctx;
+    AVCodecContext *        encoder;
+    AVPacket *              encoded;
+    char *                  io_buffer;
+
+    /**
+     * Counters.
+     */
+    int                     files;
+    int                     failed;
+    int64_t                 thumbnails;
+} ThumbnailWorker;
+
+/**
+ * Methods declaration.
+ */
+void printHelpMenu();
+
+static void * worker_thread(void * arg);
+
+static int extract_file(ThumbnailWorker * worker, const char * filename);
+
+static int decode_keyframe(ThumbnailWorker * worker, AVFormatContext * pFormatCtx, AVCodecContext * codecCtx, int videoStream);
+
+static void thumbnail_size(const ThumbnailOptions * options, AVCodecContext * codecCtx, AVRational sar, int * width, int * height);
+
+static int scale_thumbnail(ThumbnailWorker * worker, int width, int height, enum AVPixelFormat pix_fmt);
+
+static int open_encoder(ThumbnailWorker * worker, int width, int height);
+
+static int write_thumbnail(ThumbnailWorker * worker, const char * path);
+
+/**
+ * Entry point.
+ *
+ * @param   argc    command line arguments counter.
+ * @param   argv    command line arguments.
+ *
+ * @return          execution exit code.
+ */
+int main(int argc, char * argv[])
+{
+    ThumbnailOptions options;
+    options.count = THUMBNAIL_COUNT;
+    options.width = THUMBNAIL_WIDTH;
+    options.height = 0;
+    options.format = THUMBNAIL_FORMAT_JPEG;
+    options.quality = THUMBNAIL_JPEG_QUALITY;
+    options.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    options.output_dir = ".";
+
+    // parse the options, the remaining arguments are the input files
+    const char ** files = av_mallocz_array(argc, sizeof(char *));
+    int nb_files = 0;
+    char * pEnd;
+
+    if (!files)
+    {
+        printf("Could not allocate the input files list.\n");
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            options.count = (int)strtol(argv[++i], &pEnd, 10);
+
+            if (*pEnd != '\0' || options.count < 1 || options.count > THUMBNAIL_MAX_COUNT)
+            {
+                printf("Invalid number of thumbnails: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+        {
+            // WxH fits the thumbnails in the box, W alone sets the width
+            options.width = (int)strtol(argv[++i], &pEnd, 10);
+            options.height = 0;
+
+            if (*pEnd == 'x')
+            {
+                options.height = (int)strtol(pEnd + 1, &pEnd, 10);
+            }
+
+            if (*pEnd != '\0' || options.width < 2 || options.width > THUMBNAIL_MAX_SIZE ||
+                options.height < 0 || options.height == 1 || options.height > THUMBNAIL_MAX_SIZE)
+            {
+                printf("Invalid thumbnail size: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc)
+        {
+            i++;
+
+            if (strcmp(argv[i], "jpeg") == 0 || strcmp(argv[i], "jpg") == 0)
+            {
+                options.format = THUMBNAIL_FORMAT_JPEG;
+            }
+            else if (strcmp(argv[i], "png") == 0)
+            {
+                options.format = THUMBNAIL_FORMAT_PNG;
+            }
+            else if (strcmp(argv[i], "ppm") == 0)
+            {
+                options.format = THUMBNAIL_FORMAT_PPM;
+            }
+            else if (strcmp(argv[i], "raw") == 0)
+            {
+                options.format = THUMBNAIL_FORMAT_RAW;
+            }
+            else
+            {
+                printf("Invalid output format: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            options.quality = (int)strtol(argv[++i], &pEnd, 10);
+
+            if (*pEnd != '\0' || options.quality < 2 || options.quality > 31)
+            {
+                printf("Invalid JPEG quality: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-jobs") == 0 && i + 1 < argc)
+        {
+            options.jobs = (int)strtol(argv[++i], &pEnd, 10);
+
+            if (*pEnd != '\0' || options.jobs < 1 || options.jobs > THUMBNAIL_MAX_JOBS)
+            {
+                printf("Invalid number of jobs: %s.\n", argv[i]);
+                goto fail;
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            printHelpMenu();
+            goto fail;
+        }
+        else
+        {
+            files[nb_files++] = argv[i];
+        }
+    }
+
+    if (nb_files == 0)
+    {
+        printHelpMenu();
+        goto fail;
+    }
+
+    // one worker per core, never more than files
+    options.jobs = FFMAX(1, FFMIN(FFMIN(options.jobs, THUMBNAIL_MAX_JOBS), nb_files));
+
+    ThumbnailJob job;
+    job.options = &options;
+    job.files = files;
+    job.nb_files = nb_files;
+    job.next_file = 0;
+    pthread_mutex_init(&job.mutex, NULL);
+
+    ThumbnailWorker * workers = av_mallocz_array(options.jobs, sizeof(ThumbnailWorker));
+    if (!workers)
+    {
+        printf("Could not allocate the workers.\n");
+        pthread_mutex_destroy(&job.mutex);
+        goto fail;
+    }
+
+    int64_t start = av_gettime_relative();
+
+    int nb_workers = 0;
+    for (; nb_workers < options.jobs; nb_workers++)
+    {
+        workers[nb_workers].job = &job;
+
+        if (pthread_create(&workers[nb_workers].tid, NULL, worker_thread, &workers[nb_workers]) != 0)
+        {
+            printf("Could not start worker thread %d.\n", nb_workers);
+            break;
+        }
+    }
+
+    // the started workers process all of the files, even if some failed to start
+    int files_done = 0;
+    int files_failed = 0;
+    int64_t thumbnails = 0;
+
+    for (int i = 0; i < nb_workers; i++)
+    {
+        pthread_join(workers[i].tid, NULL);
+
+        files_done += workers[i].files;
+        files_failed += workers[i].failed;
+        thumbnails += workers[i].thumbnails;
+    }
+
+    double seconds = (av_gettime_relative() - start) / 1000000.0;
+
+    printf("Extracted %lld thumbnails from %d files (%d failed) in %.3f s with %d workers.\n",
+           (long long)thumbnails, files_done, files_failed, seconds, nb_workers);
+    printf("Throughput: %.1f files/s, %.1f thumbnails/s.\n",
+           seconds > 0 ? files_done / seconds : 0.0,
+           seconds > 0 ? thumbnails / seconds : 0.0);
+
+    pthread_mutex_destroy(&job.mutex);
+    av_free(workers);
+    av_free(files);
+
+    return nb_workers > 0 && files_failed == 0 ? 0 : -1;
+
+    fail:
+    {
+        av_free(files);
+
+        return -1;
+    };
+}
+
+/**
+ * Print help menu containing usage information.
+ */
+void printHelpMenu()
+{
+    printf("Invalid arguments.\n\n");
+    printf("Usage: ./thumbnail [options] file ...\n\n");
+    printf("Options:\n");
+    printf("    -n N        thumbnails per file, at evenly spaced keyframes (1-%d, default %d).\n", THUMBNAIL_MAX_COUNT, THUMBNAIL_COUNT);
+    printf("    -size WxH   thumbnail size, fitting in WxH; W alone sets the width (default %d).\n", THUMBNAIL_WIDTH);
+    printf("    -format F   jpeg, png, ppm or raw (RGB24) (default jpeg).\n");
+    printf("    -q Q        JPEG quality, 2 (best) to 31 (default %d).\n", THUMBNAIL_JPEG_QUALITY);
+    printf("    -jobs N     files processed in parallel (1-%d, default one per core).\n", THUMBNAIL_MAX_JOBS);
+    printf("    -o DIR      output directory (default .).\n\n");
+    printf("The thumbnails of <dir>/<name>.<ext> are written to DIR/<name>-NNN.<format>.\n\n");
+    printf("e.g: ./thumbnail -n 16 -size 320x180 -o thumbs /home/rambodrahmani/Videos/*.mp4\n");
+}
+
+/**
+ * This function is used as callback for the pthread.
+ *
+ * Processes the input files one at a time until none is left.
+ *
+ * @param   arg the ThumbnailWorker.
+ *
+ * @return      NULL.
+ */
+static void * worker_thread(void * arg)
+{
+    ThumbnailWorker * worker = (ThumbnailWorker *)arg;
+    ThumbnailJob * job = worker->job;
+
+    worker->packet = av_packet_alloc();
+    worker->encoded = av_packet_alloc();
+    worker->frame = av_frame_alloc();
+    worker->io_buffer = av_malloc(THUMBNAIL_IO_BUFFER_SIZE);
+
+    if (!worker->packet || !worker->encoded || !worker->frame || !worker->io_buffer)
+    {
+        printf("Could not allocate the worker resources.\n");
+        goto end;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&job->mutex);
+        int index = job->next_file < job->nb_files ? job->next_file++ : -1;
+        pthread_mutex_unlock(&job->mutex);
+
+        if (index < 0)
+        {
+            break;
+        }
+
+        worker->files++;
+
+        if (extract_file(worker, job->files[index]) < 0)
+        {
+            printf("Could not extract the thumbnails of %s.\n", job->files[index]);
+            worker->failed++;
+        }
+    }
+
+    end:
+    {
+        av_packet_free(&worker->packet);
+        av_packet_free(&worker->encoded);
+        av_frame_free(&worker->frame);
+        av_frame_free(&worker->thumb);
+        sws_freeContext(worker->sws_ctx);
+        worker->sws_ctx = NULL;
+        avcodec_free_context(&worker->encoder);
+        av_freep(&worker->io_buffer);
+
+        return NULL;
+    };
+}
+
+/**
+ * Extracts the thumbnails of the given file: seeks to the keyframe before each
+ * of the evenly spaced timestamps, decodes it alone and writes it scaled. If
+ * the duration is unknown, the first keyframes are used.
+ *
+ * @param   worker      the ThumbnailWorker.
+ * @param   filename    the input file.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int extract_file(ThumbnailWorker * worker, const char * filename)
+{
+    const ThumbnailOptions * options = worker->job->options;
+    AVFormatContext * pFormatCtx = NULL;
+    AVCodecContext * codecCtx = NULL;
+    int written = 0;
+
+    if (avformat_open_input(&pFormatCtx, filename, NULL, NULL) < 0)
+    {
+        printf("Could not open file %s.\n", filename);
+        goto fail;
+    }
+
+    if (avformat_find_stream_info(pFormatCtx, NULL) < 0)
+    {
+        printf("Could not find stream information: %s.\n", filename);
+        goto fail;
+    }
+
+    AVCodec * codec = NULL;
+    int videoStream = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (videoStream < 0 || !codec)
+    {
+        printf("Could not find a video stream: %s.\n", filename);
+        goto fail;
+    }
+
+    AVStream * stream = pFormatCtx->streams[videoStream];
+
+    // only the video stream packets are demuxed
+    for (int i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        pFormatCtx->streams[i]->discard = i == videoStream ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+
+    codecCtx = avcodec_alloc_context3(codec);
+    if (!codecCtx || avcodec_parameters_to_context(codecCtx, stream->codecpar) < 0)
+    {
+        printf("Could not allocate the codec context.\n");
+        goto fail;
+    }
+
+    // the files are decoded in parallel, each one on a single thread, and the
+    // decoder drops anything but the keyframes
+    codecCtx->thread_count = 1;
+    codecCtx->skip_frame = AVDISCARD_NONKEY;
+
+    if (avcodec_open2(codecCtx, codec, NULL) < 0)
+    {
+        printf("Unsupported codec.\n");
+        goto fail;
+    }
+
+    int width, height;
+    thumbnail_size(options, codecCtx, av_guess_sample_aspect_ratio(pFormatCtx, stream, NULL), &width, &height);
+
+    // evenly spaced timestamps, in the middle of each of the count intervals
+    int64_t duration = pFormatCtx->duration;
+    int64_t start_time = pFormatCtx->start_time != AV_NOPTS_VALUE ? pFormatCtx->start_time : 0;
+
+    if (duration <= 0 && stream->duration > 0)
+    {
+        duration = av_rescale_q(stream->duration, stream->time_base, AV_TIME_BASE_Q);
+    }
+
+    // the output files are named after the input file, without its extension
+    const char * base = strrchr(filename, '/');
+    base = base ? base + 1 : filename;
+    const char * ext = strrchr(base, '.');
+    int base_len = ext && ext != base ? (int)(ext - base) : (int)strlen(base);
+
+    static const char * extensions[] = {"jpg", "png", "ppm", "rgb"};
+
+    int64_t last_pts = AV_NOPTS_VALUE;
+
+    for (int i = 0; i < options->count; i++)
+    {
+        if (duration > 0)
+        {
+            int64_t target = start_time + av_rescale(duration, 2 * i + 1, 2 * options->count);
+
+            // the keyframe at or before the target, the decoder state is reset
+            if (av_seek_frame(pFormatCtx, videoStream, av_rescale_q(target, AV_TIME_BASE_Q, stream->time_base), AVSEEK_FLAG_BACKWARD) < 0)
+            {
+                printf("Could not seek %s, using the next keyframes.\n", filename);
+                duration = 0;
+            }
+        }
+
+        int ret = 0;
+
+        // a sparse keyframes file may seek back to the previous thumbnail frame
+        for (int attempt = 0; attempt < THUMBNAIL_MAX_ATTEMPTS; attempt++)
+        {
+            ret = decode_keyframe(worker, pFormatCtx, codecCtx, videoStream);
+            if (ret < 0 || last_pts == AV_NOPTS_VALUE || worker->frame->best_effort_timestamp > last_pts)
+            {
+                break;
+            }
+        }
+
+        if (ret == AVERROR_EOF)
+        {
+            // fewer keyframes than thumbnails
+            break;
+        }
+        else if (ret < 0)
+        {
+            goto fail;
+        }
+
+        last_pts = worker->frame->best_effort_timestamp;
+
+        enum AVPixelFormat pix_fmt = options->format == THUMBNAIL_FORMAT_JPEG ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_RGB24;
+
+        if (scale_thumbnail(worker, width, height, pix_fmt) < 0)
+        {
+            goto fail;
+        }
+
+        av_frame_unref(worker->frame);
+
+        char path[THUMBNAIL_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/%.*s-%03d.%s", options->output_dir, base_len, base, i, extensions[options->format]);
+
+        if (write_thumbnail(worker, path) < 0)
+        {
+            goto fail;
+        }
+
+        written++;
+    }
+
+    worker->thumbnails += written;
+
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&pFormatCtx);
+
+    return written > 0 ? 0 : -1;
+
+    fail:
+    {
+        worker->thumbnails += written;
+
+        av_frame_unref(worker->frame);
+        avcodec_free_context(&codecCtx);
+        avformat_close_input(&pFormatCtx);
+
+        return -1;
+    };
+}
+
+/**
+ * Decodes the next keyframe of the video stream into worker->frame. The
+ * decoder is flushed first, since this follows a seek, and drained once a
+ * keyframe packet is sent: a single packet is decoded per thumbnail.
+ *
+ * @param   worker      the ThumbnailWorker.
+ * @param   pFormatCtx  the input AVFormatContext.
+ * @param   codecCtx    the video AVCodecContext.
+ * @param   videoStream the video stream index.
+ *
+ * @return              0 if a frame was decoded, AVERROR_EOF at the end of the
+ *                      input, < 0 in case of error.
+ */
+static int decode_keyframe(ThumbnailWorker * worker, AVFormatContext * pFormatCtx, AVCodecContext * codecCtx, int videoStream)
+{
+    avcodec_flush_buffers(codecCtx);
+
+    for (;;)
+    {
+        int ret = av_read_frame(pFormatCtx, worker->packet);
+        if (ret == AVERROR_EOF)
+        {
+            return AVERROR_EOF;
+        }
+        else if (ret < 0)
+        {
+            printf("Error while reading the input.\n");
+            return ret;
+        }
+
+        // the non-keyframes are dropped before reaching the decoder
+        if (worker->packet->stream_index != videoStream || !(worker->packet->flags & AV_PKT_FLAG_KEY))
+        {
+            av_packet_unref(worker->packet);
+            continue;
+        }
+
+        ret = avcodec_send_packet(codecCtx, worker->packet);
+        av_packet_unref(worker->packet);
+
+        if (ret < 0)
+        {
+            // corrupted keyframe, try the next one
+            avcodec_flush_buffers(codecCtx);
+            continue;
+        }
+
+        // drain the decoder: the reordering delay would otherwise hold the
+        // frame back until more packets are sent
+        avcodec_send_packet(codecCtx, NULL);
+
+        ret = avcodec_receive_frame(codecCtx, worker->frame);
+        if (ret == 0)
+        {
+            return 0;
+        }
+        else if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN))
+        {
+            printf("Error while decoding.\n");
+            return ret;
+        }
+
+        // nothing came out of the packet, try the next keyframe
+        avcodec_flush_buffers(codecCtx);
+    }
+}
+
+/**
+ * Computes the thumbnail size from the options and the video display aspect
+ * ratio: the given width, or the largest size fitting in the given box. The
+ * sizes are even, for the subsampled JPEG chroma.
+ *
+ * @param   options     the ThumbnailOptions.
+ * @param   codecCtx    the video AVCodecContext.
+ * @param   sar         the video sample aspect ratio.
+ * @param   width       set to the thumbnail width.
+ * @param   height      set to the thumbnail height.
+ */
+static void thumbnail_size(const ThumbnailOptions * options, AVCodecContext * codecCtx, AVRational sar, int * width, int * height)
+{
+    double aspect_ratio = (double)codecCtx->width / codecCtx->height;
+    if (sar.num > 0 && sar.den > 0)
+    {
+        aspect_ratio *= av_q2d(sar);
+    }
+
+    *width = options->width;
+    *height = (int)(options->width / aspect_ratio + 0.5);
+
+    if (options->height > 0 && *height > options->height)
+    {
+        *height = options->height;
+        *width = (int)(options->height * aspect_ratio + 0.5);
+    }
+
+    *width = FFMAX(2, *width & ~1);
+    *height = FFMAX(2, *height & ~1);
+}
+
+/**
+ * Scales worker->frame to the thumbnail size and format into worker->thumb
+ * with a single sws_scale() call. The SwsContext and the thumbnail frame are
+ * kept across frames and files, rebuilt when the sizes or formats change.
+ *
+ * @param   worker      the ThumbnailWorker.
+ * @param   width       the thumbnail width.
+ * @param   height      the thumbnail height.
+ * @param   pix_fmt     the thumbnail pixel format.
+ *
+ * @return              < 0 in case of error, 0 otherwise.
+ */
+static int scale_thumbnail(ThumbnailWorker * worker, int width, int height, enum AVPixelFormat pix_fmt)
+{
+    AVFrame * frame = worker->frame;
+
+    if (!worker->thumb || worker->thumb->width != width || worker->thumb->height != height || worker->thumb->format != pix_fmt)
+    {
+        av_frame_free(&worker->thumb);
+
+        worker->thumb = av_frame_alloc();
+        if (!worker->thumb)
+        {
+            printf("Could not allocate frame.\n");
+            return -1;
+        }
+
+        worker->thumb->format = pix_fmt;
+        worker->thumb->width = width;
+        worker->thumb->height = height;
+
+        if (av_frame_get_buffer(worker->thumb, THUMBNAIL_ALIGN) < 0)
+        {
+            printf("Could not allocate frame buffer.\n");
+            return -1;
+        }
+    }
+
+    // the encoder may still reference the previous thumbnail
+    if (av_frame_make_writable(worker->thumb) < 0)
+    {
+        printf("Could not make the thumbnail writable.\n");
+        return -1;
+    }
+
+    worker->sws_ctx = sws_getCachedContext(
+            worker->sws_ctx,
+            frame->width,
+            frame->height,
+            frame->format,
+            width,
+            height,
+            pix_fmt,
+            SWS_BILINEAR,
+            NULL,
+            NULL,
+            NULL
+    );
+
+    if (!worker->sws_ctx)
+    {
+        printf("Could not create the SwsContext.\n");
+        return -1;
+    }
+
+    sws_scale(
+            worker->sws_ctx,
+            (uint8_t const * const *)frame->data,
+            frame->linesize,
+            0,
+            frame->height,
+            worker->thumb->data,
+            worker->thumb->linesize
+    );
+
+    return 0;
+}
+
+/**
+ * Opens the JPEG or PNG encoder of worker->thumb, kept until the thumbnail size
+ * changes.
+ *
+ * @param   worker  the ThumbnailWorker.
+ * @param   width   the thumbnail width.
+ * @param   height  the thumbnail height.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+static int open_encoder(ThumbnailWorker * worker, int width, int height)
+{
+    const ThumbnailOptions * options = worker->job->options;
+
+    if (worker->encoder && worker->encoder->width == width && worker->encoder->height == height)
+    {
+        return 0;
+    }
+
+    avcodec_free_context(&worker->encoder);
+
+    int jpeg = options->format == THUMBNAIL_FORMAT_JPEG;
+
+    AVCodec * codec = avcodec_find_encoder(jpeg ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_PNG);
+    if (!codec)
+    {
+        printf("Could not find the %s encoder.\n", jpeg ? "JPEG" : "PNG");
+        return -1;
+    }
+
+    worker->encoder = avcodec_alloc_context3(codec);
+    if (!worker->encoder)
+    {
+        printf("Could not allocate the encoder context.\n");
+        return -1;
+    }
+
+    worker->encoder->width = width;
+    worker->encoder->height = height;
+    worker->encoder->pix_fmt = jpeg ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_RGB24;
+    worker->encoder->time_base = (AVRational){1, 25};
+    worker->encoder->thread_count = 1;
+
+    if (jpeg)
+    {
+        // constant quality
+        worker->encoder->flags |= AV_CODEC_FLAG_QSCALE;
+        worker->encoder->global_quality = FF_QP2LAMBDA * options->quality;
+    }
+
+    if (avcodec_open2(worker->encoder, codec, NULL) < 0)
+    {
+        printf("Could not open the %s encoder.\n", jpeg ? "JPEG" : "PNG");
+        avcodec_free_context(&worker->encoder);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Writes worker->thumb to the given path through the worker stdio buffer: the
+ * encoded JPEG or PNG packet in a single fwrite(), or the PPM header and the
+ * RGB24 rows, buffered.
+ *
+ * @param   worker  the ThumbnailWorker.
+ * @param   path    the output file path.
+ *
+ * @return          < 0 in case of error, 0 otherwise.
+ */
+static int write_thumbnail(ThumbnailWorker * worker, const char * path)
+{
+    const ThumbnailOptions * options = worker->job->options;
+    AVFrame * thumb = worker->thumb;
+
+    if (options->format == THUMBNAIL_FORMAT_JPEG || options->format == THUMBNAIL_FORMAT_PNG)
+    {
+        if (open_encoder(worker, thumb->width, thumb->height) < 0)
+        {
+            return -1;
+        }
+
+        thumb->quality = worker->encoder->global_quality;
+
+        if (avcodec_send_frame(worker->encoder, thumb) < 0 ||
+            avcodec_receive_packet(worker->encoder, worker->encoded) < 0)
+        {
+            printf("Could not encode the thumbnail.\n");
+            return -1;
+        }
+    }
+
+    FILE * pFile = fopen(path, "wb");
+    if (pFile == NULL)
+    {
+        printf("Could not open %s.\n", path);
+        av_packet_unref(worker->encoded);
+        return -1;
+    }
+
+    setvbuf(pFile, worker->io_buffer, _IOFBF, THUMBNAIL_IO_BUFFER_SIZE);
+
+    if (options->format == THUMBNAIL_FORMAT_JPEG || options->format == THUMBNAIL_FORMAT_PNG)
+    {
+        fwrite(worker->encoded->data, 1, worker->encoded->size, pFile);
+        av_packet_unref(worker->encoded);
+    }
+    else
+    {
+        if (options->format == THUMBNAIL_FORMAT_PPM)
+        {
+            fprintf(pFile, "P6\n%d %d\n255\n", thumb->width, thumb->height);
+        }
+
+        for (int y = 0; y < thumb->height; y++)
+        {
+            fwrite(thumb->data[0] + y * thumb->linesize[0], 1, thumb->width * 3, pFile);
+        }
+    }
+
+    // the buffer is flushed to the file at once
+    if (fclose(pFile) != 0)
+    {
+        printf("Could not write %s.\n", path);
+        return -1;
+    }
+
+    return 0;
+}
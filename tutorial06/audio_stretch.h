@@ -0,0 +1,181 @@
+/**
+*
+*   File:   audio_stretch.h
+*           Linear interpolation stretch of interleaved S16 audio buffers, used by
+*           synchronize_audio() in tutorial06.c to correct the audio clock drift,
+*           and by bench/stretch.c to check the SIMD loops against the scalar one.
+*
+*           Everything is static inline so that tutorial06.c keeps building as a
+*           single translation unit.
+*
+*   Author: Rambod Rahmani <rambodrahmani@autistici.org>
+*           Created on 8/20/18.
+*
+**/
+
+#ifndef AUDIO_STRETCH_H
+#define AUDIO_STRETCH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_STRETCH_SIMD  "SSE2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_STRETCH_SIMD  "NEON"
+#else
+#define AUDIO_STRETCH_SIMD  NULL
+#endif
+
+/**
+ * Computes the stereo output frames [0, last) with the SIMD loop of the target,
+ * if any.
+ *
+ * @param   src     the input samples.
+ * @param   dst     the output samples.
+ * @param   last    the index of the last output frame.
+ * @param   step    the input position step per output frame, in 16.16 fixed point.
+ *
+ * @return          the number of output frames computed, the scalar loop does
+ *                  the others.
+ */
+static inline int audio_stretch_s16_stereo_simd(const int16_t * src, int16_t * dst, int last, uint64_t step)
+{
+    int j = 0;
+
+#if defined(__SSE2__)
+    const __m128i rounding = _mm_set1_epi32(1 << 13);
+
+    for (; j + 4 <= last; j += 4)
+    {
+        __m128i pairs[2];
+
+        for (int k = 0; k < 2; k++)
+        {
+            uint64_t pos0 = (uint64_t)(j + 2 * k) * step;
+            uint64_t pos1 = pos0 + step;
+
+            int w1a = (int)((pos0 & 0xffff) >> 2);
+            int w1b = (int)((pos1 & 0xffff) >> 2);
+
+            // [L0 R0 L1 R1] of both output frames, reordered to [L0 L1 R0 R1]
+            __m128i a = _mm_loadl_epi64((const __m128i *)&src[2 * (pos0 >> 16)]);
+            __m128i b = _mm_loadl_epi64((const __m128i *)&src[2 * (pos1 >> 16)]);
+            __m128i x = _mm_unpacklo_epi64(a, b);
+            x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 1, 2, 0));
+            x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 1, 2, 0));
+
+            __m128i w = _mm_set_epi16(
+                    (short)w1b, (short)((1 << 14) - w1b), (short)w1b, (short)((1 << 14) - w1b),
+                    (short)w1a, (short)((1 << 14) - w1a), (short)w1a, (short)((1 << 14) - w1a)
+            );
+
+            // [L R L' R'] in 32 bits, rounded back to 16 bits
+            pairs[k] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, w), rounding), 14);
+        }
+
+        _mm_storeu_si128((__m128i *)&dst[2 * j], _mm_packs_epi32(pairs[0], pairs[1]));
+    }
+#elif defined(__ARM_NEON)
+    for (; j < last; j++)
+    {
+        uint64_t pos = (uint64_t)j * step;
+        int w1 = (int)((pos & 0xffff) >> 2);
+
+        // [L0 R0 L1 R1] and [L1 R1 L0 R0]: lanes 0 and 1 get L and R
+        int16x4_t x = vld1_s16(&src[2 * (pos >> 16)]);
+        int16x4_t y = vext_s16(x, x, 2);
+
+        int32x4_t acc = vmull_n_s16(x, (int16_t)((1 << 14) - w1));
+        acc = vmlal_n_s16(acc, y, (int16_t)w1);
+
+        int16x4_t out = vrshrn_n_s32(acc, 14);
+        vst1_lane_s32((int32_t *)&dst[2 * j], vreinterpret_s32_s16(out), 0);
+    }
+#endif
+
+    return j;
+}
+
+/**
+ * Stretches or squeezes the given interleaved S16 audio buffer from src_frames to
+ * dst_frames sample frames, using linear interpolation between neighbouring
+ * samples. The first and the last sample frames are preserved.
+ *
+ * The position of each output frame in the input is computed in 16.16 fixed
+ * point, on 64 bits so that j * step cannot wrap for buffers longer than 65536
+ * frames, the interpolation weights in Q14: w0 + w1 = 1 << 14, so that both fit
+ * a signed 16 bits lane and the weighted sum of two samples fits 32 bits. The
+ * stereo case is vectorized with SSE2 (4 output frames per iteration, pmaddwd
+ * computes L0 * w0 + L1 * w1 for both channels at once) or NEON; the scalar loop
+ * gives bit-exact results and handles any number of channels.
+ *
+ * @param   src         the input samples.
+ * @param   src_frames  the number of input sample frames.
+ * @param   dst         the output samples, must not overlap src.
+ * @param   dst_frames  the number of output sample frames.
+ * @param   channels    the number of interleaved channels.
+ * @param   simd        0 to only run the scalar loop, as the reference.
+ */
+static inline void audio_stretch_s16_ex(const int16_t * src, int src_frames, int16_t * dst, int dst_frames, int channels, int simd)
+{
+    // nothing to interpolate between
+    if (src_frames < 2 || dst_frames < 2)
+    {
+        for (int j = 0; j < dst_frames; j++)
+        {
+            int i = j < src_frames - 1 ? j : src_frames - 1;
+            memcpy(&dst[j * channels], &src[i * channels], channels * sizeof(int16_t));
+        }
+        return;
+    }
+
+    // input position step per output frame: the last output frame maps onto
+    // the last input frame, all the others read two valid input frames
+    uint64_t step = ((uint64_t)(src_frames - 1) << 16) / (dst_frames - 1);
+    int last = dst_frames - 1;
+    int j = 0;
+
+    if (simd && channels == 2)
+    {
+        j = audio_stretch_s16_stereo_simd(src, dst, last, step);
+    }
+
+    // scalar loop: any channel count, and the frames left by the vector loops
+    for (; j < last; j++)
+    {
+        uint64_t pos = (uint64_t)j * step;
+        int w1 = (int)((pos & 0xffff) >> 2);
+        int w0 = (1 << 14) - w1;
+
+        const int16_t * s0 = &src[(pos >> 16) * channels];
+        const int16_t * s1 = s0 + channels;
+
+        for (int c = 0; c < channels; c++)
+        {
+            dst[j * channels + c] = (int16_t)((s0[c] * w0 + s1[c] * w1 + (1 << 13)) >> 14);
+        }
+    }
+
+    // the last output frame is the last input frame
+    memcpy(&dst[last * channels], &src[(src_frames - 1) * channels], channels * sizeof(int16_t));
+}
+
+/**
+ * Stretches the given interleaved S16 audio buffer, see audio_stretch_s16_ex(),
+ * with the SIMD loops when available.
+ *
+ * @param   src         the input samples.
+ * @param   src_frames  the number of input sample frames.
+ * @param   dst         the output samples, must not overlap src.
+ * @param   dst_frames  the number of output sample frames.
+ * @param   channels    the number of interleaved channels.
+ */
+static inline void audio_stretch_s16(const int16_t * src, int src_frames, int16_t * dst, int dst_frames, int channels)
+{
+    audio_stretch_s16_ex(src, src_frames, dst, dst_frames, channels, 1);
+}
+
+#endif  // AUDIO_STRETCH_H
@@ -30,6 +30,8 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_thread.h>
 
+#include "audio_stretch.h"
+
 /**
  * Prevents SDL from overriding main().
  */
@@ -150,6 +152,7 @@ typedef struct VideoState
     AVCodecContext *    audio_ctx;
     PacketQueue         audioq;
     uint8_t             audio_buf[(MAX_AUDIO_FRAME_SIZE * 3) /2];
+    uint8_t             audio_sync_buf[(MAX_AUDIO_FRAME_SIZE * 3) /2];
     unsigned int        audio_buf_size;
     unsigned int        audio_buf_index;
     AVFrame             audio_frame;
@@ -370,6 +373,10 @@ static int audio_resampling(
 
 AudioResamplingState * getAudioResampling(uint64_t channel_layout);
 
+static uint64_t audio_output_layout(int channels);
+
+static int audio_output_channels(VideoState * videoState);
+
 /**
  * Entry point.
  *
@@ -748,7 +755,7 @@ int stream_component_open(VideoState * videoState, int stream_index)
         // Set audio settings from codec info
         wanted_specs.freq = codecCtx->sample_rate;
         wanted_specs.format = AUDIO_S16SYS;
-        wanted_specs.channels = codecCtx->channels;
+        wanted_specs.channels = av_get_channel_layout_nb_channels(audio_output_layout(codecCtx->channels));
         wanted_specs.silence = 0;
         wanted_specs.samples = SDL_AUDIO_BUFFER_SIZE;
         wanted_specs.callback = audio_callback;
@@ -1276,7 +1283,7 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
     int n;
     double ref_clock;
 
-    n = 2 * videoState->audio_ctx->channels;
+    n = 2 * audio_output_channels(videoState);
 
     // check if
     if (videoState->av_sync_type != AV_SYNC_AUDIO_MASTER)
@@ -1287,7 +1294,7 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
         ref_clock = get_master_clock(videoState);
         diff = get_audio_clock(videoState) - ref_clock;
 
-        if (diff < AV_NOSYNC_THRESHOLD)
+        if (fabs(diff) < AV_NOSYNC_THRESHOLD)
         {
             // accumulate the diffs
             videoState->audio_diff_cum = diff + videoState->audio_diff_avg_coef * videoState->audio_diff_cum;
@@ -1309,8 +1316,8 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
                 if (fabs(avg_diff) >= videoState->audio_diff_threshold)
                 {
                     wanted_size = samples_size + ((int)(diff * videoState->audio_ctx->sample_rate) * n);
-                    min_size = samples_size * ((100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100);
-                    max_size = samples_size * ((100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100);
+                    min_size = samples_size * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100;
+                    max_size = samples_size * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100;
 
                     if(wanted_size < min_size)
                     {
@@ -1321,38 +1328,30 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
                         wanted_size = max_size;
                     }
 
+                    // the buffer must hold whole sample frames and fit audio_buf
+                    wanted_size = FFMIN(wanted_size, (int)sizeof(videoState->audio_buf)) / n * n;
+
                     /**
                      * Now we have to actually correct the audio. You may have noticed that our
                      * synchronize_audio function returns a sample size, which will then tell us
                      * how many bytes to send to the stream. So we just have to adjust the sample
-                     * size to the wanted_size. This works for making the sample size smaller.
-                     * But if we want to make it bigger, we can't just make the sample size larger
-                     * because there's no more data in the buffer! So we have to add it. But what
-                     * should we add? It would be foolish to try and extrapolate audio, so let's
-                     * just use the audio we already have by padding out the buffer with the
-                     * value of the last sample.
+                     * size to the wanted_size. Truncating the buffer or padding it out with the
+                     * last sample would make an audible click, so the whole buffer is stretched
+                     * or squeezed to the wanted size instead, interpolating between the samples.
+                     * The first and the last sample are kept, so the corrected buffer still joins
+                     * the next one smoothly.
                      */
-                    if(wanted_size < samples_size)
+                    if (wanted_size != samples_size && wanted_size > 0)
                     {
-                        /* remove samples */
-                        samples_size = wanted_size;
-                    }
-                    else if(wanted_size > samples_size)
-                    {
-                        uint8_t *samples_end, *q;
-                        int nb;
+                        audio_stretch_s16(
+                                samples,
+                                samples_size / n,
+                                (int16_t *)videoState->audio_sync_buf,
+                                wanted_size / n,
+                                n / 2
+                        );
 
-                        /* add samples by copying final sample*/
-                        nb = (samples_size - wanted_size);
-                        samples_end = (uint8_t *)samples + samples_size - n;
-                        q = samples_end + n;
-
-                        while(nb > 0)
-                        {
-                            memcpy(q, samples_end, n);
-                            q += n;
-                            nb -= n;
-                        }
+                        memcpy(samples, videoState->audio_sync_buf, wanted_size);
 
                         samples_size = wanted_size;
                     }
@@ -1534,7 +1533,7 @@ double get_audio_clock(VideoState * videoState)
 
     int bytes_per_sec = 0;
 
-    int n = 2 * videoState->audio_ctx->channels;
+    int n = 2 * audio_output_channels(videoState);
 
     if (videoState->audio_st)
     {
@@ -2155,7 +2154,7 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
             // keep audio_clock up-to-date
             pts = videoState->audio_clock;
             *pts_ptr = pts;
-            n = 2 * videoState->audio_ctx->channels;
+            n = 2 * audio_output_channels(videoState);
             videoState->audio_clock += (double)data_size / (double)(n * videoState->audio_ctx->sample_rate);
 
             // we have the data, return it and come back for more later
@@ -2190,6 +2189,42 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
     return 0;
 }
 
+/**
+ * Returns the channel layout audio_resampling() converts the decoded audio to:
+ * mono and stereo are kept, anything else is downmixed to 3 channels.
+ *
+ * @param   channels    the number of channels of the decoded audio.
+ *
+ * @return              the output channel layout.
+ */
+static uint64_t audio_output_layout(int channels)
+{
+    if (channels == 1)
+    {
+        return AV_CH_LAYOUT_MONO;
+    }
+    else if (channels == 2)
+    {
+        return AV_CH_LAYOUT_STEREO;
+    }
+
+    return AV_CH_LAYOUT_SURROUND;
+}
+
+/**
+ * Returns the number of interleaved channels of the resampled audio buffers.
+ * Their sizes and the audio clock must be computed on these, not on the
+ * decoded audio channels.
+ *
+ * @param   videoState  the global VideoState reference.
+ *
+ * @return              the number of output channels.
+ */
+static int audio_output_channels(VideoState * videoState)
+{
+    return av_get_channel_layout_nb_channels(audio_output_layout(videoState->audio_ctx->channels));
+}
+
 /**
  * Resamples the audio data retrieved using FFmpeg before playing it.
  *
@@ -2225,18 +2260,7 @@ static int audio_resampling(VideoState * videoState, AVFrame * decoded_audio_fra
     }
 
     // set output audio channels based on the input audio channels
-    if (videoState->audio_ctx->channels == 1)
-    {
-        arState->out_channel_layout = AV_CH_LAYOUT_MONO;
-    }
-    else if (videoState->audio_ctx->channels == 2)
-    {
-        arState->out_channel_layout = AV_CH_LAYOUT_STEREO;
-    }
-    else
-    {
-        arState->out_channel_layout = AV_CH_LAYOUT_SURROUND;
-    }
+    arState->out_channel_layout = audio_output_layout(videoState->audio_ctx->channels);
 
     // retrieve number of audio samples (per channel)
     arState->in_nb_samples = decoded_audio_frame->nb_samples;
@@ -24,14 +24,40 @@
 #define _DEBUG_ 1
 
 /**
- * SDL audio buffer size in samples.
+ * SDL audio buffer size in samples, default of --audio-buffer=N.
  */
 #define SDL_AUDIO_BUFFER_SIZE 1024
 
 /**
- * Maximum number of samples per channel in an audio frame.
+ * SDL audio buffer sizes in samples used by --audio-buffer=low and
+ * --audio-buffer=high: low latency for interactive use, low wake-up rate for
+ * batch and kiosk use.
  */
-#define MAX_AUDIO_FRAME_SIZE 192000
+#define AUDIO_BUFFER_LOW_LATENCY 256
+#define AUDIO_BUFFER_HIGH_LATENCY 8192
+
+/**
+ * Pseudo buffer size requesting a buffer size derived from the sample rate, so
+ * that the audio callback runs about AUDIO_MAX_CALLBACKS_PER_SEC times a second.
+ */
+#define AUDIO_BUFFER_AUTO 0
+#define AUDIO_MAX_CALLBACKS_PER_SEC 30
+
+/**
+ * Duration, in seconds, of decoded audio the AudioRing between the audio
+ * decoding thread and the audio callback can hold, at least.
+ */
+#define AUDIO_RING_DURATION 0.5
+
+/**
+ * --low-power mode: device buffer size in samples, duration in seconds of
+ * decoded audio held by the AudioRing and duration below which it is refilled.
+ * The audio decoding thread sleeps until the ring drains to the refill mark,
+ * then decodes up to the ring capacity in one burst.
+ */
+#define AUDIO_BUFFER_LOW_POWER 16384
+#define AUDIO_LOW_POWER_RING_DURATION 4.0
+#define AUDIO_LOW_POWER_REFILL_DURATION 1.0
 
 /**
  * Audio packets queue maximum size.
@@ -39,6 +65,29 @@
 #define MAX_AUDIOQ_SIZE (5 * 16 * 1024)
 
 
+/**
+ * Packet queues high watermark, in seconds of buffered media: decode_thread()
+ * stops reading when a packet queue holds more than this (or more than its
+ * maximum size in bytes) and none of the packet queues is below its low
+ * watermark.
+ */
+#define PACKET_QUEUE_HIGH_DURATION 2.0
+
+/**
+ * Packet queues low watermark, in seconds of buffered media and in percent of
+ * the queue maximum size in bytes: a waiting decode_thread() resumes reading as
+ * soon as one of the packet queues is below both.
+ */
+#define PACKET_QUEUE_LOW_DURATION 0.5
+#define PACKET_QUEUE_LOW_SIZE_PERCENT 50
+
+/**
+ * Number of av_read_frame() failures in a row, without any read error, after
+ * which decode_thread() ends the input: the packet queues are low, so it
+ * retries at once instead of waiting for them to drain.
+ */
+#define READ_RETRY_MAX 100
+
 /**
  * No AV sync correction threshold.
  */
@@ -72,19 +121,88 @@
 #define DEFAULT_AV_SYNC_TYPE AV_SYNC_AUDIO_MASTER
 
 /**
- * Queue structure used to store AVPackets.
+ * Number of AVPacket slots in a PacketQueue ring. Must be a power of 2.
+ */
+#define PACKET_QUEUE_CAPACITY 1024
+
+/**
+ * Single-producer/single-consumer ring used to store AVPackets.
+ *
+ * decode_thread() is the only producer and the decoding thread of the stream the
+ * only consumer: windex is only written by the producer and rindex only by the
+ * consumer, so no lock is taken while the ring is neither empty nor full. The
+ * indices are free running and are masked with (PACKET_QUEUE_CAPACITY - 1) to
+ * address a slot. The AVPacket slots are allocated once in packet_queue_init()
+ * and reused for the whole playback.
+ *
+ * size is the total size of the queued AVPackets in bytes and duration their
+ * total duration in milliseconds (using time_base); both are compared against
+ * max_size and the PACKET_QUEUE_* watermarks to apply backpressure on
+ * decode_thread().
+ *
+ * serial is increased by each packet_queue_flush(): packet_queue_get() returns
+ * the serial the extracted AVPacket belongs to, so the consumer knows when to
+ * flush its decoder state without any special AVPacket in the ring.
  */
 typedef struct PacketQueue
 {
-    AVPacketList *  first_pkt;
-    AVPacketList *  last_pkt;
-    int             nb_packets;
-    int             size;
+    AVPacket *      pkts[PACKET_QUEUE_CAPACITY];
+    SDL_atomic_t    windex;
+    SDL_atomic_t    rindex;
+    SDL_atomic_t    flush_index;
+    SDL_atomic_t    serial;
+    SDL_atomic_t    nb_packets;
+    SDL_atomic_t    size;
+    SDL_atomic_t    duration;
+    SDL_atomic_t    waiting;
+    int             max_size;
+    AVRational      time_base;
     SDL_mutex *     mutex;
     SDL_cond *      cond;
 } PacketQueue;
 
 
+/**
+ * Struct used to hold data fields used for audio resampling.
+ */
+typedef struct AudioResamplingState
+{
+    SwrContext * swr_ctx;
+    int64_t in_channel_layout;
+    enum AVSampleFormat in_sample_fmt;
+    int in_sample_rate;
+    uint64_t out_channel_layout;
+    enum AVSampleFormat out_sample_fmt;
+    int out_sample_rate;
+    int out_nb_channels;
+    int out_linesize;
+    int in_nb_samples;
+    int64_t out_nb_samples;
+    int64_t max_out_nb_samples;
+    uint8_t ** resampled_data;
+    int resampled_data_size;
+
+} AudioResamplingState;
+
+/**
+ * Lock-free single producer single consumer ring of decoded audio samples: the
+ * audio decoding thread writes, the SDL audio callback reads. Both indices are
+ * free running byte counters, the capacity is a power of 2.
+ *
+ * When the ring is full the audio decoding thread blocks on sem: it sets
+ * wait_room to the free bytes it waits for, and the callback which frees them
+ * clears it and posts sem. No lock is taken by the callback.
+ */
+typedef struct AudioRing
+{
+    uint8_t *       data;
+    int             capacity;
+    SDL_atomic_t    windex;
+    SDL_atomic_t    rindex;
+    SDL_atomic_t    wait_room;
+    SDL_sem *       sem;
+} AudioRing;
+
 /**
  * Struct used to hold the format context, the indices of the audio and video stream,
  * the corresponding AVStream objects, the audio and video codec information,
@@ -105,11 +223,19 @@ typedef struct VideoState
     AVStream *          audio_st;
     AVCodecContext *    audio_ctx;
     PacketQueue         audioq;
-    uint8_t             audio_buf[(MAX_AUDIO_FRAME_SIZE * 3) /2];
-    unsigned int        audio_buf_size;
-    unsigned int        audio_buf_index;
-    AVPacket            audio_pkt;
+    AudioRing           audio_ring;
+    SDL_AudioDeviceID   audio_dev;
+    int                 audio_buffer_samples;
+    int                 audio_hw_buf_size;
+    int                 audio_bytes_per_sec;
+    SDL_atomic_t        audio_callback_time;
+    SDL_SpinLock        audio_clock_lock;
+    double              audio_ring_clock;
+    int                 audio_ring_clock_windex;
+    AVPacket *          audio_pkt;
+    AVFrame *           audio_frame;
     double              audio_clock;
+    AudioResamplingState * audio_resampler;
     double              audio_diff_cum;
     double              audio_diff_avg_coef;
     double              audio_diff_threshold;
@@ -123,16 +249,60 @@ typedef struct VideoState
     int64_t external_clock_time;
 
     /**
-     * Seeking.
+     * Seeking. seek_pos and seek_rel are in AV_TIME_BASE units. In accurate
+     * seek mode the frames before seek_target_time are decoded but not played:
+     * the decoder sets audio_seek_pending when it sees a new PacketQueue serial
+     * and clears it when it reaches the target.
+     */
+    int             seek_req;
+    int64_t         seek_pos;
+    int64_t         seek_rel;
+    int             accurate_seek;
+    double          seek_target_time;
+    int             audio_pkt_serial;
+    int             audio_seek_pending;
+
+    /**
+     * Demuxer backpressure: decode_thread() waits on continue_read_cond while
+     * the packet queues are full, read_waiting is set while it does so.
+     */
+    SDL_mutex *     continue_read_mutex;
+    SDL_cond *      continue_read_cond;
+    SDL_atomic_t    read_waiting;
+
+    /**
+     * Low-power mode: the AudioRing is refilled in bursts once it holds less
+     * than audio_ring_low bytes.
+     */
+    int             low_power;
+    int             audio_ring_low;
+
+    /**
+     * Compressed audio passthrough: the packets are wrapped in IEC 61937 bursts
+     * by the spdif muxer, written to spdif_buf, instead of being decoded.
      */
-    int     seek_req;
-    int     seek_flags;
-    int64_t seek_pos;
+    int             passthrough;
+    const char *    passthrough_device;
+    AVFormatContext * spdif_ctx;
+    uint8_t *       spdif_buf;
+    int             spdif_size;
+    unsigned int    spdif_capacity;
+
+    /**
+     * Wakeups of the audio callback, of the audio decoding thread out of the
+     * full AudioRing wait and of decode_thread() out of its waits, since
+     * audio_start_time.
+     */
+    SDL_atomic_t    callback_wakeups;
+    SDL_atomic_t    ring_wakeups;
+    SDL_atomic_t    read_wakeups;
+    int64_t         audio_start_time;
 
     /**
      * Threads.
      */
     SDL_Thread *    decode_tid;
+    SDL_Thread *    audio_tid;
 
     /**
      * Input file name.
@@ -150,24 +320,6 @@ typedef struct VideoState
     long    maxFramesToDecode;
 } VideoState;
 
-/**
- * Struct used to hold data fields used for audio resampling.
- */
-typedef struct AudioResamplingState
-{
-    SwrContext * swr_ctx;
-    int64_t in_channel_layout;
-    uint64_t out_channel_layout;
-    int out_nb_channels;
-    int out_linesize;
-    int in_nb_samples;
-    int64_t out_nb_samples;
-    int64_t max_out_nb_samples;
-    uint8_t ** resampled_data;
-    int resampled_data_size;
-
-} AudioResamplingState;
-
 /**
  * Audio Video Sync Types.
  */
@@ -189,11 +341,6 @@ enum
  */
 VideoState * global_video_state;
 
-/**
- *
- */
-AVPacket flush_pkt;
-
 /**
  * Methods declaration.
  */
@@ -208,8 +355,7 @@ int stream_component_open(
 
 int synchronize_audio(
         VideoState * videoState,
-        short * samples,
-        int samples_size
+        int nb_samples
 );
 
 
@@ -239,24 +385,62 @@ int packet_queue_put(
 static int packet_queue_get(
         PacketQueue * queue,
         AVPacket * packet,
-        int blocking
+        int blocking,
+        int * serial
 );
 
 static void packet_queue_flush(PacketQueue * queue);
 
+static inline int packet_queue_distance(int windex, int rindex);
+
+static int packet_queue_is_full(PacketQueue * queue);
+
+static int packet_queue_is_low(PacketQueue * queue);
+
+static int packet_queues_full(VideoState * videoState);
+
+static int packet_queues_low(VideoState * videoState);
+
+static void decode_thread_wake(VideoState * videoState);
+
 void audio_callback(
         void * userdata,
         Uint8 * stream,
         int len
 );
 
+int audio_thread(void * arg);
+
+static void audio_ring_drain(VideoState * videoState);
+
 int audio_decode_frame(
         VideoState * videoState,
-        uint8_t * audio_buf,
-        int buf_size,
+        uint8_t ** audio_buf,
+        double * pts_ptr
+);
+
+static int audio_passthrough_init(
+        VideoState * videoState,
+        AVCodecParameters * codecpar,
+        int * device_rate
+);
+
+static int audio_passthrough_frame(
+        VideoState * videoState,
+        uint8_t ** audio_buf,
         double * pts_ptr
 );
 
+static int spdif_write_packet(
+        void * opaque,
+        uint8_t * buf,
+        int buf_size
+);
+
+static void audio_passthrough_free(VideoState * videoState);
+
+static void print_wakeups(VideoState * videoState);
+
 static int audio_resampling(
         VideoState * videoState,
         AVFrame * decoded_audio_frame,
@@ -264,9 +448,21 @@ static int audio_resampling(
         uint8_t * out_buf
 );
 
-AudioResamplingState * getAudioResampling(uint64_t channel_layout);
+static int audio_resampling_init(
+        AudioResamplingState * arState,
+        int64_t in_channel_layout,
+        enum AVSampleFormat in_sample_fmt,
+        int in_sample_rate
+);
+
+AudioResamplingState * getAudioResampling(
+        AVCodecContext * audio_ctx,
+        enum AVSampleFormat out_sample_fmt
+);
+
+void freeAudioResampling(AudioResamplingState ** arState);
 
-void stream_seek(VideoState * videoState, int64_t pos, int rel);
+void stream_seek(VideoState * videoState, int64_t pos, int64_t rel);
 
 /**
  * Entry point.
@@ -279,7 +475,7 @@ void stream_seek(VideoState * videoState, int64_t pos, int rel);
 int main(int argc, char * argv[])
 {
     // if the given number of command line arguments is wrong
-    if ( argc != 3 )
+    if ( argc < 3 )
     {
         // print help menu and exit
         printHelpMenu();
@@ -310,6 +506,82 @@ int main(int argc, char * argv[])
     char * pEnd;
     videoState->maxFramesToDecode = strtol(argv[2], &pEnd, 10);
 
+    // set default values for the optional arguments
+    videoState->audio_buffer_samples = SDL_AUDIO_BUFFER_SIZE;
+    int audio_buffer_set = 0;
+
+    // parse the optional arguments
+    for (int i = 3; i < argc; i++)
+    {
+        const char * value = NULL;
+
+        if (av_strstart(argv[i], "--audio-buffer=", &value))
+        {
+            audio_buffer_set = 1;
+
+            if (strcmp(value, "low") == 0)
+            {
+                videoState->audio_buffer_samples = AUDIO_BUFFER_LOW_LATENCY;
+            }
+            else if (strcmp(value, "high") == 0)
+            {
+                videoState->audio_buffer_samples = AUDIO_BUFFER_HIGH_LATENCY;
+            }
+            else if (strcmp(value, "auto") == 0)
+            {
+                videoState->audio_buffer_samples = AUDIO_BUFFER_AUTO;
+            }
+            else
+            {
+                videoState->audio_buffer_samples = (int)strtol(value, &pEnd, 10);
+
+                // SDL requires a power of 2 number of samples
+                if (*pEnd != '\0' || videoState->audio_buffer_samples < 16 || videoState->audio_buffer_samples > 65536 ||
+                    (videoState->audio_buffer_samples & (videoState->audio_buffer_samples - 1)))
+                {
+                    printf("Invalid audio buffer size: %s.\n", value);
+                    av_free(videoState);
+                    return -1;
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--accurate-seek") == 0)
+        {
+            videoState->accurate_seek = 1;
+        }
+        else if (strcmp(argv[i], "--low-power") == 0)
+        {
+            videoState->low_power = 1;
+        }
+        else if (strcmp(argv[i], "--passthrough") == 0)
+        {
+            videoState->passthrough = 1;
+        }
+        else if (av_strstart(argv[i], "--passthrough=", &value))
+        {
+            videoState->passthrough = 1;
+            videoState->passthrough_device = value;
+        }
+        else
+        {
+            // print help menu and exit
+            printHelpMenu();
+            av_free(videoState);
+            return -1;
+        }
+    }
+
+    // the low-power mode wakes the device up as rarely as possible, unless a
+    // buffer size was given
+    if (videoState->low_power && !audio_buffer_set)
+    {
+        videoState->audio_buffer_samples = AUDIO_BUFFER_LOW_POWER;
+    }
+
+    // initialize the lock and condition used to wake the decode thread up
+    videoState->continue_read_mutex = SDL_CreateMutex();
+    videoState->continue_read_cond = SDL_CreateCond();
+
     // launch our threads by pushing an SDL_event of type FF_REFRESH_EVENT
     schedule_refresh(videoState, 100);
 
@@ -329,9 +601,6 @@ int main(int argc, char * argv[])
         return -1;
     }
 
-    av_init_packet(&flush_pkt);
-    flush_pkt.data = "FLUSH";
-
     // infinite loop waiting for fired events
     SDL_Event event;
     for(;;)
@@ -379,7 +648,7 @@ int main(int argc, char * argv[])
                         {
                             pos = get_master_clock(global_video_state);
                             pos += incr;
-                            stream_seek(global_video_state, (int64_t)(pos * AV_TIME_BASE), incr);
+                            stream_seek(global_video_state, (int64_t)(pos * AV_TIME_BASE), (int64_t)(incr * AV_TIME_BASE));
                         }
                         break;
                     };
@@ -401,11 +670,17 @@ int main(int argc, char * argv[])
                 /**
                  * If the video has finished playing, then both the picture and audio
                  * queues are waiting for more data.  Make them stop waiting and
-                 * terminate normally.
+                 * terminate normally: the threads are joined once out of the
+                 * events loop, before anything they use is freed.
                  */
+                SDL_LockMutex(videoState->audioq.mutex);
                 SDL_CondSignal(videoState->audioq.cond);
-
-                SDL_Quit();
+                SDL_UnlockMutex(videoState->audioq.mutex);
+                decode_thread_wake(videoState);
+                if (videoState->audio_ring.sem)
+                {
+                    SDL_SemPost(videoState->audio_ring.sem);
+                }
             }
                 break;
 
@@ -424,9 +699,38 @@ int main(int argc, char * argv[])
         }
     }
 
+    // the decoding thread starts the audio decoding thread: join it first, so
+    // that audio_tid is not set anymore once it has returned
+    SDL_WaitThread(videoState->decode_tid, NULL);
+    if (videoState->audio_tid)
+    {
+        SDL_WaitThread(videoState->audio_tid, NULL);
+    }
+
+    // stop the audio callback, the last reader of the audio ring
+    if (videoState->audio_dev)
+    {
+        SDL_CloseAudioDevice(videoState->audio_dev);
+    }
+
+    print_wakeups(videoState);
+
     // clean up memory
+    freeAudioResampling(&videoState->audio_resampler);
+    audio_passthrough_free(videoState);
+    av_freep(&videoState->audio_ring.data);
+    if (videoState->audio_ring.sem)
+    {
+        SDL_DestroySemaphore(videoState->audio_ring.sem);
+    }
+    av_packet_free(&videoState->audio_pkt);
+    av_frame_free(&videoState->audio_frame);
+    SDL_DestroyCond(videoState->continue_read_cond);
+    SDL_DestroyMutex(videoState->continue_read_mutex);
     av_free(videoState);
 
+    SDL_Quit();
+
     return 0;
 }
 
@@ -436,7 +740,16 @@ int main(int argc, char * argv[])
 void printHelpMenu()
 {
     printf("Invalid arguments.\n\n");
-    printf("Usage: ./tutorial08 <filename> <max-frames-to-decode>\n\n");
+    printf("Usage: ./tutorial08 <filename> <max-frames-to-decode> [options]\n\n");
+    printf("Options:\n");
+    printf("    --audio-buffer=B audio device buffer: low (%d samples), high (%d samples),\n", AUDIO_BUFFER_LOW_LATENCY, AUDIO_BUFFER_HIGH_LATENCY);
+    printf("                    auto (from the sample rate) or N samples, a power of 2 (default %d).\n", SDL_AUDIO_BUFFER_SIZE);
+    printf("    --accurate-seek decode up to the exact seek target instead of the previous keyframe.\n");
+    printf("    --low-power     power efficient playback: %d samples device buffer (unless --audio-buffer\n", AUDIO_BUFFER_LOW_POWER);
+    printf("                    is given), %.0f s decoded ahead, refilled in bursts below %.0f s.\n", AUDIO_LOW_POWER_RING_DURATION, AUDIO_LOW_POWER_REFILL_DURATION);
+    printf("    --passthrough[=D] send AC-3, E-AC-3 and DTS undecoded, as IEC 61937 bursts, to the audio\n");
+    printf("                    device D (default device otherwise). The device must play 16 bits stereo\n");
+    printf("                    at the stream rate unconverted, e.g. an S/PDIF or HDMI output.\n\n");
 }
 
 /**
@@ -526,6 +839,9 @@ int decode_thread(void * arg)
         goto fail;
     }
 
+    // av_read_frame() failures in a row, without any read error
+    int read_retries = 0;
+
     // main decode loop: read in a packet and put it on the right queue
     for (;;)
     {
@@ -536,46 +852,54 @@ int decode_thread(void * arg)
         }
 
         // seek stuff goes here
-        if(videoState->seek_req)
+        if (videoState->seek_req)
         {
-            int audio_stream_index = -1;
+            AVStream * audio_st = pFormatCtx->streams[videoState->audioStream];
             int64_t seek_target = videoState->seek_pos;
+            int64_t seek_rel = videoState->seek_rel;
 
-            if (videoState->audioStream >= 0)
-            {
-                audio_stream_index = videoState->audioStream;
-            }
-
-            if( audio_stream_index >= 0)
-            {
-
-                seek_target = av_rescale_q(seek_target, AV_TIME_BASE_Q, pFormatCtx->streams[audio_stream_index]->time_base);
-            }
-
-            ret &= av_seek_frame(videoState->pFormatCtx, audio_stream_index, seek_target, videoState->seek_flags);
+            // do not let the demuxer land on the other side of the current position
+            int64_t ts = av_rescale_q(seek_target, AV_TIME_BASE_Q, audio_st->time_base);
+            int64_t min_ts = seek_rel > 0 ? av_rescale_q(seek_target - seek_rel, AV_TIME_BASE_Q, audio_st->time_base) + 2 : INT64_MIN;
+            int64_t max_ts = seek_rel < 0 ? av_rescale_q(seek_target - seek_rel, AV_TIME_BASE_Q, audio_st->time_base) - 2 : INT64_MAX;
 
+            ret = avformat_seek_file(pFormatCtx, videoState->audioStream, min_ts, ts, max_ts, 0);
             if (ret < 0)
             {
                 fprintf(stderr, "%s: error while seeking\n", videoState->filename);
             }
             else
             {
+                // set the target before the flush, the decoder reads it once it
+                // sees the new serial
+                videoState->seek_target_time = seek_target / (double)AV_TIME_BASE;
 
-                if (videoState->audioStream >= 0)
-                {
-                    packet_queue_flush(&videoState->audioq);
-                    packet_queue_put(&videoState->audioq, &flush_pkt);
-                }
+                packet_queue_flush(&videoState->audioq);
             }
 
             videoState->seek_req = 0;
         }
 
-        // check audio and video packets queues size
-        if (videoState->audioq.size > MAX_AUDIOQ_SIZE)
+        // check the packet queues high watermarks
+        if (packet_queues_full(videoState))
         {
-            // wait for audio and video queues to decrease size
-            SDL_Delay(10);
+            // lock mutex
+            SDL_LockMutex(videoState->continue_read_mutex);
+
+            // tell the consumers to signal us, then check again before waiting
+            SDL_AtomicSet(&videoState->read_waiting, 1);
+
+            // wait for one of the packet queues to go below its low watermark
+            while (!videoState->quit && !videoState->seek_req && !packet_queues_low(videoState))
+            {
+                SDL_CondWait(videoState->continue_read_cond, videoState->continue_read_mutex);
+                SDL_AtomicIncRef(&videoState->read_wakeups);
+            }
+
+            SDL_AtomicSet(&videoState->read_waiting, 0);
+
+            // unlock mutex
+            SDL_UnlockMutex(videoState->continue_read_mutex);
 
             continue;
         }
@@ -584,26 +908,36 @@ int decode_thread(void * arg)
         ret = av_read_frame(videoState->pFormatCtx, packet);
         if (ret < 0)
         {
-            if (ret == AVERROR_EOF)
-            {
-                // media EOF reached, quit
-                videoState->quit = 1;
-                break;
-            }
-            else if (videoState->pFormatCtx->pb->error == 0)
+            if (ret != AVERROR_EOF && videoState->pFormatCtx->pb->error == 0 && ++read_retries < READ_RETRY_MAX)
             {
-                // no read error; wait for user input
-                SDL_Delay(10);
+                // no read error: wait for the packet queues to drain, or for a
+                // seek or quit, before reading again. Retry at once if they are
+                // low already: the consumers only signal on their way down
+                SDL_LockMutex(videoState->continue_read_mutex);
+                SDL_AtomicSet(&videoState->read_waiting, 1);
+
+                while (!videoState->quit && !videoState->seek_req && !packet_queues_low(videoState))
+                {
+                    SDL_CondWait(videoState->continue_read_cond, videoState->continue_read_mutex);
+                    SDL_AtomicIncRef(&videoState->read_wakeups);
+                }
+
+                SDL_AtomicSet(&videoState->read_waiting, 0);
+                SDL_UnlockMutex(videoState->continue_read_mutex);
 
                 continue;
             }
-            else
-            {
-                // exit for loop in case of error
-                break;
-            }
+
+            // media EOF reached, or a read error: queue an empty AVPacket, which
+            // flushes the audio decoder, audio_thread() quits once the queued
+            // packets and the AudioRing are played out
+            av_packet_unref(packet);
+            packet_queue_put(&videoState->audioq, packet);
+            break;
         }
 
+        read_retries = 0;
+
         if (packet->stream_index == videoState->audioStream)
         {
             packet_queue_put(&videoState->audioq, packet);
@@ -616,10 +950,12 @@ int decode_thread(void * arg)
     }
 
     // wait for the rest of the program to end
+    SDL_LockMutex(videoState->continue_read_mutex);
     while (!videoState->quit)
     {
-        SDL_Delay(100);
+        SDL_CondWait(videoState->continue_read_cond, videoState->continue_read_mutex);
     }
+    SDL_UnlockMutex(videoState->continue_read_mutex);
 
     // close the opened input AVFormatContext
     avformat_close_input(&pFormatCtx);
@@ -689,27 +1025,52 @@ int stream_component_open(VideoState * videoState, int stream_index)
         SDL_AudioSpec wanted_specs;
         SDL_AudioSpec specs;
 
-    
+        // passthrough: 16 bits stereo IEC 61937 at the bursts rate, or decode
+        // if the codec cannot be passed through
+        int device_rate = codecCtx->sample_rate;
+        if (videoState->passthrough && audio_passthrough_init(videoState, pFormatCtx->streams[stream_index]->codecpar, &device_rate) < 0)
+        {
+            printf("Passthrough unavailable for %s, decoding.\n", avcodec_get_name(codecCtx->codec_id));
+            audio_passthrough_free(videoState);
+            videoState->passthrough = 0;
+        }
 
         // Set audio settings from codec info
-        wanted_specs.freq = codecCtx->sample_rate;
+        wanted_specs.freq = device_rate;
         wanted_specs.format = AUDIO_S16SYS;
-        wanted_specs.channels = codecCtx->channels;
+        wanted_specs.channels = videoState->passthrough ? 2 : codecCtx->channels;
         wanted_specs.silence = 0;
-        wanted_specs.samples = SDL_AUDIO_BUFFER_SIZE;
+        wanted_specs.samples = videoState->audio_buffer_samples;
         wanted_specs.callback = audio_callback;
         wanted_specs.userdata = videoState;
 
-        /* Deprecated, please refer to tutorial04-resampled.c for the new API */
-        // open audio device
-        ret = SDL_OpenAudio(&wanted_specs, &specs);
+        // derive the buffer size from the sample rate if requested
+        if (wanted_specs.samples == AUDIO_BUFFER_AUTO)
+        {
+            wanted_specs.samples = 2 << av_log2(codecCtx->sample_rate / AUDIO_MAX_CALLBACKS_PER_SEC);
+            if (wanted_specs.samples < AUDIO_BUFFER_LOW_LATENCY)
+            {
+                wanted_specs.samples = AUDIO_BUFFER_LOW_LATENCY;
+            }
+        }
+
+        // open the default audio device, the obtained buffer size may differ
+        videoState->audio_dev = SDL_OpenAudioDevice(videoState->passthrough ? videoState->passthrough_device : NULL, 0, &wanted_specs, &specs, 0);
 
         // check audio device was correctly opened
-        if (ret < 0)
+        if (videoState->audio_dev == 0)
         {
-            printf("SDL_OpenAudio: %s.\n", SDL_GetError());
+            printf("SDL_OpenAudioDevice: %s.\n", SDL_GetError());
             return -1;
         }
+
+        // keep the actual device buffer size, used to estimate its latency
+        videoState->audio_buffer_samples = specs.samples;
+        videoState->audio_hw_buf_size = specs.size;
+        videoState->audio_bytes_per_sec = specs.freq * 2 * specs.channels;
+
+        if (_DEBUG_)
+            printf("Audio device buffer: %d samples (%d bytes).\n", specs.samples, specs.size);
     }
 
     // initialize the AVCodecContext to use the given AVCodec
@@ -729,17 +1090,73 @@ int stream_component_open(VideoState * videoState, int stream_index)
             videoState->audioStream = stream_index;
             videoState->audio_st = pFormatCtx->streams[stream_index];
             videoState->audio_ctx = codecCtx;
-            videoState->audio_buf_size = 0;
-            videoState->audio_buf_index = 0;
 
-            // zero out the block of memory pointed by videoState->audio_pkt
-            memset(&videoState->audio_pkt, 0, sizeof(videoState->audio_pkt));
+            // allocate the AVPacket and AVFrame used by audio_decode_frame() for
+            // the whole playback
+            videoState->audio_pkt = av_packet_alloc();
+            videoState->audio_frame = av_frame_alloc();
+            if (!videoState->audio_pkt || !videoState->audio_frame)
+            {
+                printf("Could not allocate audio AVPacket and AVFrame.\n");
+                return -1;
+            }
 
             // init audio packet queue
             packet_queue_init(&videoState->audioq);
+            videoState->audioq.max_size = MAX_AUDIOQ_SIZE;
+            videoState->audioq.time_base = videoState->audio_st->time_base;
+
+            // init the averaging filter used by synchronize_audio()
+            videoState->audio_diff_avg_coef = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
+            videoState->audio_diff_avg_count = 0;
+            videoState->audio_diff_threshold = 2.0 * videoState->audio_buffer_samples / codecCtx->sample_rate;
+
+            // create the audio resampler once for the whole playback, the
+            // SwrContext is rebuilt only if the input audio format changes
+            if (!videoState->passthrough)
+            {
+                videoState->audio_resampler = getAudioResampling(codecCtx, AV_SAMPLE_FMT_S16);
+                if (!videoState->audio_resampler)
+                {
+                    printf("Could not allocate audio resampler.\n");
+                    return -1;
+                }
+            }
+
+            // allocate the decoded audio ring: a power of 2 bytes holding at
+            // least AUDIO_RING_DURATION seconds (several seconds in low-power
+            // mode) and a few device buffers
+            int bytes_per_sec = videoState->audio_bytes_per_sec;
+            double ring_duration = videoState->low_power ? AUDIO_LOW_POWER_RING_DURATION : AUDIO_RING_DURATION;
+            int ring_size = FFMAX((int)(ring_duration * bytes_per_sec), 4 * videoState->audio_hw_buf_size);
+            videoState->audio_ring.capacity = 1 << (av_log2(ring_size - 1) + 1);
+            videoState->audio_ring.data = av_mallocz(videoState->audio_ring.capacity);
+            videoState->audio_ring.sem = SDL_CreateSemaphore(0);
+            if (!videoState->audio_ring.data || !videoState->audio_ring.sem)
+            {
+                printf("Could not allocate audio ring.\n");
+                return -1;
+            }
+
+            // refill mark: never less than two device buffers, the callback
+            // must not underrun during the burst
+            if (videoState->low_power)
+            {
+                videoState->audio_ring_low = FFMAX((int)(AUDIO_LOW_POWER_REFILL_DURATION * bytes_per_sec), 2 * videoState->audio_hw_buf_size);
+                videoState->audio_ring_low = FFMIN(videoState->audio_ring_low, videoState->audio_ring.capacity / 2);
+            }
+
+            // start the audio decoding thread, it fills the audio ring
+            videoState->audio_tid = SDL_CreateThread(audio_thread, "Audio Decoding Thread", videoState);
+            if (!videoState->audio_tid)
+            {
+                printf("Could not start audio decoding SDL_Thread: %s.\n", SDL_GetError());
+                return -1;
+            }
 
-            // start playing audio on the first audio device
-            SDL_PauseAudio(0);
+            // start playing audio on the opened audio device
+            videoState->audio_start_time = av_gettime_relative();
+            SDL_PauseAudioDevice(videoState->audio_dev, 0);
         }
             break;
         default:
@@ -765,29 +1182,33 @@ int stream_component_open(VideoState * videoState, int stream_index)
  * When we are ready to find the average difference, we simply calculate
  * avg_diff = diff_sum * (1-c).
  *
- * @param   videoState      the global VideoState reference.
- * @param   samples         global VideoState reference audio buffer.
- * @param   samples_size    last decoded audio AVFrame size after resampling.
+ * The correction is not applied to the output buffer anymore: the returned number
+ * of samples is handed to swr_set_compensation() by audio_resampling(), so the
+ * persistent SwrContext stretches or squeezes the audio smoothly instead of
+ * duplicating or truncating samples.
+ *
+ * @param   videoState  the global VideoState reference.
+ * @param   nb_samples  number of samples (per channel) of the last decoded
+ *                      audio AVFrame, before resampling.
  *
- * @return
+ * @return              the wanted number of samples (per channel) for the last
+ *                      decoded audio AVFrame.
  */
-int synchronize_audio(VideoState * videoState, short * samples, int samples_size)
+int synchronize_audio(VideoState * videoState, int nb_samples)
 {
-    int n;
+    int wanted_nb_samples = nb_samples;
     double ref_clock;
 
-    n = 2 * videoState->audio_ctx->channels;
-
-    // check if
+    // audio is only corrected when it is not used as the master clock itself
     if (videoState->av_sync_type != AV_SYNC_AUDIO_MASTER)
     {
         double diff, avg_diff;
-        int wanted_size, min_size, max_size /*, nb_samples */;
+        int min_nb_samples, max_nb_samples;
 
         ref_clock = get_master_clock(videoState);
         diff = get_audio_clock(videoState) - ref_clock;
 
-        if (diff < AV_NOSYNC_THRESHOLD)
+        if (fabs(diff) < AV_NOSYNC_THRESHOLD)
         {
             // accumulate the diffs
             videoState->audio_diff_cum = diff + videoState->audio_diff_avg_coef * videoState->audio_diff_cum;
@@ -803,58 +1224,22 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
                 /**
                  * So we're doing pretty well; we know approximately how off the audio
                  * is from the video or whatever we're using for a clock. So let's now
-                 * calculate how many samples we need to add or lop off by putting this
-                 * code where the "Shrinking/expanding buffer code" section is:
+                 * calculate how many samples we need to add or lop off, without going
+                 * beyond SAMPLE_CORRECTION_PERCENT_MAX percent of the original frame.
                  */
                 if (fabs(avg_diff) >= videoState->audio_diff_threshold)
                 {
-                    wanted_size = samples_size + ((int)(diff * videoState->audio_ctx->sample_rate) * n);
-                    min_size = samples_size * ((100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100);
-                    max_size = samples_size * ((100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100);
-
-                    if(wanted_size < min_size)
-                    {
-                        wanted_size = min_size;
-                    }
-                    else if (wanted_size > max_size)
-                    {
-                        wanted_size = max_size;
-                    }
+                    wanted_nb_samples = nb_samples + (int)(diff * videoState->audio_ctx->sample_rate);
+                    min_nb_samples = nb_samples * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100;
+                    max_nb_samples = nb_samples * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100;
 
-                    /**
-                     * Now we have to actually correct the audio. You may have noticed that our
-                     * synchronize_audio function returns a sample size, which will then tell us
-                     * how many bytes to send to the stream. So we just have to adjust the sample
-                     * size to the wanted_size. This works for making the sample size smaller.
-                     * But if we want to make it bigger, we can't just make the sample size larger
-                     * because there's no more data in the buffer! So we have to add it. But what
-                     * should we add? It would be foolish to try and extrapolate audio, so let's
-                     * just use the audio we already have by padding out the buffer with the
-                     * value of the last sample.
-                     */
-                    if(wanted_size < samples_size)
+                    if (wanted_nb_samples < min_nb_samples)
                     {
-                        /* remove samples */
-                        samples_size = wanted_size;
+                        wanted_nb_samples = min_nb_samples;
                     }
-                    else if(wanted_size > samples_size)
+                    else if (wanted_nb_samples > max_nb_samples)
                     {
-                        uint8_t *samples_end, *q;
-                        int nb;
-
-                        /* add samples by copying final sample*/
-                        nb = (samples_size - wanted_size);
-                        samples_end = (uint8_t *)samples + samples_size - n;
-                        q = samples_end + n;
-
-                        while(nb > 0)
-                        {
-                            memcpy(q, samples_end, n);
-                            q += n;
-                            nb -= n;
-                        }
-
-                        samples_size = wanted_size;
+                        wanted_nb_samples = max_nb_samples;
                     }
                 }
             }
@@ -867,12 +1252,14 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
         }
     }
 
-    return samples_size;
+    return wanted_nb_samples;
 }
 
 
 /**
- * Calculates and returns the current audio clock reference value.
+ * Calculates and returns the current audio clock reference value: the audio
+ * clock at the AudioRing write position, minus the samples still buffered in
+ * the ring and in the audio device.
  *
  * @param   videoState  the global VideoState reference.
  *
@@ -880,22 +1267,30 @@ int synchronize_audio(VideoState * videoState, short * samples, int samples_size
  */
 double get_audio_clock(VideoState * videoState)
 {
-    double pts = videoState->audio_clock;
-
-    int hw_buf_size = videoState->audio_buf_size - videoState->audio_buf_index;
+    // audio clock at the AudioRing write position
+    SDL_AtomicLock(&videoState->audio_clock_lock);
+    double pts = videoState->audio_ring_clock;
+    int windex = videoState->audio_ring_clock_windex;
+    SDL_AtomicUnlock(&videoState->audio_clock_lock);
 
     int bytes_per_sec = 0;
 
-    int n = 2 * videoState->audio_ctx->channels;
-
     if (videoState->audio_st)
     {
-        bytes_per_sec = videoState->audio_ctx->sample_rate * n;
+        bytes_per_sec = videoState->audio_bytes_per_sec;
     }
 
     if (bytes_per_sec)
     {
-        pts -= (double) hw_buf_size / bytes_per_sec;
+        // samples still in the ring, not handed to the audio device yet
+        int ring_size = packet_queue_distance(windex, SDL_AtomicGet(&videoState->audio_ring.rindex));
+
+        // the device latency: the buffer just filled by the callback and the
+        // one being played, minus the time elapsed since that callback
+        double elapsed = (Uint32)(SDL_GetTicks() - (Uint32)SDL_AtomicGet(&videoState->audio_callback_time)) / 1000.0;
+        double hw_latency = 2.0 * videoState->audio_hw_buf_size / bytes_per_sec;
+
+        pts -= (double) ring_size / bytes_per_sec + hw_latency - FFMIN(elapsed, hw_latency / 2);
     }
 
     return pts;
@@ -989,7 +1384,7 @@ static Uint32 sdl_refresh_timer_cb(Uint32 interval, void * param)
 }
 
 /**
- * Initialize the given PacketQueue.
+ * Initialize the given PacketQueue and pre-allocate its AVPacket slots.
  *
  * @param q the PacketQueue to be initialized.
  */
@@ -1002,6 +1397,17 @@ void packet_queue_init(PacketQueue * q)
             sizeof(PacketQueue)
     );
 
+    // allocate the AVPacket pool once, the slots are reused for the whole playback
+    for (int i = 0; i < PACKET_QUEUE_CAPACITY; i++)
+    {
+        q->pkts[i] = av_packet_alloc();
+        if (!q->pkts[i])
+        {
+            printf("Could not allocate AVPacket.\n");
+            return;
+        }
+    }
+
     // Returns the initialized and unlocked mutex or NULL on failure
     q->mutex = SDL_CreateMutex();
     if (!q->mutex)
@@ -1022,60 +1428,123 @@ void packet_queue_init(PacketQueue * q)
 }
 
 /**
- * Put the given AVPacket in the given PacketQueue.
+ * Returns the number of ring slots between the two given free running indices.
+ * Also used for the AudioRing byte indices.
  *
- * @param  queue    the queue to be used for the insert
- * @param  packet   the AVPacket to be inserted in the queue
+ * @param   windex  the PacketQueue write index.
+ * @param   rindex  the PacketQueue read index.
  *
- * @return          0 if the AVPacket is correctly inserted in the given PacketQueue.
+ * @return          windex - rindex, correct across index wrap-around.
  */
-int packet_queue_put(PacketQueue * queue, AVPacket * packet)
+static inline int packet_queue_distance(int windex, int rindex)
 {
-    // alloc the new AVPacketList to be inserted in the audio PacketQueue
-    AVPacketList * avPacketList;
-    avPacketList = av_malloc(sizeof(AVPacketList));
+    return (int)((unsigned)windex - (unsigned)rindex);
+}
 
-    // check the AVPacketList was allocated
-    if (!avPacketList)
+/**
+ * Returns the duration of the given AVPacket in milliseconds, using the given
+ * PacketQueue time base.
+ *
+ * @param   queue   the PacketQueue the AVPacket belongs to.
+ * @param   packet  the AVPacket.
+ *
+ * @return          the AVPacket duration in milliseconds, 0 if unknown.
+ */
+static inline int packet_queue_packet_duration(PacketQueue * queue, AVPacket * packet)
+{
+    if (packet->duration <= 0 || queue->time_base.den == 0)
     {
-        return -1;
+        return 0;
     }
 
-    // add reference to the given AVPacket
-    avPacketList->pkt = * packet;
-
-    // the new AVPacketList will be inserted at the end of the queue
-    avPacketList->next = NULL;
-
-    // lock mutex
-    SDL_LockMutex(queue->mutex);
+    return (int)av_rescale_q(packet->duration, queue->time_base, (AVRational){1, 1000});
+}
 
-    // check the queue is empty
-    if (!queue->last_pkt)
-    {
-        // if it is, insert as first
-        queue->first_pkt = avPacketList;
-    }
-    else
+/**
+ * Wakes up the other side of the given PacketQueue, only if it is blocked
+ * waiting for the ring not to be empty (consumer) or full (producer).
+ *
+ * @param   queue   the PacketQueue to be signaled.
+ */
+static void packet_queue_wake(PacketQueue * queue)
+{
+    if (SDL_AtomicGet(&queue->waiting))
+    {
+        SDL_LockMutex(queue->mutex);
+        SDL_CondSignal(queue->cond);
+        SDL_UnlockMutex(queue->mutex);
+    }
+}
+
+/**
+ * Put the given AVPacket in the given PacketQueue. The AVPacket reference is
+ * moved into a pre-allocated slot of the ring, the caller's AVPacket is reset.
+ * Blocks only if the ring is full.
+ *
+ * @param  queue    the queue to be used for the insert
+ * @param  packet   the AVPacket to be inserted in the queue
+ *
+ * @return          0 if the AVPacket is correctly inserted in the given PacketQueue,
+ *                  < 0 if the global quit flag is set or its data could not be
+ *                  referenced, the AVPacket is then unreferenced.
+ */
+int packet_queue_put(PacketQueue * queue, AVPacket * packet)
+{
+    // the queued AVPacket must own its data: the caller reuses its own one
+    int ret = av_packet_make_refcounted(packet);
+    if (ret < 0)
+    {
+        printf("Could not reference the AVPacket data.\n");
+        av_packet_unref(packet);
+        return ret;
+    }
+
+    int windex = SDL_AtomicGet(&queue->windex);
+
+    // check the ring is full
+    if (packet_queue_distance(windex, SDL_AtomicGet(&queue->rindex)) >= PACKET_QUEUE_CAPACITY)
     {
-        // if not, insert as last
-        queue->last_pkt->next = avPacketList;
+        // lock mutex
+        SDL_LockMutex(queue->mutex);
+
+        // tell the consumer to signal us, then check again before waiting
+        SDL_AtomicSet(&queue->waiting, 1);
+
+        while (packet_queue_distance(windex, SDL_AtomicGet(&queue->rindex)) >= PACKET_QUEUE_CAPACITY &&
+               !global_video_state->quit)
+        {
+            // unlock mutex and wait for cond signal, then lock mutex again
+            SDL_CondWait(queue->cond, queue->mutex);
+        }
+
+        SDL_AtomicSet(&queue->waiting, 0);
+
+        // unlock mutex
+        SDL_UnlockMutex(queue->mutex);
+
+        // check quit flag
+        if (global_video_state->quit)
+        {
+            return -1;
+        }
     }
 
-    // point the last AVPacketList in the queue to the newly created AVPacketList
-    queue->last_pkt = avPacketList;
+    // the slot pointed by the write index is owned by the producer until published
+    AVPacket * slot = queue->pkts[windex & (PACKET_QUEUE_CAPACITY - 1)];
 
-    // increase by 1 the number of AVPackets in the queue
-    queue->nb_packets++;
+    // move the reference counted data into the slot, no copy involved
+    av_packet_move_ref(slot, packet);
 
-    // increase queue size by adding the size of the newly inserted AVPacket
-    queue->size += avPacketList->pkt.size;
+    // increase the number of AVPackets, the size and the duration of the queue
+    SDL_AtomicAdd(&queue->nb_packets, 1);
+    SDL_AtomicAdd(&queue->size, slot->size);
+    SDL_AtomicAdd(&queue->duration, packet_queue_packet_duration(queue, slot));
 
-    // notify packet_queue_get which is waiting that a new packet is available
-    SDL_CondSignal(queue->cond);
+    // publish the packet to the consumer
+    SDL_AtomicSet(&queue->windex, (int)((unsigned)windex + 1));
 
-    // unlock mutex
-    SDL_UnlockMutex(queue->mutex);
+    // notify packet_queue_get if it is waiting for a new packet
+    packet_queue_wake(queue);
 
     return 0;
 }
@@ -1087,218 +1556,398 @@ int packet_queue_put(PacketQueue * queue, AVPacket * packet)
  * @param   packet      the first AVPacket extracted from the queue.
  * @param   blocking    0 to avoid waiting for an AVPacket to be inserted in the given
  *                      queue, != 0 otherwise.
+ * @param   serial      if not NULL, set to the serial of the queue the extracted
+ *                      AVPacket was put with.
  *
  * @return              < 0 if returning because the quit flag is set, 0 if the queue
  *                      is empty, 1 if it is not empty and a packet was extracted.
  */
-static int packet_queue_get(PacketQueue * queue, AVPacket * packet, int blocking)
+static int packet_queue_get(PacketQueue * queue, AVPacket * packet, int blocking, int * serial)
 {
-    int ret;
-
-    AVPacketList * avPacketList;
-
-    // lock mutex
-    SDL_LockMutex(queue->mutex);
-
     for (;;)
     {
         // check quit flag
         if (global_video_state->quit)
         {
-            ret = -1;
-            break;
+            return -1;
         }
 
-        // point to the first AVPacketList in the queue
-        avPacketList = queue->first_pkt;
+        int rindex = SDL_AtomicGet(&queue->rindex);
+
+        // read the serial before the flush index: packet_queue_flush() updates
+        // them the other way round, so no AVPacket put before the flush can be
+        // returned with the new serial
+        int queue_serial = SDL_AtomicGet(&queue->serial);
 
-        // if the first packet is not NULL, the queue is not empty
-        if (avPacketList)
+        // discard the AVPackets left behind by packet_queue_flush()
+        if (packet_queue_distance(SDL_AtomicGet(&queue->flush_index), rindex) > 0)
         {
-            // place the second packet in the queue at first position
-            queue->first_pkt = avPacketList->next;
+            AVPacket * slot = queue->pkts[rindex & (PACKET_QUEUE_CAPACITY - 1)];
 
-            // check if queue is empty after removal
-            if (!queue->first_pkt)
-            {
-                // first_pkt = last_pkt = NULL = empty queue
-                queue->last_pkt = NULL;
-            }
+            SDL_AtomicAdd(&queue->nb_packets, -1);
+            SDL_AtomicAdd(&queue->size, -slot->size);
+            SDL_AtomicAdd(&queue->duration, -packet_queue_packet_duration(queue, slot));
+
+            av_packet_unref(slot);
 
-            // decrease the number of packets in the queue
-            queue->nb_packets--;
+            SDL_AtomicSet(&queue->rindex, (int)((unsigned)rindex + 1));
+            packet_queue_wake(queue);
 
-            // decrease the size of the packets in the queue
-            queue->size -= avPacketList->pkt.size;
+            continue;
+        }
+
+        // if the write index is ahead of the read index, the queue is not empty
+        if (SDL_AtomicGet(&queue->windex) != rindex)
+        {
+            // the slot pointed by the read index is owned by the consumer until released
+            AVPacket * slot = queue->pkts[rindex & (PACKET_QUEUE_CAPACITY - 1)];
+
+            // decrease the number of packets, the size and the duration of the queue
+            SDL_AtomicAdd(&queue->nb_packets, -1);
+            SDL_AtomicAdd(&queue->size, -slot->size);
+            SDL_AtomicAdd(&queue->duration, -packet_queue_packet_duration(queue, slot));
 
             // point packet to the extracted packet, this will return to the calling function
-            *packet = avPacketList->pkt;
+            av_packet_move_ref(packet, slot);
 
-            // free memory
-            av_free(avPacketList);
+            if (serial)
+            {
+                *serial = queue_serial;
+            }
 
-            ret = 1;
-            break;
+            // release the slot to the producer
+            SDL_AtomicSet(&queue->rindex, (int)((unsigned)rindex + 1));
+
+            // notify packet_queue_put if it is waiting for a free slot
+            packet_queue_wake(queue);
+
+            // raise the space available signal if decode_thread() is waiting for it
+            if (SDL_AtomicGet(&global_video_state->read_waiting) && packet_queue_is_low(queue))
+            {
+                decode_thread_wake(global_video_state);
+            }
+
+            return 1;
         }
         else if (!blocking)
         {
-            ret = 0;
-            break;
+            return 0;
         }
-        else
+
+        // lock mutex
+        SDL_LockMutex(queue->mutex);
+
+        // tell the producer to signal us, then check again before waiting
+        SDL_AtomicSet(&queue->waiting, 1);
+
+        while (SDL_AtomicGet(&queue->windex) == rindex && !global_video_state->quit)
         {
             // unlock mutex and wait for cond signal, then lock mutex again
             SDL_CondWait(queue->cond, queue->mutex);
         }
-    }
 
-    // unlock mutex
-    SDL_UnlockMutex(queue->mutex);
+        SDL_AtomicSet(&queue->waiting, 0);
 
-    return ret;
+        // unlock mutex
+        SDL_UnlockMutex(queue->mutex);
+    }
 }
 
 /**
+ * Discards all the AVPackets currently in the given PacketQueue.
+ *
+ * Must only be called by the producer. The consumer owns the AVPackets it has
+ * not read yet, so the flush only records the current write index: the discarded
+ * AVPackets are released by packet_queue_get() before returning the next one, and
+ * the serial of the queue is increased to tell the consumer to flush its decoder.
  *
- * @param queue
+ * @param queue the PacketQueue to be flushed.
  */
 static void packet_queue_flush(PacketQueue * queue)
 {
-    AVPacketList *pkt, *pkt1;
+    SDL_AtomicSet(&queue->flush_index, SDL_AtomicGet(&queue->windex));
+    SDL_AtomicIncRef(&queue->serial);
 
-    SDL_LockMutex(queue->mutex);
+    // let the consumer release the discarded AVPackets
+    packet_queue_wake(queue);
+}
 
-    for (pkt = queue->first_pkt; pkt != NULL; pkt = pkt1)
-    {
-        pkt1 = pkt->next;
-        // av_free_packet(&pkt->pkt);
-        av_freep(&pkt);
-    }
+/**
+ * Checks the given PacketQueue is above its high watermark: more than max_size
+ * bytes or more than PACKET_QUEUE_HIGH_DURATION seconds of media.
+ *
+ * @param   queue   the PacketQueue to be checked.
+ *
+ * @return          != 0 if the PacketQueue is full, 0 otherwise.
+ */
+static int packet_queue_is_full(PacketQueue * queue)
+{
+    return SDL_AtomicGet(&queue->size) > queue->max_size ||
+           SDL_AtomicGet(&queue->duration) > (int)(PACKET_QUEUE_HIGH_DURATION * 1000);
+}
 
-    queue->last_pkt = NULL;
-    queue->first_pkt = NULL;
-    queue->nb_packets = 0;
-    queue->size = 0;
+/**
+ * Checks the given PacketQueue is below its low watermark: less than
+ * PACKET_QUEUE_LOW_SIZE_PERCENT of max_size bytes and less than
+ * PACKET_QUEUE_LOW_DURATION seconds of media. Using the duration as well keeps a
+ * low bitrate stream, which is never big in bytes, from asking for more data
+ * while it already holds plenty of media.
+ *
+ * @param   queue   the PacketQueue to be checked.
+ *
+ * @return          != 0 if the PacketQueue is low, 0 otherwise.
+ */
+static int packet_queue_is_low(PacketQueue * queue)
+{
+    return SDL_AtomicGet(&queue->size) < queue->max_size / 100 * PACKET_QUEUE_LOW_SIZE_PERCENT &&
+           SDL_AtomicGet(&queue->duration) < (int)(PACKET_QUEUE_LOW_DURATION * 1000);
+}
 
-    SDL_UnlockMutex(queue->mutex);
+/**
+ * Checks whether decode_thread() should stop reading: the audio packet queue is
+ * above its high watermark.
+ *
+ * @param   videoState  the global VideoState reference.
+ *
+ * @return              != 0 if decode_thread() should wait, 0 otherwise.
+ */
+static int packet_queues_full(VideoState * videoState)
+{
+    return videoState->audio_st && packet_queue_is_full(&videoState->audioq);
 }
 
 /**
- * Pull in data from audio_decode_frame(), store the result in an intermediary
- * buffer, attempt to write as many bytes as the amount defined by len to
- * stream, and get more data if we don't have enough yet, or save it for later
- * if we have some left over.
+ * Checks whether a waiting decode_thread() should resume reading: the audio
+ * packet queue is below its low watermark.
  *
- * @param   userdata    the pointer we gave to SDL.
- * @param   stream      the buffer we will be writing audio data to.
- * @param   len         the size of that buffer.
+ * @param   videoState  the global VideoState reference.
+ *
+ * @return              != 0 if decode_thread() should resume, 0 otherwise.
  */
-void audio_callback(void * userdata, Uint8 * stream, int len)
+static int packet_queues_low(VideoState * videoState)
+{
+    return videoState->audio_st && packet_queue_is_low(&videoState->audioq);
+}
+
+/**
+ * Wakes decode_thread() up if it is waiting for space in the packet queues, for
+ * user input, or for the rest of the program to end.
+ *
+ * @param   videoState  the global VideoState reference.
+ */
+static void decode_thread_wake(VideoState * videoState)
+{
+    SDL_LockMutex(videoState->continue_read_mutex);
+    SDL_CondSignal(videoState->continue_read_cond);
+    SDL_UnlockMutex(videoState->continue_read_mutex);
+}
+
+/**
+ * This function is used as callback for the SDL_Thread.
+ *
+ * The audio decoding thread pulls in data from audio_decode_frame(), or from
+ * audio_passthrough_frame(), and writes it to the AudioRing read by
+ * audio_callback(), so that the callback never decodes inline. When the ring
+ * is full it blocks until the callback frees enough room: the next frame, or
+ * in low-power mode everything above the refill mark, so that the ring is
+ * refilled in one burst. After each write, the audio clock at the ring write
+ * position is published for get_audio_clock().
+ *
+ * @param   arg the data pointer passed to the SDL_Thread callback function.
+ *
+ * @return      0.
+ */
+int audio_thread(void * arg)
 {
     // retrieve the VideoState
-    VideoState * videoState = (VideoState *)userdata;
+    VideoState * videoState = (VideoState *)arg;
+    AudioRing * ring = &videoState->audio_ring;
 
     double pts;
 
-    // while the length of the audio data buffer is > 0
-    while (len > 0)
+    while (!videoState->quit)
     {
-        // check global quit flag
-        if (global_video_state->quit)
+        uint8_t * audio_buf = NULL;
+
+        // decode and resample, or wrap, the next audio frame
+        int audio_size = videoState->passthrough ?
+                         audio_passthrough_frame(videoState, &audio_buf, &pts) :
+                         audio_decode_frame(videoState, &audio_buf, &pts);
+        if (audio_size < 0)
         {
-            return;
+            if (!videoState->quit)
+            {
+                printf("audio_decode_frame() failed.\n");
+            }
+            continue;
+        }
+        else if (audio_size == 0)
+        {
+            // end of the input: play the AudioRing out, then quit
+            audio_ring_drain(videoState);
+            break;
         }
 
-        // check how much audio is left to writes
-        if (videoState->audio_buf_index >= videoState->audio_buf_size)
+        // should never happen: the ring holds several decoded frames
+        if (audio_size > ring->capacity)
         {
-            // we have already sent all avaialble data; get more
-            int audio_size = audio_decode_frame(
-                    videoState,
-                    videoState->audio_buf,
-                    sizeof(videoState->audio_buf),
-                    &pts
-            );
+            audio_size = ring->capacity;
+        }
 
-            // if error
-            if (audio_size < 0)
-            {
-                // output silence
-                videoState->audio_buf_size = 1024;
+        // wait for enough room in the ring
+        int windex = SDL_AtomicGet(&ring->windex);
+        int wanted_room = videoState->low_power ? FFMAX(audio_size, ring->capacity - videoState->audio_ring_low) : audio_size;
 
-                // clear memory
-                memset(videoState->audio_buf, 0, videoState->audio_buf_size);
+        while (!videoState->quit && ring->capacity - packet_queue_distance(windex, SDL_AtomicGet(&ring->rindex)) < audio_size)
+        {
+            // tell the callback to post the semaphore, then check again before
+            // waiting: if the callback already took wait_room, its post is due
+            SDL_AtomicSet(&ring->wait_room, wanted_room);
 
-                printf("audio_decode_frame() failed.\n");
-            }
-            else
+            if (ring->capacity - packet_queue_distance(windex, SDL_AtomicGet(&ring->rindex)) >= wanted_room &&
+                SDL_AtomicCAS(&ring->wait_room, wanted_room, 0))
             {
-                audio_size = synchronize_audio(videoState, (int16_t *)videoState->audio_buf, audio_size);
-
-                // cast to usigned just to get rid of annoying warning messages
-                videoState->audio_buf_size = (unsigned)audio_size;
+                break;
             }
 
-            videoState->audio_buf_index = 0;
+            SDL_SemWait(ring->sem);
+            SDL_AtomicIncRef(&videoState->ring_wakeups);
         }
 
-        int len1 = videoState->audio_buf_size - videoState->audio_buf_index;
+        // copy the samples, in two parts if wrapping around the ring end
+        int offset = (int)((unsigned)windex & (unsigned)(ring->capacity - 1));
+        int len1 = FFMIN(audio_size, ring->capacity - offset);
+        memcpy(ring->data + offset, audio_buf, len1);
+        memcpy(ring->data, audio_buf + len1, audio_size - len1);
+
+        // publish the samples along with the audio clock at the write position
+        SDL_AtomicLock(&videoState->audio_clock_lock);
+        videoState->audio_ring_clock = videoState->audio_clock;
+        videoState->audio_ring_clock_windex = (int)((unsigned)windex + (unsigned)audio_size);
+        SDL_AtomicSet(&ring->windex, videoState->audio_ring_clock_windex);
+        SDL_AtomicUnlock(&videoState->audio_clock_lock);
+    }
+
+    return 0;
+}
 
-        if (len1 > len)
+/**
+ * Waits for audio_callback() to play the whole AudioRing out, then for the
+ * audio device to play its own buffers, and quits: called by audio_thread() at
+ * the end of the input.
+ *
+ * @param   videoState  the global VideoState reference.
+ */
+static void audio_ring_drain(VideoState * videoState)
+{
+    AudioRing * ring = &videoState->audio_ring;
+    int windex = SDL_AtomicGet(&ring->windex);
+
+    while (!videoState->quit && packet_queue_distance(windex, SDL_AtomicGet(&ring->rindex)) > 0)
+    {
+        // the whole ring free: the callback posts the semaphore once it is empty
+        SDL_AtomicSet(&ring->wait_room, ring->capacity);
+
+        if (packet_queue_distance(windex, SDL_AtomicGet(&ring->rindex)) == 0 &&
+            SDL_AtomicCAS(&ring->wait_room, ring->capacity, 0))
         {
-            len1 = len;
+            break;
         }
 
-        // copy data from audio buffer to the SDL stream
-        memcpy(stream, (uint8_t *)videoState->audio_buf + videoState->audio_buf_index, len1);
+        SDL_SemWait(ring->sem);
+        SDL_AtomicIncRef(&videoState->ring_wakeups);
+    }
+
+    if (videoState->quit)
+    {
+        return;
+    }
+
+    // the last samples are still in the audio device buffers, see get_audio_clock()
+    SDL_Delay(2 * 1000 * videoState->audio_hw_buf_size / videoState->audio_bytes_per_sec);
+
+    videoState->quit = 1;
+
+    // let main() join the threads and clean up
+    SDL_Event event;
+    event.type = FF_QUIT_EVENT;
+    event.user.data1 = videoState;
+    SDL_PushEvent(&event);
+}
+
+/**
+ * Copies as many bytes as the amount defined by len from the AudioRing to
+ * stream. Silence is output for whatever the audio decoding thread did not
+ * provide in time. Never blocks, nor decodes.
+ *
+ * @param   userdata    the pointer we gave to SDL.
+ * @param   stream      the buffer we will be writing audio data to.
+ * @param   len         the size of that buffer.
+ */
+void audio_callback(void * userdata, Uint8 * stream, int len)
+{
+    // retrieve the VideoState
+    VideoState * videoState = (VideoState *)userdata;
+    AudioRing * ring = &videoState->audio_ring;
 
-        len -= len1;
-        stream += len1;
+    // check global quit flag
+    if (global_video_state->quit)
+    {
+        memset(stream, 0, len);
+        return;
+    }
 
-        // update global VideoState audio buffer index
-        videoState->audio_buf_index += len1;
+    int rindex = SDL_AtomicGet(&ring->rindex);
+    int available = packet_queue_distance(SDL_AtomicGet(&ring->windex), rindex);
+    int size = FFMIN(available, len);
+
+    // copy the samples, in two parts if wrapping around the ring end
+    int offset = (int)((unsigned)rindex & (unsigned)(ring->capacity - 1));
+    int len1 = FFMIN(size, ring->capacity - offset);
+    memcpy(stream, ring->data + offset, len1);
+    memcpy(stream + len1, ring->data, size - len1);
+
+    // output silence in case of underrun
+    memset(stream + size, 0, len - size);
+
+    // give the room back to the audio decoding thread
+    SDL_AtomicSet(&ring->rindex, (int)((unsigned)rindex + (unsigned)size));
+    SDL_AtomicSet(&videoState->audio_callback_time, (int)SDL_GetTicks());
+    SDL_AtomicIncRef(&videoState->callback_wakeups);
+
+    // wake the audio decoding thread up once the room it waits for is free
+    int wait_room = SDL_AtomicGet(&ring->wait_room);
+    if (wait_room > 0 &&
+        ring->capacity - packet_queue_distance(SDL_AtomicGet(&ring->windex), (int)((unsigned)rindex + (unsigned)size)) >= wait_room &&
+        SDL_AtomicCAS(&ring->wait_room, wait_room, 0))
+    {
+        SDL_SemPost(ring->sem);
     }
 }
 
 /**
  * Get a packet from the queue if available. Decode the extracted packet. Once
- * we have the frame, resample it and simply copy it to our audio buffer, making
- * sure the data_size is smaller than our audio buffer.
+ * we have the frame, resample it and hand the resampled data out without any
+ * copy. The AVPacket and AVFrame used are owned by the VideoState, nothing is
+ * allocated per call.
  *
- * @param   aCodecCtx   the audio AVCodecContext used for decoding
- * @param   audio_buf   the audio buffer to write into
- * @param   buf_size    the size of the audio buffer, 1.5 larger than the one
- *                      provided by FFmpeg
+ * @param   videoState  the global VideoState reference.
+ * @param   audio_buf   set to the resampled audio data, owned by the
+ *                      audio resampler and valid until the next call.
  * @param   pts_ptr     a pointer to the pts of the decoded audio frame.
  *
- * @return              0 if everything goes well, -1 in case of error or quit
+ * @return              the size of the audio data, 0 once the decoder is drained
+ *                      at the end of the input, -1 in case of error or quit
  */
-int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_size, double * pts_ptr)
+int audio_decode_frame(VideoState * videoState, uint8_t ** audio_buf, double * pts_ptr)
 {
-    // allocate AVPacket to read from the audio PacketQueue (audioq)
-    AVPacket * avPacket = av_packet_alloc();
-    if (avPacket == NULL)
-    {
-        printf("Could not allocate AVPacket.\n");
-        return -1;
-    }
-
-    static uint8_t * audio_pkt_data = NULL;
-    static int audio_pkt_size = 0;
+    // the AVPacket and AVFrame are owned by the VideoState for the whole
+    // playback: they are only unreferenced between uses, never reallocated
+    AVPacket * avPacket = videoState->audio_pkt;
+    AVFrame * avFrame = videoState->audio_frame;
 
     double pts;
-    int n;
 
-    // allocate a new frame, used to decode audio packets
-    static AVFrame * avFrame = NULL;
-    avFrame = av_frame_alloc();
-    if (!avFrame)
-    {
-        printf("Could not allocate AVFrame.\n");
-        return -1;
-    }
-
-    int len1 = 0;
     int data_size = 0;
 
     // infinite loop: read AVPackets from the audio PacketQueue, decode them into
@@ -1311,71 +1960,43 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
             return -1;
         }
 
-        // check if we obtained an AVPacket from the audio PacketQueue
-        while (audio_pkt_size > 0)
-        {
-            int got_frame = 0;
-
-            // get decoded output data from decoder
-            int ret = avcodec_receive_frame(videoState->audio_ctx, avFrame);
-
-            // check and entire audio frame was decoded
-            if (ret == 0)
-            {
-                got_frame = 1;
-            }
+        // get decoded output data from decoder, if any is pending
+        int ret = avcodec_receive_frame(videoState->audio_ctx, avFrame);
 
-            // check the decoder needs more AVPackets to be sent
-            if (ret == AVERROR(EAGAIN))
-            {
-                ret = 0;
-            }
-
-            if (ret == 0)
+        // check an entire audio frame was decoded
+        if (ret == 0)
+        {
+            // keep audio_clock up-to-date
+            if (avFrame->pts != AV_NOPTS_VALUE)
             {
-                // give the decoder raw compressed data in an AVPacket
-                ret = avcodec_send_packet(videoState->audio_ctx, avPacket);
+                videoState->audio_clock = av_q2d(videoState->audio_st->time_base) * avFrame->pts;
             }
 
-            // check the decoder needs more AVPackets to be sent
-            if (ret == AVERROR(EAGAIN))
-            {
-                ret = 0;
-            }
-            else if (ret < 0)
-            {
-                printf("avcodec_receive_frame decoding error.\n");
-                return -1;
-            }
-            else
+            // accurate seek: drop the frames ending before the seek target
+            // without resampling them
+            if (videoState->audio_seek_pending)
             {
-                len1 = avPacket->size;
-            }
+                if (avFrame->pts != AV_NOPTS_VALUE &&
+                    videoState->audio_clock + (double)avFrame->nb_samples / avFrame->sample_rate <= videoState->seek_target_time)
+                {
+                    av_frame_unref(avFrame);
+                    continue;
+                }
 
-            if (len1 < 0)
-            {
-                // if error, skip frame
-                audio_pkt_size = 0;
-                break;
+                videoState->audio_seek_pending = 0;
             }
 
-            audio_pkt_data += len1;
-            audio_pkt_size -= len1;
-            data_size = 0;
+            // apply audio resampling to the decoded frame
+            data_size = audio_resampling(
+                    videoState,
+                    avFrame,
+                    AV_SAMPLE_FMT_S16,
+                    NULL
+            );
+            *audio_buf = videoState->audio_resampler->resampled_data ? videoState->audio_resampler->resampled_data[0] : NULL;
 
-            // if we decoded an entire audio frame
-            if (got_frame)
-            {
-                // apply audio resampling to the decoded frame
-                data_size = audio_resampling(
-                        videoState,
-                        avFrame,
-                        AV_SAMPLE_FMT_S16,
-                        audio_buf
-                );
-
-                assert(data_size <= buf_size);
-            }
+            // release the decoded frame buffers, the AVFrame itself is kept
+            av_frame_unref(avFrame);
 
             if (data_size <= 0)
             {
@@ -1386,21 +2007,25 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
             // keep audio_clock up-to-date
             pts = videoState->audio_clock;
             *pts_ptr = pts;
-            n = 2 * videoState->audio_ctx->channels;
-            videoState->audio_clock += (double)data_size / (double)(n * videoState->audio_ctx->sample_rate);
+            videoState->audio_clock += (double)data_size / videoState->audio_bytes_per_sec;
 
             // we have the data, return it and come back for more later
             return data_size;
         }
-
-        if (avPacket->data)
+        else if (ret == AVERROR_EOF)
         {
-            // wipe the packet
-            av_packet_unref(avPacket);
+            // the decoder was flushed at the end of the input and is drained
+            return 0;
+        }
+        else if (ret != AVERROR(EAGAIN))
+        {
+            printf("avcodec_receive_frame decoding error.\n");
+            return -1;
         }
 
-        // get more audio AVPacket
-        int ret = packet_queue_get(&videoState->audioq, avPacket, 1);
+        // the decoder needs more data: get more audio AVPacket
+        int serial;
+        ret = packet_queue_get(&videoState->audioq, avPacket, 1, &serial);
 
         // if packet_queue_get returns < 0, the global quit flag was set
         if (ret < 0)
@@ -1408,20 +2033,25 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
             return -1;
         }
 
-        if (avPacket->data == flush_pkt.data)
+        // a seek flushed the queue: drop the samples buffered by the decoder
+        if (serial != videoState->audio_pkt_serial)
         {
             avcodec_flush_buffers(videoState->audio_ctx);
-
-            continue;
+            videoState->audio_pkt_serial = serial;
+            videoState->audio_seek_pending = videoState->accurate_seek;
         }
 
-        audio_pkt_data = avPacket->data;
-        audio_pkt_size = avPacket->size;
+        // give the decoder raw compressed data in an AVPacket: the empty
+        // AVPacket queued at the end of the input flushes it
+        ret = avcodec_send_packet(videoState->audio_ctx, avPacket->size > 0 ? avPacket : NULL);
 
-        // keep audio_clock up-to-date
-        if (avPacket->pts != AV_NOPTS_VALUE)
+        // wipe the packet
+        av_packet_unref(avPacket);
+
+        if (ret < 0 && ret != AVERROR(EAGAIN))
         {
-            videoState->audio_clock = av_q2d(videoState->audio_st->time_base)*avPacket->pts;
+            // if error, skip the packet
+            printf("Error sending audio packet for decoding.\n");
         }
     }
 
@@ -1429,159 +2059,316 @@ int audio_decode_frame(VideoState * videoState, uint8_t * audio_buf, int buf_siz
 }
 
 /**
- * Resamples the audio data retrieved using FFmpeg before playing it.
+ * Sets up the compressed audio passthrough for the given audio stream: an
+ * spdif muxer writing its IEC 61937 bursts to videoState->spdif_buf through
+ * spdif_write_packet().
  *
- * @param   videoState          the global VideoState reference.
- * @param   decoded_audio_frame the decoded audio frame.
- * @param   out_sample_fmt      audio output sample format (e.g. AV_SAMPLE_FMT_S16).
- * @param   out_buf             audio output buffer.
+ * @param   videoState  the global VideoState reference.
+ * @param   codecpar    the audio stream codec parameters.
+ * @param   device_rate set to the sample rate of the IEC 61937 stream: the
+ *                      E-AC-3 bursts are sent at 4 times the audio rate.
  *
- * @return                      the size of the resampled audio data.
+ * @return              < 0 if the codec cannot be passed through, 0 otherwise.
  */
-static int audio_resampling(VideoState * videoState, AVFrame * decoded_audio_frame, enum AVSampleFormat out_sample_fmt, uint8_t * out_buf)
+static int audio_passthrough_init(VideoState * videoState, AVCodecParameters * codecpar, int * device_rate)
 {
-    // get an instance of the AudioResamplingState struct
-    AudioResamplingState * arState = getAudioResampling(videoState->audio_ctx->channel_layout);
+    if (codecpar->codec_id != AV_CODEC_ID_AC3 && codecpar->codec_id != AV_CODEC_ID_EAC3 && codecpar->codec_id != AV_CODEC_ID_DTS)
+    {
+        return -1;
+    }
 
-    if (!arState->swr_ctx)
+    int ret = avformat_alloc_output_context2(&videoState->spdif_ctx, NULL, "spdif", NULL);
+    if (ret < 0)
     {
-        printf("swr_alloc error.\n");
+        printf("Could not allocate the spdif muxer.\n");
         return -1;
     }
 
-    // get input audio channels
-    arState->in_channel_layout = (videoState->audio_ctx->channels ==
-                                  av_get_channel_layout_nb_channels(videoState->audio_ctx->channel_layout)) ?
-                                 videoState->audio_ctx->channel_layout :
-                                 av_get_default_channel_layout(videoState->audio_ctx->channels);
+    AVStream * stream = avformat_new_stream(videoState->spdif_ctx, NULL);
+    if (!stream || avcodec_parameters_copy(stream->codecpar, codecpar) < 0)
+    {
+        printf("Could not create the spdif stream.\n");
+        return -1;
+    }
 
-    // check input audio channels correctly retrieved
-    if (arState->in_channel_layout <= 0)
+    // the bursts are collected by spdif_write_packet(), one packet at a time
+    int io_size = 4096;
+    uint8_t * io_buffer = av_malloc(io_size);
+    if (!io_buffer)
     {
-        printf("in_channel_layout error.\n");
         return -1;
     }
 
-    // set output audio channels based on the input audio channels
-    if (videoState->audio_ctx->channels == 1)
+    videoState->spdif_ctx->pb = avio_alloc_context(io_buffer, io_size, 1, videoState, NULL, spdif_write_packet, NULL);
+    if (!videoState->spdif_ctx->pb)
+    {
+        av_free(io_buffer);
+        return -1;
+    }
+
+    ret = avformat_write_header(videoState->spdif_ctx, NULL);
+    if (ret < 0)
     {
-        arState->out_channel_layout = AV_CH_LAYOUT_MONO;
+        printf("Could not initialize the spdif muxer.\n");
+        return -1;
     }
-    else if (videoState->audio_ctx->channels == 2)
+
+    *device_rate = codecpar->codec_id == AV_CODEC_ID_EAC3 ? 4 * codecpar->sample_rate : codecpar->sample_rate;
+
+    return 0;
+}
+
+/**
+ * Get a packet from the queue and wraps it in an IEC 61937 burst, without
+ * decoding it.
+ *
+ * @param   videoState  the global VideoState reference.
+ * @param   audio_buf   set to the burst, owned by the VideoState and valid
+ *                      until the next call.
+ * @param   pts_ptr     a pointer to the pts of the burst.
+ *
+ * @return              the size of the burst, 0 at the end of the input, -1 in
+ *                      case of error or quit.
+ */
+static int audio_passthrough_frame(VideoState * videoState, uint8_t ** audio_buf, double * pts_ptr)
+{
+    AVPacket * avPacket = videoState->audio_pkt;
+
+    for (;;)
     {
-        arState->out_channel_layout = AV_CH_LAYOUT_STEREO;
+        int serial;
+        int ret = packet_queue_get(&videoState->audioq, avPacket, 1, &serial);
+
+        // if packet_queue_get returns < 0, the global quit flag was set
+        if (ret < 0)
+        {
+            return -1;
+        }
+
+        // the empty AVPacket queued at the end of the input
+        if (avPacket->size == 0)
+        {
+            av_packet_unref(avPacket);
+            return 0;
+        }
+
+        // the bursts are independent, a seek only moves the clock
+        videoState->audio_pkt_serial = serial;
+
+        if (avPacket->pts != AV_NOPTS_VALUE)
+        {
+            videoState->audio_clock = av_q2d(videoState->audio_st->time_base) * avPacket->pts;
+        }
+
+        // the spdif muxer ignores the timestamps, which jump on seeks
+        avPacket->stream_index = 0;
+        avPacket->pts = AV_NOPTS_VALUE;
+        avPacket->dts = AV_NOPTS_VALUE;
+
+        videoState->spdif_size = 0;
+        ret = av_write_frame(videoState->spdif_ctx, avPacket);
+        avio_flush(videoState->spdif_ctx->pb);
+
+        // wipe the packet
+        av_packet_unref(avPacket);
+
+        if (ret < 0)
+        {
+            // if error, skip the packet
+            printf("Error wrapping audio packet for passthrough.\n");
+            continue;
+        }
+
+        if (videoState->spdif_size > 0)
+        {
+            *audio_buf = videoState->spdif_buf;
+            *pts_ptr = videoState->audio_clock;
+            videoState->audio_clock += (double)videoState->spdif_size / videoState->audio_bytes_per_sec;
+
+            return videoState->spdif_size;
+        }
     }
-    else
+}
+
+/**
+ * AVIOContext write callback of the spdif muxer: appends the written bytes to
+ * videoState->spdif_buf, which only grows.
+ *
+ * @param   opaque      the global VideoState reference.
+ * @param   buf         the bytes written by the muxer.
+ * @param   buf_size    the number of bytes.
+ *
+ * @return              buf_size, AVERROR(ENOMEM) in case of error.
+ */
+static int spdif_write_packet(void * opaque, uint8_t * buf, int buf_size)
+{
+    VideoState * videoState = (VideoState *)opaque;
+
+    uint8_t * data = av_fast_realloc(videoState->spdif_buf, &videoState->spdif_capacity, videoState->spdif_size + buf_size);
+    if (!data)
     {
-        arState->out_channel_layout = AV_CH_LAYOUT_SURROUND;
+        return AVERROR(ENOMEM);
     }
 
-    // retrieve number of audio samples (per channel)
-    arState->in_nb_samples = decoded_audio_frame->nb_samples;
-    if (arState->in_nb_samples <= 0)
+    videoState->spdif_buf = data;
+    memcpy(videoState->spdif_buf + videoState->spdif_size, buf, buf_size);
+    videoState->spdif_size += buf_size;
+
+    return buf_size;
+}
+
+/**
+ * Frees the spdif muxer and its buffers.
+ *
+ * @param   videoState  the global VideoState reference.
+ */
+static void audio_passthrough_free(VideoState * videoState)
+{
+    if (videoState->spdif_ctx)
     {
-        printf("in_nb_samples error.\n");
-        return -1;
+        if (videoState->spdif_ctx->pb)
+        {
+            av_freep(&videoState->spdif_ctx->pb->buffer);
+            avio_context_free(&videoState->spdif_ctx->pb);
+        }
+
+        avformat_free_context(videoState->spdif_ctx);
+        videoState->spdif_ctx = NULL;
     }
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_int(
-            arState->swr_ctx,
-            "in_channel_layout",
-            arState->in_channel_layout,
-            0
-    );
+    av_freep(&videoState->spdif_buf);
+    videoState->spdif_size = 0;
+    videoState->spdif_capacity = 0;
+}
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_int(
-            arState->swr_ctx,
-            "in_sample_rate",
-            videoState->audio_ctx->sample_rate,
-            0
-    );
+/**
+ * Prints the number of wakeups per second of the audio callback, of the audio
+ * decoding thread and of decode_thread() since the audio device was started.
+ *
+ * @param   videoState  the global VideoState reference.
+ */
+static void print_wakeups(VideoState * videoState)
+{
+    if (!videoState->audio_start_time)
+    {
+        return;
+    }
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_sample_fmt(
-            arState->swr_ctx,
-            "in_sample_fmt",
-            videoState->audio_ctx->sample_fmt,
-            0
-    );
+    double seconds = (av_gettime_relative() - videoState->audio_start_time) / 1000000.0;
+    if (seconds <= 0)
+    {
+        return;
+    }
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_int(
-            arState->swr_ctx,
-            "out_channel_layout",
-            arState->out_channel_layout,
-            0
-    );
+    printf("Wakeups per second over %.1f s: audio callback %.2f, audio decoding thread %.2f, decode thread %.2f.\n",
+           seconds,
+           SDL_AtomicGet(&videoState->callback_wakeups) / seconds,
+           SDL_AtomicGet(&videoState->ring_wakeups) / seconds,
+           SDL_AtomicGet(&videoState->read_wakeups) / seconds);
+}
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_int(
-            arState->swr_ctx,
-            "out_sample_rate",
-            videoState->audio_ctx->sample_rate,
-            0
-    );
+/**
+ * Resamples the audio data retrieved using FFmpeg before playing it.
+ *
+ * The SwrContext and the output samples buffer are owned by the VideoState
+ * (videoState->audio_resampler): the context is only rebuilt when the input
+ * channel layout, sample format or sample rate changes, so the resampler filter
+ * history is preserved across frames, and the buffer only grows, it is never
+ * freed per frame.
+ *
+ * @param   videoState          the global VideoState reference.
+ * @param   decoded_audio_frame the decoded audio frame.
+ * @param   out_sample_fmt      audio output sample format (e.g. AV_SAMPLE_FMT_S16).
+ * @param   out_buf             audio output buffer, NULL to leave the resampled
+ *                              data in the AudioResamplingState buffer only.
+ *
+ * @return                      the size of the resampled audio data.
+ */
+static int audio_resampling(VideoState * videoState, AVFrame * decoded_audio_frame, enum AVSampleFormat out_sample_fmt, uint8_t * out_buf)
+{
+    // retrieve the AudioResamplingState created in stream_component_open()
+    AudioResamplingState * arState = videoState->audio_resampler;
 
-    // Set SwrContext parameters for resampling
-    av_opt_set_sample_fmt(
-            arState->swr_ctx,
-            "out_sample_fmt",
-            out_sample_fmt,
-            0
-    );
+    if (!arState)
+    {
+        printf("audio resampler not initialized.\n");
+        return -1;
+    }
 
-    // initialize SWR context after user parameters have been set
-    int ret = swr_init(arState->swr_ctx);;
-    if (ret < 0)
+    // the output format is chosen when the audio device is opened
+    if (out_sample_fmt != arState->out_sample_fmt)
     {
-        printf("Failed to initialize the resampling context.\n");
+        printf("unexpected output sample format.\n");
         return -1;
     }
 
-    arState->max_out_nb_samples = arState->out_nb_samples = av_rescale_rnd(
-            arState->in_nb_samples,
-            videoState->audio_ctx->sample_rate,
-            videoState->audio_ctx->sample_rate,
-            AV_ROUND_UP
-    );
+    // get input audio channels
+    int64_t in_channel_layout = (decoded_audio_frame->channels ==
+                                 av_get_channel_layout_nb_channels(decoded_audio_frame->channel_layout)) ?
+                                decoded_audio_frame->channel_layout :
+                                av_get_default_channel_layout(decoded_audio_frame->channels);
 
-    // check rescaling was successful
-    if (arState->max_out_nb_samples <= 0)
+    // check input audio channels correctly retrieved
+    if (in_channel_layout <= 0)
     {
-        printf("av_rescale_rnd error.\n");
+        printf("in_channel_layout error.\n");
         return -1;
     }
 
-    // get number of output audio channels
-    arState->out_nb_channels = av_get_channel_layout_nb_channels(arState->out_channel_layout);
+    // retrieve number of audio samples (per channel)
+    arState->in_nb_samples = decoded_audio_frame->nb_samples;
+    if (arState->in_nb_samples <= 0)
+    {
+        printf("in_nb_samples error.\n");
+        return -1;
+    }
 
-    // allocate data pointers array for arState->resampled_data and fill data
-    // pointers and linesize accordingly
-    ret = av_samples_alloc_array_and_samples(
-            &arState->resampled_data,
-            &arState->out_linesize,
-            arState->out_nb_channels,
-            arState->out_nb_samples,
-            out_sample_fmt,
-            0
-    );
+    // rebuild the SwrContext only if the input audio format actually changed
+    if (!arState->swr_ctx ||
+        in_channel_layout != arState->in_channel_layout ||
+        decoded_audio_frame->format != arState->in_sample_fmt ||
+        decoded_audio_frame->sample_rate != arState->in_sample_rate)
+    {
+        int ret = audio_resampling_init(
+                arState,
+                in_channel_layout,
+                decoded_audio_frame->format,
+                decoded_audio_frame->sample_rate
+        );
 
-    // check memory allocation for the resampled data was successful
-    if (ret < 0)
+        if (ret < 0)
+        {
+            return -1;
+        }
+    }
+
+    // get the number of samples this frame should produce to stay in sync
+    int wanted_nb_samples = synchronize_audio(videoState, arState->in_nb_samples);
+
+    // stretch or squeeze the audio inside the resampler instead of editing the output
+    if (wanted_nb_samples != arState->in_nb_samples)
     {
-        printf("av_samples_alloc_array_and_samples() error: Could not allocate destination samples.\n");
-        return -1;
+        int ret = swr_set_compensation(
+                arState->swr_ctx,
+                (wanted_nb_samples - arState->in_nb_samples) * arState->out_sample_rate / arState->in_sample_rate,
+                wanted_nb_samples * arState->out_sample_rate / arState->in_sample_rate
+        );
+
+        if (ret < 0)
+        {
+            printf("swr_set_compensation() failed.\n");
+            return -1;
+        }
     }
 
     // retrieve output samples number taking into account the progressive delay
+    // and the compensation; a small margin covers the resampler rounding
     arState->out_nb_samples = av_rescale_rnd(
-            swr_get_delay(arState->swr_ctx, videoState->audio_ctx->sample_rate) + arState->in_nb_samples,
-            videoState->audio_ctx->sample_rate,
-            videoState->audio_ctx->sample_rate,
+            swr_get_delay(arState->swr_ctx, arState->in_sample_rate) + wanted_nb_samples,
+            arState->out_sample_rate,
+            arState->in_sample_rate,
             AV_ROUND_UP
-    );
+    ) + 256;
 
     // check output samples number was correctly rescaled
     if (arState->out_nb_samples <= 0)
@@ -1590,112 +2377,181 @@ static int audio_resampling(VideoState * videoState, AVFrame * decoded_audio_fra
         return -1;
     }
 
+    // grow the output buffer if needed: it is kept for the whole playback
     if (arState->out_nb_samples > arState->max_out_nb_samples)
     {
-        // free memory block and set pointer to NULL
-        av_free(arState->resampled_data[0]);
-
-        // Allocate a samples buffer for out_nb_samples samples
-        ret = av_samples_alloc(
-                arState->resampled_data,
-                &arState->out_linesize,
-                arState->out_nb_channels,
-                arState->out_nb_samples,
-                out_sample_fmt,
-                1
-        );
+        int ret;
+
+        if (arState->resampled_data)
+        {
+            // free memory block and set pointer to NULL
+            av_freep(&arState->resampled_data[0]);
+
+            // Allocate a samples buffer for out_nb_samples samples
+            ret = av_samples_alloc(
+                    arState->resampled_data,
+                    &arState->out_linesize,
+                    arState->out_nb_channels,
+                    arState->out_nb_samples,
+                    arState->out_sample_fmt,
+                    1
+            );
+        }
+        else
+        {
+            // allocate data pointers array for arState->resampled_data and fill data
+            // pointers and linesize accordingly
+            ret = av_samples_alloc_array_and_samples(
+                    &arState->resampled_data,
+                    &arState->out_linesize,
+                    arState->out_nb_channels,
+                    arState->out_nb_samples,
+                    arState->out_sample_fmt,
+                    1
+            );
+        }
 
         // check samples buffer correctly allocated
         if (ret < 0)
         {
             printf("av_samples_alloc failed.\n");
+            arState->max_out_nb_samples = 0;
             return -1;
         }
 
         arState->max_out_nb_samples = arState->out_nb_samples;
     }
 
-    if (arState->swr_ctx)
-    {
-        // do the actual audio data resampling
-        ret = swr_convert(
-                arState->swr_ctx,
-                arState->resampled_data,
-                arState->out_nb_samples,
-                (const uint8_t **) decoded_audio_frame->data,
-                decoded_audio_frame->nb_samples
-        );
+    // do the actual audio data resampling
+    int ret = swr_convert(
+            arState->swr_ctx,
+            arState->resampled_data,
+            arState->out_nb_samples,
+            (const uint8_t **) decoded_audio_frame->data,
+            decoded_audio_frame->nb_samples
+    );
 
-        // check audio conversion was successful
-        if (ret < 0)
-        {
-            printf("swr_convert_error.\n");
-            return -1;
-        }
+    // check audio conversion was successful
+    if (ret < 0)
+    {
+        printf("swr_convert_error.\n");
+        return -1;
+    }
 
-        // get the required buffer size for the given audio parameters
-        arState->resampled_data_size = av_samples_get_buffer_size(
-                &arState->out_linesize,
-                arState->out_nb_channels,
-                ret,
-                out_sample_fmt,
-                1
-        );
+    // get the required buffer size for the given audio parameters
+    arState->resampled_data_size = av_samples_get_buffer_size(
+            &arState->out_linesize,
+            arState->out_nb_channels,
+            ret,
+            arState->out_sample_fmt,
+            1
+    );
 
-        // check audio buffer size
-        if (arState->resampled_data_size < 0)
-        {
-            printf("av_samples_get_buffer_size error.\n");
-            return -1;
-        }
-    }
-    else
+    // check audio buffer size
+    if (arState->resampled_data_size < 0)
     {
-        printf("swr_ctx null error.\n");
+        printf("av_samples_get_buffer_size error.\n");
         return -1;
     }
 
-    // copy the resampled data to the output buffer
-    memcpy(out_buf, arState->resampled_data[0], arState->resampled_data_size);
+    // copy the resampled data to the output buffer, if any
+    if (out_buf)
+    {
+        memcpy(out_buf, arState->resampled_data[0], arState->resampled_data_size);
+    }
 
-    /*
-     * Memory Cleanup.
-     */
-    if (arState->resampled_data)
+    return arState->resampled_data_size;
+}
+
+/**
+ * (Re)initializes the SwrContext of the given AudioResamplingState for the given
+ * input audio format. Any previous SwrContext is freed first.
+ *
+ * @param   arState             the AudioResamplingState to be (re)initialized.
+ * @param   in_channel_layout   input audio channel layout.
+ * @param   in_sample_fmt       input audio sample format.
+ * @param   in_sample_rate      input audio sample rate.
+ *
+ * @return                      < 0 in case of error, 0 otherwise.
+ */
+static int audio_resampling_init(AudioResamplingState * arState, int64_t in_channel_layout, enum AVSampleFormat in_sample_fmt, int in_sample_rate)
+{
+    // free the previous SwrContext, if any
+    swr_free(&arState->swr_ctx);
+
+    arState->swr_ctx = swr_alloc();
+    if (!arState->swr_ctx)
     {
-        // free memory block and set pointer to NULL
-        av_freep(&arState->resampled_data[0]);
+        printf("swr_alloc error.\n");
+        return -1;
     }
 
-    av_freep(&arState->resampled_data);
-    arState->resampled_data = NULL;
+    // Set SwrContext parameters for resampling
+    av_opt_set_int(arState->swr_ctx, "in_channel_layout", in_channel_layout, 0);
+    av_opt_set_int(arState->swr_ctx, "in_sample_rate", in_sample_rate, 0);
+    av_opt_set_sample_fmt(arState->swr_ctx, "in_sample_fmt", in_sample_fmt, 0);
+    av_opt_set_int(arState->swr_ctx, "out_channel_layout", arState->out_channel_layout, 0);
+    av_opt_set_int(arState->swr_ctx, "out_sample_rate", arState->out_sample_rate, 0);
+    av_opt_set_sample_fmt(arState->swr_ctx, "out_sample_fmt", arState->out_sample_fmt, 0);
 
-    if (arState->swr_ctx)
+    // initialize SWR context after user parameters have been set
+    int ret = swr_init(arState->swr_ctx);
+    if (ret < 0)
     {
-        // free the allocated SwrContext and set the pointer to NULL
+        printf("Failed to initialize the resampling context.\n");
         swr_free(&arState->swr_ctx);
+        return -1;
     }
 
-    return arState->resampled_data_size;
+    // remember the input format the SwrContext was built for
+    arState->in_channel_layout = in_channel_layout;
+    arState->in_sample_fmt = in_sample_fmt;
+    arState->in_sample_rate = in_sample_rate;
+
+    return 0;
 }
 
 /**
- * Initializes an instance of the AudioResamplingState Struct with the given
- * parameters.
+ * Initializes an instance of the AudioResamplingState Struct for the given audio
+ * codec context. The output channel layout and sample rate are the ones used to
+ * open the audio device. The SwrContext itself is created by audio_resampling()
+ * when the first decoded audio frame is available.
  *
- * @param   channel_layout  the audio codec context channel layout to be used.
+ * @param   audio_ctx       the audio codec context to be used.
+ * @param   out_sample_fmt  audio output sample format (e.g. AV_SAMPLE_FMT_S16).
  *
  * @return                  the allocated and initialized AudioResamplingState
- *                          struct instance.
+ *                          struct instance, NULL in case of error.
  */
-AudioResamplingState * getAudioResampling(uint64_t channel_layout)
+AudioResamplingState * getAudioResampling(AVCodecContext * audio_ctx, enum AVSampleFormat out_sample_fmt)
 {
     AudioResamplingState * audioResampling = av_mallocz(sizeof(AudioResamplingState));
+    if (!audioResampling)
+    {
+        return NULL;
+    }
 
-    audioResampling->swr_ctx = swr_alloc();
-    audioResampling->in_channel_layout = channel_layout;
-    audioResampling->out_channel_layout = AV_CH_LAYOUT_STEREO;
-    audioResampling->out_nb_channels = 0;
+    // set output audio channels based on the input audio channels
+    if (audio_ctx->channels == 1)
+    {
+        audioResampling->out_channel_layout = AV_CH_LAYOUT_MONO;
+    }
+    else if (audio_ctx->channels == 2)
+    {
+        audioResampling->out_channel_layout = AV_CH_LAYOUT_STEREO;
+    }
+    else
+    {
+        audioResampling->out_channel_layout = AV_CH_LAYOUT_SURROUND;
+    }
+
+    audioResampling->swr_ctx = NULL;
+    audioResampling->in_channel_layout = 0;
+    audioResampling->in_sample_fmt = AV_SAMPLE_FMT_NONE;
+    audioResampling->in_sample_rate = 0;
+    audioResampling->out_sample_fmt = out_sample_fmt;
+    audioResampling->out_sample_rate = audio_ctx->sample_rate;
+    audioResampling->out_nb_channels = av_get_channel_layout_nb_channels(audioResampling->out_channel_layout);
     audioResampling->out_linesize = 0;
     audioResampling->in_nb_samples = 0;
     audioResampling->out_nb_samples = 0;
@@ -1707,17 +2563,51 @@ AudioResamplingState * getAudioResampling(uint64_t channel_layout)
 }
 
 /**
+ * Frees the given AudioResamplingState together with its SwrContext and output
+ * samples buffer, and sets the pointer to NULL.
  *
- * @param videoState
- * @param pos
- * @param rel
+ * @param   arState the AudioResamplingState to be freed.
  */
-void stream_seek(VideoState * videoState, int64_t pos, int rel)
+void freeAudioResampling(AudioResamplingState ** arState)
+{
+    if (!arState || !*arState)
+    {
+        return;
+    }
+
+    if ((*arState)->resampled_data)
+    {
+        // free memory block and set pointer to NULL
+        av_freep(&(*arState)->resampled_data[0]);
+    }
+
+    av_freep(&(*arState)->resampled_data);
+
+    // free the allocated SwrContext and set the pointer to NULL
+    swr_free(&(*arState)->swr_ctx);
+
+    av_freep(arState);
+}
+
+/**
+ * Requests decode_thread() to seek to the given position. The request is ignored
+ * if the previous one has not been served yet.
+ *
+ * @param videoState    the global VideoState reference.
+ * @param pos           the seek target, in AV_TIME_BASE units.
+ * @param rel           the seek offset from the current position, in AV_TIME_BASE
+ *                      units: the demuxer is not allowed to land on the other
+ *                      side of the current position.
+ */
+void stream_seek(VideoState * videoState, int64_t pos, int64_t rel)
 {
     if (!videoState->seek_req)
     {
         videoState->seek_pos = pos;
-        videoState->seek_flags = rel < 0 ? AVSEEK_FLAG_BACKWARD : 0;
+        videoState->seek_rel = rel;
         videoState->seek_req = 1;
+
+        // wake the decode thread up in case it is waiting on the packet queues
+        decode_thread_wake(videoState);
     }
 }
\ No newline at end of file